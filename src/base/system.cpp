@@ -11,6 +11,7 @@
 #include <cstring>
 #include <iomanip> // std::get_time
 #include <iterator> // std::size
+#include <limits>
 #include <mutex>
 #include <sstream> // std::istringstream
 #include <string_view>
@@ -28,6 +29,7 @@
 #if defined(CONF_FAMILY_UNIX)
 #include <csignal>
 #include <locale>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/utsname.h>
@@ -111,6 +113,21 @@ void net_buffer_init(NETSOCKET_BUFFER *buffer);
 void net_buffer_reinit(NETSOCKET_BUFFER *buffer);
 void net_buffer_simple(NETSOCKET_BUFFER *buffer, char **buf, int *size);
 
+#ifdef CONF_PLATFORM_LINUX
+// packets queued by net_udp_send between net_udp_send_batch_begin and
+// net_udp_send_batch_flush
+typedef struct
+{
+	bool active;
+	int num;
+	int fds[VLEN];
+	struct mmsghdr msgs[VLEN];
+	struct iovec iovecs[VLEN];
+	char bufs[VLEN][PACKETSIZE];
+	sockaddr_in6 sockaddrs[VLEN];
+} NETSOCKET_SEND_BUFFER;
+#endif
+
 struct NETSOCKET_INTERNAL
 {
 	int type;
@@ -120,6 +137,10 @@ struct NETSOCKET_INTERNAL
 	int web_ipv6sock;
 
 	NETSOCKET_BUFFER buffer;
+#ifdef CONF_PLATFORM_LINUX
+	// allocated on the first net_udp_send_batch_begin
+	NETSOCKET_SEND_BUFFER *send_buffer;
+#endif
 };
 static NETSOCKET_INTERNAL invalid_socket = {NETTYPE_INVALID, -1, -1, -1, -1};
 
@@ -398,6 +419,41 @@ int64_t io_length(IOHANDLE io)
 	return length;
 }
 
+void *io_map(IOHANDLE io, int64_t size)
+{
+	if(size <= 0 || (uint64_t)size > (uint64_t)std::numeric_limits<size_t>::max())
+	{
+		return nullptr;
+	}
+#if defined(CONF_FAMILY_WINDOWS)
+	HANDLE mapping = CreateFileMappingW((HANDLE)_get_osfhandle(_fileno((FILE *)io)), nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+	if(mapping == nullptr)
+	{
+		return nullptr;
+	}
+	// the view keeps the mapping alive
+	void *data = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, size);
+	CloseHandle(mapping);
+	return data;
+#else
+	void *data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno((FILE *)io), 0);
+	return data == MAP_FAILED ? nullptr : data;
+#endif
+}
+
+void io_unmap(void *data, int64_t size)
+{
+	if(data == nullptr)
+	{
+		return;
+	}
+#if defined(CONF_FAMILY_WINDOWS)
+	UnmapViewOfFile(data);
+#else
+	munmap(data, size);
+#endif
+}
+
 unsigned io_write(IOHANDLE io, const void *buffer, unsigned size)
 {
 	return fwrite(buffer, 1, size, (FILE *)io);
@@ -1779,10 +1835,116 @@ NETSOCKET net_udp_create(NETADDR bindaddr)
 	return sock;
 }
 
+#if defined(CONF_PLATFORM_LINUX)
+static void net_udp_send_queued(NETSOCKET_SEND_BUFFER *buffer)
+{
+	static int64_t s_LastErrorLog = 0;
+	int pos = 0;
+	while(pos < buffer->num)
+	{
+		// sendmmsg takes one socket, send the packets for the same socket together
+		int end = pos + 1;
+		while(end < buffer->num && buffer->fds[end] == buffer->fds[pos])
+			end++;
+		const int sent = sendmmsg(buffer->fds[pos], &buffer->msgs[pos], end - pos, 0);
+		if(sent > 0)
+		{
+			for(int i = pos; i < pos + sent; i++)
+				network_stats.sent_bytes += buffer->iovecs[i].iov_len;
+			network_stats.sent_packets += sent;
+			pos += sent;
+			continue;
+		}
+
+		// skip the packet that failed, log at most once per second
+		const int64_t now = time_get();
+		if(now - s_LastErrorLog > time_freq())
+		{
+			s_LastErrorLog = now;
+			log_error("net", "Failed to send packet (%s)", net_error_message().c_str());
+		}
+		pos++;
+	}
+	buffer->num = 0;
+}
+
+// returns false if the packet has to be sent immediately
+static bool net_udp_queue(NETSOCKET sock, const NETADDR *addr, const void *data, int size)
+{
+	NETSOCKET_SEND_BUFFER *buffer = sock->send_buffer;
+	if(size > PACKETSIZE)
+		return false;
+	const unsigned type = addr->type & (NETTYPE_ALL | NETTYPE_LINK_BROADCAST);
+	int fd;
+	if(type == NETTYPE_IPV4 && sock->ipv4sock >= 0)
+		fd = sock->ipv4sock;
+	else if(type == NETTYPE_IPV6 && sock->ipv6sock >= 0)
+		fd = sock->ipv6sock;
+	else
+		return false;
+
+	if(buffer->num == VLEN)
+		net_udp_send_queued(buffer);
+	const int i = buffer->num++;
+	buffer->fds[i] = fd;
+	mem_copy(buffer->bufs[i], data, size);
+	buffer->iovecs[i].iov_base = buffer->bufs[i];
+	buffer->iovecs[i].iov_len = size;
+	msghdr &hdr = buffer->msgs[i].msg_hdr;
+	mem_zero(&hdr, sizeof(hdr));
+	hdr.msg_iov = &buffer->iovecs[i];
+	hdr.msg_iovlen = 1;
+	hdr.msg_name = &buffer->sockaddrs[i];
+	if(type == NETTYPE_IPV4)
+	{
+		netaddr_to_sockaddr_in(addr, (sockaddr_in *)&buffer->sockaddrs[i]);
+		hdr.msg_namelen = sizeof(sockaddr_in);
+	}
+	else
+	{
+		netaddr_to_sockaddr_in6(addr, &buffer->sockaddrs[i]);
+		hdr.msg_namelen = sizeof(sockaddr_in6);
+	}
+	return true;
+}
+#endif
+
+void net_udp_send_batch_begin(NETSOCKET sock)
+{
+#if defined(CONF_PLATFORM_LINUX)
+	if(sock->send_buffer == nullptr)
+	{
+		sock->send_buffer = (NETSOCKET_SEND_BUFFER *)malloc(sizeof(*sock->send_buffer));
+		sock->send_buffer->num = 0;
+	}
+	sock->send_buffer->active = true;
+#endif
+}
+
+void net_udp_send_batch_flush(NETSOCKET sock)
+{
+#if defined(CONF_PLATFORM_LINUX)
+	if(sock->send_buffer == nullptr)
+		return;
+	net_udp_send_queued(sock->send_buffer);
+	sock->send_buffer->active = false;
+#endif
+}
+
 int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size)
 {
 	int d = -1;
 
+#if defined(CONF_PLATFORM_LINUX)
+	if(sock->send_buffer != nullptr && sock->send_buffer->active)
+	{
+		// counted in the network stats once it is sent
+		if(net_udp_queue(sock, addr, data, size))
+			return size;
+		net_udp_send_queued(sock->send_buffer);
+	}
+#endif
+
 	if(addr->type & NETTYPE_IPV4)
 	{
 		if(sock->ipv4sock >= 0)
@@ -2026,6 +2188,14 @@ int net_udp_recv(NETSOCKET sock, NETADDR *addr, unsigned char **data)
 
 void net_udp_close(NETSOCKET sock)
 {
+#if defined(CONF_PLATFORM_LINUX)
+	if(sock->send_buffer != nullptr)
+	{
+		net_udp_send_queued(sock->send_buffer);
+		free(sock->send_buffer);
+		sock->send_buffer = nullptr;
+	}
+#endif
 	priv_net_close_all_sockets(sock);
 }
 
@@ -3768,6 +3938,32 @@ bool is_process_alive(PROCESS process)
 #endif
 }
 
+bool process_exit_code(PROCESS process, int *exit_code)
+{
+	*exit_code = -1;
+	if(process == INVALID_PROCESS)
+		return true;
+#if defined(CONF_FAMILY_WINDOWS)
+	DWORD code = 0;
+	if(GetExitCodeProcess(process, &code))
+	{
+		if(code == STILL_ACTIVE)
+			return false;
+		*exit_code = code;
+	}
+	CloseHandle(process);
+	return true;
+#else
+	int status;
+	const pid_t result = waitpid(process, &status, WNOHANG);
+	if(result == 0)
+		return false;
+	if(result == process && WIFEXITED(status))
+		*exit_code = WEXITSTATUS(status);
+	return true;
+#endif
+}
+
 int open_link(const char *link)
 {
 #if defined(CONF_FAMILY_WINDOWS)
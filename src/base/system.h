@@ -364,6 +364,35 @@ int64_t io_tell(IOHANDLE io);
  */
 int64_t io_length(IOHANDLE io);
 
+/**
+ * Maps a file into memory. Pages of the mapping are shared with the page
+ * cache and with other processes mapping the same file until they are
+ * written, writes stay private to the mapping and never reach the file.
+ *
+ * @ingroup File-IO
+ *
+ * @param io Handle to the file.
+ * @param size Number of bytes to map from the start of the file.
+ *
+ * @return Pointer to the mapped memory, or `nullptr` on failure.
+ *
+ * @remark The mapping stays valid after the file is closed.
+ * @remark Truncating the file while it is mapped invalidates the mapping.
+ *
+ * @see io_unmap
+ */
+void *io_map(IOHANDLE io, int64_t size);
+
+/**
+ * Releases memory mapped with @link io_map @endlink.
+ *
+ * @ingroup File-IO
+ *
+ * @param data Pointer to the mapped memory, may be `nullptr`.
+ * @param size Number of mapped bytes.
+ */
+void io_unmap(void *data, int64_t size);
+
 /**
  * Writes data from a buffer to a file.
  *
@@ -1017,6 +1046,31 @@ NETSOCKET net_udp_create(NETADDR bindaddr);
  */
 int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size);
 
+/**
+ * Starts queueing the packets sent with @link net_udp_send @endlink over an
+ * UDP socket, so that @link net_udp_send_batch_flush @endlink can send them
+ * with few system calls. Only has an effect on Linux, elsewhere the packets
+ * are still sent immediately.
+ *
+ * @ingroup Network-UDP
+ *
+ * @param sock Socket to use.
+ *
+ * @remark Packets to websocket or broadcast addresses are never queued, the
+ * queued packets are sent before them to keep the order.
+ */
+void net_udp_send_batch_begin(NETSOCKET sock);
+
+/**
+ * Sends the packets queued since @link net_udp_send_batch_begin @endlink
+ * and stops queueing.
+ *
+ * @ingroup Network-UDP
+ *
+ * @param sock Socket to use.
+ */
+void net_udp_send_batch_flush(NETSOCKET sock);
+
 /**
  * Receives a packet over an UDP socket.
  *
@@ -2041,6 +2095,22 @@ int kill_process(PROCESS process);
  */
 bool is_process_alive(PROCESS process);
 
+/**
+ * Checks if a process has exited and gets its exit code.
+ *
+ * @ingroup Shell
+ *
+ * @param process Handle/PID of the process.
+ * @param exit_code Receives the exit code if the process has exited,
+ * `-1` if it was terminated by a signal.
+ *
+ * @return `true` if the process has exited, `false` if it is still running.
+ *
+ * @remark The handle is released once the process has exited, so this must
+ * not be called again for the same process after returning `true`.
+ */
+bool process_exit_code(PROCESS process, int *exit_code);
+
 /**
  * Opens a link in the browser.
  *
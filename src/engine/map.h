@@ -36,7 +36,14 @@ class IEngineMap : public IMap
 	MACRO_INTERFACE("enginemap")
 public:
 	[[nodiscard]] virtual bool Load(const char *pMapName) = 0;
+	// Does the work of Load without replacing the loaded map, so it can run
+	// on another thread while the current map is in use. The next Load of
+	// the same map then takes the preloaded map instead of reading it again.
+	[[nodiscard]] virtual bool Preload(const char *pMapName) = 0;
 	virtual void Unload() = 0;
+	// Maps the files of the following loads into memory instead of reading
+	// them, see CDataFileReader::Open.
+	virtual void SetMapped(bool Mapped) = 0;
 	virtual bool IsLoaded() const = 0;
 	virtual IOHANDLE File() const = 0;
 
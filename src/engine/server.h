@@ -19,6 +19,7 @@
 #include <generated/protocol7.h>
 #include <generated/protocolglue.h>
 
+class CJobPool;
 struct CAntibotRoundData;
 
 // When recording a demo on the server, the ClientId -1 is used
@@ -293,6 +294,10 @@ public:
 	virtual const char *GetMapName() const = 0;
 
 	virtual bool IsSixup(int ClientId) const = 0;
+
+	// workers of sv_world_threads, shared by the game worlds of all maps.
+	// nullptr if the world only ticks on the main thread.
+	virtual CJobPool *WorldJobPool() = 0;
 };
 
 class IGameServer : public IInterface
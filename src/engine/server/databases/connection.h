@@ -66,6 +66,13 @@ public:
 	// Print expanded sql statement
 	virtual void Print() = 0;
 
+	// executes a statement without parameters and results, used for
+	// transaction control like BEGIN, COMMIT and SAVEPOINT, discards the
+	// prepared statement
+	//
+	// returns true on success
+	virtual bool Execute(const char *pStmt, char *pError, int ErrorSize) = 0;
+
 	// executes the query and returns if a result row exists and selects it
 	// when called multiple times the next row is selected
 	//
@@ -6,6 +6,8 @@
 #include <cstring>
 #include <engine/console.h>
 
+#include <algorithm>
+#include <cinttypes>
 #include <chrono>
 #include <iterator>
 #include <memory>
@@ -65,6 +67,15 @@ struct CSqlExecData
 
 	std::unique_ptr<const ISqlData> m_pThreadData;
 	const char *m_pName;
+	int m_JobNum = 0;
+	int64_t m_EnqueueTime = 0;
+
+	// whether the query is executed by the reader threads
+	bool IsRead() const
+	{
+		return m_Mode == READ_ACCESS ||
+		       (m_Mode == PRINT && m_Ptr.m_Print.m_Mode == CDbConnectionPool::Mode::READ);
+	}
 };
 
 CSqlExecData::CSqlExecData(
@@ -118,35 +129,119 @@ CSqlExecData::CSqlExecData(IConsole *pConsole, CDbConnectionPool::Mode m) :
 	m_Ptr.m_Print.m_Mode = m;
 }
 
-void CDbConnectionPool::Print(IConsole *pConsole, Mode DatabaseMode)
+// upper bounds of the latency histogram buckets in milliseconds, the last
+// bucket holds everything above
+static const int s_aLatencyBuckets[] = {1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000};
+
+void CDbConnectionPool::Enqueue(std::unique_ptr<CSqlExecData> pData)
 {
-	m_pShared->m_aQueries[m_InsertIdx++] = std::make_unique<CSqlExecData>(pConsole, DatabaseMode);
-	m_InsertIdx %= std::size(m_pShared->m_aQueries);
+	if(pData != nullptr)
+	{
+		pData->m_JobNum = m_NextJobNum++;
+		pData->m_EnqueueTime = time_get();
+		m_pShared->m_NumPending.fetch_add(1);
+	}
+	{
+		const CLockScope LockScope(m_pShared->m_QueueLock);
+		m_pShared->m_vpBackupQueue.push_back(std::move(pData));
+	}
 	m_pShared->m_NumBackup.Signal();
 }
 
+void CDbConnectionPool::Print(IConsole *pConsole, Mode DatabaseMode)
+{
+	if(DatabaseMode == Mode::READ)
+		StartReaders();
+	Enqueue(std::make_unique<CSqlExecData>(pConsole, DatabaseMode));
+}
+
+void CDbConnectionPool::PrintStats(IConsole *pConsole)
+{
+	int aQueued[NUM_LANES];
+	int NumBackup;
+	{
+		const CLockScope LockScope(m_pShared->m_QueueLock);
+		NumBackup = m_pShared->m_vpBackupQueue.size();
+		aQueued[LANE_READ] = m_pShared->m_vpReadQueue.size();
+		aQueued[LANE_WRITE] = m_pShared->m_vpWriteQueue.size();
+	}
+
+	char aBuf[512];
+	str_format(aBuf, sizeof(aBuf), "%d queries pending, %d waiting for the backup thread, %d reader threads",
+		m_pShared->m_NumPending.load(), NumBackup, m_pShared->m_NumReaders.load());
+	pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "sql", aBuf);
+
+	static_assert(std::size(s_aLatencyBuckets) + 1 == NUM_LATENCY_BUCKETS);
+	static const char *s_apLaneNames[] = {"read", "write"};
+	for(int Lane = 0; Lane < NUM_LANES; Lane++)
+	{
+		int64_t Done = 0;
+		for(const auto &Count : m_pShared->m_aaLatency[Lane])
+			Done += Count.load();
+		const double AvgMs = Done > 0 ? m_pShared->m_aLatencySumUs[Lane].load() / 1000.0 / Done : 0.0;
+		str_format(aBuf, sizeof(aBuf), "%s: %d queued (peak %d), %" PRId64 " done, average latency %.1fms",
+			s_apLaneNames[Lane], aQueued[Lane], m_pShared->m_aPeakQueue[Lane].load(), Done, AvgMs);
+		pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "sql", aBuf);
+
+		aBuf[0] = '\0';
+		for(int Bucket = 0; Bucket < NUM_LATENCY_BUCKETS; Bucket++)
+		{
+			char aBucket[64];
+			if(Bucket < (int)std::size(s_aLatencyBuckets))
+				str_format(aBucket, sizeof(aBucket), " <%dms:%" PRId64, s_aLatencyBuckets[Bucket], m_pShared->m_aaLatency[Lane][Bucket].load());
+			else
+				str_format(aBucket, sizeof(aBucket), " >=%dms:%" PRId64, s_aLatencyBuckets[Bucket - 1], m_pShared->m_aaLatency[Lane][Bucket].load());
+			str_append(aBuf, aBucket);
+		}
+		pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "sql", aBuf);
+	}
+}
+
 void CDbConnectionPool::RegisterSqliteDatabase(Mode DatabaseMode, const char aFileName[64])
 {
-	m_pShared->m_aQueries[m_InsertIdx++] = std::make_unique<CSqlExecData>(DatabaseMode, aFileName);
-	m_InsertIdx %= std::size(m_pShared->m_aQueries);
-	m_pShared->m_NumBackup.Signal();
+	if(DatabaseMode == Mode::READ)
+		StartReaders();
+	Enqueue(std::make_unique<CSqlExecData>(DatabaseMode, aFileName));
 }
 
 void CDbConnectionPool::RegisterMysqlDatabase(Mode DatabaseMode, const CMysqlConfig *pMysqlConfig)
 {
-	m_pShared->m_aQueries[m_InsertIdx++] = std::make_unique<CSqlExecData>(DatabaseMode, pMysqlConfig);
-	m_InsertIdx %= std::size(m_pShared->m_aQueries);
-	m_pShared->m_NumBackup.Signal();
+	if(DatabaseMode == Mode::READ)
+		StartReaders();
+	Enqueue(std::make_unique<CSqlExecData>(DatabaseMode, pMysqlConfig));
+}
+
+bool CDbConnectionPool::UpdateBacklogged()
+{
+	const int NumPending = m_pShared->m_NumPending.load();
+	const bool Backlogged = NumPending >= g_Config.m_SvSqlQueueLimit;
+	if(Backlogged && !m_Backlogged)
+		dbg_msg("sql", "%d queries pending, dismissing repeatable read queries until the database caught up", NumPending);
+	else if(!Backlogged && m_Backlogged)
+		dbg_msg("sql", "%d queries pending, no longer dismissing read queries", NumPending);
+	m_Backlogged = Backlogged;
+	return Backlogged;
 }
 
 void CDbConnectionPool::Execute(
 	FRead pFunc,
 	std::unique_ptr<const ISqlData> pSqlRequestData,
-	const char *pName)
+	const char *pName,
+	bool Dismissable)
 {
-	m_pShared->m_aQueries[m_InsertIdx++] = std::make_unique<CSqlExecData>(pFunc, std::move(pSqlRequestData), pName);
-	m_InsertIdx %= std::size(m_pShared->m_aQueries);
-	m_pShared->m_NumBackup.Signal();
+	StartReaders();
+	// Queries the player can repeat are dropped instead of letting the queue
+	// grow when the database can't keep up.
+	if(UpdateBacklogged() && Dismissable)
+	{
+		if(pSqlRequestData->m_pResult != nullptr)
+		{
+			pSqlRequestData->m_pResult->m_Success = false;
+			pSqlRequestData->m_pResult->m_Completed.store(true);
+		}
+		return;
+	}
+	Enqueue(std::make_unique<CSqlExecData>(pFunc, std::move(pSqlRequestData), pName));
 }
 
 void CDbConnectionPool::ExecuteWrite(
@@ -154,9 +249,9 @@ void CDbConnectionPool::ExecuteWrite(
 	std::unique_ptr<const ISqlData> pSqlRequestData,
 	const char *pName)
 {
-	m_pShared->m_aQueries[m_InsertIdx++] = std::make_unique<CSqlExecData>(pFunc, std::move(pSqlRequestData), pName);
-	m_InsertIdx %= std::size(m_pShared->m_aQueries);
-	m_pShared->m_NumBackup.Signal();
+	// Write queries are never dropped, they would lose ranks or saves.
+	UpdateBacklogged();
+	Enqueue(std::make_unique<CSqlExecData>(pFunc, std::move(pSqlRequestData), pName));
 }
 
 void CDbConnectionPool::OnShutdown()
@@ -165,7 +260,7 @@ void CDbConnectionPool::OnShutdown()
 		return;
 	m_Shutdown = true;
 	m_pShared->m_Shutdown.store(true);
-	m_pShared->m_NumBackup.Signal();
+	Enqueue(nullptr);
 	int i = 0;
 	while(m_pShared->m_Shutdown.load())
 	{
@@ -179,9 +274,39 @@ void CDbConnectionPool::OnShutdown()
 	}
 }
 
+void CDbConnectionPool::CSharedData::Finish(CSqlExecData *pData, bool Success)
+{
+	if(!Success)
+		dbg_msg("sql", "[%i] %s failed on all databases", pData->m_JobNum, pData->m_pName);
+	if(pData->m_pThreadData != nullptr && pData->m_pThreadData->m_pResult != nullptr)
+	{
+		pData->m_pThreadData->m_pResult->m_Success = Success;
+		pData->m_pThreadData->m_pResult->m_Completed.store(true);
+	}
+	if(pData->m_Mode == CSqlExecData::READ_ACCESS || pData->m_Mode == CSqlExecData::WRITE_ACCESS)
+	{
+		const int Lane = pData->m_Mode == CSqlExecData::READ_ACCESS ? LANE_READ : LANE_WRITE;
+		const int64_t LatencyUs = (time_get() - pData->m_EnqueueTime) * 1000000 / time_freq();
+		int Bucket = 0;
+		while(Bucket < (int)std::size(s_aLatencyBuckets) && LatencyUs >= s_aLatencyBuckets[Bucket] * (int64_t)1000)
+			Bucket++;
+		m_aaLatency[Lane][Bucket].fetch_add(1);
+		m_aLatencySumUs[Lane].fetch_add(LatencyUs);
+	}
+	m_NumPending.fetch_sub(1);
+}
+
+void CDbConnectionPool::CSharedData::ThreadExited()
+{
+	// the last thread tells the main thread that all queries are processed
+	if(m_NumRunning.fetch_sub(1) == 1)
+		m_Shutdown.store(false);
+}
+
 // The backup worker thread looks at write queries and stores them
 // in the sqlite database (WRITE_BACKUP). It skips over read queries.
-// After processing the query, it gets passed on to the Worker thread.
+// After processing the query, it gets passed on to the writer thread or
+// the reader threads.
 // This is done to not loose ranks when the server shuts down before all
 // queries are executed on the mysql server
 class CBackup
@@ -195,6 +320,7 @@ private:
 	bool m_DebugSql;
 
 	void ProcessQueries();
+	void PassOn(std::unique_ptr<CSqlExecData> pThreadData);
 
 	std::unique_ptr<IDbConnection> m_pWriteBackup;
 
@@ -211,18 +337,34 @@ void CBackup::Start(void *pUser)
 
 void CBackup::ProcessQueries()
 {
-	for(int JobNum = 0;; JobNum++)
+	while(true)
 	{
 		m_pShared->m_NumBackup.Wait();
-		CSqlExecData *pThreadData = m_pShared->m_aQueries[JobNum % std::size(m_pShared->m_aQueries)].get();
+		std::unique_ptr<CSqlExecData> pThreadData;
+		{
+			const CLockScope LockScope(m_pShared->m_QueueLock);
+			pThreadData = std::move(m_pShared->m_vpBackupQueue.front());
+			m_pShared->m_vpBackupQueue.pop_front();
+		}
 
 		// work through all database jobs after OnShutdown is called before exiting the thread
 		if(pThreadData == nullptr)
 		{
-			m_pShared->m_NumWorker.Signal();
+			PassOn(nullptr);
 			return;
 		}
 
+		if((pThreadData->m_Mode == CSqlExecData::ADD_SQLITE && pThreadData->m_Ptr.m_Sqlite.m_Mode == CDbConnectionPool::Mode::READ) ||
+			(pThreadData->m_Mode == CSqlExecData::ADD_MYSQL && pThreadData->m_Ptr.m_Mysql.m_Mode == CDbConnectionPool::Mode::READ))
+		{
+			// the reader threads pick up the new database before their next
+			// query, which is always enqueued after this one
+			m_pShared->Finish(pThreadData.get(), true);
+			const CLockScope LockScope(m_pShared->m_QueueLock);
+			m_pShared->m_vpReadDatabases.push_back(std::move(pThreadData));
+			continue;
+		}
+
 		if(pThreadData->m_Mode == CSqlExecData::ADD_SQLITE &&
 			pThreadData->m_Ptr.m_Sqlite.m_Mode == CDbConnectionPool::Mode::WRITE_BACKUP)
 		{
@@ -230,40 +372,81 @@ void CBackup::ProcessQueries()
 		}
 		else if(pThreadData->m_Mode == CSqlExecData::WRITE_ACCESS && m_pWriteBackup.get())
 		{
-			bool Success = CDbConnectionPool::ExecSqlFunc(m_pWriteBackup.get(), pThreadData, Write::BACKUP_FIRST);
+			bool Success = CDbConnectionPool::ExecSqlFunc(m_pWriteBackup.get(), pThreadData.get(), Write::BACKUP_FIRST);
 			if(m_DebugSql || !Success)
-				dbg_msg("sql", "[%i] %s done on write backup database, Success=%i", JobNum, pThreadData->m_pName, Success);
+				dbg_msg("sql", "[%i] %s done on write backup database, Success=%i", pThreadData->m_JobNum, pThreadData->m_pName, Success);
 		}
-		m_pShared->m_NumWorker.Signal();
+		PassOn(std::move(pThreadData));
+	}
+}
+
+void CBackup::PassOn(std::unique_ptr<CSqlExecData> pThreadData)
+{
+	if(pThreadData == nullptr)
+	{
+		// every thread needs its own shutdown signal
+		const int NumReaders = m_pShared->m_NumReaders.load();
+		{
+			const CLockScope LockScope(m_pShared->m_QueueLock);
+			m_pShared->m_vpWriteQueue.push_back(nullptr);
+			for(int i = 0; i < NumReaders; i++)
+				m_pShared->m_vpReadQueue.push_back(nullptr);
+		}
+		m_pShared->m_NumWrite.Signal();
+		for(int i = 0; i < NumReaders; i++)
+			m_pShared->m_NumRead.Signal();
+		return;
 	}
+
+	const bool Read = pThreadData->IsRead();
+	const int Lane = Read ? CDbConnectionPool::LANE_READ : CDbConnectionPool::LANE_WRITE;
+	int Queued;
+	{
+		const CLockScope LockScope(m_pShared->m_QueueLock);
+		auto &vpQueue = Read ? m_pShared->m_vpReadQueue : m_pShared->m_vpWriteQueue;
+		vpQueue.push_back(std::move(pThreadData));
+		Queued = vpQueue.size();
+	}
+	if(Queued > m_pShared->m_aPeakQueue[Lane].load())
+		m_pShared->m_aPeakQueue[Lane].store(Queued);
+	if(Read)
+		m_pShared->m_NumRead.Signal();
+	else
+		m_pShared->m_NumWrite.Signal();
+}
+
+static std::unique_ptr<IDbConnection> CreateConnection(const CSqlExecData *pThreadData)
+{
+	if(pThreadData->m_Mode == CSqlExecData::ADD_MYSQL)
+		return CreateMysqlConnection(pThreadData->m_Ptr.m_Mysql.m_Config);
+	return CreateSqliteConnection(pThreadData->m_Ptr.m_Sqlite.m_FileName, true);
 }
 
-// the worker threads executes queries on mysql or sqlite. If we write on
-// a mysql server and have a backup server configured, we'll remove the
-// entry from the backup server after completing it on the write server.
-// static void Worker(void *pUser);
-class CWorker
+// The writer thread executes the write queries on mysql or sqlite, one after
+// another in the order they were added, so that the queries of a player or
+// team never overtake each other. If we write on a mysql server and have a
+// backup server configured, we'll remove the entry from the backup server
+// after completing it on the write server.
+class CWriter
 {
 public:
-	CWorker(std::shared_ptr<CDbConnectionPool::CSharedData> pShared, int DebugSql) :
+	CWriter(std::shared_ptr<CDbConnectionPool::CSharedData> pShared, int DebugSql) :
 		m_DebugSql(DebugSql), m_pShared(std::move(pShared)) {}
 	static void Start(void *pUser);
 	void ProcessQueries();
 
 private:
 	void Print(IConsole *pConsole, CDbConnectionPool::Mode DatabaseMode);
+	// returns the next query, or nullptr if OnlyWrite is set and the next query
+	// isn't a write query
+	std::unique_ptr<CSqlExecData> PopQuery(bool OnlyWrite);
+	void ProcessWrites(std::vector<std::unique_ptr<CSqlExecData>> &vpBatch, bool &FailMode);
 
 	bool m_DebugSql;
 
-	// There are two possible configurations
-	//  * sqlite mode: There exists exactly one READ and the same WRITE server
-	//                 with no WRITE_BACKUP server
-	//  * mysql mode: there can exist multiple READ server, there must be at
-	//                most one WRITE server. The WRITE server for all DDNet
-	//                Servers must be the same (to counteract double loads).
-	//                There may be one WRITE_BACKUP sqlite server.
-	// This variable should only change, before the worker threads
-	std::vector<std::unique_ptr<IDbConnection>> m_vpReadConnections;
+	// There must be at most one WRITE server. The WRITE server for all DDNet
+	// Servers must be the same (to counteract double loads). There may be one
+	// WRITE_BACKUP sqlite server.
 	std::unique_ptr<IDbConnection> m_pWriteConnection;
 	std::unique_ptr<IDbConnection> m_pWriteBackup;
 
@@ -271,131 +454,64 @@ private:
 };
 
 /* static */
-void CWorker::Start(void *pUser)
+void CWriter::Start(void *pUser)
 {
-	CWorker *pThis = (CWorker *)pUser;
+	CWriter *pThis = (CWriter *)pUser;
 	pThis->ProcessQueries();
 	delete pThis;
 }
 
-void CWorker::ProcessQueries()
+void CWriter::ProcessQueries()
 {
-	// remember last working server and try to connect to it first
-	int ReadServer = 0;
-	// enter fail mode when a sql request fails, skip read request during it and
-	// write to the backup database until all requests are handled
+	// enter fail mode when a sql request fails and write to the backup
+	// database until all requests are handled
 	bool FailMode = false;
-	for(int JobNum = 0;; JobNum++)
+	while(true)
 	{
-		if(FailMode && m_pShared->m_NumWorker.GetApproximateValue() == 0)
+		if(FailMode && m_pShared->m_NumWrite.GetApproximateValue() == 0)
 		{
 			FailMode = false;
 		}
-		m_pShared->m_NumWorker.Wait();
-		auto pThreadData = std::move(m_pShared->m_aQueries[JobNum % std::size(m_pShared->m_aQueries)]);
+		m_pShared->m_NumWrite.Wait();
+		auto pThreadData = PopQuery(false);
 		// work through all database jobs after OnShutdown is called before exiting the thread
 		if(pThreadData == nullptr)
 		{
-			m_pShared->m_Shutdown.store(false);
+			m_pShared->ThreadExited();
 			return;
 		}
 		bool Success = false;
 		switch(pThreadData->m_Mode)
 		{
-		case CSqlExecData::READ_ACCESS:
+		case CSqlExecData::WRITE_ACCESS:
 		{
-			for(size_t i = 0; i < m_vpReadConnections.size(); i++)
+			std::vector<std::unique_ptr<CSqlExecData>> vpBatch;
+			vpBatch.push_back(std::move(pThreadData));
+			// coalesce the write queries that are already waiting into one
+			// transaction, they only go to the backup database otherwise
+			if(!m_pShared->m_Shutdown && !FailMode)
 			{
-				if(m_pShared->m_Shutdown)
-				{
-					dbg_msg("sql", "[%i] %s dismissed read request during shutdown", JobNum, pThreadData->m_pName);
-					break;
-				}
-				if(FailMode)
-				{
-					dbg_msg("sql", "[%i] %s dismissed read request during FailMode", JobNum, pThreadData->m_pName);
-					break;
-				}
-				int CurServer = (ReadServer + i) % (int)m_vpReadConnections.size();
-				if(CDbConnectionPool::ExecSqlFunc(m_vpReadConnections[CurServer].get(), pThreadData.get(), Write::NORMAL))
+				while((int)vpBatch.size() < g_Config.m_SvSqlWriteBatch)
 				{
-					ReadServer = CurServer;
-					if(m_DebugSql)
-						dbg_msg("sql", "[%i] %s done on read database %d", JobNum, pThreadData->m_pName, CurServer);
-					Success = true;
-					break;
+					auto pNext = PopQuery(true);
+					if(pNext == nullptr)
+						break;
+					// consume the signal belonging to the query
+					m_pShared->m_NumWrite.Wait();
+					vpBatch.push_back(std::move(pNext));
 				}
 			}
-			if(!Success)
-			{
-				FailMode = true;
-			}
-		}
-		break;
-		case CSqlExecData::WRITE_ACCESS:
-		{
-			if(m_pShared->m_Shutdown && m_pWriteBackup != nullptr)
-			{
-				dbg_msg("sql", "[%i] %s skipped to backup database during shutdown", JobNum, pThreadData->m_pName);
-			}
-			else if(FailMode && m_pWriteBackup != nullptr)
-			{
-				dbg_msg("sql", "[%i] %s skipped to backup database during FailMode", JobNum, pThreadData->m_pName);
-			}
-			else if(CDbConnectionPool::ExecSqlFunc(m_pWriteConnection.get(), pThreadData.get(), Write::NORMAL))
-			{
-				if(m_DebugSql)
-					dbg_msg("sql", "[%i] %s done on write database", JobNum, pThreadData->m_pName);
-				Success = true;
-			}
-			// enter fail mode if not successful
-			FailMode = FailMode || !Success;
-			const Write w = Success ? Write::NORMAL_SUCCEEDED : Write::NORMAL_FAILED;
-			if(m_pWriteBackup && CDbConnectionPool::ExecSqlFunc(m_pWriteBackup.get(), pThreadData.get(), w))
-			{
-				if(m_DebugSql)
-					dbg_msg("sql", "[%i] %s done move write on backup database to non-backup table", JobNum, pThreadData->m_pName);
-				Success = true;
-			}
+			ProcessWrites(vpBatch, FailMode);
+			continue;
 		}
-		break;
 		case CSqlExecData::ADD_MYSQL:
-		{
-			auto pMysql = CreateMysqlConnection(pThreadData->m_Ptr.m_Mysql.m_Config);
-			switch(pThreadData->m_Ptr.m_Mysql.m_Mode)
-			{
-			case CDbConnectionPool::Mode::READ:
-				m_vpReadConnections.push_back(std::move(pMysql));
-				break;
-			case CDbConnectionPool::Mode::WRITE:
-				m_pWriteConnection = std::move(pMysql);
-				break;
-			case CDbConnectionPool::Mode::WRITE_BACKUP:
-				m_pWriteBackup = std::move(pMysql);
-				break;
-			case CDbConnectionPool::Mode::NUM_MODES:
-				break;
-			}
-			Success = true;
-			break;
-		}
 		case CSqlExecData::ADD_SQLITE:
 		{
-			auto pSqlite = CreateSqliteConnection(pThreadData->m_Ptr.m_Sqlite.m_FileName, true);
-			switch(pThreadData->m_Ptr.m_Sqlite.m_Mode)
-			{
-			case CDbConnectionPool::Mode::READ:
-				m_vpReadConnections.push_back(std::move(pSqlite));
-				break;
-			case CDbConnectionPool::Mode::WRITE:
-				m_pWriteConnection = std::move(pSqlite);
-				break;
-			case CDbConnectionPool::Mode::WRITE_BACKUP:
-				m_pWriteBackup = std::move(pSqlite);
-				break;
-			case CDbConnectionPool::Mode::NUM_MODES:
-				break;
-			}
+			const CDbConnectionPool::Mode Mode = pThreadData->m_Mode == CSqlExecData::ADD_MYSQL ? pThreadData->m_Ptr.m_Mysql.m_Mode : pThreadData->m_Ptr.m_Sqlite.m_Mode;
+			if(Mode == CDbConnectionPool::Mode::WRITE)
+				m_pWriteConnection = CreateConnection(pThreadData.get());
+			else if(Mode == CDbConnectionPool::Mode::WRITE_BACKUP)
+				m_pWriteBackup = CreateConnection(pThreadData.get());
 			Success = true;
 			break;
 		}
@@ -403,27 +519,71 @@ void CWorker::ProcessQueries()
 			Print(pThreadData->m_Ptr.m_Print.m_pConsole, pThreadData->m_Ptr.m_Print.m_Mode);
 			Success = true;
 			break;
+		case CSqlExecData::READ_ACCESS:
+			dbg_assert(false, "read query passed to the writer thread");
+			break;
 		}
-		if(!Success)
-			dbg_msg("sql", "[%i] %s failed on all databases", JobNum, pThreadData->m_pName);
-		if(pThreadData->m_pThreadData != nullptr && pThreadData->m_pThreadData->m_pResult != nullptr)
-		{
-			pThreadData->m_pThreadData->m_pResult->m_Success = Success;
-			pThreadData->m_pThreadData->m_pResult->m_Completed.store(true);
-		}
+		m_pShared->Finish(pThreadData.get(), Success);
 	}
 }
 
-void CWorker::Print(IConsole *pConsole, CDbConnectionPool::Mode DatabaseMode)
+std::unique_ptr<CSqlExecData> CWriter::PopQuery(bool OnlyWrite)
 {
-	if(DatabaseMode == CDbConnectionPool::Mode::READ)
+	const CLockScope LockScope(m_pShared->m_QueueLock);
+	auto &vpQueue = m_pShared->m_vpWriteQueue;
+	if(OnlyWrite && (vpQueue.empty() || vpQueue.front() == nullptr || vpQueue.front()->m_Mode != CSqlExecData::WRITE_ACCESS))
+		return nullptr;
+	auto pThreadData = std::move(vpQueue.front());
+	vpQueue.pop_front();
+	return pThreadData;
+}
+
+void CWriter::ProcessWrites(std::vector<std::unique_ptr<CSqlExecData>> &vpBatch, bool &FailMode)
+{
+	std::vector<bool> vSuccess(vpBatch.size(), false);
+	if(m_pShared->m_Shutdown && m_pWriteBackup != nullptr)
+	{
+		for(const auto &pThreadData : vpBatch)
+			dbg_msg("sql", "[%i] %s skipped to backup database during shutdown", pThreadData->m_JobNum, pThreadData->m_pName);
+	}
+	else if(FailMode && m_pWriteBackup != nullptr)
+	{
+		for(const auto &pThreadData : vpBatch)
+			dbg_msg("sql", "[%i] %s skipped to backup database during FailMode", pThreadData->m_JobNum, pThreadData->m_pName);
+	}
+	else if(vpBatch.size() == 1)
+	{
+		vSuccess[0] = CDbConnectionPool::ExecSqlFunc(m_pWriteConnection.get(), vpBatch[0].get(), Write::NORMAL);
+	}
+	else
 	{
-		for(auto &pReadConnection : m_vpReadConnections)
-			pReadConnection->Print(pConsole, "Read");
-		if(m_vpReadConnections.empty())
-			pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", "There are no read databases");
+		CDbConnectionPool::ExecSqlBatch(m_pWriteConnection.get(), vpBatch, vSuccess);
+		if(m_DebugSql)
+			dbg_msg("sql", "[%i-%i] batch of %d queries done on write database", vpBatch.front()->m_JobNum, vpBatch.back()->m_JobNum, (int)vpBatch.size());
 	}
-	else if(DatabaseMode == CDbConnectionPool::Mode::WRITE)
+
+	for(size_t i = 0; i < vpBatch.size(); i++)
+	{
+		CSqlExecData *pThreadData = vpBatch[i].get();
+		bool Success = vSuccess[i];
+		if(Success && m_DebugSql)
+			dbg_msg("sql", "[%i] %s done on write database", pThreadData->m_JobNum, pThreadData->m_pName);
+		// enter fail mode if not successful
+		FailMode = FailMode || !Success;
+		const Write w = Success ? Write::NORMAL_SUCCEEDED : Write::NORMAL_FAILED;
+		if(m_pWriteBackup && CDbConnectionPool::ExecSqlFunc(m_pWriteBackup.get(), pThreadData, w))
+		{
+			if(m_DebugSql)
+				dbg_msg("sql", "[%i] %s done move write on backup database to non-backup table", pThreadData->m_JobNum, pThreadData->m_pName);
+			Success = true;
+		}
+		m_pShared->Finish(pThreadData, Success);
+	}
+}
+
+void CWriter::Print(IConsole *pConsole, CDbConnectionPool::Mode DatabaseMode)
+{
+	if(DatabaseMode == CDbConnectionPool::Mode::WRITE)
 	{
 		if(m_pWriteConnection)
 			m_pWriteConnection->Print(pConsole, "Write");
@@ -439,6 +599,137 @@ void CWorker::Print(IConsole *pConsole, CDbConnectionPool::Mode DatabaseMode)
 	}
 }
 
+// The reader threads execute the read queries in parallel to each other and
+// to the writer thread, so that slow reads don't delay the saving of ranks.
+// Every reader has its own connections to all read databases.
+//  * sqlite mode: There exists exactly one READ and the same WRITE server
+//                 with no WRITE_BACKUP server
+//  * mysql mode: there can exist multiple READ server
+class CReader
+{
+public:
+	CReader(std::shared_ptr<CDbConnectionPool::CSharedData> pShared, int DebugSql, int ReaderId) :
+		m_DebugSql(DebugSql), m_ReaderId(ReaderId), m_pShared(std::move(pShared)) {}
+	static void Start(void *pUser);
+	void ProcessQueries();
+
+private:
+	// opens the connections to the read databases registered since the
+	// last query
+	void AddDatabases();
+	void Print(IConsole *pConsole);
+
+	bool m_DebugSql;
+	int m_ReaderId;
+
+	std::vector<std::unique_ptr<IDbConnection>> m_vpReadConnections;
+
+	std::shared_ptr<CDbConnectionPool::CSharedData> m_pShared;
+};
+
+/* static */
+void CReader::Start(void *pUser)
+{
+	CReader *pThis = (CReader *)pUser;
+	pThis->ProcessQueries();
+	delete pThis;
+}
+
+void CReader::ProcessQueries()
+{
+	// remember last working server and try to connect to it first
+	int ReadServer = 0;
+	// enter fail mode when a sql request fails, skip read requests during it
+	// until all requests are handled
+	bool FailMode = false;
+	while(true)
+	{
+		if(FailMode && m_pShared->m_NumRead.GetApproximateValue() == 0)
+		{
+			FailMode = false;
+		}
+		m_pShared->m_NumRead.Wait();
+		std::unique_ptr<CSqlExecData> pThreadData;
+		{
+			const CLockScope LockScope(m_pShared->m_QueueLock);
+			pThreadData = std::move(m_pShared->m_vpReadQueue.front());
+			m_pShared->m_vpReadQueue.pop_front();
+		}
+		// work through all database jobs after OnShutdown is called before exiting the thread
+		if(pThreadData == nullptr)
+		{
+			m_pShared->ThreadExited();
+			return;
+		}
+		AddDatabases();
+
+		if(pThreadData->m_Mode == CSqlExecData::PRINT)
+		{
+			Print(pThreadData->m_Ptr.m_Print.m_pConsole);
+			m_pShared->Finish(pThreadData.get(), true);
+			continue;
+		}
+
+		bool Success = false;
+		for(size_t i = 0; i < m_vpReadConnections.size(); i++)
+		{
+			if(m_pShared->m_Shutdown)
+			{
+				dbg_msg("sql", "[%i] %s dismissed read request during shutdown", pThreadData->m_JobNum, pThreadData->m_pName);
+				break;
+			}
+			if(FailMode)
+			{
+				dbg_msg("sql", "[%i] %s dismissed read request during FailMode", pThreadData->m_JobNum, pThreadData->m_pName);
+				break;
+			}
+			int CurServer = (ReadServer + i) % (int)m_vpReadConnections.size();
+			if(CDbConnectionPool::ExecSqlFunc(m_vpReadConnections[CurServer].get(), pThreadData.get(), Write::NORMAL))
+			{
+				ReadServer = CurServer;
+				if(m_DebugSql)
+					dbg_msg("sql", "[%i] %s done on read database %d by reader %d", pThreadData->m_JobNum, pThreadData->m_pName, CurServer, m_ReaderId);
+				Success = true;
+				break;
+			}
+		}
+		if(!Success)
+		{
+			FailMode = true;
+		}
+		m_pShared->Finish(pThreadData.get(), Success);
+	}
+}
+
+void CReader::AddDatabases()
+{
+	const CLockScope LockScope(m_pShared->m_QueueLock);
+	for(size_t i = m_vpReadConnections.size(); i < m_pShared->m_vpReadDatabases.size(); i++)
+		m_vpReadConnections.push_back(CreateConnection(m_pShared->m_vpReadDatabases[i].get()));
+}
+
+void CReader::Print(IConsole *pConsole)
+{
+	for(auto &pReadConnection : m_vpReadConnections)
+		pReadConnection->Print(pConsole, "Read");
+	if(m_vpReadConnections.empty())
+		pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", "There are no read databases");
+}
+
+static bool CallSqlFunc(IDbConnection *pConnection, CSqlExecData *pData, Write w, char *pError, int ErrorSize)
+{
+	switch(pData->m_Mode)
+	{
+	case CSqlExecData::READ_ACCESS:
+		return pData->m_Ptr.m_pReadFunc(pConnection, pData->m_pThreadData.get(), pError, ErrorSize);
+	case CSqlExecData::WRITE_ACCESS:
+		return pData->m_Ptr.m_pWriteFunc(pConnection, pData->m_pThreadData.get(), w, pError, ErrorSize);
+	default:
+		dbg_assert(false, "unreachable");
+	}
+	return false;
+}
+
 /* static */
 bool CDbConnectionPool::ExecSqlFunc(IDbConnection *pConnection, CSqlExecData *pData, Write w)
 {
@@ -453,18 +744,7 @@ bool CDbConnectionPool::ExecSqlFunc(IDbConnection *pConnection, CSqlExecData *pD
 		dbg_msg("sql", "failed connecting to db: %s", aError);
 		return false;
 	}
-	bool Success = false;
-	switch(pData->m_Mode)
-	{
-	case CSqlExecData::READ_ACCESS:
-		Success = pData->m_Ptr.m_pReadFunc(pConnection, pData->m_pThreadData.get(), aError, sizeof(aError));
-		break;
-	case CSqlExecData::WRITE_ACCESS:
-		Success = pData->m_Ptr.m_pWriteFunc(pConnection, pData->m_pThreadData.get(), w, aError, sizeof(aError));
-		break;
-	default:
-		dbg_assert(false, "unreachable");
-	}
+	bool Success = CallSqlFunc(pConnection, pData, w, aError, sizeof(aError));
 	pConnection->Disconnect();
 	if(!Success)
 	{
@@ -473,18 +753,86 @@ bool CDbConnectionPool::ExecSqlFunc(IDbConnection *pConnection, CSqlExecData *pD
 	return Success;
 }
 
+/* static */
+void CDbConnectionPool::ExecSqlBatch(IDbConnection *pConnection, std::vector<std::unique_ptr<CSqlExecData>> &vpData, std::vector<bool> &vSuccess)
+{
+	if(pConnection == nullptr)
+	{
+		dbg_msg("sql", "No database given");
+		return;
+	}
+	char aError[256] = "unknown error";
+	if(!pConnection->Connect(aError, sizeof(aError)))
+	{
+		dbg_msg("sql", "failed connecting to db: %s", aError);
+		return;
+	}
+	bool Committed = false;
+	if(pConnection->Execute("BEGIN", aError, sizeof(aError)))
+	{
+		bool TransactionOk = true;
+		for(size_t i = 0; i < vpData.size() && TransactionOk; i++)
+		{
+			// every query gets its own savepoint, so a failing query doesn't
+			// take the other queries of the batch with it
+			if(!pConnection->Execute("SAVEPOINT batch_query", aError, sizeof(aError)))
+			{
+				TransactionOk = false;
+				break;
+			}
+			str_copy(aError, "unknown error");
+			vSuccess[i] = CallSqlFunc(pConnection, vpData[i].get(), Write::NORMAL, aError, sizeof(aError));
+			if(!vSuccess[i])
+			{
+				dbg_msg("sql", "%s failed: %s", vpData[i]->m_pName, aError);
+				TransactionOk = pConnection->Execute("ROLLBACK TO SAVEPOINT batch_query", aError, sizeof(aError));
+			}
+			TransactionOk = TransactionOk && pConnection->Execute("RELEASE SAVEPOINT batch_query", aError, sizeof(aError));
+		}
+		Committed = TransactionOk && pConnection->Execute("COMMIT", aError, sizeof(aError));
+		if(!Committed)
+		{
+			dbg_msg("sql", "batch of %d queries failed: %s", (int)vpData.size(), aError);
+			char aRollbackError[256];
+			if(!pConnection->Execute("ROLLBACK", aRollbackError, sizeof(aRollbackError)))
+				dbg_msg("sql", "failed rolling back batch: %s", aRollbackError);
+		}
+	}
+	else
+	{
+		dbg_msg("sql", "failed starting transaction: %s", aError);
+	}
+	pConnection->Disconnect();
+	if(!Committed)
+		std::fill(vSuccess.begin(), vSuccess.end(), false);
+}
+
 CDbConnectionPool::CDbConnectionPool()
 {
 	m_pShared = std::make_shared<CSharedData>();
-	m_pWorkerThread = thread_init(CWorker::Start, new CWorker(m_pShared, g_Config.m_DbgSql), "database worker thread");
+	m_pShared->m_NumRunning.store(1);
+	m_pWriterThread = thread_init(CWriter::Start, new CWriter(m_pShared, g_Config.m_DbgSql), "database writer thread");
 	m_pBackupThread = thread_init(CBackup::Start, new CBackup(m_pShared, g_Config.m_DbgSql), "database backup worker thread");
 }
 
 CDbConnectionPool::~CDbConnectionPool()
 {
 	OnShutdown();
-	if(m_pWorkerThread)
-		thread_wait(m_pWorkerThread);
+	if(m_pWriterThread)
+		thread_wait(m_pWriterThread);
 	if(m_pBackupThread)
 		thread_wait(m_pBackupThread);
+	for(void *pReaderThread : m_vpReaderThreads)
+		thread_wait(pReaderThread);
+}
+
+void CDbConnectionPool::StartReaders()
+{
+	if(!m_vpReaderThreads.empty() || m_Shutdown)
+		return;
+	const int NumReaders = g_Config.m_SvSqlReadWorkers;
+	m_pShared->m_NumRunning.fetch_add(NumReaders);
+	m_pShared->m_NumReaders.store(NumReaders);
+	for(int i = 0; i < NumReaders; i++)
+		m_vpReaderThreads.push_back(thread_init(CReader::Start, new CReader(m_pShared, g_Config.m_DbgSql, i), "database reader thread"));
 }
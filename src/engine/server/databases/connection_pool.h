@@ -2,7 +2,10 @@
 #define ENGINE_SERVER_DATABASES_CONNECTION_POOL_H
 
 #include <atomic>
+#include <base/lock.h>
 #include <base/tl/threading.h>
+#include <cstdint>
+#include <deque>
 #include <memory>
 #include <vector>
 
@@ -77,14 +80,19 @@ public:
 	};
 
 	void Print(IConsole *pConsole, Mode DatabaseMode);
+	// prints the queue depths and the latency histograms of the queries
+	void PrintStats(IConsole *pConsole);
 
 	void RegisterSqliteDatabase(Mode DatabaseMode, const char FileName[64]);
 	void RegisterMysqlDatabase(Mode DatabaseMode, const CMysqlConfig *pMysqlConfig);
 
+	// Dismissable queries are dropped while more than sv_sql_queue_limit
+	// queries are pending. Only set it for queries the player can repeat.
 	void Execute(
 		FRead pFunc,
 		std::unique_ptr<const ISqlData> pSqlRequestData,
-		const char *pName);
+		const char *pName,
+		bool Dismissable = false);
 	// writes to WRITE_BACKUP first and removes it from there when successfully
 	// executed on WRITE server
 	void ExecuteWrite(
@@ -94,40 +102,93 @@ public:
 
 	void OnShutdown();
 
-	friend class CWorker;
+	friend class CWriter;
+	friend class CReader;
 	friend class CBackup;
 
 private:
 	static bool ExecSqlFunc(IDbConnection *pConnection, struct CSqlExecData *pData, Write w);
+	// Executes the write queries in one transaction. A failing query is rolled
+	// back on its own, the other queries of the batch are still committed.
+	static void ExecSqlBatch(IDbConnection *pConnection, std::vector<std::unique_ptr<struct CSqlExecData>> &vpData, std::vector<bool> &vSuccess);
+
+	void Enqueue(std::unique_ptr<struct CSqlExecData> pData);
+	// Starts the reader threads. Done on the first read access instead of in
+	// the constructor, so that sv_sql_read_workers is already loaded.
+	void StartReaders();
+	// Updates m_Backlogged and logs when it changes
+	bool UpdateBacklogged();
+
+	enum
+	{
+		LANE_READ,
+		LANE_WRITE,
+		NUM_LANES,
 
-	// Only the main thread accesses this variable. It points to the index,
-	// where the next query is added to the queue.
-	int m_InsertIdx = 0;
+		NUM_LATENCY_BUCKETS = 13,
+	};
 
 	bool m_Shutdown = false;
+	// Only the main thread accesses this variable. Numbers the queries for
+	// the debug output of the threads.
+	int m_NextJobNum = 0;
+	// Only the main thread accesses this variable. Set while more queries than
+	// sv_sql_queue_limit are pending, to only log when it changes.
+	bool m_Backlogged = false;
 
 	struct CSharedData
 	{
 		// Used as signal that shutdown is in progress from main thread to
 		// speed up the queries by discarding read queries and writing to
 		// the sqlite file instead of the remote mysql server.
-		// The worker thread signals the main thread that all queries are
+		// The worker threads signal the main thread that all queries are
 		// processed by setting this variable to false again.
 		std::atomic_bool m_Shutdown{false};
 		// Queries go first to the backup thread. This semaphore signals about
 		// new queries.
 		CSemaphore m_NumBackup;
-		// When the backup thread processed the query, it signals the main
-		// thread with this semaphore about the new query
-		CSemaphore m_NumWorker;
-
-		// spsc queue with additional backup worker to look at queries first.
-		std::unique_ptr<struct CSqlExecData> m_aQueries[512];
+		// When the backup thread processed the query, it passes it on to the
+		// writer thread or the reader threads and signals them with these
+		// semaphores about the new query
+		CSemaphore m_NumWrite;
+		CSemaphore m_NumRead;
+
+		// Queries are passed from the main thread to the backup thread and
+		// from there on to the writer thread, which executes the write queries
+		// in order, or to the reader threads. A nullptr signals shutdown.
+		CLock m_QueueLock;
+		std::deque<std::unique_ptr<struct CSqlExecData>> m_vpBackupQueue GUARDED_BY(m_QueueLock);
+		std::deque<std::unique_ptr<struct CSqlExecData>> m_vpWriteQueue GUARDED_BY(m_QueueLock);
+		std::deque<std::unique_ptr<struct CSqlExecData>> m_vpReadQueue GUARDED_BY(m_QueueLock);
+		// Registered read databases, each reader thread opens its own
+		// connections to them.
+		std::vector<std::unique_ptr<struct CSqlExecData>> m_vpReadDatabases GUARDED_BY(m_QueueLock);
+
+		// Set by the main thread before the first read query is enqueued.
+		std::atomic_int m_NumReaders{0};
+		// Writer and reader threads that haven't reached the shutdown yet.
+		std::atomic_int m_NumRunning{0};
+
+		// Number of queries added by the main thread, that the worker threads
+		// haven't finished yet. Used to reject read queries when the database
+		// can't keep up.
+		std::atomic_int m_NumPending{0};
+
+		// statistics for sql_stats, only the backup thread writes the peaks
+		std::atomic_int m_aPeakQueue[NUM_LANES] = {};
+		// time from adding the query to its completion
+		std::atomic<int64_t> m_aaLatency[NUM_LANES][NUM_LATENCY_BUCKETS] = {};
+		std::atomic<int64_t> m_aLatencySumUs[NUM_LANES] = {};
+
+		// publishes the result of the query
+		void Finish(struct CSqlExecData *pData, bool Success);
+		void ThreadExited();
 	};
 
 	std::shared_ptr<CSharedData> m_pShared;
-	void *m_pWorkerThread = nullptr;
+	void *m_pWriterThread = nullptr;
 	void *m_pBackupThread = nullptr;
+	std::vector<void *> m_vpReaderThreads;
 };
 
 #endif // ENGINE_SERVER_DATABASES_CONNECTION_POOL_H
@@ -1,4 +1,5 @@
 #include "connection.h"
+#include "statement_cache.h"
 
 #include <engine/server/databases/connection_pool.h>
 
@@ -94,6 +95,7 @@ public:
 	void Print() override {}
 	bool Step(bool *pEnd, char *pError, int ErrorSize) override;
 	bool ExecuteUpdate(int *pNumUpdated, char *pError, int ErrorSize) override;
+	bool Execute(const char *pStmt, char *pError, int ErrorSize) override;
 
 	bool IsNull(int Col) override;
 	float GetFloat(int Col) override;
@@ -116,6 +118,7 @@ private:
 	void StoreErrorStmt(const char *pContext);
 	bool ConnectImpl();
 	bool PrepareAndExecuteStatement(const char *pStmt);
+	void ClearStatements();
 	//static void DeleteResult(MYSQL_RES *pResult);
 
 	union UParameterExtra
@@ -129,7 +132,14 @@ private:
 	bool m_NewQuery = false;
 	bool m_HaveConnection = false;
 	MYSQL m_Mysql;
-	std::unique_ptr<MYSQL_STMT, CStmtDeleter> m_pStmt = nullptr;
+	// current statement, owned by m_pSetupStmt or m_StmtCache
+	MYSQL_STMT *m_pStmt = nullptr;
+	// used for the statements creating the database and tables
+	std::unique_ptr<MYSQL_STMT, CStmtDeleter> m_pSetupStmt = nullptr;
+	CStatementCache<MYSQL_STMT, CStmtDeleter> m_StmtCache;
+	// prepared statements don't survive reconnects, remember the
+	// connection the cached statements belong to
+	unsigned long m_StmtCacheThreadId = 0;
 	std::vector<MYSQL_BIND> m_vStmtParameters;
 	std::vector<UParameterExtra> m_vStmtParameterExtras;
 
@@ -159,6 +169,7 @@ CMysqlConnection::CMysqlConnection(CMysqlConfig Config) :
 
 CMysqlConnection::~CMysqlConnection()
 {
+	ClearStatements();
 	mysql_close(&m_Mysql);
 	g_MysqlNumConnections -= 1;
 }
@@ -170,17 +181,25 @@ void CMysqlConnection::StoreErrorMysql(const char *pContext)
 
 void CMysqlConnection::StoreErrorStmt(const char *pContext)
 {
-	str_format(m_aErrorDetail, sizeof(m_aErrorDetail), "(%s:stmt:%d): %s", pContext, mysql_stmt_errno(m_pStmt.get()), mysql_stmt_error(m_pStmt.get()));
+	str_format(m_aErrorDetail, sizeof(m_aErrorDetail), "(%s:stmt:%d): %s", pContext, mysql_stmt_errno(m_pStmt), mysql_stmt_error(m_pStmt));
+}
+
+void CMysqlConnection::ClearStatements()
+{
+	m_pStmt = nullptr;
+	m_pSetupStmt = nullptr;
+	m_StmtCache.Clear();
 }
 
 bool CMysqlConnection::PrepareAndExecuteStatement(const char *pStmt)
 {
-	if(mysql_stmt_prepare(m_pStmt.get(), pStmt, str_length(pStmt)))
+	m_pStmt = m_pSetupStmt.get();
+	if(mysql_stmt_prepare(m_pStmt, pStmt, str_length(pStmt)))
 	{
 		StoreErrorStmt("prepare");
 		return false;
 	}
-	if(mysql_stmt_execute(m_pStmt.get()))
+	if(mysql_stmt_execute(m_pStmt))
 	{
 		StoreErrorStmt("execute");
 		return false;
@@ -192,8 +211,9 @@ void CMysqlConnection::Print(IConsole *pConsole, const char *pMode)
 {
 	char aBuf[512];
 	str_format(aBuf, sizeof(aBuf),
-		"MySQL-%s: DB: '%s' Prefix: '%s' User: '%s' IP: <{'%s'}> Port: %d",
-		pMode, m_Config.m_aDatabase, GetPrefix(), m_Config.m_aUser, m_Config.m_aIp, m_Config.m_Port);
+		"MySQL-%s: DB: '%s' Prefix: '%s' User: '%s' IP: <{'%s'}> Port: %d Cached statements: %d (%" PRId64 " hits, %" PRId64 " misses)",
+		pMode, m_Config.m_aDatabase, GetPrefix(), m_Config.m_aUser, m_Config.m_aIp, m_Config.m_Port,
+		m_StmtCache.Size(), m_StmtCache.Hits(), m_StmtCache.Misses());
 	pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
 }
 
@@ -220,7 +240,7 @@ bool CMysqlConnection::ConnectImpl()
 {
 	if(m_HaveConnection)
 	{
-		if(m_pStmt && mysql_stmt_free_result(m_pStmt.get()))
+		if(m_pStmt && mysql_stmt_free_result(m_pStmt))
 		{
 			StoreErrorStmt("free_result");
 			dbg_msg("mysql", "can't free last result %s", m_aErrorDetail);
@@ -228,16 +248,24 @@ bool CMysqlConnection::ConnectImpl()
 		if(!mysql_select_db(&m_Mysql, m_Config.m_aDatabase))
 		{
 			// Success.
+			if(mysql_thread_id(&m_Mysql) != m_StmtCacheThreadId)
+			{
+				// reconnected automatically, the cached statements are gone
+				m_pStmt = nullptr;
+				m_StmtCache.Clear();
+				m_StmtCacheThreadId = mysql_thread_id(&m_Mysql);
+			}
 			return true;
 		}
 		StoreErrorMysql("select_db");
 		dbg_msg("mysql", "ping error, trying to reconnect %s", m_aErrorDetail);
+		ClearStatements();
 		mysql_close(&m_Mysql);
 		mem_zero(&m_Mysql, sizeof(m_Mysql));
 		mysql_init(&m_Mysql);
 	}
 
-	m_pStmt = nullptr;
+	ClearStatements();
 	unsigned int OptConnectTimeout = 60;
 	unsigned int OptReadTimeout = 60;
 	unsigned int OptWriteTimeout = 120;
@@ -259,7 +287,8 @@ bool CMysqlConnection::ConnectImpl()
 	}
 	m_HaveConnection = true;
 
-	m_pStmt = std::unique_ptr<MYSQL_STMT, CStmtDeleter>(mysql_stmt_init(&m_Mysql));
+	m_pSetupStmt = std::unique_ptr<MYSQL_STMT, CStmtDeleter>(mysql_stmt_init(&m_Mysql));
+	m_StmtCacheThreadId = mysql_thread_id(&m_Mysql);
 
 	// Apparently MYSQL_SET_CHARSET_NAME is not enough
 	if(!PrepareAndExecuteStatement("SET CHARACTER SET utf8mb4"))
@@ -319,14 +348,40 @@ void CMysqlConnection::Disconnect()
 
 bool CMysqlConnection::PrepareStatement(const char *pStmt, char *pError, int ErrorSize)
 {
-	if(mysql_stmt_prepare(m_pStmt.get(), pStmt, str_length(pStmt)))
+	// unread rows of the previous statement would leave the connection out of sync
+	if(m_pStmt != nullptr)
+		mysql_stmt_free_result(m_pStmt);
+	m_pStmt = m_StmtCache.Find(pStmt);
+	if(m_pStmt != nullptr)
 	{
-		StoreErrorStmt("prepare");
-		str_copy(pError, m_aErrorDetail, ErrorSize);
-		return false;
+		if(mysql_stmt_reset(m_pStmt))
+		{
+			StoreErrorStmt("reset");
+			str_copy(pError, m_aErrorDetail, ErrorSize);
+			return false;
+		}
+	}
+	else
+	{
+		std::unique_ptr<MYSQL_STMT, CStmtDeleter> pNewStmt(mysql_stmt_init(&m_Mysql));
+		if(pNewStmt == nullptr)
+		{
+			StoreErrorMysql("stmt_init");
+			str_copy(pError, m_aErrorDetail, ErrorSize);
+			return false;
+		}
+		m_pStmt = pNewStmt.get();
+		if(mysql_stmt_prepare(m_pStmt, pStmt, str_length(pStmt)))
+		{
+			StoreErrorStmt("prepare");
+			str_copy(pError, m_aErrorDetail, ErrorSize);
+			m_pStmt = nullptr;
+			return false;
+		}
+		m_StmtCache.Add(pStmt, pNewStmt.release());
 	}
 	m_NewQuery = true;
-	unsigned NumParameters = mysql_stmt_param_count(m_pStmt.get());
+	unsigned NumParameters = mysql_stmt_param_count(m_pStmt);
 	m_vStmtParameters.resize(NumParameters);
 	m_vStmtParameterExtras.resize(NumParameters);
 	if(NumParameters)
@@ -444,20 +499,20 @@ bool CMysqlConnection::Step(bool *pEnd, char *pError, int ErrorSize)
 	if(m_NewQuery)
 	{
 		m_NewQuery = false;
-		if(mysql_stmt_bind_param(m_pStmt.get(), m_vStmtParameters.data()))
+		if(mysql_stmt_bind_param(m_pStmt, m_vStmtParameters.data()))
 		{
 			StoreErrorStmt("bind_param");
 			str_copy(pError, m_aErrorDetail, ErrorSize);
 			return false;
 		}
-		if(mysql_stmt_execute(m_pStmt.get()))
+		if(mysql_stmt_execute(m_pStmt))
 		{
 			StoreErrorStmt("execute");
 			str_copy(pError, m_aErrorDetail, ErrorSize);
 			return false;
 		}
 	}
-	int Result = mysql_stmt_fetch(m_pStmt.get());
+	int Result = mysql_stmt_fetch(m_pStmt);
 	if(Result == 1)
 	{
 		StoreErrorStmt("fetch");
@@ -475,25 +530,45 @@ bool CMysqlConnection::ExecuteUpdate(int *pNumUpdated, char *pError, int ErrorSi
 	if(m_NewQuery)
 	{
 		m_NewQuery = false;
-		if(mysql_stmt_bind_param(m_pStmt.get(), m_vStmtParameters.data()))
+		if(mysql_stmt_bind_param(m_pStmt, m_vStmtParameters.data()))
 		{
 			StoreErrorStmt("bind_param");
 			str_copy(pError, m_aErrorDetail, ErrorSize);
 			return false;
 		}
-		if(mysql_stmt_execute(m_pStmt.get()))
+		if(mysql_stmt_execute(m_pStmt))
 		{
 			StoreErrorStmt("execute");
 			str_copy(pError, m_aErrorDetail, ErrorSize);
 			return false;
 		}
-		*pNumUpdated = mysql_stmt_affected_rows(m_pStmt.get());
+		*pNumUpdated = mysql_stmt_affected_rows(m_pStmt);
 		return true;
 	}
 	str_copy(pError, "tried to execute update without query", ErrorSize);
 	return false;
 }
 
+bool CMysqlConnection::Execute(const char *pStmt, char *pError, int ErrorSize)
+{
+	// unread rows of the last statement would leave the connection out of sync
+	if(m_pStmt != nullptr && mysql_stmt_free_result(m_pStmt))
+	{
+		StoreErrorStmt("free_result");
+		str_copy(pError, m_aErrorDetail, ErrorSize);
+		return false;
+	}
+	m_NewQuery = false;
+	// not every transaction control statement can be prepared, use the text protocol
+	if(mysql_real_query(&m_Mysql, pStmt, str_length(pStmt)))
+	{
+		StoreErrorMysql("real_query");
+		str_copy(pError, m_aErrorDetail, ErrorSize);
+		return false;
+	}
+	return true;
+}
+
 bool CMysqlConnection::IsNull(int Col)
 {
 	Col -= 1;
@@ -508,7 +583,7 @@ bool CMysqlConnection::IsNull(int Col)
 	Bind.is_null = &IsNull;
 	Bind.is_unsigned = false;
 	Bind.error = nullptr;
-	if(mysql_stmt_fetch_column(m_pStmt.get(), &Bind, Col, 0))
+	if(mysql_stmt_fetch_column(m_pStmt, &Bind, Col, 0))
 	{
 		StoreErrorStmt("fetch_column:null");
 		dbg_assert(false, "Error in IsNull: error fetching column %s", m_aErrorDetail);
@@ -531,7 +606,7 @@ float CMysqlConnection::GetFloat(int Col)
 	Bind.is_null = &IsNull;
 	Bind.is_unsigned = false;
 	Bind.error = nullptr;
-	if(mysql_stmt_fetch_column(m_pStmt.get(), &Bind, Col, 0))
+	if(mysql_stmt_fetch_column(m_pStmt, &Bind, Col, 0))
 	{
 		StoreErrorStmt("fetch_column:float");
 		dbg_assert(false, "Error in GetFloat: error fetching column %s", m_aErrorDetail);
@@ -555,7 +630,7 @@ int CMysqlConnection::GetInt(int Col)
 	Bind.is_null = &IsNull;
 	Bind.is_unsigned = false;
 	Bind.error = nullptr;
-	if(mysql_stmt_fetch_column(m_pStmt.get(), &Bind, Col, 0))
+	if(mysql_stmt_fetch_column(m_pStmt, &Bind, Col, 0))
 	{
 		StoreErrorStmt("fetch_column:int");
 		dbg_assert(false, "Error in GetInt: error fetching column %s", m_aErrorDetail);
@@ -579,7 +654,7 @@ int64_t CMysqlConnection::GetInt64(int Col)
 	Bind.is_null = &IsNull;
 	Bind.is_unsigned = false;
 	Bind.error = nullptr;
-	if(mysql_stmt_fetch_column(m_pStmt.get(), &Bind, Col, 0))
+	if(mysql_stmt_fetch_column(m_pStmt, &Bind, Col, 0))
 	{
 		StoreErrorStmt("fetch_column:int64");
 		dbg_assert(false, "Error in GetInt64: error fetching column %s", m_aErrorDetail);
@@ -610,7 +685,7 @@ void CMysqlConnection::GetString(int Col, char *pBuffer, int BufferSize)
 	Bind.is_null = &IsNull;
 	Bind.is_unsigned = false;
 	Bind.error = &Error;
-	if(mysql_stmt_fetch_column(m_pStmt.get(), &Bind, Col, 0))
+	if(mysql_stmt_fetch_column(m_pStmt, &Bind, Col, 0))
 	{
 		StoreErrorStmt("fetch_column:string");
 		dbg_assert(false, "Error in GetString: error fetching column %s", m_aErrorDetail);
@@ -635,7 +710,7 @@ int CMysqlConnection::GetBlob(int Col, unsigned char *pBuffer, int BufferSize)
 	Bind.is_null = &IsNull;
 	Bind.is_unsigned = false;
 	Bind.error = &Error;
-	if(mysql_stmt_fetch_column(m_pStmt.get(), &Bind, Col, 0))
+	if(mysql_stmt_fetch_column(m_pStmt, &Bind, Col, 0))
 	{
 		StoreErrorStmt("fetch_column:blob");
 		dbg_assert(false, "Error in GetBlob: error fetching column %s", m_aErrorDetail);
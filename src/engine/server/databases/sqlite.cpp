@@ -1,4 +1,5 @@
 #include "connection.h"
+#include "statement_cache.h"
 
 #include <sqlite3.h>
 
@@ -6,6 +7,7 @@
 #include <engine/console.h>
 
 #include <atomic>
+#include <limits>
 
 class CSqliteConnection : public IDbConnection
 {
@@ -42,6 +44,7 @@ public:
 	void Print() override;
 	bool Step(bool *pEnd, char *pError, int ErrorSize) override;
 	bool ExecuteUpdate(int *pNumUpdated, char *pError, int ErrorSize) override;
+	bool Execute(const char *pQuery, char *pError, int ErrorSize) override;
 
 	bool IsNull(int Col) override;
 	float GetFloat(int Col) override;
@@ -61,11 +64,19 @@ private:
 	char m_aFilename[IO_MAX_PATH_LENGTH];
 	bool m_Setup;
 
+	class CStmtFinalizer
+	{
+	public:
+		void operator()(sqlite3_stmt *pStmt) const { sqlite3_finalize(pStmt); }
+	};
+
 	sqlite3 *m_pDb;
+	// current statement, owned by m_StmtCache
 	sqlite3_stmt *m_pStmt;
+	CStatementCache<sqlite3_stmt, CStmtFinalizer> m_StmtCache;
 	bool m_Done; // no more rows available for Step
-	// returns false, if the query succeeded
-	bool Execute(const char *pQuery, char *pError, int ErrorSize);
+	// resets the current statement for the next use and releases its locks
+	void ReleaseStatement();
 	// returns true on failure
 	bool ConnectImpl(char *pError, int ErrorSize);
 
@@ -89,8 +100,8 @@ CSqliteConnection::CSqliteConnection(const char *pFilename, bool Setup) :
 
 CSqliteConnection::~CSqliteConnection()
 {
-	if(m_pStmt != nullptr)
-		sqlite3_finalize(m_pStmt);
+	ReleaseStatement();
+	m_StmtCache.Clear();
 	sqlite3_close(m_pDb);
 	m_pDb = nullptr;
 }
@@ -99,8 +110,8 @@ void CSqliteConnection::Print(IConsole *pConsole, const char *pMode)
 {
 	char aBuf[512];
 	str_format(aBuf, sizeof(aBuf),
-		"SQLite-%s: DB: '%s'",
-		pMode, m_aFilename);
+		"SQLite-%s: DB: '%s' Cached statements: %d (%" PRId64 " hits, %" PRId64 " misses)",
+		pMode, m_aFilename, m_StmtCache.Size(), m_StmtCache.Hits(), m_StmtCache.Misses());
 	pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
 }
 
@@ -142,8 +153,10 @@ bool CSqliteConnection::ConnectImpl(char *pError, int ErrorSize)
 		return false;
 	}
 
-	// wait for database to unlock so we don't have to handle SQLITE_BUSY errors
-	sqlite3_busy_timeout(m_pDb, -1);
+	// wait for database to unlock so we don't have to handle SQLITE_BUSY errors,
+	// the reader threads and the writer thread use separate connections. A
+	// negative timeout would turn the busy handler off instead.
+	sqlite3_busy_timeout(m_pDb, std::numeric_limits<int>::max());
 
 	if(m_Setup)
 	{
@@ -182,26 +195,39 @@ bool CSqliteConnection::ConnectImpl(char *pError, int ErrorSize)
 
 void CSqliteConnection::Disconnect()
 {
-	if(m_pStmt != nullptr)
-		sqlite3_finalize(m_pStmt);
-	m_pStmt = nullptr;
+	ReleaseStatement();
 	m_InUse.store(false);
 }
 
-bool CSqliteConnection::PrepareStatement(const char *pStmt, char *pError, int ErrorSize)
+void CSqliteConnection::ReleaseStatement()
 {
 	if(m_pStmt != nullptr)
-		sqlite3_finalize(m_pStmt);
+	{
+		sqlite3_reset(m_pStmt);
+		sqlite3_clear_bindings(m_pStmt);
+	}
 	m_pStmt = nullptr;
-	int Result = sqlite3_prepare_v2(
-		m_pDb,
-		pStmt,
-		-1, // pStmt can be any length
-		&m_pStmt,
-		nullptr);
-	if(FormatError(Result, pError, ErrorSize))
+}
+
+bool CSqliteConnection::PrepareStatement(const char *pStmt, char *pError, int ErrorSize)
+{
+	ReleaseStatement();
+	m_pStmt = m_StmtCache.Find(pStmt);
+	if(m_pStmt == nullptr)
 	{
-		return false;
+		int Result = sqlite3_prepare_v2(
+			m_pDb,
+			pStmt,
+			-1, // pStmt can be any length
+			&m_pStmt,
+			nullptr);
+		if(FormatError(Result, pError, ErrorSize))
+		{
+			sqlite3_finalize(m_pStmt);
+			m_pStmt = nullptr;
+			return false;
+		}
+		m_StmtCache.Add(pStmt, m_pStmt);
 	}
 	m_Done = false;
 	return true;
@@ -362,6 +388,8 @@ const char *CSqliteConnection::MedianMapTime(char *pBuffer, int BufferSize) cons
 
 bool CSqliteConnection::Execute(const char *pQuery, char *pError, int ErrorSize)
 {
+	// a pending statement would keep the transaction busy
+	ReleaseStatement();
 	char *pErrorMsg;
 	int Result = sqlite3_exec(m_pDb, pQuery, nullptr, nullptr, &pErrorMsg);
 	if(Result != SQLITE_OK)
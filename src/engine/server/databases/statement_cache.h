@@ -0,0 +1,88 @@
+#ifndef ENGINE_SERVER_DATABASES_STATEMENT_CACHE_H
+#define ENGINE_SERVER_DATABASES_STATEMENT_CACHE_H
+
+#include <base/system.h>
+
+#include <cstdint>
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Least recently used cache of the prepared statements of one connection,
+// keyed by their SQL text. TDeleter frees a statement evicted from the cache.
+template<typename TStmt, typename TDeleter>
+class CStatementCache
+{
+public:
+	enum
+	{
+		MAX_STATEMENTS = 32,
+	};
+
+	CStatementCache() = default;
+	CStatementCache(const CStatementCache &) = delete;
+	CStatementCache &operator=(const CStatementCache &) = delete;
+	~CStatementCache() { Clear(); }
+
+	// returns the statement prepared from pSql and marks it as most recently
+	// used, nullptr if it isn't cached
+	TStmt *Find(const char *pSql)
+	{
+		auto It = m_Index.find(std::string_view(pSql));
+		if(It == m_Index.end())
+		{
+			m_Misses++;
+			return nullptr;
+		}
+		m_Hits++;
+		m_lEntries.splice(m_lEntries.begin(), m_lEntries, It->second);
+		return It->second->m_pStmt;
+	}
+
+	// takes ownership of pStmt, evicts the least recently used statement if
+	// the cache is full
+	void Add(const char *pSql, TStmt *pStmt)
+	{
+		dbg_assert(m_Index.find(std::string_view(pSql)) == m_Index.end(), "statement is already cached");
+		if(m_lEntries.size() >= MAX_STATEMENTS)
+		{
+			CEntry &Oldest = m_lEntries.back();
+			m_Index.erase(std::string_view(Oldest.m_Sql));
+			TDeleter()(Oldest.m_pStmt);
+			m_lEntries.pop_back();
+		}
+		m_lEntries.push_front(CEntry{pSql, pStmt});
+		m_Index.emplace(std::string_view(m_lEntries.front().m_Sql), m_lEntries.begin());
+	}
+
+	// frees all statements, must be called before the connection they
+	// belong to is closed
+	void Clear()
+	{
+		m_Index.clear();
+		for(CEntry &Entry : m_lEntries)
+			TDeleter()(Entry.m_pStmt);
+		m_lEntries.clear();
+	}
+
+	int Size() const { return m_lEntries.size(); }
+	int64_t Hits() const { return m_Hits; }
+	int64_t Misses() const { return m_Misses; }
+
+private:
+	struct CEntry
+	{
+		std::string m_Sql;
+		TStmt *m_pStmt;
+	};
+
+	// most recently used first, the index refers to the strings in here
+	std::list<CEntry> m_lEntries;
+	std::unordered_map<std::string_view, typename std::list<CEntry>::iterator> m_Index;
+
+	int64_t m_Hits = 0;
+	int64_t m_Misses = 0;
+};
+
+#endif // ENGINE_SERVER_DATABASES_STATEMENT_CACHE_H
@@ -173,6 +173,8 @@ int main(int argc, const char **argv)
 	pConfigManager->SetReadOnly("sv_test_cmds", true);
 	pConfigManager->SetReadOnly("sv_rescue", true);
 	pConfigManager->SetReadOnly("sv_port", true);
+	pConfigManager->SetReadOnly("sv_snapshot_threads", true);
+	pConfigManager->SetReadOnly("sv_world_threads", true);
 	pConfigManager->SetReadOnly("bindaddr", true);
 
 	if(g_Config.m_Logfile[0])
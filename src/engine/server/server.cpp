@@ -29,6 +29,7 @@
 #include <engine/shared/netban.h>
 #include <engine/shared/network.h>
 #include <engine/shared/packer.h>
+#include <engine/shared/profiler.h>
 #include <engine/shared/protocol.h>
 #include <engine/shared/protocol7.h>
 #include <engine/shared/protocol_ex.h>
@@ -47,6 +48,8 @@
 #include "register.h"
 
 #include <chrono>
+#include <limits>
+#include <utility>
 
 using namespace std::chrono_literals;
 
@@ -54,6 +57,43 @@ using namespace std::chrono_literals;
 extern std::vector<std::string> FetchAndroidServerCommandQueue();
 #endif
 
+// Maps the file for downloads if wanted, a private mapping is not affected
+// when the game server modifies the tiles of the loaded map.
+static bool ReadMapFile(IStorage *pStorage, const char *pPath, bool Mapped, unsigned char **ppData, unsigned *pSize, bool *pIsMapped)
+{
+	*pIsMapped = false;
+	if(Mapped)
+	{
+		IOHANDLE File = pStorage->OpenFile(pPath, IOFLAG_READ, IStorage::TYPE_ALL);
+		if(File)
+		{
+			const int64_t Size = io_length(File);
+			void *pData = Size > 0 && Size <= std::numeric_limits<unsigned>::max() ? io_map(File, Size) : nullptr;
+			io_close(File);
+			if(pData)
+			{
+				*ppData = static_cast<unsigned char *>(pData);
+				*pSize = Size;
+				*pIsMapped = true;
+				return true;
+			}
+		}
+	}
+	void *pData;
+	if(!pStorage->ReadFile(pPath, IStorage::TYPE_ALL, &pData, pSize))
+		return false;
+	*ppData = static_cast<unsigned char *>(pData);
+	return true;
+}
+
+static void FreeMapFile(unsigned char *pData, unsigned Size, bool Mapped)
+{
+	if(Mapped)
+		io_unmap(pData, Size);
+	else
+		free(pData);
+}
+
 void CServerBan::InitServerBan(IConsole *pConsole, IStorage *pStorage, CServer *pServer)
 {
 	CNetBan::Init(pConsole, pStorage);
@@ -247,6 +287,7 @@ CServer::CServer()
 	{
 		m_apCurrentMapData[i] = nullptr;
 		m_aCurrentMapSize[i] = 0;
+		m_aCurrentMapDataMapped[i] = false;
 	}
 
 	m_MapReload = false;
@@ -272,14 +313,18 @@ CServer::CServer()
 
 	m_aErrorShutdownReason[0] = 0;
 
+	m_vpSnapshotWorkspaces.push_back(std::make_unique<CSnapshotWorkspace>());
+	m_SnapshotDeltaCacheHits = 0;
+	m_SnapshotDeltaCacheMisses = 0;
+
 	Init();
 }
 
 CServer::~CServer()
 {
-	for(auto &pCurrentMapData : m_apCurrentMapData)
+	for(int i = 0; i < NUM_MAP_TYPES; i++)
 	{
-		free(pCurrentMapData);
+		FreeMapFile(m_apCurrentMapData[i], m_aCurrentMapSize[i], m_aCurrentMapDataMapped[i]);
 	}
 
 	if(m_RunServer != UNINITIALIZED)
@@ -973,10 +1018,217 @@ void CServer::SendMsgRaw(int ClientId, const void *pData, int Size, int Flags)
 	m_NetServer.Send(&Packet);
 }
 
-void CServer::DoSnapshot()
+class CSnapshotJob : public IJob
 {
-	bool IsGlobalSnap = Config()->m_SvHighBandwidth || (m_CurrentGameTick % 2) == 0;
+	CServer *m_pServer;
+	CServer::CSnapshotWorkspace *m_pWorkspace;
+
+	void Run() override
+	{
+		m_pServer->RunSnapshotWorker(m_pWorkspace);
+		sphore_signal(&m_pServer->m_SnapshotJobsDone);
+	}
+
+public:
+	CSnapshotJob(CServer *pServer, CServer::CSnapshotWorkspace *pWorkspace) :
+		m_pServer(pServer), m_pWorkspace(pWorkspace)
+	{
+	}
+};
+
+void CServer::InitSnapshotWorkers()
+{
+	// workspace of the main thread is created in the constructor
+	// static sizes are set later by the game server through SnapSetStaticsize
+	for(int i = 0; i < Config()->m_SvSnapshotThreads; i++)
+		m_vpSnapshotWorkspaces.push_back(std::make_unique<CSnapshotWorkspace>());
+	if(Config()->m_SvSnapshotThreads > 0)
+	{
+		sphore_init(&m_SnapshotJobsDone);
+		m_SnapshotJobPool.Init(Config()->m_SvSnapshotThreads);
+		log_info("server", "using %d snapshot worker threads", Config()->m_SvSnapshotThreads);
+	}
+}
+
+void CServer::ShutdownSnapshotWorkers()
+{
+	if(m_vpSnapshotWorkspaces.size() > 1)
+	{
+		m_SnapshotJobPool.Shutdown();
+		sphore_destroy(&m_SnapshotJobsDone);
+		m_vpSnapshotWorkspaces.resize(1);
+	}
+}
+
+CJobPool *CServer::WorldJobPool()
+{
+	// the thread count only takes effect on restart, the pool outlives map changes
+	if(!m_WorldJobPoolStarted && Config()->m_SvWorldThreads > 0)
+	{
+		m_WorldJobPool.Init(Config()->m_SvWorldThreads);
+		m_WorldJobPoolStarted = true;
+		log_info("server", "using %d world worker threads", Config()->m_SvWorldThreads);
+	}
+	return m_WorldJobPoolStarted ? &m_WorldJobPool : nullptr;
+}
+
+void CServer::BuildClientSnapshot(int ClientId, bool IsGlobalSnap)
+{
+	m_SnapshotBuilder.Init(m_aClients[ClientId].m_Sixup);
+
+	// only snap events on global ticks
+	GameServer()->OnSnap(ClientId, IsGlobalSnap);
+
+	// finish snapshot
+	char aData[CSnapshot::MAX_SIZE];
+	CSnapshot *pData = (CSnapshot *)aData; // Fix compiler warning for strict-aliasing
+	int SnapshotSize = m_SnapshotBuilder.Finish(pData);
+
+	if(m_aDemoRecorder[ClientId].IsRecording())
+	{
+		// write snapshot
+		m_aDemoRecorder[ClientId].RecordSnapshot(Tick(), aData, SnapshotSize);
+	}
+
+	// remove old snapshots
+	// keep 3 seconds worth of snapshots
+	m_aClients[ClientId].m_Snapshots.PurgeUntil(m_CurrentGameTick - TickSpeed() * 3);
+
+	// save the snapshot
+	m_aClients[ClientId].m_Snapshots.Add(m_CurrentGameTick, time_get(), SnapshotSize, pData, 0, nullptr);
+	m_aClients[ClientId].m_SnapshotCrc = pData->Crc();
+
+	// find snapshot that we can perform delta against
+	m_aClients[ClientId].m_SnapshotDeltaTick = -1;
+	m_aClients[ClientId].m_pSnapshotDeltaBase = CSnapshot::EmptySnapshot();
+	m_aClients[ClientId].m_SnapshotDeltaBaseSize = sizeof(CSnapshot);
+	{
+		int DeltashotSize = m_aClients[ClientId].m_Snapshots.Get(m_aClients[ClientId].m_LastAckedSnapshot, nullptr, &m_aClients[ClientId].m_pSnapshotDeltaBase, nullptr);
+		if(DeltashotSize >= 0)
+		{
+			m_aClients[ClientId].m_SnapshotDeltaTick = m_aClients[ClientId].m_LastAckedSnapshot;
+			m_aClients[ClientId].m_SnapshotDeltaBaseSize = DeltashotSize;
+		}
+		else
+		{
+			// no acked package found, force client to recover rate
+			if(m_aClients[ClientId].m_SnapRate == CClient::SNAPRATE_FULL)
+				m_aClients[ClientId].m_SnapRate = CClient::SNAPRATE_RECOVER;
+		}
+	}
+}
+
+int CServer::FindSnapshotDeltaSource(int ClientId) const
+{
+	// clients that got the same snapshot and acked the same one before end up
+	// with the same delta, so it only has to be created and compressed once
+	const CClient &Client = m_aClients[ClientId];
+	const CSnapshotStorage::CHolder *pSnapshot = Client.m_Snapshots.m_pLast;
+	for(int OtherId : m_vSnapshotClients)
+	{
+		const CClient &Other = m_aClients[OtherId];
+		const CSnapshotStorage::CHolder *pOtherSnapshot = Other.m_Snapshots.m_pLast;
+		if(Other.m_SnapshotCrc != Client.m_SnapshotCrc ||
+			Other.m_Sixup != Client.m_Sixup ||
+			pOtherSnapshot->m_SnapSize != pSnapshot->m_SnapSize ||
+			Other.m_SnapshotDeltaBaseSize != Client.m_SnapshotDeltaBaseSize)
+		{
+			continue;
+		}
+		if(mem_comp(pOtherSnapshot->m_pSnap, pSnapshot->m_pSnap, pSnapshot->m_SnapSize) != 0)
+			continue;
+		if(Other.m_pSnapshotDeltaBase != Client.m_pSnapshotDeltaBase &&
+			mem_comp(Other.m_pSnapshotDeltaBase, Client.m_pSnapshotDeltaBase, Client.m_SnapshotDeltaBaseSize) != 0)
+		{
+			continue;
+		}
+		return OtherId;
+	}
+	return -1;
+}
+
+void CServer::PackClientSnapshot(int ClientId, CSnapshotWorkspace *pWorkspace)
+{
+	CClient &Client = m_aClients[ClientId];
+
+	// create delta
+	pWorkspace->m_Delta.SetStaticsize(protocol7::NETEVENTTYPE_SOUNDWORLD, Client.m_Sixup);
+	pWorkspace->m_Delta.SetStaticsize(protocol7::NETEVENTTYPE_DAMAGE, Client.m_Sixup);
+	int DeltaSize = pWorkspace->m_Delta.CreateDelta(Client.m_pSnapshotDeltaBase, Client.m_Snapshots.m_pLast->m_pSnap, pWorkspace->m_aDeltaData);
+
+	if(DeltaSize)
+	{
+		// compress it
+		int CompSize = CVariableInt::Compress(pWorkspace->m_aDeltaData, DeltaSize, pWorkspace->m_aCompData, sizeof(pWorkspace->m_aCompData));
+		Client.m_vSnapshotData.assign(pWorkspace->m_aCompData, pWorkspace->m_aCompData + CompSize);
+	}
+	else
+	{
+		Client.m_vSnapshotData.clear();
+	}
+}
+
+void CServer::SendClientSnapshot(int ClientId)
+{
+	const CClient &Client = m_aClients[ClientId];
+	const int DeltaTick = Client.m_SnapshotDeltaTick;
+
+	if(!Client.m_vSnapshotData.empty())
+	{
+		const int MaxSize = MAX_SNAPSHOT_PACKSIZE;
+		const char *pCompData = Client.m_vSnapshotData.data();
+		const int SnapshotSize = Client.m_vSnapshotData.size();
+		int NumPackets = (SnapshotSize + MaxSize - 1) / MaxSize;
+
+		for(int n = 0, Left = SnapshotSize; Left > 0; n++)
+		{
+			int Chunk = Left < MaxSize ? Left : MaxSize;
+			Left -= Chunk;
+
+			if(NumPackets == 1)
+			{
+				CMsgPacker Msg(NETMSG_SNAPSINGLE, true);
+				Msg.AddInt(m_CurrentGameTick);
+				Msg.AddInt(m_CurrentGameTick - DeltaTick);
+				Msg.AddInt(Client.m_SnapshotCrc);
+				Msg.AddInt(Chunk);
+				Msg.AddRaw(&pCompData[n * MaxSize], Chunk);
+				SendMsg(&Msg, MSGFLAG_FLUSH, ClientId);
+			}
+			else
+			{
+				CMsgPacker Msg(NETMSG_SNAP, true);
+				Msg.AddInt(m_CurrentGameTick);
+				Msg.AddInt(m_CurrentGameTick - DeltaTick);
+				Msg.AddInt(NumPackets);
+				Msg.AddInt(n);
+				Msg.AddInt(Client.m_SnapshotCrc);
+				Msg.AddInt(Chunk);
+				Msg.AddRaw(&pCompData[n * MaxSize], Chunk);
+				SendMsg(&Msg, MSGFLAG_FLUSH, ClientId);
+			}
+		}
+	}
+	else
+	{
+		CMsgPacker Msg(NETMSG_SNAPEMPTY, true);
+		Msg.AddInt(m_CurrentGameTick);
+		Msg.AddInt(m_CurrentGameTick - DeltaTick);
+		SendMsg(&Msg, MSGFLAG_FLUSH, ClientId);
+	}
+}
+
+void CServer::RunSnapshotWorker(CSnapshotWorkspace *pWorkspace)
+{
+	const int NumClients = m_vSnapshotClients.size();
+	for(int Index = m_NextSnapshotClient.fetch_add(1); Index < NumClients; Index = m_NextSnapshotClient.fetch_add(1))
+	{
+		PackClientSnapshot(m_vSnapshotClients[Index], pWorkspace);
+	}
+}
 
+void CServer::CreateSnapshots(bool IsGlobalSnap)
+{
 	if(m_aDemoRecorder[RECORDER_MANUAL].IsRecording() || m_aDemoRecorder[RECORDER_AUTO].IsRecording())
 	{
 		// create snapshot for demo recording
@@ -995,6 +1247,8 @@ void CServer::DoSnapshot()
 	}
 
 	// create snapshots for all clients
+	m_vSnapshotClients.clear();
+	m_vSnapshotRecipients.clear();
 	for(int i = 0; i < MaxClients(); i++)
 	{
 		// client must be ingame to receive snapshots
@@ -1013,100 +1267,57 @@ void CServer::DoSnapshot()
 		if(!IsGlobalSnap && !(m_aClients[i].m_ForceHighBandwidthOnSpectate && GameServer()->IsClientHighBandwidth(i)))
 			continue;
 
-		{
-			m_SnapshotBuilder.Init(m_aClients[i].m_Sixup);
-
-			// only snap events on global ticks
-			GameServer()->OnSnap(i, IsGlobalSnap);
-
-			// finish snapshot
-			char aData[CSnapshot::MAX_SIZE];
-			CSnapshot *pData = (CSnapshot *)aData; // Fix compiler warning for strict-aliasing
-			int SnapshotSize = m_SnapshotBuilder.Finish(pData);
-
-			if(m_aDemoRecorder[i].IsRecording())
-			{
-				// write snapshot
-				m_aDemoRecorder[i].RecordSnapshot(Tick(), aData, SnapshotSize);
-			}
-
-			int Crc = pData->Crc();
+		// the game server is not thread-safe, so the snapshot items are always collected on the main thread
+		BuildClientSnapshot(i, IsGlobalSnap);
+		m_vSnapshotRecipients.push_back(i);
 
-			// remove old snapshots
-			// keep 3 seconds worth of snapshots
-			m_aClients[i].m_Snapshots.PurgeUntil(m_CurrentGameTick - TickSpeed() * 3);
-
-			// save the snapshot
-			m_aClients[i].m_Snapshots.Add(m_CurrentGameTick, time_get(), SnapshotSize, pData, 0, nullptr);
-
-			// find snapshot that we can perform delta against
-			int DeltaTick = -1;
-			const CSnapshot *pDeltashot = CSnapshot::EmptySnapshot();
-			{
-				int DeltashotSize = m_aClients[i].m_Snapshots.Get(m_aClients[i].m_LastAckedSnapshot, nullptr, &pDeltashot, nullptr);
-				if(DeltashotSize >= 0)
-					DeltaTick = m_aClients[i].m_LastAckedSnapshot;
-				else
-				{
-					// no acked package found, force client to recover rate
-					if(m_aClients[i].m_SnapRate == CClient::SNAPRATE_FULL)
-						m_aClients[i].m_SnapRate = CClient::SNAPRATE_RECOVER;
-				}
-			}
-
-			// create delta
-			m_SnapshotDelta.SetStaticsize(protocol7::NETEVENTTYPE_SOUNDWORLD, m_aClients[i].m_Sixup);
-			m_SnapshotDelta.SetStaticsize(protocol7::NETEVENTTYPE_DAMAGE, m_aClients[i].m_Sixup);
-			char aDeltaData[CSnapshot::MAX_SIZE];
-			int DeltaSize = m_SnapshotDelta.CreateDelta(pDeltashot, pData, aDeltaData);
+		m_aClients[i].m_SnapshotDeltaSource = FindSnapshotDeltaSource(i);
+		if(m_aClients[i].m_SnapshotDeltaSource == -1)
+		{
+			m_vSnapshotClients.push_back(i);
+			m_SnapshotDeltaCacheMisses++;
+		}
+		else
+		{
+			m_SnapshotDeltaCacheHits++;
+		}
+	}
 
-			if(DeltaSize)
-			{
-				// compress it
-				const int MaxSize = MAX_SNAPSHOT_PACKSIZE;
+	// create and compress the deltas, spread over the snapshot workers if there are any
+	const int NumWorkers = m_vpSnapshotWorkspaces.size() - 1;
+	m_NextSnapshotClient = 0;
+	if(NumWorkers > 0 && m_vSnapshotClients.size() > 1)
+	{
+		const int NumJobs = minimum<int>(NumWorkers, m_vSnapshotClients.size() - 1);
+		for(int i = 0; i < NumJobs; i++)
+			m_SnapshotJobPool.Add(std::make_shared<CSnapshotJob>(this, m_vpSnapshotWorkspaces[i + 1].get()));
+		RunSnapshotWorker(m_vpSnapshotWorkspaces[0].get());
+		for(int i = 0; i < NumJobs; i++)
+			sphore_wait(&m_SnapshotJobsDone);
+	}
+	else
+	{
+		RunSnapshotWorker(m_vpSnapshotWorkspaces[0].get());
+	}
+}
 
-				char aCompData[CSnapshot::MAX_SIZE];
-				SnapshotSize = CVariableInt::Compress(aDeltaData, DeltaSize, aCompData, sizeof(aCompData));
-				int NumPackets = (SnapshotSize + MaxSize - 1) / MaxSize;
+void CServer::DoSnapshot()
+{
+	bool IsGlobalSnap = Config()->m_SvHighBandwidth || (m_CurrentGameTick % 2) == 0;
 
-				for(int n = 0, Left = SnapshotSize; Left > 0; n++)
-				{
-					int Chunk = Left < MaxSize ? Left : MaxSize;
-					Left -= Chunk;
+	CreateSnapshots(IsGlobalSnap);
 
-					if(NumPackets == 1)
-					{
-						CMsgPacker Msg(NETMSG_SNAPSINGLE, true);
-						Msg.AddInt(m_CurrentGameTick);
-						Msg.AddInt(m_CurrentGameTick - DeltaTick);
-						Msg.AddInt(Crc);
-						Msg.AddInt(Chunk);
-						Msg.AddRaw(&aCompData[n * MaxSize], Chunk);
-						SendMsg(&Msg, MSGFLAG_FLUSH, i);
-					}
-					else
-					{
-						CMsgPacker Msg(NETMSG_SNAP, true);
-						Msg.AddInt(m_CurrentGameTick);
-						Msg.AddInt(m_CurrentGameTick - DeltaTick);
-						Msg.AddInt(NumPackets);
-						Msg.AddInt(n);
-						Msg.AddInt(Crc);
-						Msg.AddInt(Chunk);
-						Msg.AddRaw(&aCompData[n * MaxSize], Chunk);
-						SendMsg(&Msg, MSGFLAG_FLUSH, i);
-					}
-				}
-			}
-			else
-			{
-				CMsgPacker Msg(NETMSG_SNAPEMPTY, true);
-				Msg.AddInt(m_CurrentGameTick);
-				Msg.AddInt(m_CurrentGameTick - DeltaTick);
-				SendMsg(&Msg, MSGFLAG_FLUSH, i);
-			}
-		}
+	// sending is not thread-safe either, the snapshots of all clients leave
+	// in a few system calls
+	m_NetServer.BeginSendBatch();
+	for(int ClientId : m_vSnapshotRecipients)
+	{
+		const int Source = m_aClients[ClientId].m_SnapshotDeltaSource;
+		if(Source != -1)
+			m_aClients[ClientId].m_vSnapshotData = m_aClients[Source].m_vSnapshotData;
+		SendClientSnapshot(ClientId);
 	}
+	m_NetServer.FlushSendBatch();
 
 	if(IsGlobalSnap)
 	{
@@ -2835,6 +3046,73 @@ void CServer::ReloadMap()
 	m_SameMapReload = true;
 }
 
+class CServer::CMapPreloadJob : public IJob
+{
+	IEngineMap *m_pMap;
+	IStorage *m_pStorage;
+
+	void Run() override
+	{
+		m_Success = m_pMap->Preload(m_aPath);
+		if(!m_Success)
+			return;
+
+		if(!ReadMapFile(m_pStorage, m_aPath, m_Mapped, &m_apData[MAP_TYPE_SIX], &m_aSize[MAP_TYPE_SIX], &m_aMapped[MAP_TYPE_SIX]))
+			m_apData[MAP_TYPE_SIX] = nullptr;
+
+		char aSixupPath[IO_MAX_PATH_LENGTH];
+		str_format(aSixupPath, sizeof(aSixupPath), "maps7/%s.map", m_aMapName);
+		if(m_Sixup && ReadMapFile(m_pStorage, aSixupPath, m_Mapped, &m_apData[MAP_TYPE_SIXUP], &m_aSize[MAP_TYPE_SIXUP], &m_aMapped[MAP_TYPE_SIXUP]))
+		{
+			m_SixupSha256 = sha256(m_apData[MAP_TYPE_SIXUP], m_aSize[MAP_TYPE_SIXUP]);
+			m_SixupCrc = crc32(0, m_apData[MAP_TYPE_SIXUP], m_aSize[MAP_TYPE_SIXUP]);
+		}
+	}
+
+public:
+	char m_aMapName[IO_MAX_PATH_LENGTH];
+	char m_aPath[IO_MAX_PATH_LENGTH];
+	bool m_Sixup;
+	bool m_Mapped;
+
+	bool m_Success = false;
+	unsigned char *m_apData[NUM_MAP_TYPES] = {nullptr, nullptr};
+	unsigned m_aSize[NUM_MAP_TYPES] = {0, 0};
+	bool m_aMapped[NUM_MAP_TYPES] = {false, false};
+	SHA256_DIGEST m_SixupSha256;
+	unsigned m_SixupCrc = 0;
+
+	CMapPreloadJob(IEngineMap *pMap, IStorage *pStorage, const char *pMapName, bool Sixup, bool Mapped) :
+		m_pMap(pMap), m_pStorage(pStorage), m_Sixup(Sixup), m_Mapped(Mapped)
+	{
+		str_copy(m_aMapName, pMapName);
+		str_format(m_aPath, sizeof(m_aPath), "maps/%s.map", pMapName);
+	}
+
+	~CMapPreloadJob() override
+	{
+		for(int i = 0; i < NUM_MAP_TYPES; i++)
+			FreeMapFile(m_apData[i], m_aSize[i], m_aMapped[i]);
+	}
+};
+
+bool CServer::PreloadingMap()
+{
+	// the map must not be loaded while it is preloaded
+	if(m_pMapPreload && !m_pMapPreload->Done())
+		return true;
+	if(!m_MapReload || !str_valid_filename(fs_filename(Config()->m_SvMap)))
+		return false;
+	if(m_pMapPreload && str_comp(m_pMapPreload->m_aMapName, Config()->m_SvMap) == 0)
+		return false;
+
+	m_pMap->SetMapped(Config()->m_SvMapMmap);
+	m_pMapPreload = std::make_shared<CMapPreloadJob>(m_pMap, Storage(), Config()->m_SvMap, Config()->m_SvSixup, Config()->m_SvMapMmap);
+	Engine()->AddJob(m_pMapPreload);
+	log_info("server", "preloading map '%s'", Config()->m_SvMap);
+	return true;
+}
+
 int CServer::LoadMap(const char *pMapName)
 {
 	m_MapReload = false;
@@ -2851,6 +3129,13 @@ int CServer::LoadMap(const char *pMapName)
 	{
 		return 0;
 	}
+
+	// the preload is of no use if the game server rewrote the map
+	std::shared_ptr<CMapPreloadJob> pPreload = std::move(m_pMapPreload);
+	if(pPreload && (!pPreload->m_Success || str_comp(pPreload->m_aPath, aBuf) != 0))
+		pPreload = nullptr;
+
+	m_pMap->SetMapped(Config()->m_SvMapMmap);
 	if(!m_pMap->Load(aBuf))
 	{
 		return 0;
@@ -2873,10 +3158,18 @@ int CServer::LoadMap(const char *pMapName)
 
 	// load complete map into memory for download
 	{
-		free(m_apCurrentMapData[MAP_TYPE_SIX]);
-		void *pData;
-		Storage()->ReadFile(aBuf, IStorage::TYPE_ALL, &pData, &m_aCurrentMapSize[MAP_TYPE_SIX]);
-		m_apCurrentMapData[MAP_TYPE_SIX] = (unsigned char *)pData;
+		FreeMapFile(m_apCurrentMapData[MAP_TYPE_SIX], m_aCurrentMapSize[MAP_TYPE_SIX], m_aCurrentMapDataMapped[MAP_TYPE_SIX]);
+		if(pPreload && pPreload->m_apData[MAP_TYPE_SIX])
+		{
+			m_apCurrentMapData[MAP_TYPE_SIX] = std::exchange(pPreload->m_apData[MAP_TYPE_SIX], nullptr);
+			m_aCurrentMapSize[MAP_TYPE_SIX] = pPreload->m_aSize[MAP_TYPE_SIX];
+			m_aCurrentMapDataMapped[MAP_TYPE_SIX] = pPreload->m_aMapped[MAP_TYPE_SIX];
+		}
+		else if(!ReadMapFile(Storage(), aBuf, Config()->m_SvMapMmap, &m_apCurrentMapData[MAP_TYPE_SIX], &m_aCurrentMapSize[MAP_TYPE_SIX], &m_aCurrentMapDataMapped[MAP_TYPE_SIX]))
+		{
+			m_apCurrentMapData[MAP_TYPE_SIX] = nullptr;
+			m_aCurrentMapSize[MAP_TYPE_SIX] = 0;
+		}
 	}
 
 	if(Config()->m_SvMapsBaseUrl[0])
@@ -2895,8 +3188,17 @@ int CServer::LoadMap(const char *pMapName)
 	if(Config()->m_SvSixup)
 	{
 		str_format(aBuf, sizeof(aBuf), "maps7/%s.map", pMapName);
-		void *pData;
-		if(!Storage()->ReadFile(aBuf, IStorage::TYPE_ALL, &pData, &m_aCurrentMapSize[MAP_TYPE_SIXUP]))
+		unsigned char *pData;
+		unsigned Size;
+		bool Mapped;
+		const bool Preloaded = pPreload && pPreload->m_apData[MAP_TYPE_SIXUP];
+		if(Preloaded)
+		{
+			pData = std::exchange(pPreload->m_apData[MAP_TYPE_SIXUP], nullptr);
+			Size = pPreload->m_aSize[MAP_TYPE_SIXUP];
+			Mapped = pPreload->m_aMapped[MAP_TYPE_SIXUP];
+		}
+		if(!Preloaded && !ReadMapFile(Storage(), aBuf, Config()->m_SvMapMmap, &pData, &Size, &Mapped))
 		{
 			Config()->m_SvSixup = 0;
 			if(m_pRegister)
@@ -2908,11 +3210,13 @@ int CServer::LoadMap(const char *pMapName)
 		}
 		else
 		{
-			free(m_apCurrentMapData[MAP_TYPE_SIXUP]);
-			m_apCurrentMapData[MAP_TYPE_SIXUP] = (unsigned char *)pData;
+			FreeMapFile(m_apCurrentMapData[MAP_TYPE_SIXUP], m_aCurrentMapSize[MAP_TYPE_SIXUP], m_aCurrentMapDataMapped[MAP_TYPE_SIXUP]);
+			m_apCurrentMapData[MAP_TYPE_SIXUP] = pData;
+			m_aCurrentMapSize[MAP_TYPE_SIXUP] = Size;
+			m_aCurrentMapDataMapped[MAP_TYPE_SIXUP] = Mapped;
 
-			m_aCurrentMapSha256[MAP_TYPE_SIXUP] = sha256(m_apCurrentMapData[MAP_TYPE_SIXUP], m_aCurrentMapSize[MAP_TYPE_SIXUP]);
-			m_aCurrentMapCrc[MAP_TYPE_SIXUP] = crc32(0, m_apCurrentMapData[MAP_TYPE_SIXUP], m_aCurrentMapSize[MAP_TYPE_SIXUP]);
+			m_aCurrentMapSha256[MAP_TYPE_SIXUP] = Preloaded ? pPreload->m_SixupSha256 : sha256(m_apCurrentMapData[MAP_TYPE_SIXUP], m_aCurrentMapSize[MAP_TYPE_SIXUP]);
+			m_aCurrentMapCrc[MAP_TYPE_SIXUP] = Preloaded ? pPreload->m_SixupCrc : crc32(0, m_apCurrentMapData[MAP_TYPE_SIXUP], m_aCurrentMapSize[MAP_TYPE_SIXUP]);
 			sha256_str(m_aCurrentMapSha256[MAP_TYPE_SIXUP], aSha256, sizeof(aSha256));
 			str_format(aBufMsg, sizeof(aBufMsg), "%s sha256 is %s", aBuf, aSha256);
 			Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "sixup", aBufMsg);
@@ -2920,8 +3224,9 @@ int CServer::LoadMap(const char *pMapName)
 	}
 	if(!Config()->m_SvSixup)
 	{
-		free(m_apCurrentMapData[MAP_TYPE_SIXUP]);
+		FreeMapFile(m_apCurrentMapData[MAP_TYPE_SIXUP], m_aCurrentMapSize[MAP_TYPE_SIXUP], m_aCurrentMapDataMapped[MAP_TYPE_SIXUP]);
 		m_apCurrentMapData[MAP_TYPE_SIXUP] = nullptr;
+		m_aCurrentMapDataMapped[MAP_TYPE_SIXUP] = false;
 	}
 
 	for(int i = 0; i < MAX_CLIENTS; i++)
@@ -2991,6 +3296,74 @@ void CServer::UpdateDebugDummies(bool ForceDisconnect)
 }
 #endif
 
+void CServer::DoGameTick()
+{
+	static const int s_ProfileTick = g_Profiler.Section("server/tick");
+	static const int s_ProfileTeehistorian = g_Profiler.Section("server/tick/teehistorian");
+	static const int s_ProfileInput = g_Profiler.Section("server/tick/input");
+	static const int s_ProfileGame = g_Profiler.Section("server/tick/game");
+
+	g_Profiler.OnTick();
+	CProfileScope ProfileTick(s_ProfileTick);
+
+	{
+		CProfileScope Profile(s_ProfileTeehistorian);
+		GameServer()->OnPreTickTeehistorian();
+	}
+
+#ifdef CONF_DEBUG
+	UpdateDebugDummies(false);
+#endif
+
+	{
+		CProfileScope Profile(s_ProfileInput);
+		for(int c = 0; c < MAX_CLIENTS; c++)
+		{
+			if(m_aClients[c].m_State != CClient::STATE_INGAME)
+				continue;
+			bool ClientHadInput = false;
+			for(auto &Input : m_aClients[c].m_aInputs)
+			{
+				if(Input.m_GameTick == Tick() + 1)
+				{
+					GameServer()->OnClientPredictedEarlyInput(c, Input.m_aData);
+					ClientHadInput = true;
+					break;
+				}
+			}
+			if(!ClientHadInput)
+				GameServer()->OnClientPredictedEarlyInput(c, nullptr);
+		}
+	}
+
+	m_CurrentGameTick++;
+
+	// apply new input
+	{
+		CProfileScope Profile(s_ProfileInput);
+		for(int c = 0; c < MAX_CLIENTS; c++)
+		{
+			if(m_aClients[c].m_State != CClient::STATE_INGAME)
+				continue;
+			bool ClientHadInput = false;
+			for(auto &Input : m_aClients[c].m_aInputs)
+			{
+				if(Input.m_GameTick == Tick())
+				{
+					GameServer()->OnClientPredictedInput(c, Input.m_aData);
+					ClientHadInput = true;
+					break;
+				}
+			}
+			if(!ClientHadInput)
+				GameServer()->OnClientPredictedInput(c, nullptr);
+		}
+	}
+
+	CProfileScope Profile(s_ProfileGame);
+	GameServer()->OnTick();
+}
+
 int CServer::Run()
 {
 	if(m_RunServer == UNINITIALIZED)
@@ -3072,7 +3445,6 @@ int CServer::Run()
 		return -1;
 	}
 
-	m_pEngine = Kernel()->RequestInterface<IEngine>();
 	m_pRegister = CreateRegister(&g_Config, m_pConsole, m_pEngine, &m_Http, g_Config.m_SvRegisterPort > 0 ? g_Config.m_SvRegisterPort : this->Port(), m_NetServer.GetGlobalToken());
 
 	m_NetServer.SetCallbacks(NewClientCallback, NewClientNoAuthCallback, ClientRejoinCallback, DelClientCallback, this);
@@ -3086,6 +3458,7 @@ int CServer::Run()
 	Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
 
 	Antibot()->Init();
+	InitSnapshotWorkers();
 	GameServer()->OnInit(nullptr);
 	if(ErrorShutdown())
 	{
@@ -3117,6 +3490,11 @@ int CServer::Run()
 		bool NonActive = false;
 		bool PacketWaiting = false;
 
+		const int ProfileSnapshot = g_Profiler.Section("server/snapshot");
+		const int ProfileRegister = g_Profiler.Section("server/register");
+		const int ProfileDnsbl = g_Profiler.Section("server/dnsbl");
+		const int ProfileNetwork = g_Profiler.Section("server/network");
+
 		m_GameStartTime = time_get();
 
 		UpdateServerInfo();
@@ -3130,8 +3508,8 @@ int CServer::Run()
 			int64_t LastTime = time_get();
 			int NewTicks = 0;
 
-			// load new map
-			if(m_MapReload || m_SameMapReload || m_CurrentGameTick >= MAX_TICK) // force reload to make sure the ticks stay within a valid range
+			// load new map, the current one keeps running until the new one is preloaded
+			if((m_MapReload || m_SameMapReload || m_CurrentGameTick >= MAX_TICK) && !PreloadingMap()) // force reload to make sure the ticks stay within a valid range
 			{
 				const bool SameMapReload = m_SameMapReload;
 				// load map
@@ -3201,53 +3579,8 @@ int CServer::Run()
 
 			while(LastTime > TickStartTime(m_CurrentGameTick + 1))
 			{
-				GameServer()->OnPreTickTeehistorian();
-
-#ifdef CONF_DEBUG
-				UpdateDebugDummies(false);
-#endif
-
-				for(int c = 0; c < MAX_CLIENTS; c++)
-				{
-					if(m_aClients[c].m_State != CClient::STATE_INGAME)
-						continue;
-					bool ClientHadInput = false;
-					for(auto &Input : m_aClients[c].m_aInputs)
-					{
-						if(Input.m_GameTick == Tick() + 1)
-						{
-							GameServer()->OnClientPredictedEarlyInput(c, Input.m_aData);
-							ClientHadInput = true;
-							break;
-						}
-					}
-					if(!ClientHadInput)
-						GameServer()->OnClientPredictedEarlyInput(c, nullptr);
-				}
-
-				m_CurrentGameTick++;
+				DoGameTick();
 				NewTicks++;
-
-				// apply new input
-				for(int c = 0; c < MAX_CLIENTS; c++)
-				{
-					if(m_aClients[c].m_State != CClient::STATE_INGAME)
-						continue;
-					bool ClientHadInput = false;
-					for(auto &Input : m_aClients[c].m_aInputs)
-					{
-						if(Input.m_GameTick == Tick())
-						{
-							GameServer()->OnClientPredictedInput(c, Input.m_aData);
-							ClientHadInput = true;
-							break;
-						}
-					}
-					if(!ClientHadInput)
-						GameServer()->OnClientPredictedInput(c, nullptr);
-				}
-
-				GameServer()->OnTick();
 				if(ErrorShutdown())
 				{
 					break;
@@ -3257,7 +3590,10 @@ int CServer::Run()
 			// snap game
 			if(NewTicks)
 			{
-				DoSnapshot();
+				{
+					CProfileScope Profile(ProfileSnapshot);
+					DoSnapshot();
+				}
 
 				const int CommandSendingClientId = Tick() % MAX_CLIENTS;
 				UpdateClientRconCommands(CommandSendingClientId);
@@ -3274,7 +3610,10 @@ int CServer::Run()
 #endif
 
 				// master server stuff
-				m_pRegister->Update();
+				{
+					CProfileScope Profile(ProfileRegister);
+					m_pRegister->Update();
+				}
 
 				if(m_ServerInfoNeedsUpdate)
 					UpdateServerInfo();
@@ -3284,6 +3623,7 @@ int CServer::Run()
 				// handle dnsbl
 				if(Config()->m_SvDnsbl)
 				{
+					CProfileScope Profile(ProfileDnsbl);
 					for(int ClientId = 0; ClientId < MAX_CLIENTS; ClientId++)
 					{
 						if(m_aClients[ClientId].m_State == CClient::STATE_EMPTY)
@@ -3334,7 +3674,10 @@ int CServer::Run()
 			}
 
 			if(!NonActive)
+			{
+				CProfileScope Profile(ProfileNetwork);
 				PumpNetwork(PacketWaiting);
+			}
 
 			NonActive = true;
 			for(const auto &Client : m_aClients)
@@ -3408,6 +3751,7 @@ int CServer::Run()
 	m_pRegister->OnShutdown();
 	m_Econ.Shutdown();
 	m_Fifo.Shutdown();
+	ShutdownSnapshotWorkers();
 	Engine()->ShutdownJobs();
 
 	GameServer()->OnShutdown(nullptr);
@@ -4000,12 +4344,81 @@ void CServer::ConDumpSqlServers(IConsole::IResult *pResult, void *pUserData)
 	}
 }
 
+void CServer::ConSqlStats(IConsole::IResult *pResult, void *pUserData)
+{
+	CServer *pSelf = (CServer *)pUserData;
+	pSelf->DbPool()->PrintStats(pSelf->Console());
+}
+
 void CServer::ConReloadAnnouncement(IConsole::IResult *pResult, void *pUserData)
 {
 	CServer *pThis = static_cast<CServer *>(pUserData);
 	pThis->ReadAnnouncementsFile();
 }
 
+void CServer::ConSnapshotDeltaCache(IConsole::IResult *pResult, void *pUserData)
+{
+	CServer *pThis = static_cast<CServer *>(pUserData);
+	const uint64_t Total = pThis->m_SnapshotDeltaCacheHits + pThis->m_SnapshotDeltaCacheMisses;
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "snapshot deltas: reused=%" PRIu64 " created=%" PRIu64 " hit_rate=%.1f%%",
+		pThis->m_SnapshotDeltaCacheHits, pThis->m_SnapshotDeltaCacheMisses,
+		Total ? 100.0 * pThis->m_SnapshotDeltaCacheHits / Total : 0.0);
+	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+}
+
+void CServer::ConProfilerStats(IConsole::IResult *pResult, void *pUserData)
+{
+	CServer *pThis = static_cast<CServer *>(pUserData);
+	const char *pPrefix = pResult->NumArguments() ? pResult->GetString(0) : "";
+	if(!g_Profiler.Enabled())
+		pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "profiler", "the profiler is disabled, enable it with sv_profiler 1");
+
+	char aBuf[256];
+	for(int i = 0; i < g_Profiler.NumSections(); i++)
+	{
+		const CProfiler::CSection &Section = g_Profiler.GetSection(i);
+		if(Section.m_Count == 0 || !str_startswith(Section.m_pName, pPrefix))
+			continue;
+		str_format(aBuf, sizeof(aBuf), "%s: count=%" PRId64 " avg=%.3fms p50<%.3fms p99<%.3fms max=%.3fms over_tick=%" PRId64,
+			Section.m_pName, Section.m_Count,
+			Section.m_TotalNs / (double)Section.m_Count / 1000000.0,
+			g_Profiler.Percentile(i, 0.5f) / 1000000.0,
+			g_Profiler.Percentile(i, 0.99f) / 1000000.0,
+			Section.m_MaxNs / 1000000.0,
+			Section.m_OverBudget);
+		pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "profiler", aBuf);
+	}
+}
+
+void CServer::ConProfilerReset(IConsole::IResult *pResult, void *pUserData)
+{
+	g_Profiler.Reset();
+}
+
+void CServer::ConProfilerTrace(IConsole::IResult *pResult, void *pUserData)
+{
+	CServer *pThis = static_cast<CServer *>(pUserData);
+	const char *pFilename = pResult->GetString(0);
+	const int NumTicks = pResult->NumArguments() > 1 ? pResult->GetInteger(1) : SERVER_TICK_SPEED;
+	char aBuf[IO_MAX_PATH_LENGTH + 64];
+	if(NumTicks <= 0 || NumTicks > 60 * SERVER_TICK_SPEED)
+	{
+		pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "profiler", "the number of ticks must be between 1 and 3000");
+		return;
+	}
+	IOHANDLE File = pThis->Storage()->OpenFile(pFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+	if(!File)
+	{
+		str_format(aBuf, sizeof(aBuf), "failed to open '%s' for writing", pFilename);
+		pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "profiler", aBuf);
+		return;
+	}
+	g_Profiler.StartTrace(File, NumTicks);
+	str_format(aBuf, sizeof(aBuf), "recording %d ticks to '%s'", NumTicks, pFilename);
+	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "profiler", aBuf);
+}
+
 void CServer::ConReloadMaplist(IConsole::IResult *pResult, void *pUserData)
 {
 	CServer *pThis = static_cast<CServer *>(pUserData);
@@ -4186,6 +4599,13 @@ void CServer::ConchainSixupUpdate(IConsole::IResult *pResult, void *pUserData, I
 		pThis->m_MapReload |= (pThis->m_apCurrentMapData[MAP_TYPE_SIXUP] != nullptr) != (pResult->GetInteger(0) != 0);
 }
 
+void CServer::ConchainProfiler(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData)
+{
+	pfnCallback(pResult, pCallbackUserData);
+	if(pResult->NumArguments())
+		g_Profiler.SetEnabled(g_Config.m_SvProfiler);
+}
+
 void CServer::ConchainLoglevel(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData)
 {
 	CServer *pSelf = (CServer *)pUserData;
@@ -4259,6 +4679,7 @@ void CServer::ConchainConnLoggingServerChange(IConsole::IResult *pResult, void *
 void CServer::RegisterCommands()
 {
 	m_pConsole = Kernel()->RequestInterface<IConsole>();
+	m_pEngine = Kernel()->RequestInterface<IEngine>();
 	m_pGameServer = Kernel()->RequestInterface<IGameServer>();
 	m_pMap = Kernel()->RequestInterface<IEngineMap>();
 	m_pStorage = Kernel()->RequestInterface<IStorage>();
@@ -4282,6 +4703,7 @@ void CServer::RegisterCommands()
 
 	Console()->Register("add_sqlserver", "s['r'|'w'] s[Database] s[Prefix] s[User] s[Password] s[IP] i[Port] ?i[SetUpDatabase ?]", CFGFLAG_SERVER | CFGFLAG_NONTEEHISTORIC, ConAddSqlServer, this, "add a sqlserver");
 	Console()->Register("dump_sqlservers", "s['r'|'w']", CFGFLAG_SERVER, ConDumpSqlServers, this, "dumps all sqlservers readservers = r, writeservers = w");
+	Console()->Register("sql_stats", "", CFGFLAG_SERVER, ConSqlStats, this, "Shows the queue depths and latency histograms of the SQL queries");
 
 	Console()->Register("auth_add", "s[ident] s[level] r[pw]", CFGFLAG_SERVER | CFGFLAG_NONTEEHISTORIC, ConAuthAdd, this, "Add a rcon key");
 	Console()->Register("auth_add_p", "s[ident] s[level] s[hash] s[salt]", CFGFLAG_SERVER | CFGFLAG_NONTEEHISTORIC, ConAuthAddHashed, this, "Add a prehashed rcon key");
@@ -4292,6 +4714,10 @@ void CServer::RegisterCommands()
 
 	Console()->Register("reload_announcement", "", CFGFLAG_SERVER, ConReloadAnnouncement, this, "Reload the announcements");
 	Console()->Register("reload_maplist", "", CFGFLAG_SERVER, ConReloadMaplist, this, "Reload the maplist");
+	Console()->Register("snapshot_delta_cache", "", CFGFLAG_SERVER, ConSnapshotDeltaCache, this, "Show how many snapshot deltas were reused for clients with identical snapshots");
+	Console()->Register("profiler_stats", "?s[prefix]", CFGFLAG_SERVER, ConProfilerStats, this, "Show the durations of the profiled sections of the server tick, optionally only those starting with prefix");
+	Console()->Register("profiler_reset", "", CFGFLAG_SERVER, ConProfilerReset, this, "Reset the durations of the profiled sections");
+	Console()->Register("profiler_trace", "s[file] ?i[ticks]", CFGFLAG_SERVER, ConProfilerTrace, this, "Record the profiled sections of the next ticks (default 50) to a Chrome trace file");
 
 	RustVersionRegister(*Console());
 
@@ -4307,6 +4733,7 @@ void CServer::RegisterCommands()
 	Console()->Chain("sv_rcon_helper_password", ConchainRconHelperPasswordChange, this);
 	Console()->Chain("sv_map", ConchainMapUpdate, this);
 	Console()->Chain("sv_sixup", ConchainSixupUpdate, this);
+	Console()->Chain("sv_profiler", ConchainProfiler, this);
 
 	Console()->Chain("loglevel", ConchainLoglevel, this);
 	Console()->Chain("stdout_output_level", ConchainStdoutOutputLevel, this);
@@ -4344,6 +4771,8 @@ void *CServer::SnapNewItem(int Type, int Id, int Size)
 void CServer::SnapSetStaticsize(int ItemType, int Size)
 {
 	m_SnapshotDelta.SetStaticsize(ItemType, Size);
+	for(auto &pWorkspace : m_vpSnapshotWorkspaces)
+		pWorkspace->m_Delta.SetStaticsize(ItemType, Size);
 }
 
 CServer *CreateServer() { return new CServer(); }
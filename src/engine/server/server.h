@@ -12,12 +12,14 @@
 #include <engine/shared/econ.h>
 #include <engine/shared/fifo.h>
 #include <engine/shared/http.h>
+#include <engine/shared/jobs.h>
 #include <engine/shared/netban.h>
 #include <engine/shared/network.h>
 #include <engine/shared/protocol.h>
 #include <engine/shared/snapshot.h>
 #include <engine/shared/uuid_manager.h>
 
+#include <atomic>
 #include <memory>
 #include <optional>
 #include <vector>
@@ -154,6 +156,14 @@ public:
 		int m_LastInputTick;
 		CSnapshotStorage m_Snapshots;
 
+		// compressed snapshot delta of the current tick, waiting to be sent
+		int m_SnapshotCrc;
+		int m_SnapshotDeltaTick;
+		const CSnapshot *m_pSnapshotDeltaBase;
+		int m_SnapshotDeltaBaseSize;
+		int m_SnapshotDeltaSource;
+		std::vector<char> m_vSnapshotData;
+
 		CNetMsg_Sv_PreInput m_LastPreInput = {};
 		CInput m_LatestInput;
 		CInput m_aInputs[200]; // TODO: handle input better
@@ -217,6 +227,26 @@ public:
 
 	CSnapshotDelta m_SnapshotDelta;
 	CSnapshotBuilder m_SnapshotBuilder;
+
+	class CSnapshotWorkspace
+	{
+	public:
+		CSnapshotDelta m_Delta;
+		char m_aDeltaData[CSnapshot::MAX_SIZE];
+		char m_aCompData[CSnapshot::MAX_SIZE];
+	};
+	// the first workspace belongs to the main thread, the others to the snapshot job pool
+	std::vector<std::unique_ptr<CSnapshotWorkspace>> m_vpSnapshotWorkspaces;
+	CJobPool m_SnapshotJobPool;
+	SEMAPHORE m_SnapshotJobsDone;
+	// started by the first game world that asks for it
+	CJobPool m_WorldJobPool;
+	bool m_WorldJobPoolStarted = false;
+	std::vector<int> m_vSnapshotClients;
+	std::vector<int> m_vSnapshotRecipients;
+	std::atomic<int> m_NextSnapshotClient;
+	uint64_t m_SnapshotDeltaCacheHits;
+	uint64_t m_SnapshotDeltaCacheMisses;
 	CSnapIdPool m_IdPool;
 	CNetServer m_NetServer;
 	CEcon m_Econ;
@@ -267,8 +297,15 @@ public:
 	unsigned m_aCurrentMapCrc[NUM_MAP_TYPES];
 	unsigned char *m_apCurrentMapData[NUM_MAP_TYPES];
 	unsigned int m_aCurrentMapSize[NUM_MAP_TYPES];
+	// whether the map data for downloads is mapped instead of read
+	bool m_aCurrentMapDataMapped[NUM_MAP_TYPES];
 	char m_aMapDownloadUrl[256];
 
+	// the next map is read, hashed and parsed on a job thread while the
+	// current one keeps running, LoadMap takes the result
+	class CMapPreloadJob;
+	std::shared_ptr<CMapPreloadJob> m_pMapPreload;
+
 	CDemoRecorder m_aDemoRecorder[NUM_RECORDERS];
 	CAuthManager m_AuthManager;
 
@@ -313,6 +350,11 @@ public:
 
 	int Init();
 
+	// advances the game by one tick, applying the inputs of the clients
+	void DoGameTick();
+	// lets tools replaying recorded games start at the recorded tick
+	void SetTick(int Tick) { m_CurrentGameTick = Tick; }
+
 	void SendLogLine(const CLogMessage *pMessage);
 	void SetRconCid(int ClientId) override;
 	int GetAuthedState(int ClientId) const override;
@@ -338,6 +380,15 @@ public:
 	int GetClientVersion(int ClientId) const override;
 	int SendMsg(CMsgPacker *pMsg, int Flags, int ClientId) override;
 
+	void InitSnapshotWorkers();
+	void ShutdownSnapshotWorkers();
+	void BuildClientSnapshot(int ClientId, bool IsGlobalSnap);
+	int FindSnapshotDeltaSource(int ClientId) const;
+	void PackClientSnapshot(int ClientId, CSnapshotWorkspace *pWorkspace);
+	void SendClientSnapshot(int ClientId);
+	void RunSnapshotWorker(CSnapshotWorkspace *pWorkspace);
+	// builds and packs the snapshots of the clients that get one this tick, without sending them
+	void CreateSnapshots(bool IsGlobalSnap);
 	void DoSnapshot();
 
 	static int NewClientCallback(int ClientId, void *pUser, bool Sixup);
@@ -423,6 +474,7 @@ public:
 	const char *GetMapName() const override;
 	void ReloadMap() override;
 	int LoadMap(const char *pMapName);
+	bool PreloadingMap();
 
 	void SaveDemo(int ClientId, float Time) override;
 	void StartRecord(int ClientId) override;
@@ -453,9 +505,14 @@ public:
 	// console commands for sqlmasters
 	static void ConAddSqlServer(IConsole::IResult *pResult, void *pUserData);
 	static void ConDumpSqlServers(IConsole::IResult *pResult, void *pUserData);
+	static void ConSqlStats(IConsole::IResult *pResult, void *pUserData);
 
 	static void ConReloadAnnouncement(IConsole::IResult *pResult, void *pUserData);
 	static void ConReloadMaplist(IConsole::IResult *pResult, void *pUserData);
+	static void ConSnapshotDeltaCache(IConsole::IResult *pResult, void *pUserData);
+	static void ConProfilerStats(IConsole::IResult *pResult, void *pUserData);
+	static void ConProfilerReset(IConsole::IResult *pResult, void *pUserData);
+	static void ConProfilerTrace(IConsole::IResult *pResult, void *pUserData);
 
 	static void ConchainSpecialInfoupdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 	static void ConchainMaxclientsperipUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
@@ -470,6 +527,7 @@ public:
 	static void ConchainRconHelperPasswordChange(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 	static void ConchainMapUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 	static void ConchainSixupUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
+	static void ConchainProfiler(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 	static void ConchainLoglevel(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 	static void ConchainStdoutOutputLevel(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 	static void ConchainAnnouncementFileName(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
@@ -526,6 +584,8 @@ public:
 
 	bool IsSixup(int ClientId) const override { return ClientId != SERVER_DEMO_CLIENT && m_aClients[ClientId].m_Sixup; }
 
+	CJobPool *WorldJobPool() override;
+
 	void SetLoggers(std::shared_ptr<ILogger> &&pFileLogger, std::shared_ptr<ILogger> &&pStdoutLogger);
 
 #ifdef CONF_FAMILY_UNIX
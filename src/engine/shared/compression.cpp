@@ -37,6 +37,9 @@ unsigned char *CVariableInt::Pack(unsigned char *pDst, int i, int DstSize)
 	return pDst;
 }
 
+static const int s_aMasks[] = {0x7F, 0x7F, 0x7F, 0x0F};
+static const int s_aShifts[] = {6, 6 + 7, 6 + 7 + 7, 6 + 7 + 7 + 7};
+
 const unsigned char *CVariableInt::Unpack(const unsigned char *pSrc, int *pInOut, int SrcSize)
 {
 	if(SrcSize <= 0)
@@ -46,9 +49,6 @@ const unsigned char *CVariableInt::Unpack(const unsigned char *pSrc, int *pInOut
 	*pInOut = *pSrc & 0x3F;
 	SrcSize--;
 
-	static const int s_aMasks[] = {0x7F, 0x7F, 0x7F, 0x0F};
-	static const int s_aShifts[] = {6, 6 + 7, 6 + 7 + 7, 6 + 7 + 7 + 7};
-
 	for(unsigned i = 0; i < std::size(s_aMasks); i++)
 	{
 		if(!(*pSrc & 0x80))
@@ -65,6 +65,47 @@ const unsigned char *CVariableInt::Unpack(const unsigned char *pSrc, int *pInOut
 	return pSrc;
 }
 
+// The bulk routines below produce and accept exactly the same bytes as Pack
+// and Unpack. Most ints in snapshot deltas are small, so they first try to
+// handle a whole block of ints that each fit into a single byte with
+// branch-free loops, and otherwise skip the bounds checks of Pack and Unpack
+// while the buffers have room for the longest encoding.
+static constexpr int BLOCK_SIZE = 8;
+
+static unsigned char *PackUnchecked(unsigned char *pDst, int i)
+{
+	const int Sign = i < 0 ? 0x40 : 0;
+	unsigned Value = i < 0 ? ~i : i;
+	if(Value < 0x40)
+	{
+		*pDst++ = Sign | Value;
+		return pDst;
+	}
+	*pDst++ = 0x80 | Sign | (Value & 0x3F);
+	Value >>= 6;
+	while(Value >= 0x80)
+	{
+		*pDst++ = 0x80 | (Value & 0x7F);
+		Value >>= 7;
+	}
+	*pDst++ = Value;
+	return pDst;
+}
+
+static const unsigned char *UnpackUnchecked(const unsigned char *pSrc, int *pOut)
+{
+	const int Sign = (*pSrc >> 6) & 1;
+	int Value = *pSrc & 0x3F;
+	for(unsigned i = 0; i < std::size(s_aMasks) && (*pSrc & 0x80); i++)
+	{
+		pSrc++;
+		Value |= (*pSrc & s_aMasks[i]) << s_aShifts[i];
+	}
+	pSrc++;
+	*pOut = Value ^ -Sign;
+	return pSrc;
+}
+
 long CVariableInt::Decompress(const void *pSrc_, int SrcSize, void *pDst_, int DstSize)
 {
 	dbg_assert(DstSize % sizeof(int) == 0, "invalid bounds");
@@ -77,9 +118,32 @@ long CVariableInt::Decompress(const void *pSrc_, int SrcSize, void *pDst_, int D
 	{
 		if(pDst >= pDstEnd)
 			return -1;
-		pSrc = CVariableInt::Unpack(pSrc, pDst, pSrcEnd - pSrc);
-		if(!pSrc)
-			return -1;
+
+		if(pSrcEnd - pSrc >= BLOCK_SIZE && pDstEnd - pDst >= BLOCK_SIZE)
+		{
+			unsigned char Extended = 0;
+			for(int i = 0; i < BLOCK_SIZE; i++)
+				Extended |= pSrc[i];
+			if(!(Extended & 0x80))
+			{
+				for(int i = 0; i < BLOCK_SIZE; i++)
+					pDst[i] = (pSrc[i] & 0x3F) ^ -((pSrc[i] >> 6) & 1);
+				pSrc += BLOCK_SIZE;
+				pDst += BLOCK_SIZE;
+				continue;
+			}
+		}
+
+		if(pSrcEnd - pSrc >= MAX_BYTES_PACKED)
+		{
+			pSrc = UnpackUnchecked(pSrc, pDst);
+		}
+		else
+		{
+			pSrc = CVariableInt::Unpack(pSrc, pDst, pSrcEnd - pSrc);
+			if(!pSrc)
+				return -1;
+		}
 		pDst++;
 	}
 	return (long)((unsigned char *)pDst - (unsigned char *)pDst_);
@@ -90,15 +154,37 @@ long CVariableInt::Compress(const void *pSrc_, int SrcSize, void *pDst_, int Dst
 	dbg_assert(SrcSize % sizeof(int) == 0, "invalid bounds");
 
 	const int *pSrc = (int *)pSrc_;
+	const int *pSrcEnd = pSrc + SrcSize / sizeof(int); // NOLINT(bugprone-sizeof-expression)
 	unsigned char *pDst = (unsigned char *)pDst_;
 	const unsigned char *pDstEnd = pDst + DstSize;
-	SrcSize /= sizeof(int);
-	while(SrcSize)
+	while(pSrc < pSrcEnd)
 	{
-		pDst = CVariableInt::Pack(pDst, *pSrc, pDstEnd - pDst);
-		if(!pDst)
-			return -1;
-		SrcSize--;
+		if(pSrcEnd - pSrc >= BLOCK_SIZE && pDstEnd - pDst >= BLOCK_SIZE)
+		{
+			// an int fits into a single byte if it lies in [-64, 63]
+			unsigned Large = 0;
+			for(int i = 0; i < BLOCK_SIZE; i++)
+				Large |= ((unsigned)pSrc[i] + 64) >> 7;
+			if(!Large)
+			{
+				for(int i = 0; i < BLOCK_SIZE; i++)
+					pDst[i] = ((pSrc[i] >> 31) & 0x40) | ((pSrc[i] ^ (pSrc[i] >> 31)) & 0x3F);
+				pSrc += BLOCK_SIZE;
+				pDst += BLOCK_SIZE;
+				continue;
+			}
+		}
+
+		if(pDstEnd - pDst >= MAX_BYTES_PACKED)
+		{
+			pDst = PackUnchecked(pDst, *pSrc);
+		}
+		else
+		{
+			pDst = CVariableInt::Pack(pDst, *pSrc, pDstEnd - pDst);
+			if(!pDst)
+				return -1;
+		}
 		pSrc++;
 	}
 	return (long)(pDst - (unsigned char *)pDst_);
@@ -13,6 +13,12 @@ public:
 	};
 
 	static unsigned char *Pack(unsigned char *pDst, int i, int DstSize);
+	// the number of bytes Pack needs for i
+	static int PackedSize(int i)
+	{
+		const unsigned Value = i < 0 ? ~i : i;
+		return 1 + (Value >= (1u << 6)) + (Value >= (1u << 13)) + (Value >= (1u << 20)) + (Value >= (1u << 27));
+	}
 	static const unsigned char *Unpack(const unsigned char *pSrc, int *pInOut, int SrcSize);
 
 	static long Compress(const void *pSrc, int SrcSize, void *pDst, int DstSize);
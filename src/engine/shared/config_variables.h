@@ -460,6 +460,9 @@ MACRO_CONFIG_STR(SvMap, sv_map, 128, "Sunny Side Up", CFGFLAG_SERVER, "Map to us
 MACRO_CONFIG_INT(SvMaxClients, sv_max_clients, SERVER_MAX_CLIENTS, 1, SERVER_MAX_CLIENTS, CFGFLAG_SERVER, "Maximum number of clients that are allowed on a server")
 MACRO_CONFIG_INT(SvMaxClientsPerIp, sv_max_clients_per_ip, 4, 1, SERVER_MAX_CLIENTS, CFGFLAG_SERVER, "Maximum number of clients with the same IP that can connect to the server")
 MACRO_CONFIG_INT(SvHighBandwidth, sv_high_bandwidth, 0, 0, 1, CFGFLAG_SERVER, "Use high bandwidth mode. Doubles the bandwidth required for the server. LAN use only")
+MACRO_CONFIG_INT(SvSnapshotThreads, sv_snapshot_threads, 0, 0, 64, CFGFLAG_SERVER, "Number of worker threads used to create and compress snapshots for clients (0 = only use the main thread, requires a restart)")
+MACRO_CONFIG_INT(SvWorldThreads, sv_world_threads, 0, 0, 64, CFGFLAG_SERVER, "Number of worker threads that move the characters of different teams concurrently (0 = only use the main thread, requires a restart)")
+MACRO_CONFIG_INT(SvMapMmap, sv_map_mmap, 0, 0, 1, CFGFLAG_SERVER, "Map the map files into memory instead of reading them, they must not be modified in place while loaded")
 MACRO_CONFIG_INT(SvPreInput, sv_preinput, 1, 0, 1, CFGFLAG_SERVER, "Sends client inputs to other clients before their correct tick. Increases the bandwidth required for the server")
 MACRO_CONFIG_STR(SvRegister, sv_register, 16, "1", CFGFLAG_SERVER, "Register server with master server for public listing, can also accept a comma-separated list of protocols to register on, like 'ipv4,ipv6'")
 MACRO_CONFIG_STR(SvRegisterExtra, sv_register_extra, 256, "", CFGFLAG_SERVER, "Extra headers to send to the register endpoint, comma-separated 'Header: Value' pairs")
@@ -474,7 +477,10 @@ MACRO_CONFIG_INT(SvRconBantime, sv_rcon_bantime, 5, 0, 1440, CFGFLAG_SERVER, "Th
 MACRO_CONFIG_INT(SvAutoDemoRecord, sv_auto_demo_record, 0, 0, 1, CFGFLAG_SERVER, "Automatically record demos")
 MACRO_CONFIG_INT(SvAutoDemoMax, sv_auto_demo_max, 10, 0, 1000, CFGFLAG_SERVER, "Maximum number of automatically recorded demos (0 = no limit)")
 MACRO_CONFIG_INT(SvTeeHistorian, sv_tee_historian, 0, 0, 1, CFGFLAG_SERVER, "Activate the tee historian that writes complete gameplay data to disk (WARNING: This will use a lot of disk space)")
+MACRO_CONFIG_INT(SvTeeHistorianCompress, sv_tee_historian_compress, 0, 0, 1, CFGFLAG_SERVER, "Write compressed tee historian files with a tick index (.teehistorian.z)")
+MACRO_CONFIG_INT(SvTeeHistorianFrameInterval, sv_tee_historian_frame_interval, 10, 1, 3600, CFGFLAG_SERVER, "Seconds between the independently compressed frames of compressed tee historian files, also the granularity of seeking")
 MACRO_CONFIG_INT(SvVanillaAntiSpoof, sv_vanilla_antispoof, 1, 0, 1, CFGFLAG_SERVER, "Enable vanilla Antispoof")
+MACRO_CONFIG_INT(SvProfiler, sv_profiler, 0, 0, 1, CFGFLAG_SERVER, "Measure the durations of the sections of the server tick, see profiler_stats")
 MACRO_CONFIG_INT(SvDnsbl, sv_dnsbl, 0, 0, 1, CFGFLAG_SERVER, "Enable DNSBL (DNS-based Blackhole List)")
 MACRO_CONFIG_STR(SvDnsblHost, sv_dnsbl_host, 128, "", CFGFLAG_SERVER, "Hostname of DNSBL provider to use for IP Verification")
 MACRO_CONFIG_STR(SvDnsblKey, sv_dnsbl_key, 128, "", CFGFLAG_SERVER | CFGFLAG_NONTEEHISTORIC, "Optional Authentication Key for the specified DNSBL provider")
@@ -566,6 +572,11 @@ MACRO_CONFIG_INT(SvSwap, sv_swap, 1, 0, 1, CFGFLAG_SERVER, "Enable /swap")
 MACRO_CONFIG_INT(SvTeam0Mode, sv_team0mode, 1, 0, 1, CFGFLAG_SERVER, "Enables /team0mode")
 MACRO_CONFIG_INT(SvUseSql, sv_use_sql, 0, 0, 1, CFGFLAG_SERVER, "Enables MySQL backend instead of SQLite backend (sv_sqlite_file is still used as fallback write server when no MySQL server is reachable)")
 MACRO_CONFIG_INT(SvSqlQueriesDelay, sv_sql_queries_delay, 1, 0, 20, CFGFLAG_SERVER, "Delay in seconds between SQL queries of a single player")
+MACRO_CONFIG_INT(SvSqlWriteBatch, sv_sql_write_batch, 32, 1, 256, CFGFLAG_SERVER, "Maximum number of queued SQL write queries executed in one transaction (1 disables batching)")
+MACRO_CONFIG_INT(SvSqlQueueLimit, sv_sql_queue_limit, 512, 16, 65536, CFGFLAG_SERVER, "Number of pending SQL queries above which repeatable player commands like /rank are dismissed, other queries are always queued")
+MACRO_CONFIG_INT(SvSqlReadWorkers, sv_sql_read_workers, 2, 1, 16, CFGFLAG_SERVER, "Number of threads executing SQL read queries in parallel to the writes (takes effect on the first read database)")
+MACRO_CONFIG_INT(SvLeaderboardCache, sv_leaderboard_cache, 0, 0, 86400, CFGFLAG_SERVER, "Seconds the cached leaderboard answers /rank, /top5, /points and /toppoints before it is reloaded from the database (0 = disabled)")
+MACRO_CONFIG_INT(SvLeaderboardCachePoints, sv_leaderboard_cache_points, 10000, 0, 1000000, CFGFLAG_SERVER, "Number of players with the most points kept in the leaderboard cache")
 MACRO_CONFIG_STR(SvSqliteFile, sv_sqlite_file, 64, "ddnet-server.sqlite", CFGFLAG_SERVER, "File to store ranks in case sv_use_sql is turned off or used as backup sql server")
 
 #if defined(CONF_UPNP)
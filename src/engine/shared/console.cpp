@@ -16,6 +16,7 @@
 #include "linereader.h"
 
 #include <algorithm>
+#include <cctype>
 #include <iterator> // std::size
 #include <new>
 
@@ -660,7 +661,11 @@ int CConsole::PossibleCommands(const char *pStr, int FlagMask, bool Temp, FPossi
 
 CConsole::CCommand *CConsole::FindCommand(const char *pName, int FlagMask)
 {
-	for(CCommand *pCommand = m_pFirstCommand; pCommand; pCommand = pCommand->Next())
+	const auto Bucket = m_CommandIndex.find(NameHash(pName));
+	if(Bucket == m_CommandIndex.end())
+		return nullptr;
+
+	for(CCommand *pCommand : Bucket->second)
 	{
 		if(pCommand->m_Flags & FlagMask)
 		{
@@ -922,8 +927,25 @@ void CConsole::ParseArguments(int NumArgs, const char **ppArguments)
 	}
 }
 
+unsigned CConsole::NameHash(const char *pName)
+{
+	// folds case the same way as str_comp_nocase
+	unsigned Hash = 5381;
+	for(; *pName; pName++)
+		Hash = ((Hash << 5) + Hash) + tolower((unsigned char)*pName);
+	return Hash;
+}
+
 void CConsole::AddCommandSorted(CCommand *pCommand)
 {
+	// keep the commands with the same name in list order, the first one
+	// matching the flags is found
+	std::vector<CCommand *> &vBucket = m_CommandIndex[NameHash(pCommand->m_pName)];
+	const auto InsertAt = std::find_if(vBucket.begin(), vBucket.end(), [pCommand](const CCommand *pOther) {
+		return str_comp(pCommand->m_pName, pOther->m_pName) <= 0;
+	});
+	vBucket.insert(InsertAt, pCommand);
+
 	if(!m_pFirstCommand || str_comp(pCommand->m_pName, m_pFirstCommand->m_pName) <= 0)
 	{
 		if(m_pFirstCommand && m_pFirstCommand->Next())
@@ -946,6 +968,16 @@ void CConsole::AddCommandSorted(CCommand *pCommand)
 	}
 }
 
+void CConsole::RemoveCommandIndex(CCommand *pCommand)
+{
+	const auto Bucket = m_CommandIndex.find(NameHash(pCommand->m_pName));
+	if(Bucket == m_CommandIndex.end())
+		return;
+	std::erase(Bucket->second, pCommand);
+	if(Bucket->second.empty())
+		m_CommandIndex.erase(Bucket);
+}
+
 void CConsole::Register(const char *pName, const char *pParams,
 	int Flags, FCommandCallback pfnFunc, void *pUser, const char *pHelp)
 {
@@ -1034,6 +1066,7 @@ void CConsole::DeregisterTemp(const char *pName)
 	// add to recycle list
 	if(pRemoved)
 	{
+		RemoveCommandIndex(pRemoved);
 		pRemoved->SetNext(m_pRecycleList);
 		m_pRecycleList = pRemoved;
 	}
@@ -1057,6 +1090,15 @@ void CConsole::DeregisterTempAll()
 		}
 	}
 
+	for(auto Bucket = m_CommandIndex.begin(); Bucket != m_CommandIndex.end();)
+	{
+		std::erase_if(Bucket->second, [](const CCommand *pCommand) { return pCommand->m_Temp; });
+		if(Bucket->second.empty())
+			Bucket = m_CommandIndex.erase(Bucket);
+		else
+			++Bucket;
+	}
+
 	m_TempCommands.Reset();
 	m_pRecycleList = nullptr;
 }
@@ -1107,7 +1149,11 @@ void CConsole::StoreCommands(bool Store)
 
 const IConsole::ICommandInfo *CConsole::GetCommandInfo(const char *pName, int FlagMask, bool Temp)
 {
-	for(CCommand *pCommand = m_pFirstCommand; pCommand; pCommand = pCommand->Next())
+	const auto Bucket = m_CommandIndex.find(NameHash(pName));
+	if(Bucket == m_CommandIndex.end())
+		return nullptr;
+
+	for(CCommand *pCommand : Bucket->second)
 	{
 		if(pCommand->m_Flags & FlagMask && pCommand->m_Temp == Temp)
 		{
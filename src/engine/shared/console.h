@@ -9,6 +9,7 @@
 #include <engine/storage.h>
 
 #include <optional>
+#include <unordered_map>
 #include <vector>
 
 class CConsole : public IConsole
@@ -52,6 +53,8 @@ class CConsole : public IConsole
 	bool m_StoreCommands;
 	const char *m_apStrokeStr[2];
 	CCommand *m_pFirstCommand;
+	// commands by the hash of their lowercase name, in the order of the command list
+	std::unordered_map<unsigned, std::vector<CCommand *>> m_CommandIndex;
 
 	class CExecFile
 	{
@@ -157,7 +160,9 @@ class CConsole : public IConsole
 	};
 	std::vector<CExecutionQueueEntry> m_vExecutionQueue;
 
+	static unsigned NameHash(const char *pName);
 	void AddCommandSorted(CCommand *pCommand);
+	void RemoveCommandIndex(CCommand *pCommand);
 	CCommand *FindCommand(const char *pName, int FlagMask);
 
 	bool m_Cheated;
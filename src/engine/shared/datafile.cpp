@@ -8,10 +8,14 @@
 #include <base/math.h>
 #include <base/system.h>
 
+#include <engine/engine.h>
+#include <engine/shared/jobs.h>
 #include <engine/storage.h>
 
 #include "uuid_manager.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cstdlib>
 #include <limits>
 #include <unordered_set>
@@ -138,6 +142,21 @@ public:
 	void **m_ppDataPtrs;
 	int *m_pDataSizes;
 	char *m_pData;
+	// the whole file if it is mapped, the items and uncompressed data point into it
+	char *m_pMapping;
+	int64_t m_MappingSize;
+
+	bool IsMapped(const void *pData) const
+	{
+		return m_pMapping != nullptr && (uintptr_t)pData >= (uintptr_t)m_pMapping && (uintptr_t)pData < (uintptr_t)m_pMapping + m_MappingSize;
+	}
+
+	void FreeData(int Index) const
+	{
+		if(!IsMapped(m_ppDataPtrs[Index]))
+			free(m_ppDataPtrs[Index]);
+		m_ppDataPtrs[Index] = nullptr;
+	}
 
 	int GetFileDataSize(int Index) const
 	{
@@ -213,41 +232,51 @@ public:
 				return nullptr;
 			}
 
-			// read the compressed data
-			void *pCompressedData = malloc(DataSize);
-			if(pCompressedData == nullptr)
-			{
-				log_error("datafile", "out of memory. could not allocate memory for compressed data. index=%d size=%d", Index, DataSize);
-				m_ppDataPtrs[Index] = nullptr;
-				m_pDataSizes[Index] = -1;
-				return nullptr;
-			}
-			unsigned ActualDataSize = 0;
-			if(io_seek(m_File, m_DataStartOffset + m_Info.m_pDataOffsets[Index], IOSEEK_START) == 0)
+			// read the compressed data, unless it can be decompressed from the mapping
+			void *pCompressedCopy = nullptr;
+			const void *pCompressedData;
+			if(m_pMapping)
 			{
-				ActualDataSize = io_read(m_File, pCompressedData, DataSize);
+				pCompressedData = m_pMapping + m_DataStartOffset + m_Info.m_pDataOffsets[Index];
 			}
-			if(DataSize != ActualDataSize)
+			else
 			{
-				log_error("datafile", "truncation error. could not read all compressed data. index=%d wanted=%d got=%d", Index, DataSize, ActualDataSize);
-				free(pCompressedData);
-				m_ppDataPtrs[Index] = nullptr;
-				m_pDataSizes[Index] = -1;
-				return nullptr;
+				pCompressedCopy = malloc(DataSize);
+				if(pCompressedCopy == nullptr)
+				{
+					log_error("datafile", "out of memory. could not allocate memory for compressed data. index=%d size=%d", Index, DataSize);
+					m_ppDataPtrs[Index] = nullptr;
+					m_pDataSizes[Index] = -1;
+					return nullptr;
+				}
+				unsigned ActualDataSize = 0;
+				if(io_seek(m_File, m_DataStartOffset + m_Info.m_pDataOffsets[Index], IOSEEK_START) == 0)
+				{
+					ActualDataSize = io_read(m_File, pCompressedCopy, DataSize);
+				}
+				if(DataSize != ActualDataSize)
+				{
+					log_error("datafile", "truncation error. could not read all compressed data. index=%d wanted=%d got=%d", Index, DataSize, ActualDataSize);
+					free(pCompressedCopy);
+					m_ppDataPtrs[Index] = nullptr;
+					m_pDataSizes[Index] = -1;
+					return nullptr;
+				}
+				pCompressedData = pCompressedCopy;
 			}
 
 			// decompress the data
 			m_ppDataPtrs[Index] = static_cast<char *>(malloc(OriginalUncompressedSize));
 			if(m_ppDataPtrs[Index] == nullptr)
 			{
-				free(pCompressedData);
+				free(pCompressedCopy);
 				log_error("datafile", "out of memory. could not allocate memory for uncompressed data. index=%d size=%d", Index, OriginalUncompressedSize);
 				m_pDataSizes[Index] = -1;
 				return nullptr;
 			}
 			unsigned long UncompressedSize = OriginalUncompressedSize;
-			const int Result = uncompress(static_cast<Bytef *>(m_ppDataPtrs[Index]), &UncompressedSize, static_cast<Bytef *>(pCompressedData), DataSize);
-			free(pCompressedData);
+			const int Result = uncompress(static_cast<Bytef *>(m_ppDataPtrs[Index]), &UncompressedSize, static_cast<const Bytef *>(pCompressedData), DataSize);
+			free(pCompressedCopy);
 			if(Result != Z_OK || UncompressedSize != OriginalUncompressedSize)
 			{
 				log_error("datafile", "failed to uncompress data. index=%d result=%d wanted=%d got=%ld", Index, Result, OriginalUncompressedSize, UncompressedSize);
@@ -258,6 +287,12 @@ public:
 			}
 			m_pDataSizes[Index] = OriginalUncompressedSize;
 		}
+		else if(m_pMapping && (m_DataStartOffset + m_Info.m_pDataOffsets[Index]) % sizeof(int) == 0)
+		{
+			log_trace("datafile", "mapping data. index=%d size=%d", Index, DataSize);
+			m_ppDataPtrs[Index] = m_pMapping + m_DataStartOffset + m_Info.m_pDataOffsets[Index];
+			m_pDataSizes[Index] = DataSize;
+		}
 		else
 		{
 			log_trace("datafile", "loading data. index=%d size=%d", Index, DataSize);
@@ -269,7 +304,12 @@ public:
 				return nullptr;
 			}
 			unsigned ActualDataSize = 0;
-			if(io_seek(m_File, m_DataStartOffset + m_Info.m_pDataOffsets[Index], IOSEEK_START) == 0)
+			if(m_pMapping)
+			{
+				mem_copy(m_ppDataPtrs[Index], m_pMapping + m_DataStartOffset + m_Info.m_pDataOffsets[Index], DataSize);
+				ActualDataSize = DataSize;
+			}
+			else if(io_seek(m_File, m_DataStartOffset + m_Info.m_pDataOffsets[Index], IOSEEK_START) == 0)
 			{
 				ActualDataSize = io_read(m_File, m_ppDataPtrs[Index], DataSize);
 			}
@@ -442,7 +482,7 @@ CDataFileReader &CDataFileReader::operator=(CDataFileReader &&Other)
 	return *this;
 }
 
-bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int StorageType)
+bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int StorageType, bool Mapped)
 {
 	dbg_assert(m_pDataFile == nullptr, "File already open");
 
@@ -582,13 +622,23 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 		}
 	}
 
+	// with a mapping, the types, offsets, sizes and item data aren't copied
+	char *pMapping = nullptr;
+	if(Mapped)
+	{
+		pMapping = static_cast<char *>(io_map(File, FileSize));
+		if(pMapping == nullptr)
+			log_warn("datafile", "could not map file, reading it instead. filename='%s'", pFilename);
+	}
+
 	constexpr int64_t MaxAllocSize = (int64_t)2 * 1024 * 1024 * 1024;
-	int64_t AllocSize = Size;
+	int64_t AllocSize = pMapping ? 0 : Size;
 	AllocSize += sizeof(CDatafile); // add space for info structure
 	AllocSize += (int64_t)Header.m_NumRawData * sizeof(void *); // add space for data pointers
 	AllocSize += (int64_t)Header.m_NumRawData * sizeof(int); // add space for data sizes
 	if(AllocSize > MaxAllocSize)
 	{
+		io_unmap(pMapping, FileSize);
 		io_close(File);
 		log_error("datafile", "file too large. alloc_size=%" PRId64 " max=%" PRId64, AllocSize, MaxAllocSize);
 		return false;
@@ -597,6 +647,7 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	CDatafile *pTmpDataFile = static_cast<CDatafile *>(malloc(AllocSize));
 	if(pTmpDataFile == nullptr)
 	{
+		io_unmap(pMapping, FileSize);
 		io_close(File);
 		log_error("datafile", "out of memory. could not allocate memory for datafile. alloc_size=%" PRId64, AllocSize);
 		return false;
@@ -605,7 +656,9 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	pTmpDataFile->m_DataStartOffset = sizeof(CDatafileHeader) + Size;
 	pTmpDataFile->m_ppDataPtrs = (void **)(pTmpDataFile + 1);
 	pTmpDataFile->m_pDataSizes = (int *)(pTmpDataFile->m_ppDataPtrs + Header.m_NumRawData);
-	pTmpDataFile->m_pData = (char *)(pTmpDataFile->m_pDataSizes + Header.m_NumRawData);
+	pTmpDataFile->m_pData = pMapping ? pMapping + sizeof(CDatafileHeader) : (char *)(pTmpDataFile->m_pDataSizes + Header.m_NumRawData);
+	pTmpDataFile->m_pMapping = pMapping;
+	pTmpDataFile->m_MappingSize = pMapping ? FileSize : 0;
 	pTmpDataFile->m_File = File;
 	pTmpDataFile->m_FileSize = FileSize;
 	pTmpDataFile->m_Sha256 = Sha256;
@@ -616,7 +669,7 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	mem_zero(pTmpDataFile->m_pDataSizes, Header.m_NumRawData * sizeof(int));
 
 	// read types, offsets, sizes and item data
-	const unsigned ReadSize = io_read(pTmpDataFile->m_File, pTmpDataFile->m_pData, Size);
+	const unsigned ReadSize = pMapping ? Size : io_read(pTmpDataFile->m_File, pTmpDataFile->m_pData, Size);
 	if((int64_t)ReadSize != Size)
 	{
 		io_close(pTmpDataFile->m_File);
@@ -647,6 +700,7 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 
 	if(!pTmpDataFile->Validate())
 	{
+		io_unmap(pMapping, FileSize);
 		io_close(pTmpDataFile->m_File);
 		free(pTmpDataFile);
 		return false;
@@ -667,9 +721,10 @@ void CDataFileReader::Close()
 
 	for(int i = 0; i < m_pDataFile->m_Header.m_NumRawData; i++)
 	{
-		free(m_pDataFile->m_ppDataPtrs[i]);
+		m_pDataFile->FreeData(i);
 	}
 
+	io_unmap(m_pDataFile->m_pMapping, m_pDataFile->m_MappingSize);
 	io_close(m_pDataFile->m_File);
 	free(m_pDataFile);
 	m_pDataFile = nullptr;
@@ -736,7 +791,7 @@ void CDataFileReader::ReplaceData(int Index, char *pData, size_t Size)
 	dbg_assert(m_pDataFile != nullptr, "File not open");
 	dbg_assert(Index >= 0 && Index < m_pDataFile->m_Header.m_NumRawData, "Index invalid: %d", Index);
 
-	free(m_pDataFile->m_ppDataPtrs[Index]);
+	m_pDataFile->FreeData(Index);
 	m_pDataFile->m_ppDataPtrs[Index] = pData;
 	m_pDataFile->m_pDataSizes[Index] = Size;
 }
@@ -748,11 +803,83 @@ void CDataFileReader::UnloadData(int Index)
 	if(Index < 0 || Index >= m_pDataFile->m_Header.m_NumRawData)
 		return;
 
-	free(m_pDataFile->m_ppDataPtrs[Index]);
-	m_pDataFile->m_ppDataPtrs[Index] = nullptr;
+	m_pDataFile->FreeData(Index);
 	m_pDataFile->m_pDataSizes[Index] = 0;
 }
 
+// State shared between the caller of LoadData and the jobs helping it. Jobs
+// that only start after all data was taken return without touching the file.
+class CDataLoadState
+{
+public:
+	CDatafile *m_pDataFile;
+	std::vector<int> m_vToLoad;
+	std::atomic<int> m_NextIndex = 0;
+	std::atomic<int> m_NumLoaded = 0;
+	SEMAPHORE m_AllLoaded;
+
+	CDataLoadState() { sphore_init(&m_AllLoaded); }
+	~CDataLoadState() { sphore_destroy(&m_AllLoaded); }
+
+	void LoadLoop()
+	{
+		const int Num = m_vToLoad.size();
+		for(int i = m_NextIndex.fetch_add(1); i < Num; i = m_NextIndex.fetch_add(1))
+		{
+			m_pDataFile->GetData(m_vToLoad[i], false);
+			if(m_NumLoaded.fetch_add(1) + 1 == Num)
+				sphore_signal(&m_AllLoaded);
+		}
+	}
+};
+
+class CDataLoadJob : public IJob
+{
+	std::shared_ptr<CDataLoadState> m_pState;
+
+	void Run() override
+	{
+		m_pState->LoadLoop();
+	}
+
+public:
+	CDataLoadJob(std::shared_ptr<CDataLoadState> pState) :
+		m_pState(std::move(pState))
+	{
+	}
+};
+
+void CDataFileReader::LoadData(const std::vector<int> &vIndices, IEngine *pEngine)
+{
+	dbg_assert(m_pDataFile != nullptr, "File not open");
+
+	// different indices can only be loaded concurrently from the mapping,
+	// reading the file would race on its position
+	std::shared_ptr<CDataLoadState> pState = std::make_shared<CDataLoadState>();
+	pState->m_pDataFile = m_pDataFile;
+	for(int Index : vIndices)
+	{
+		if(Index >= 0 && Index < m_pDataFile->m_Header.m_NumRawData && m_pDataFile->m_ppDataPtrs[Index] == nullptr && m_pDataFile->m_pDataSizes[Index] == 0)
+			pState->m_vToLoad.push_back(Index);
+	}
+	std::sort(pState->m_vToLoad.begin(), pState->m_vToLoad.end());
+	pState->m_vToLoad.erase(std::unique(pState->m_vToLoad.begin(), pState->m_vToLoad.end()), pState->m_vToLoad.end());
+	if(pState->m_vToLoad.empty())
+		return;
+
+	// The caller loads as well, so this also finishes if all workers of the
+	// pool are busy, e.g. when the map is preloaded from a job itself. It
+	// then only waits for data that a worker has already started to load.
+	if(pEngine && m_pDataFile->m_pMapping)
+	{
+		const int NumJobs = std::min<int>(pState->m_vToLoad.size(), 8) - 1;
+		for(int i = 0; i < NumJobs; i++)
+			pEngine->AddJob(std::make_shared<CDataLoadJob>(pState));
+	}
+	pState->LoadLoop();
+	sphore_wait(&pState->m_AllLoaded);
+}
+
 int CDataFileReader::NumData() const
 {
 	dbg_assert(m_pDataFile != nullptr, "File not open");
@@ -31,7 +31,10 @@ public:
 	~CDataFileReader();
 	CDataFileReader &operator=(CDataFileReader &&Other);
 
-	[[nodiscard]] bool Open(class IStorage *pStorage, const char *pFilename, int StorageType);
+	// A mapped datafile serves the items and uncompressed data straight from
+	// the mapping and decompresses data from it without reading the file.
+	// The file must not be truncated while it is mapped.
+	[[nodiscard]] bool Open(class IStorage *pStorage, const char *pFilename, int StorageType, bool Mapped = false);
 	void Close();
 	bool IsOpen() const;
 	IOHANDLE File() const;
@@ -42,6 +45,8 @@ public:
 	const char *GetDataString(int Index);
 	void ReplaceData(int Index, char *pData, size_t Size); // memory for data must have been allocated with malloc
 	void UnloadData(int Index);
+	// loads the data of all indices at once, spread over jobs of the engine if the file is mapped
+	void LoadData(const std::vector<int> &vIndices, class IEngine *pEngine = nullptr);
 	int NumData() const;
 
 	int GetItemSize(int Index) const;
@@ -27,6 +27,9 @@ static const unsigned char gs_OldVersion = 3;
 static const unsigned char gs_Sha256Version = 6;
 static const unsigned char gs_VersionTickCompression = 5; // demo files with this version or higher will use `CHUNKTICKFLAG_TICK_COMPRESSED`
 
+static const unsigned char gs_aKeyFrameIndexMarker[8] = {'T', 'W', 'D', 'E', 'M', 'O', 'K', 'F'};
+static const int gs_KeyFrameIndexVersion = 1;
+
 // TODO: rewrite all logs in this file using log_log_color, and remove gs_DemoPrintColor and m_pConsole
 static constexpr ColorRGBA gs_DemoPrintColor{0.75f, 0.7f, 0.7f, 1.0f};
 static constexpr LOG_COLOR DEMO_PRINT_COLOR = {191, 178, 178};
@@ -41,6 +44,133 @@ bool CDemoHeader::Valid() const
 	       mem_has_null(m_aTimestamp, sizeof(m_aTimestamp)) && str_utf8_check(m_aTimestamp);
 }
 
+/*
+	Keyframe index, all values are big endian
+		8	= Marker
+		4	= Version
+		8	= Size of the demo file
+		4	= First tick
+		4	= Last tick
+		4	= Number of keyframes
+	Followed by the keyframes
+		8	= File position of the tick marker
+		4	= Tick
+*/
+
+void CDemoKeyFrameIndex::Filename(const char *pDemoFilename, char *pBuffer, size_t BufferSize)
+{
+	str_format(pBuffer, BufferSize, "%s.idx", pDemoFilename);
+}
+
+bool CDemoKeyFrameIndex::Write(IStorage *pStorage, const char *pDemoFilename, int64_t DemoSize, int FirstTick, int LastTick, const std::vector<CDemoKeyFrame> &vKeyFrames)
+{
+	std::vector<unsigned char> vData(gs_aKeyFrameIndexMarker, gs_aKeyFrameIndexMarker + sizeof(gs_aKeyFrameIndexMarker));
+	const auto &&AddInt = [&vData](unsigned Value) {
+		unsigned char aBytes[sizeof(int32_t)];
+		uint_to_bytes_be(aBytes, Value);
+		vData.insert(vData.end(), aBytes, aBytes + sizeof(aBytes));
+	};
+	AddInt(gs_KeyFrameIndexVersion);
+	AddInt(DemoSize >> 32);
+	AddInt(DemoSize);
+	AddInt(FirstTick);
+	AddInt(LastTick);
+	AddInt(vKeyFrames.size());
+	for(const CDemoKeyFrame &KeyFrame : vKeyFrames)
+	{
+		AddInt(KeyFrame.m_Filepos >> 32);
+		AddInt(KeyFrame.m_Filepos);
+		AddInt(KeyFrame.m_Tick);
+	}
+
+	char aFilename[IO_MAX_PATH_LENGTH];
+	Filename(pDemoFilename, aFilename, sizeof(aFilename));
+	IOHANDLE File = pStorage->OpenFile(aFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+	if(!File)
+		return false;
+	const bool Success = io_write(File, vData.data(), vData.size()) == vData.size();
+	io_close(File);
+	if(!Success)
+		pStorage->RemoveFile(aFilename, IStorage::TYPE_SAVE);
+	return Success;
+}
+
+bool CDemoKeyFrameIndex::Read(IStorage *pStorage, const char *pDemoFilename, int StorageType, int64_t DemoSize, int *pFirstTick, int *pLastTick, std::vector<CDemoKeyFrame> *pvKeyFrames)
+{
+	char aFilename[IO_MAX_PATH_LENGTH];
+	Filename(pDemoFilename, aFilename, sizeof(aFilename));
+	void *pData;
+	unsigned Size;
+	if(!pStorage->FileExists(aFilename, StorageType) || !pStorage->ReadFile(aFilename, StorageType, &pData, &Size))
+		return false;
+
+	const unsigned char *pBytes = static_cast<const unsigned char *>(pData);
+	const unsigned char *pEnd = pBytes + Size;
+	const auto &&GetInt = [&pBytes]() {
+		const unsigned Value = bytes_be_to_uint(pBytes);
+		pBytes += sizeof(int32_t);
+		return Value;
+	};
+	const auto &&GetInt64 = [&GetInt]() {
+		const uint64_t High = GetInt();
+		return (int64_t)((High << 32) | GetInt());
+	};
+
+	constexpr size_t HeaderSize = sizeof(gs_aKeyFrameIndexMarker) + 6 * sizeof(int32_t);
+	constexpr size_t KeyFrameSize = 3 * sizeof(int32_t);
+	bool Valid = Size >= HeaderSize && mem_comp(pBytes, gs_aKeyFrameIndexMarker, sizeof(gs_aKeyFrameIndexMarker)) == 0;
+	if(Valid)
+	{
+		pBytes += sizeof(gs_aKeyFrameIndexMarker);
+		const int Version = GetInt();
+		const int64_t IndexDemoSize = GetInt64();
+		*pFirstTick = GetInt();
+		*pLastTick = GetInt();
+		const unsigned NumKeyFrames = GetInt();
+		Valid = Version == gs_KeyFrameIndexVersion && IndexDemoSize == DemoSize &&
+			*pFirstTick >= MIN_TICK && *pFirstTick <= *pLastTick && *pLastTick < MAX_TICK &&
+			NumKeyFrames > 0 && NumKeyFrames == (size_t)(pEnd - pBytes) / KeyFrameSize && (size_t)(pEnd - pBytes) % KeyFrameSize == 0;
+		if(Valid)
+		{
+			pvKeyFrames->clear();
+			pvKeyFrames->reserve(NumKeyFrames);
+			for(unsigned i = 0; i < NumKeyFrames && Valid; i++)
+			{
+				const int64_t Filepos = GetInt64();
+				const int Tick = GetInt();
+				// keyframes are ordered by position and tick
+				Valid = Filepos >= 0 && Filepos < DemoSize && Tick >= *pFirstTick && Tick <= *pLastTick &&
+					(pvKeyFrames->empty() || (Filepos > pvKeyFrames->back().m_Filepos && Tick >= pvKeyFrames->back().m_Tick));
+				pvKeyFrames->emplace_back(Filepos, Tick);
+			}
+		}
+	}
+	free(pData);
+	if(!Valid)
+		pvKeyFrames->clear();
+	return Valid;
+}
+
+void CDemoKeyFrameIndex::Rename(IStorage *pStorage, const char *pOldDemoFilename, const char *pNewDemoFilename, int StorageType)
+{
+	char aOldFilename[IO_MAX_PATH_LENGTH];
+	char aNewFilename[IO_MAX_PATH_LENGTH];
+	Filename(pOldDemoFilename, aOldFilename, sizeof(aOldFilename));
+	Filename(pNewDemoFilename, aNewFilename, sizeof(aNewFilename));
+	if(pStorage->FileExists(aOldFilename, StorageType))
+		pStorage->RenameFile(aOldFilename, aNewFilename, StorageType);
+	else
+		Remove(pStorage, pNewDemoFilename, StorageType);
+}
+
+void CDemoKeyFrameIndex::Remove(IStorage *pStorage, const char *pDemoFilename, int StorageType)
+{
+	char aFilename[IO_MAX_PATH_LENGTH];
+	Filename(pDemoFilename, aFilename, sizeof(aFilename));
+	if(pStorage->FileExists(aFilename, StorageType))
+		pStorage->RemoveFile(aFilename, StorageType);
+}
+
 CDemoRecorder::CDemoRecorder(class CSnapshotDelta *pSnapshotDelta, bool NoMapData)
 {
 	m_File = nullptr;
@@ -203,6 +333,10 @@ int CDemoRecorder::Start(class IStorage *pStorage, class IConsole *pConsole, con
 	m_LastTickMarker = -1;
 	m_FirstTick = -1;
 	m_NumTimelineMarkers = 0;
+	m_vKeyFrames.clear();
+
+	// an index left from an earlier demo with this name doesn't belong to this one
+	CDemoKeyFrameIndex::Remove(pStorage, pFilename, IStorage::TYPE_SAVE);
 
 	if(m_pConsole)
 	{
@@ -327,6 +461,10 @@ void CDemoRecorder::RecordSnapshot(int Tick, const void *pData, int Size)
 {
 	if(m_LastKeyFrame == -1 || (Tick - m_LastKeyFrame) > SERVER_TICK_SPEED * 5)
 	{
+		const int64_t Filepos = io_tell(m_File);
+		if(Filepos >= 0)
+			m_vKeyFrames.emplace_back(Filepos, Tick);
+
 		// write full tickmarker
 		WriteTickMarker(Tick, true);
 
@@ -372,8 +510,11 @@ int CDemoRecorder::Stop(IDemoRecorder::EStopMode Mode, const char *pTargetFilena
 	if(!m_File)
 		return -1;
 
+	int64_t DemoSize = -1;
 	if(Mode == IDemoRecorder::EStopMode::KEEP_FILE)
 	{
+		DemoSize = io_tell(m_File);
+
 		// add the demo length to the header
 		io_seek(m_File, offsetof(CDemoHeader, m_aLength), IOSEEK_START);
 		unsigned char aLength[sizeof(int32_t)];
@@ -423,6 +564,14 @@ int CDemoRecorder::Stop(IDemoRecorder::EStopMode Mode, const char *pTargetFilena
 		}
 	}
 
+	if(DemoSize >= 0 && !m_vKeyFrames.empty())
+	{
+		const char *pFilename = pTargetFilename[0] != '\0' ? pTargetFilename : m_aCurrentFilename;
+		if(!CDemoKeyFrameIndex::Write(m_pStorage, pFilename, DemoSize, m_FirstTick, m_LastTickMarker, m_vKeyFrames))
+			log_warn_color(DEMO_PRINT_COLOR, "demo_recorder", "Could not write the keyframe index of '%s'", pFilename);
+	}
+	m_vKeyFrames.clear();
+
 	if(m_pConsole)
 	{
 		char aBuf[64 + IO_MAX_PATH_LENGTH];
@@ -652,6 +801,38 @@ CDemoPlayer::EScanFileResult CDemoPlayer::ScanFile()
 	return ResetToStartPosition(m_vKeyFrames.empty() ? EScanFileResult::ERROR_UNRECOVERABLE : EScanFileResult::SUCCESS);
 }
 
+bool CDemoPlayer::LoadKeyFrameIndex(IStorage *pStorage, const char *pFilename, int StorageType)
+{
+	const int64_t StartPos = io_tell(m_File);
+	if(StartPos < 0 || io_seek(m_File, 0, IOSEEK_END) != 0)
+		return false;
+	const int64_t DemoSize = io_tell(m_File);
+
+	int FirstTick, LastTick;
+	std::vector<CDemoKeyFrame> vKeyFrames;
+	bool Valid = DemoSize >= 0 && CDemoKeyFrameIndex::Read(pStorage, pFilename, StorageType, DemoSize, &FirstTick, &LastTick, &vKeyFrames);
+
+	// the first and last keyframe must be where the index says
+	const auto &&CheckKeyFrame = [&](const CDemoKeyFrame &KeyFrame) {
+		int ChunkType, ChunkSize;
+		int ChunkTick = -1;
+		return KeyFrame.m_Filepos >= StartPos &&
+		       io_seek(m_File, KeyFrame.m_Filepos, IOSEEK_START) == 0 &&
+		       ReadChunkHeader(&ChunkType, &ChunkSize, &ChunkTick) == CHUNKHEADER_SUCCESS &&
+		       ChunkType == (CHUNKTYPEFLAG_TICKMARKER | CHUNKTICKFLAG_KEYFRAME) &&
+		       ChunkTick == KeyFrame.m_Tick;
+	};
+	Valid = Valid && CheckKeyFrame(vKeyFrames.front()) && CheckKeyFrame(vKeyFrames.back());
+
+	if(io_seek(m_File, StartPos, IOSEEK_START) != 0 || !Valid)
+		return false;
+
+	m_vKeyFrames = std::move(vKeyFrames);
+	m_Info.m_Info.m_FirstTick = FirstTick;
+	m_Info.m_Info.m_LastTick = LastTick;
+	return true;
+}
+
 void CDemoPlayer::DoTick()
 {
 	// update ticks
@@ -865,8 +1046,8 @@ int CDemoPlayer::Load(class IStorage *pStorage, class IConsole *pConsole, const
 		}
 	}
 
-	// Scan the file for interesting points
-	if(ScanFile() == EScanFileResult::ERROR_UNRECOVERABLE)
+	// Scan the file for interesting points, unless they are indexed already
+	if(!LoadKeyFrameIndex(pStorage, pFilename, StorageType) && ScanFile() == EScanFileResult::ERROR_UNRECOVERABLE)
 	{
 		Stop("Error scanning demo file");
 		return -1;
@@ -15,6 +15,36 @@
 
 typedef std::function<void()> TUpdateIntraTimesFunc;
 
+class CDemoKeyFrame
+{
+public:
+	int64_t m_Filepos;
+	int m_Tick;
+
+	CDemoKeyFrame(int64_t Filepos, int Tick) :
+		m_Filepos(Filepos), m_Tick(Tick)
+	{
+	}
+};
+
+/*
+	Class: Demo keyframe index
+		The keyframes of a finished demo are stored in a file next to it,
+		so the demo player does not have to scan all chunks of the demo to
+		open it. The index is only used if it matches the demo, it has to
+		be renamed and removed along with the demo.
+*/
+class CDemoKeyFrameIndex
+{
+public:
+	static void Filename(const char *pDemoFilename, char *pBuffer, size_t BufferSize);
+	static bool Write(class IStorage *pStorage, const char *pDemoFilename, int64_t DemoSize, int FirstTick, int LastTick, const std::vector<CDemoKeyFrame> &vKeyFrames);
+	// fails if the index is missing, invalid or belongs to a demo of a different size
+	static bool Read(class IStorage *pStorage, const char *pDemoFilename, int StorageType, int64_t DemoSize, int *pFirstTick, int *pLastTick, std::vector<CDemoKeyFrame> *pvKeyFrames);
+	static void Rename(class IStorage *pStorage, const char *pOldDemoFilename, const char *pNewDemoFilename, int StorageType);
+	static void Remove(class IStorage *pStorage, const char *pDemoFilename, int StorageType);
+};
+
 class CDemoRecorder : public IDemoRecorder
 {
 	class IConsole *m_pConsole;
@@ -32,6 +62,8 @@ class CDemoRecorder : public IDemoRecorder
 	int m_NumTimelineMarkers;
 	int m_aTimelineMarkers[MAX_TIMELINE_MARKERS];
 
+	std::vector<CDemoKeyFrame> m_vKeyFrames;
+
 	bool m_NoMapData;
 
 	DEMOFUNC_FILTER m_pfnFilter;
@@ -101,24 +133,12 @@ private:
 	TUpdateIntraTimesFunc m_UpdateIntraTimesFunc;
 
 	// Playback
-	class CKeyFrame
-	{
-	public:
-		int64_t m_Filepos;
-		int m_Tick;
-
-		CKeyFrame(int64_t Filepos, int Tick) :
-			m_Filepos(Filepos), m_Tick(Tick)
-		{
-		}
-	};
-
 	class IConsole *m_pConsole;
 	IOHANDLE m_File;
 	int64_t m_MapOffset;
 	char m_aFilename[IO_MAX_PATH_LENGTH];
 	char m_aErrorMessage[256];
-	std::vector<CKeyFrame> m_vKeyFrames;
+	std::vector<CDemoKeyFrame> m_vKeyFrames;
 	CMapInfo m_MapInfo;
 	int m_SpeedIndex;
 
@@ -156,6 +176,7 @@ private:
 		ERROR_UNRECOVERABLE,
 	};
 	EScanFileResult ScanFile();
+	bool LoadKeyFrameIndex(class IStorage *pStorage, const char *pFilename, int StorageType);
 	void UpdateTimes();
 
 	int64_t Time();
@@ -6,6 +6,7 @@
 
 #include <engine/storage.h>
 
+#include "demo.h"
 #include "filecollection.h"
 
 void CFileCollection::Init(IStorage *pStorage, const char *pPath, const char *pFileDesc, const char *pFileExt, int MaxEntries)
@@ -40,6 +41,8 @@ void CFileCollection::Init(IStorage *pStorage, const char *pPath, const char *pF
 		}
 
 		m_pStorage->RemoveFile(aBuf, IStorage::TYPE_SAVE);
+		if(str_comp(m_aFileExt, ".demo") == 0)
+			CDemoKeyFrameIndex::Remove(m_pStorage, aBuf, IStorage::TYPE_SAVE);
 		FilesDeleted++;
 	}
 }
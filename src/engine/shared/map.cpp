@@ -3,7 +3,9 @@
 #include "map.h"
 
 #include <base/log.h>
+#include <base/system.h>
 
+#include <engine/engine.h>
 #include <engine/storage.h>
 
 #include <game/mapitems.h>
@@ -72,14 +74,55 @@ int CMap::NumItems() const
 
 bool CMap::Load(const char *pMapName)
 {
-	IStorage *pStorage = Kernel()->RequestInterface<IStorage>();
-	if(!pStorage)
-		return false;
+	if(m_PreloadedDataFile.IsOpen())
+	{
+		const bool Preloaded = str_comp(m_aPreloadedMapName, pMapName) == 0;
+		if(Preloaded)
+		{
+			m_DataFile.Close();
+			m_DataFile = std::move(m_PreloadedDataFile);
+		}
+		else
+		{
+			m_PreloadedDataFile.Close();
+		}
+		m_aPreloadedMapName[0] = '\0';
+		if(Preloaded)
+			return true;
+	}
 
 	// Ensure current datafile is not left in an inconsistent state if loading fails,
 	// by loading the new datafile separately first.
 	CDataFileReader NewDataFile;
-	if(!NewDataFile.Open(pStorage, pMapName, IStorage::TYPE_ALL))
+	if(!LoadDataFile(pMapName, NewDataFile))
+		return false;
+
+	// Replace existing datafile with new datafile
+	m_DataFile.Close();
+	m_DataFile = std::move(NewDataFile);
+	return true;
+}
+
+bool CMap::Preload(const char *pMapName)
+{
+	m_PreloadedDataFile.Close();
+	m_aPreloadedMapName[0] = '\0';
+	if(!LoadDataFile(pMapName, m_PreloadedDataFile))
+	{
+		m_PreloadedDataFile.Close();
+		return false;
+	}
+	str_copy(m_aPreloadedMapName, pMapName);
+	return true;
+}
+
+bool CMap::LoadDataFile(const char *pMapName, CDataFileReader &NewDataFile)
+{
+	IStorage *pStorage = Kernel()->RequestInterface<IStorage>();
+	if(!pStorage)
+		return false;
+
+	if(!NewDataFile.Open(pStorage, pMapName, IStorage::TYPE_ALL, m_Mapped))
 		return false;
 
 	// Check version
@@ -91,10 +134,21 @@ bool CMap::Load(const char *pMapName)
 		return false;
 	}
 
-	// Replace compressed tile layers with uncompressed ones
 	int GroupsStart, GroupsNum, LayersStart, LayersNum;
 	NewDataFile.GetType(MAPITEMTYPE_GROUP, &GroupsStart, &GroupsNum);
 	NewDataFile.GetType(MAPITEMTYPE_LAYER, &LayersStart, &LayersNum);
+
+	// Decompress all tile layers at once, which is spread over the jobs of the engine for mapped files
+	std::vector<int> vTileData;
+	for(int l = 0; l < LayersNum; l++)
+	{
+		const CMapItemLayer *pLayer = static_cast<CMapItemLayer *>(NewDataFile.GetItem(LayersStart + l));
+		if(pLayer->m_Type == LAYERTYPE_TILES)
+			vTileData.push_back(reinterpret_cast<const CMapItemLayerTilemap *>(pLayer)->m_Data);
+	}
+	NewDataFile.LoadData(vTileData, m_Mapped ? Kernel()->RequestInterface<IEngine>() : nullptr);
+
+	// Replace compressed tile layers with uncompressed ones
 	for(int g = 0; g < GroupsNum; g++)
 	{
 		const CMapItemGroup *pGroup = static_cast<CMapItemGroup *>(NewDataFile.GetItem(GroupsStart + g));
@@ -124,15 +178,19 @@ bool CMap::Load(const char *pMapName)
 		}
 	}
 
-	// Replace existing datafile with new datafile
-	m_DataFile.Close();
-	m_DataFile = std::move(NewDataFile);
 	return true;
 }
 
 void CMap::Unload()
 {
 	m_DataFile.Close();
+	m_PreloadedDataFile.Close();
+	m_aPreloadedMapName[0] = '\0';
+}
+
+void CMap::SetMapped(bool Mapped)
+{
+	m_Mapped = Mapped;
 }
 
 bool CMap::IsLoaded() const
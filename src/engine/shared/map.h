@@ -11,6 +11,11 @@
 class CMap : public IEngineMap
 {
 	CDataFileReader m_DataFile;
+	CDataFileReader m_PreloadedDataFile;
+	char m_aPreloadedMapName[IO_MAX_PATH_LENGTH] = "";
+	bool m_Mapped = false;
+
+	[[nodiscard]] bool LoadDataFile(const char *pMapName, CDataFileReader &NewDataFile);
 
 public:
 	CMap();
@@ -32,7 +37,9 @@ public:
 	int NumItems() const override;
 
 	[[nodiscard]] bool Load(const char *pMapName) override;
+	[[nodiscard]] bool Preload(const char *pMapName) override;
 	void Unload() override;
+	void SetMapped(bool Mapped) override;
 	bool IsLoaded() const override;
 	IOHANDLE File() const override;
 
@@ -10,6 +10,7 @@
 
 #include <array>
 #include <optional>
+#include <unordered_map>
 
 class CHuffman;
 class CNetBan;
@@ -417,6 +418,10 @@ class CNetServer
 	CSlot m_aSlots[NET_MAX_CLIENTS];
 	int m_MaxClients = NET_MAX_CLIENTS;
 	int m_MaxClientsPerIp;
+	// slot of each peer address, so incoming packets don't have to be
+	// compared with all slots. Entries of timed out slots stay until the
+	// slot is dropped or reused, GetClientSlot checks the slot state.
+	std::unordered_map<NETADDR, int> m_AddrSlots;
 
 	NETFUNC_NEWCLIENT m_pfnNewClient;
 	NETFUNC_NEWCLIENT_NOAUTH m_pfnNewClientNoAuth;
@@ -439,7 +444,8 @@ class CNetServer
 	void OnPreConnMsg(NETADDR &Addr, CNetPacketConstruct &Packet);
 	void OnConnCtrlMsg(NETADDR &Addr, int ClientId, int ControlMsg, const CNetPacketConstruct &Packet);
 	bool ClientExists(const NETADDR &Addr) { return GetClientSlot(Addr) != -1; }
-	int GetClientSlot(const NETADDR &Addr);
+	void AddSlotAddr(int ClientId);
+	void RemoveSlotAddr(int ClientId);
 	void SendControl(NETADDR &Addr, int ControlMsg, const void *pExtra, int ExtraSize, SECURITY_TOKEN SecurityToken);
 
 	int TryAcceptClient(NETADDR &Addr, SECURITY_TOKEN SecurityToken, bool VanillaAuth = false, bool Sixup = false, SECURITY_TOKEN Token = 0);
@@ -459,6 +465,9 @@ public:
 	int Recv(CNetChunk *pChunk, SECURITY_TOKEN *pResponseToken);
 	int Send(CNetChunk *pChunk);
 	void Update();
+	// packets sent in between leave together when flushing
+	void BeginSendBatch() { net_udp_send_batch_begin(m_Socket); }
+	void FlushSendBatch() { net_udp_send_batch_flush(m_Socket); }
 
 	//
 	void Drop(int ClientId, const char *pReason);
@@ -467,6 +476,8 @@ public:
 	const NETADDR *ClientAddr(int ClientId) const { return m_aSlots[ClientId].m_Connection.PeerAddress(); }
 	const std::array<char, NETADDR_MAXSTRSIZE> &ClientAddrString(int ClientId, bool IncludePort) const { return m_aSlots[ClientId].m_Connection.PeerAddressString(IncludePort); }
 	bool HasSecurityToken(int ClientId) const { return m_aSlots[ClientId].m_Connection.SecurityToken() != NET_SECURITY_TOKEN_UNSUPPORTED; }
+	// slot of the connected client with the address, -1 if there is none
+	int GetClientSlot(const NETADDR &Addr);
 	NETADDR Address() const { return m_Address; }
 	NETSOCKET Socket() const { return m_Socket; }
 	CNetBan *NetBan() const { return m_pNetBan; }
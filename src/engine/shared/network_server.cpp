@@ -100,11 +100,13 @@ void CNetServer::Drop(int ClientId, const char *pReason)
 	if(m_pfnDelClient)
 		m_pfnDelClient(ClientId, pReason, m_pUser);
 
+	RemoveSlotAddr(ClientId);
 	m_aSlots[ClientId].m_Connection.Disconnect(pReason);
 }
 
 void CNetServer::Update()
 {
+	BeginSendBatch();
 	for(int i = 0; i < MaxClients(); i++)
 	{
 		m_aSlots[i].m_Connection.Update();
@@ -115,6 +117,7 @@ void CNetServer::Update()
 			Drop(i, m_aSlots[i].m_Connection.ErrorString());
 		}
 	}
+	FlushSendBatch();
 }
 
 SECURITY_TOKEN CNetServer::GetGlobalToken()
@@ -244,7 +247,9 @@ int CNetServer::TryAcceptClient(NETADDR &Addr, SECURITY_TOKEN SecurityToken, boo
 	}
 
 	// init connection slot
+	RemoveSlotAddr(Slot);
 	m_aSlots[Slot].m_Connection.DirectInit(Addr, SecurityToken, Token, Sixup);
+	AddSlotAddr(Slot);
 
 	if(VanillaAuth)
 	{
@@ -548,18 +553,33 @@ int CNetServer::OnSixupCtrlMsg(NETADDR &Addr, CNetChunk *pChunk, int ControlMsg,
 
 int CNetServer::GetClientSlot(const NETADDR &Addr)
 {
-	for(int i = 0; i < MaxClients(); i++)
+	const auto It = m_AddrSlots.find(Addr);
+	if(It == m_AddrSlots.end())
+		return -1;
+	const int Slot = It->second;
+	if(m_aSlots[Slot].m_Connection.State() != CNetConnection::EState::OFFLINE &&
+		m_aSlots[Slot].m_Connection.State() != CNetConnection::EState::ERROR &&
+		net_addr_comp(m_aSlots[Slot].m_Connection.PeerAddress(), &Addr) == 0)
 	{
-		if(m_aSlots[i].m_Connection.State() != CNetConnection::EState::OFFLINE &&
-			m_aSlots[i].m_Connection.State() != CNetConnection::EState::ERROR &&
-			net_addr_comp(m_aSlots[i].m_Connection.PeerAddress(), &Addr) == 0)
-		{
-			return i;
-		}
+		return Slot;
 	}
 	return -1;
 }
 
+void CNetServer::AddSlotAddr(int ClientId)
+{
+	// a timed out slot with the same address loses its entry, it can't
+	// receive packets anymore
+	m_AddrSlots[*m_aSlots[ClientId].m_Connection.PeerAddress()] = ClientId;
+}
+
+void CNetServer::RemoveSlotAddr(int ClientId)
+{
+	const auto It = m_AddrSlots.find(*m_aSlots[ClientId].m_Connection.PeerAddress());
+	if(It != m_AddrSlots.end() && It->second == ClientId)
+		m_AddrSlots.erase(It);
+}
+
 static bool IsDDNetControlMsg(const CNetPacketConstruct *pPacket)
 {
 	if(!(pPacket->m_Flags & NET_PACKETFLAG_CONTROL) || pPacket->m_DataSize < 1)
@@ -734,8 +754,11 @@ bool CNetServer::SetTimedOut(int ClientId, int OrigId)
 	if(m_aSlots[ClientId].m_Connection.State() != CNetConnection::EState::ERROR)
 		return false;
 
+	// the timed out slot takes over the address of the new connection
+	RemoveSlotAddr(ClientId);
 	m_aSlots[ClientId].m_Connection.SetTimedOut(ClientAddr(OrigId), m_aSlots[OrigId].m_Connection.SeqSequence(), m_aSlots[OrigId].m_Connection.AckSequence(), m_aSlots[OrigId].m_Connection.SecurityToken(), m_aSlots[OrigId].m_Connection.ResendBuffer(), m_aSlots[OrigId].m_Connection.m_Sixup);
 	m_aSlots[OrigId].m_Connection.Reset();
+	AddSlotAddr(ClientId);
 	return true;
 }
 
@@ -0,0 +1,120 @@
+#include "profiler.h"
+
+#include "protocol.h"
+
+#include <algorithm>
+
+CProfiler g_Profiler;
+
+// keeps a forgotten trace from eating all memory
+static constexpr size_t MAX_TRACE_EVENTS = 4 * 1024 * 1024;
+
+CProfiler::CProfiler() :
+	m_Enabled(false),
+	m_TraceFile(nullptr),
+	m_TraceTicksLeft(0),
+	m_TraceStartNs(0)
+{
+}
+
+CProfiler::~CProfiler()
+{
+	StopTrace();
+}
+
+int CProfiler::Section(const char *pName)
+{
+	for(int i = 0; i < NumSections(); i++)
+	{
+		if(str_comp(m_vSections[i].m_pName, pName) == 0)
+			return i;
+	}
+	CSection Section = {};
+	Section.m_pName = pName;
+	m_vSections.push_back(Section);
+	return m_vSections.size() - 1;
+}
+
+void CProfiler::Add(int Section, int64_t StartNs, int64_t DurationNs)
+{
+	CSection &Stats = m_vSections[Section];
+	Stats.m_Count++;
+	Stats.m_TotalNs += DurationNs;
+	Stats.m_MaxNs = std::max(Stats.m_MaxNs, DurationNs);
+	if(DurationNs > 1000000000 / SERVER_TICK_SPEED)
+		Stats.m_OverBudget++;
+
+	int Bucket = 0;
+	for(int64_t Us = DurationNs / 1000; Us > 0 && Bucket < NUM_BUCKETS - 1; Us >>= 1)
+		Bucket++;
+	Stats.m_aBuckets[Bucket]++;
+
+	if(m_TraceFile && StartNs >= m_TraceStartNs && m_vTraceEvents.size() < MAX_TRACE_EVENTS)
+		m_vTraceEvents.push_back({Section, StartNs, DurationNs});
+}
+
+void CProfiler::Reset()
+{
+	for(CSection &Section : m_vSections)
+	{
+		const char *pName = Section.m_pName;
+		Section = {};
+		Section.m_pName = pName;
+	}
+}
+
+int64_t CProfiler::Percentile(int Section, float Fraction) const
+{
+	const CSection &Stats = m_vSections[Section];
+	const int64_t Wanted = std::max<int64_t>(1, Stats.m_Count * Fraction);
+	int64_t Seen = 0;
+	for(int i = 0; i < NUM_BUCKETS; i++)
+	{
+		Seen += Stats.m_aBuckets[i];
+		if(Seen >= Wanted)
+			return std::min(Stats.m_MaxNs, (int64_t(1) << i) * 1000);
+	}
+	return Stats.m_MaxNs;
+}
+
+void CProfiler::StartTrace(IOHANDLE File, int NumTicks)
+{
+	StopTrace();
+	m_TraceFile = File;
+	m_TraceTicksLeft = NumTicks;
+	m_TraceStartNs = time_get_nanoseconds().count();
+	m_vTraceEvents.clear();
+}
+
+void CProfiler::OnTick()
+{
+	if(m_TraceFile && m_TraceTicksLeft-- <= 0)
+		StopTrace();
+}
+
+void CProfiler::StopTrace()
+{
+	if(!m_TraceFile)
+		return;
+
+	// written by hand because the timestamps are fractional microseconds,
+	// the section names are literals that need no escaping
+	io_write(m_TraceFile, "{\"traceEvents\":[", 16);
+	char aBuf[256];
+	for(size_t i = 0; i < m_vTraceEvents.size(); i++)
+	{
+		const CTraceEvent &Event = m_vTraceEvents[i];
+		str_format(aBuf, sizeof(aBuf), "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":1}",
+			i == 0 ? "" : ",",
+			m_vSections[Event.m_Section].m_pName,
+			(Event.m_StartNs - m_TraceStartNs) / 1000.0,
+			Event.m_DurationNs / 1000.0);
+		io_write(m_TraceFile, aBuf, str_length(aBuf));
+	}
+	io_write(m_TraceFile, "\n]}\n", 4);
+	io_close(m_TraceFile);
+
+	m_TraceFile = nullptr;
+	m_vTraceEvents.clear();
+	m_vTraceEvents.shrink_to_fit();
+}
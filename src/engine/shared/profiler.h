@@ -0,0 +1,101 @@
+#ifndef ENGINE_SHARED_PROFILER_H
+#define ENGINE_SHARED_PROFILER_H
+
+#include <base/system.h>
+
+#include <cstdint>
+#include <vector>
+
+/*
+	Class: Profiler
+		Aggregates the durations of named sections of the main thread into
+		histograms. Sections are measured with CProfileScope, which costs
+		a single branch while the profiler is disabled.
+
+		While a trace is recorded, every measured section is also kept and
+		written to a file in the Chrome trace event format, which can be
+		viewed in chrome://tracing or https://ui.perfetto.dev.
+*/
+class CProfiler
+{
+public:
+	enum
+	{
+		// bucket i holds durations below 2^i microseconds
+		NUM_BUCKETS = 28,
+	};
+
+	struct CSection
+	{
+		const char *m_pName;
+		int64_t m_Count;
+		int64_t m_TotalNs;
+		int64_t m_MaxNs;
+		// samples that took longer than a whole tick
+		int64_t m_OverBudget;
+		int64_t m_aBuckets[NUM_BUCKETS];
+	};
+
+	CProfiler();
+	~CProfiler();
+
+	void SetEnabled(bool Enabled) { m_Enabled = Enabled; }
+	bool Enabled() const { return m_Enabled || m_TraceFile; }
+
+	// returns the id of the section with the name, the name must be a string literal
+	int Section(const char *pName);
+	void Add(int Section, int64_t StartNs, int64_t DurationNs);
+	void Reset();
+
+	int NumSections() const { return m_vSections.size(); }
+	const CSection &GetSection(int Section) const { return m_vSections[Section]; }
+	// upper bound of the duration below which the fraction of the samples lies
+	int64_t Percentile(int Section, float Fraction) const;
+
+	// takes ownership of the file, records the next NumTicks ticks
+	void StartTrace(IOHANDLE File, int NumTicks);
+	// writes the trace if it is complete, called before every tick
+	void OnTick();
+	// writes the trace recorded so far
+	void StopTrace();
+	bool Tracing() const { return m_TraceFile != nullptr; }
+
+private:
+	struct CTraceEvent
+	{
+		int m_Section;
+		int64_t m_StartNs;
+		int64_t m_DurationNs;
+	};
+
+	bool m_Enabled;
+	std::vector<CSection> m_vSections;
+
+	IOHANDLE m_TraceFile;
+	int m_TraceTicksLeft;
+	int64_t m_TraceStartNs;
+	std::vector<CTraceEvent> m_vTraceEvents;
+};
+
+extern CProfiler g_Profiler;
+
+class CProfileScope
+{
+	int m_Section;
+	int64_t m_StartNs;
+
+public:
+	CProfileScope(int Section) :
+		m_Section(Section),
+		m_StartNs(g_Profiler.Enabled() ? time_get_nanoseconds().count() : -1)
+	{
+	}
+
+	~CProfileScope()
+	{
+		if(m_StartNs >= 0)
+			g_Profiler.Add(m_Section, m_StartNs, time_get_nanoseconds().count() - m_StartNs);
+	}
+};
+
+#endif // ENGINE_SHARED_PROFILER_H
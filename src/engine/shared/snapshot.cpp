@@ -213,44 +213,32 @@ static int GetItemIndexHashed(int Key, const CItemList *pHashlist)
 	return -1;
 }
 
+// the item kernels are written without early exits or branches so the
+// compiler can vectorize them for the target's instruction set
 int CSnapshotDelta::DiffItem(const int *pPast, const int *pCurrent, int *pOut, int Size)
 {
-	int Needed = 0;
-	while(Size)
+	unsigned Needed = 0;
+	for(int i = 0; i < Size; i++)
 	{
 		// subtraction with wrapping by casting to unsigned
-		*pOut = (unsigned)*pCurrent - (unsigned)*pPast;
-		Needed |= *pOut;
-		pOut++;
-		pPast++;
-		pCurrent++;
-		Size--;
+		const unsigned Diff = (unsigned)pCurrent[i] - (unsigned)pPast[i];
+		pOut[i] = Diff;
+		Needed |= Diff;
 	}
 
-	return Needed;
+	return Needed != 0;
 }
 
 void CSnapshotDelta::UndiffItem(const int *pPast, const int *pDiff, int *pOut, int Size, uint64_t *pDataRate)
 {
-	while(Size)
+	uint64_t DataRate = 0;
+	for(int i = 0; i < Size; i++)
 	{
 		// addition with wrapping by casting to unsigned
-		*pOut = (unsigned)*pPast + (unsigned)*pDiff;
-
-		if(*pDiff == 0)
-			*pDataRate += 1;
-		else
-		{
-			unsigned char aBuf[CVariableInt::MAX_BYTES_PACKED];
-			unsigned char *pEnd = CVariableInt::Pack(aBuf, *pDiff, sizeof(aBuf));
-			*pDataRate += (uint64_t)(pEnd - (unsigned char *)aBuf) * 8;
-		}
-
-		pOut++;
-		pPast++;
-		pDiff++;
-		Size--;
+		pOut[i] = (unsigned)pPast[i] + (unsigned)pDiff[i];
+		DataRate += pDiff[i] == 0 ? 1 : CVariableInt::PackedSize(pDiff[i]) * 8;
 	}
+	*pDataRate += DataRate;
 }
 
 CSnapshotDelta::CSnapshotDelta()
@@ -290,7 +278,6 @@ const CSnapshotDelta::CData *CSnapshotDelta::EmptyDelta() const
 	return &m_Empty;
 }
 
-// TODO: OPT: this should be made much faster
 int CSnapshotDelta::CreateDelta(const CSnapshot *pFrom, const CSnapshot *pTo, void *pDstData)
 {
 	CData *pDelta = (CData *)pDstData;
@@ -300,34 +287,55 @@ int CSnapshotDelta::CreateDelta(const CSnapshot *pFrom, const CSnapshot *pTo, vo
 	pDelta->m_NumUpdateItems = 0;
 	pDelta->m_NumTempItems = 0;
 
+	// fetch previous indices
+	// the snapshots of a client are built in the same order every tick, so
+	// most items are found right after the previous match and the hash is
+	// only needed once that guess fails
 	CItemList aHashlist[HASHLIST_SIZE];
-	GenerateHash(aHashlist, pTo);
+	bool HashGenerated = false;
+	int aPastIndices[CSnapshot::MAX_ITEMS];
+	bool aKept[CSnapshot::MAX_ITEMS] = {};
+	const int NumItems = pTo->NumItems();
+	const int NumPastItems = pFrom->NumItems();
+	dbg_assert(NumPastItems <= CSnapshot::MAX_ITEMS, "too many items in the delta base");
+	int NextPastIndex = 0;
+	for(int i = 0; i < NumItems; i++)
+	{
+		const int Key = pTo->GetItem(i)->Key();
+		int PastIndex;
+		if(NextPastIndex < NumPastItems && pFrom->GetItem(NextPastIndex)->Key() == Key)
+		{
+			PastIndex = NextPastIndex;
+		}
+		else
+		{
+			if(!HashGenerated)
+			{
+				GenerateHash(aHashlist, pFrom);
+				HashGenerated = true;
+			}
+			PastIndex = GetItemIndexHashed(Key, aHashlist);
+		}
+		aPastIndices[i] = PastIndex;
+		if(PastIndex != -1)
+		{
+			aKept[PastIndex] = true;
+			NextPastIndex = PastIndex + 1;
+		}
+	}
 
 	// pack deleted stuff
-	for(int i = 0; i < pFrom->NumItems(); i++)
+	for(int i = 0; i < NumPastItems; i++)
 	{
-		const CSnapshotItem *pFromItem = pFrom->GetItem(i);
-		if(GetItemIndexHashed(pFromItem->Key(), aHashlist) == -1)
+		if(!aKept[i])
 		{
 			// deleted
 			pDelta->m_NumDeletedItems++;
-			*pData = pFromItem->Key();
+			*pData = pFrom->GetItem(i)->Key();
 			pData++;
 		}
 	}
 
-	GenerateHash(aHashlist, pFrom);
-
-	// fetch previous indices
-	// we do this as a separate pass because it helps the cache
-	int aPastIndices[CSnapshot::MAX_ITEMS];
-	const int NumItems = pTo->NumItems();
-	for(int i = 0; i < NumItems; i++)
-	{
-		const CSnapshotItem *pCurItem = pTo->GetItem(i); // O(1) .. O(n)
-		aPastIndices[i] = GetItemIndexHashed(pCurItem->Key(), aHashlist); // O(n) .. O(n^n)
-	}
-
 	for(int i = 0; i < NumItems; i++)
 	{
 		// do delta
@@ -342,6 +350,10 @@ int CSnapshotDelta::CreateDelta(const CSnapshot *pFrom, const CSnapshot *pTo, vo
 
 			const CSnapshotItem *pPastItem = pFrom->GetItem(PastIndex);
 
+			// most items don't change, comparing them is cheaper than diffing
+			if(mem_comp(pPastItem->Data(), pCurItem->Data(), ItemSize) == 0)
+				continue;
+
 			if(!IncludeSize)
 				pItemDataDst = pData + 2;
 
@@ -523,33 +535,40 @@ int CSnapshotDelta::UnpackDelta(const CSnapshot *pFrom, CSnapshot *pTo, const vo
 	if(pData > pEnd)
 		return -101;
 
+	const int NumFromItems = pFrom->NumItems();
+	dbg_assert(NumFromItems <= CSnapshot::MAX_ITEMS, "too many items in the delta base");
+	CItemList aHashlist[HASHLIST_SIZE];
+	GenerateHash(aHashlist, pFrom);
+
+	bool aDeleted[CSnapshot::MAX_ITEMS] = {};
+	for(int d = 0; d < pDelta->m_NumDeletedItems; d++)
+	{
+		const int FromIndex = GetItemIndexHashed(pDeleted[d], aHashlist);
+		if(FromIndex != -1)
+			aDeleted[FromIndex] = true;
+	}
+
 	// copy all non deleted stuff
-	for(int i = 0; i < pFrom->NumItems(); i++)
+	int *apKeptData[CSnapshot::MAX_ITEMS];
+	for(int i = 0; i < NumFromItems; i++)
 	{
+		apKeptData[i] = nullptr;
+		if(aDeleted[i])
+			continue;
+
 		const CSnapshotItem *pFromItem = pFrom->GetItem(i);
 		const int ItemSize = pFrom->GetItemSize(i);
-		bool Keep = true;
-		for(int d = 0; d < pDelta->m_NumDeletedItems; d++)
-		{
-			if(pDeleted[d] == pFromItem->Key())
-			{
-				Keep = false;
-				break;
-			}
-		}
+		void *pObj = Builder.NewItem(pFromItem->Type(), pFromItem->Id(), ItemSize);
+		if(!pObj)
+			return -301;
 
-		if(Keep)
-		{
-			void *pObj = Builder.NewItem(pFromItem->Type(), pFromItem->Id(), ItemSize);
-			if(!pObj)
-				return -301;
-
-			// keep it
-			mem_copy(pObj, pFromItem->Data(), ItemSize);
-		}
+		// keep it
+		mem_copy(pObj, pFromItem->Data(), ItemSize);
+		apKeptData[i] = (int *)pObj;
 	}
 
 	// unpack updated stuff
+	int NextFromIndex = 0;
 	for(int i = 0; i < pDelta->m_NumUpdateItems; i++)
 	{
 		if(pData + 2 > pEnd)
@@ -581,15 +600,27 @@ int CSnapshotDelta::UnpackDelta(const CSnapshot *pFrom, CSnapshot *pTo, const vo
 
 		const int Key = (Type << 16) | Id;
 
-		// create the item if needed
-		int *pNewData = Builder.GetItemData(Key);
+		// the updates are in snapshot order too, so the previous item is
+		// usually the one after the previous match
+		int FromIndex;
+		if(NextFromIndex < NumFromItems && pFrom->GetItem(NextFromIndex)->Key() == Key)
+			FromIndex = NextFromIndex;
+		else
+			FromIndex = GetItemIndexHashed(Key, aHashlist);
+		if(FromIndex != -1)
+			NextFromIndex = FromIndex + 1;
+
+		// create the item if needed, items that weren't kept are still
+		// searched in case the delta contains them more than once
+		int *pNewData = FromIndex != -1 ? apKeptData[FromIndex] : nullptr;
+		if(!pNewData)
+			pNewData = Builder.GetItemData(Key);
 		if(!pNewData)
 			pNewData = (int *)Builder.NewItem(Type, Id, ItemSize);
 
 		if(!pNewData)
 			return -302;
 
-		const int FromIndex = pFrom->GetItemIndex(Key);
 		if(FromIndex != -1)
 		{
 			// we got an update so we need to apply the diff
@@ -0,0 +1,319 @@
+#include "teehistorian_compressed.h"
+
+#include <engine/shared/uuid_manager.h>
+
+#include <algorithm>
+
+#include <zlib.h>
+
+static const CUuid TEEHISTORIAN_COMPRESSED_UUID = CalculateUuid("teehistorian-compressed@ddnet.tw");
+static const CUuid TEEHISTORIAN_INDEX_UUID = CalculateUuid("teehistorian-index@ddnet.tw");
+
+enum
+{
+	TEEHISTORIAN_COMPRESSED_VERSION = 1,
+
+	HEADER_SIZE = sizeof(CUuid) + 4,
+	FRAME_HEADER_SIZE = 4 * 4 + 8,
+	INDEX_ENTRY_SIZE = 4 + 8 + 8,
+	FOOTER_SIZE = 4 + sizeof(CUuid),
+};
+
+static void WriteInt64(unsigned char *pBytes, int64_t Value)
+{
+	uint_to_bytes_be(pBytes, (uint64_t)Value >> 32);
+	uint_to_bytes_be(pBytes + 4, (uint64_t)Value & 0xffffffff);
+}
+
+static int64_t ReadInt64(const unsigned char *pBytes)
+{
+	return (int64_t)(((uint64_t)bytes_be_to_uint(pBytes) << 32) | bytes_be_to_uint(pBytes + 4));
+}
+
+CCompressedTeeHistorianWriter::CCompressedTeeHistorianWriter() = default;
+
+CCompressedTeeHistorianWriter::~CCompressedTeeHistorianWriter()
+{
+	if(IsOpen())
+		Close();
+}
+
+void CCompressedTeeHistorianWriter::Open(IOHANDLE File, int FrameTicks)
+{
+	dbg_assert(!IsOpen(), "teehistorian writer is already open");
+
+	m_File = File;
+	m_FrameTicks = FrameTicks;
+	m_DataOffset = 0;
+	m_Error = false;
+	m_vIndex.clear();
+
+	unsigned char aHeader[HEADER_SIZE];
+	mem_copy(aHeader, &TEEHISTORIAN_COMPRESSED_UUID, sizeof(CUuid));
+	uint_to_bytes_be(aHeader + sizeof(CUuid), TEEHISTORIAN_COMPRESSED_VERSION);
+	WriteFile(aHeader, sizeof(aHeader));
+	m_FileOffset = sizeof(aHeader);
+
+	// the first frame contains the header of the teehistorian stream
+	m_pFrame = std::make_unique<CFrame>();
+	m_pFrame->m_Tick = 0;
+	m_pFrame->m_StateSize = 0;
+	m_pFrame->m_DataOffset = 0;
+
+	m_pThread = thread_init(CompressThread, this, "teehistorian compress");
+}
+
+void CCompressedTeeHistorianWriter::Close()
+{
+	dbg_assert(IsOpen(), "teehistorian writer is not open");
+
+	int NumQueued = 1;
+	{
+		CLockScope LockScope(m_Lock);
+		if(m_pFrame->m_vBuffer.size() > (size_t)m_pFrame->m_StateSize)
+		{
+			m_vpQueue.push_back(std::move(m_pFrame));
+			NumQueued++;
+		}
+		m_vpQueue.push_back(nullptr);
+	}
+	for(int i = 0; i < NumQueued; i++)
+		m_NumQueued.Signal();
+	thread_wait(m_pThread);
+	m_pThread = nullptr;
+	m_pFrame = nullptr;
+
+	WriteIndex();
+	if(io_close(m_File) != 0)
+		m_Error = true;
+	m_File = nullptr;
+}
+
+void CCompressedTeeHistorianWriter::Write(const void *pData, int DataSize)
+{
+	const unsigned char *pBytes = (const unsigned char *)pData;
+	m_pFrame->m_vBuffer.insert(m_pFrame->m_vBuffer.end(), pBytes, pBytes + DataSize);
+	m_DataOffset += DataSize;
+}
+
+bool CCompressedTeeHistorianWriter::FrameDue(int Tick) const
+{
+	// keep the header in a frame of its own
+	if(m_pFrame->m_DataOffset == 0)
+		return true;
+	return Tick - m_pFrame->m_Tick >= m_FrameTicks || m_pFrame->m_vBuffer.size() >= MAX_FRAME_DATA;
+}
+
+void CCompressedTeeHistorianWriter::BeginFrame(int Tick, const void *pState, int StateSize)
+{
+	// replace frames without data instead of writing them
+	if(m_pFrame->m_vBuffer.size() > (size_t)m_pFrame->m_StateSize)
+	{
+		std::unique_ptr<CFrame> pNext = std::make_unique<CFrame>();
+		pNext->m_vBuffer.reserve(m_pFrame->m_vBuffer.size());
+		{
+			CLockScope LockScope(m_Lock);
+			m_vpQueue.push_back(std::move(m_pFrame));
+		}
+		m_NumQueued.Signal();
+		m_pFrame = std::move(pNext);
+	}
+
+	const unsigned char *pBytes = (const unsigned char *)pState;
+	m_pFrame->m_Tick = Tick;
+	m_pFrame->m_StateSize = StateSize;
+	m_pFrame->m_DataOffset = m_DataOffset;
+	m_pFrame->m_vBuffer.assign(pBytes, pBytes + StateSize);
+}
+
+void CCompressedTeeHistorianWriter::CompressThread(void *pUser)
+{
+	CCompressedTeeHistorianWriter *pThis = (CCompressedTeeHistorianWriter *)pUser;
+	while(true)
+	{
+		pThis->m_NumQueued.Wait();
+		std::unique_ptr<CFrame> pFrame;
+		{
+			CLockScope LockScope(pThis->m_Lock);
+			pFrame = std::move(pThis->m_vpQueue.front());
+			pThis->m_vpQueue.pop_front();
+		}
+		if(pFrame == nullptr)
+			break;
+		pThis->CompressFrame(pFrame.get());
+	}
+}
+
+void CCompressedTeeHistorianWriter::CompressFrame(const CFrame *pFrame)
+{
+	uLongf CompressedSize = compressBound(pFrame->m_vBuffer.size());
+	m_vCompressed.resize(FRAME_HEADER_SIZE + CompressedSize);
+	if(compress2(m_vCompressed.data() + FRAME_HEADER_SIZE, &CompressedSize, pFrame->m_vBuffer.data(), pFrame->m_vBuffer.size(), Z_DEFAULT_COMPRESSION) != Z_OK)
+	{
+		dbg_msg("teehistorian", "failed to compress frame at tick %d", pFrame->m_Tick);
+		m_Error = true;
+		return;
+	}
+
+	unsigned char *pHeader = m_vCompressed.data();
+	uint_to_bytes_be(pHeader, pFrame->m_Tick);
+	uint_to_bytes_be(pHeader + 4, pFrame->m_StateSize);
+	uint_to_bytes_be(pHeader + 8, pFrame->m_vBuffer.size() - pFrame->m_StateSize);
+	uint_to_bytes_be(pHeader + 12, CompressedSize);
+	WriteInt64(pHeader + 16, pFrame->m_DataOffset);
+	WriteFile(m_vCompressed.data(), FRAME_HEADER_SIZE + CompressedSize);
+
+	m_vIndex.push_back({pFrame->m_Tick, m_FileOffset, pFrame->m_DataOffset});
+	m_FileOffset += FRAME_HEADER_SIZE + CompressedSize;
+}
+
+void CCompressedTeeHistorianWriter::WriteIndex()
+{
+	std::vector<unsigned char> vIndex(m_vIndex.size() * INDEX_ENTRY_SIZE + FOOTER_SIZE);
+	unsigned char *pEntry = vIndex.data();
+	for(const CIndexEntry &Entry : m_vIndex)
+	{
+		uint_to_bytes_be(pEntry, Entry.m_Tick);
+		WriteInt64(pEntry + 4, Entry.m_FileOffset);
+		WriteInt64(pEntry + 12, Entry.m_DataOffset);
+		pEntry += INDEX_ENTRY_SIZE;
+	}
+	uint_to_bytes_be(pEntry, m_vIndex.size());
+	mem_copy(pEntry + 4, &TEEHISTORIAN_INDEX_UUID, sizeof(CUuid));
+	WriteFile(vIndex.data(), vIndex.size());
+}
+
+void CCompressedTeeHistorianWriter::WriteFile(const void *pData, int DataSize)
+{
+	if(io_write(m_File, pData, DataSize) != (unsigned)DataSize)
+		m_Error = true;
+}
+
+bool CCompressedTeeHistorianReader::IsCompressed(const void *pData, int DataSize)
+{
+	return DataSize >= (int)sizeof(CUuid) && mem_comp(pData, &TEEHISTORIAN_COMPRESSED_UUID, sizeof(CUuid)) == 0;
+}
+
+bool CCompressedTeeHistorianReader::Open(IOHANDLE File)
+{
+	Close();
+	m_File = File;
+
+	unsigned char aHeader[HEADER_SIZE];
+	if(io_read(m_File, aHeader, sizeof(aHeader)) != sizeof(aHeader) ||
+		!IsCompressed(aHeader, sizeof(aHeader)) ||
+		bytes_be_to_uint(aHeader + sizeof(CUuid)) != TEEHISTORIAN_COMPRESSED_VERSION)
+	{
+		Close();
+		return false;
+	}
+
+	const int64_t Length = io_length(m_File);
+	if(Length < 0 || (!ReadIndex(Length) && !ScanFrames(Length)))
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void CCompressedTeeHistorianReader::Close()
+{
+	if(m_File)
+	{
+		io_close(m_File);
+		m_File = nullptr;
+	}
+	m_vFrames.clear();
+}
+
+bool CCompressedTeeHistorianReader::ReadIndex(int64_t Length)
+{
+	if(Length < HEADER_SIZE + FOOTER_SIZE)
+		return false;
+
+	unsigned char aFooter[FOOTER_SIZE];
+	if(io_seek(m_File, Length - FOOTER_SIZE, IOSEEK_START) != 0 ||
+		io_read(m_File, aFooter, sizeof(aFooter)) != sizeof(aFooter) ||
+		mem_comp(aFooter + 4, &TEEHISTORIAN_INDEX_UUID, sizeof(CUuid)) != 0)
+		return false;
+
+	const int64_t NumEntries = bytes_be_to_uint(aFooter);
+	const int64_t IndexStart = Length - FOOTER_SIZE - NumEntries * INDEX_ENTRY_SIZE;
+	if(IndexStart < HEADER_SIZE)
+		return false;
+
+	std::vector<unsigned char> vIndex(NumEntries * INDEX_ENTRY_SIZE);
+	if(io_seek(m_File, IndexStart, IOSEEK_START) != 0 ||
+		io_read(m_File, vIndex.data(), vIndex.size()) != vIndex.size())
+		return false;
+
+	m_vFrames.resize(NumEntries);
+	for(int64_t i = 0; i < NumEntries; i++)
+	{
+		const unsigned char *pEntry = vIndex.data() + i * INDEX_ENTRY_SIZE;
+		CFrameInfo &Frame = m_vFrames[i];
+		Frame.m_Tick = bytes_be_to_uint(pEntry);
+		Frame.m_FileOffset = ReadInt64(pEntry + 4);
+		Frame.m_DataOffset = ReadInt64(pEntry + 12);
+		if(Frame.m_FileOffset < HEADER_SIZE || Frame.m_FileOffset >= IndexStart ||
+			(i > 0 && Frame.m_FileOffset <= m_vFrames[i - 1].m_FileOffset))
+		{
+			m_vFrames.clear();
+			return false;
+		}
+	}
+	return true;
+}
+
+bool CCompressedTeeHistorianReader::ScanFrames(int64_t Length)
+{
+	int64_t Offset = HEADER_SIZE;
+	while(Offset + FRAME_HEADER_SIZE <= Length)
+	{
+		unsigned char aHeader[FRAME_HEADER_SIZE];
+		if(io_seek(m_File, Offset, IOSEEK_START) != 0 ||
+			io_read(m_File, aHeader, sizeof(aHeader)) != sizeof(aHeader))
+			break;
+		const int64_t FrameEnd = Offset + FRAME_HEADER_SIZE + bytes_be_to_uint(aHeader + 12);
+		// the last frame might be incomplete
+		if(FrameEnd > Length)
+			break;
+		m_vFrames.push_back({(int)bytes_be_to_uint(aHeader), Offset, ReadInt64(aHeader + 16)});
+		Offset = FrameEnd;
+	}
+	return true;
+}
+
+int CCompressedTeeHistorianReader::FindFrame(int Tick) const
+{
+	auto It = std::upper_bound(m_vFrames.begin(), m_vFrames.end(), Tick, [](int Value, const CFrameInfo &Frame) {
+		return Value < Frame.m_Tick;
+	});
+	return (It - m_vFrames.begin()) - 1;
+}
+
+bool CCompressedTeeHistorianReader::ReadFrame(int Index, std::vector<unsigned char> &vState, std::vector<unsigned char> &vData)
+{
+	unsigned char aHeader[FRAME_HEADER_SIZE];
+	if(io_seek(m_File, m_vFrames[Index].m_FileOffset, IOSEEK_START) != 0 ||
+		io_read(m_File, aHeader, sizeof(aHeader)) != sizeof(aHeader))
+		return false;
+
+	const unsigned StateSize = bytes_be_to_uint(aHeader + 4);
+	const unsigned DataSize = bytes_be_to_uint(aHeader + 8);
+	const unsigned CompressedSize = bytes_be_to_uint(aHeader + 12);
+	m_vCompressed.resize(CompressedSize);
+	if(io_read(m_File, m_vCompressed.data(), CompressedSize) != CompressedSize)
+		return false;
+
+	uLongf UncompressedSize = (uLongf)StateSize + DataSize;
+	m_vUncompressed.resize(UncompressedSize);
+	if(uncompress(m_vUncompressed.data(), &UncompressedSize, m_vCompressed.data(), CompressedSize) != Z_OK ||
+		UncompressedSize != (uLongf)StateSize + DataSize)
+		return false;
+
+	vState.assign(m_vUncompressed.begin(), m_vUncompressed.begin() + StateSize);
+	vData.assign(m_vUncompressed.begin() + StateSize, m_vUncompressed.end());
+	return true;
+}
@@ -0,0 +1,135 @@
+#ifndef ENGINE_SHARED_TEEHISTORIAN_COMPRESSED_H
+#define ENGINE_SHARED_TEEHISTORIAN_COMPRESSED_H
+
+#include <base/lock.h>
+#include <base/system.h>
+#include <base/tl/threading.h>
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+/*
+	Compressed teehistorian files
+
+	The teehistorian stream is split into frames at tick boundaries, each
+	frame is compressed with zlib on its own. A frame starts with the state
+	of the teehistorian writer at its first tick, so it can be decoded
+	without the frames before it. Integers are stored big endian.
+
+	header:  uuid "teehistorian-compressed@ddnet.tw", int32 version
+	frame:   int32 tick, int32 state size, int32 data size,
+	         int32 compressed size, int64 data offset,
+	         zlib compressed state followed by the data
+	index:   per frame int32 tick, int64 file offset, int64 data offset
+	footer:  int32 number of index entries, uuid "teehistorian-index@ddnet.tw"
+
+	The index is written when the file is closed. If it is missing, e.g.
+	after a crash, the frames can still be found by walking their headers.
+*/
+
+class CCompressedTeeHistorianWriter
+{
+public:
+	CCompressedTeeHistorianWriter();
+	~CCompressedTeeHistorianWriter();
+
+	// takes ownership of the file, starts a new frame every FrameTicks ticks
+	void Open(IOHANDLE File, int FrameTicks);
+	void Close();
+	bool IsOpen() const { return m_pThread != nullptr; }
+	bool Error() const { return m_Error; }
+
+	void Write(const void *pData, int DataSize);
+	// whether the current frame should be ended before the tick
+	bool FrameDue(int Tick) const;
+	// hands the current frame to the compression thread, the following data
+	// starts a frame that is decoded with pState, the writer state at Tick
+	void BeginFrame(int Tick, const void *pState, int StateSize);
+
+private:
+	enum
+	{
+		// end frames early if a lot happens
+		MAX_FRAME_DATA = 4 * 1024 * 1024,
+	};
+
+	struct CFrame
+	{
+		int m_Tick;
+		int m_StateSize;
+		int64_t m_DataOffset;
+		// the state followed by the data
+		std::vector<unsigned char> m_vBuffer;
+	};
+
+	struct CIndexEntry
+	{
+		int m_Tick;
+		int64_t m_FileOffset;
+		int64_t m_DataOffset;
+	};
+
+	IOHANDLE m_File = nullptr;
+	void *m_pThread = nullptr;
+	int m_FrameTicks = 0;
+	int64_t m_DataOffset = 0;
+	std::unique_ptr<CFrame> m_pFrame;
+
+	CLock m_Lock;
+	// a nullptr frame stops the thread
+	std::deque<std::unique_ptr<CFrame>> m_vpQueue GUARDED_BY(m_Lock);
+	CSemaphore m_NumQueued;
+	std::atomic_bool m_Error{false};
+
+	// only accessed by the compression thread
+	int64_t m_FileOffset = 0;
+	std::vector<CIndexEntry> m_vIndex;
+	std::vector<unsigned char> m_vCompressed;
+
+	static void CompressThread(void *pUser);
+	void CompressFrame(const CFrame *pFrame);
+	void WriteIndex();
+	void WriteFile(const void *pData, int DataSize);
+};
+
+class CCompressedTeeHistorianReader
+{
+public:
+	struct CFrameInfo
+	{
+		int m_Tick;
+		int64_t m_FileOffset;
+		int64_t m_DataOffset;
+	};
+
+	CCompressedTeeHistorianReader() = default;
+	~CCompressedTeeHistorianReader() { Close(); }
+
+	// checks the first bytes of a file
+	static bool IsCompressed(const void *pData, int DataSize);
+
+	// takes ownership of the file
+	bool Open(IOHANDLE File);
+	void Close();
+
+	int NumFrames() const { return m_vFrames.size(); }
+	const CFrameInfo &Frame(int Index) const { return m_vFrames[Index]; }
+	// returns the last frame starting at or before Tick, -1 if there is none
+	int FindFrame(int Tick) const;
+	// an empty state means the initial state of the writer
+	bool ReadFrame(int Index, std::vector<unsigned char> &vState, std::vector<unsigned char> &vData);
+
+private:
+	IOHANDLE m_File = nullptr;
+	std::vector<CFrameInfo> m_vFrames;
+	std::vector<unsigned char> m_vCompressed;
+	std::vector<unsigned char> m_vUncompressed;
+
+	bool ReadIndex(int64_t Length);
+	bool ScanFrames(int64_t Length);
+};
+
+#endif // ENGINE_SHARED_TEEHISTORIAN_COMPRESSED_H
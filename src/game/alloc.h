@@ -3,6 +3,7 @@
 #ifndef GAME_ALLOC_H
 #define GAME_ALLOC_H
 
+#include <cstdlib>
 #include <new>
 
 #include <base/system.h>
@@ -41,6 +42,58 @@ public: \
 \
 private:
 
+// Keeps the memory of deleted objects in a per-thread free list and reuses
+// it for the next objects of the class, for classes that are created and
+// deleted all the time. Objects of derived classes are allocated on the heap.
+#define MACRO_ALLOC_FREELIST() \
+public: \
+	void *operator new(size_t Size); \
+	void operator delete(void *pObj, size_t Size); \
+\
+private:
+
+// the free memory blocks form a singly linked list through their first bytes
+struct CAllocFreeList
+{
+	void *m_pFirst;
+
+	void *Pop(size_t Size)
+	{
+		void *pObj = m_pFirst;
+		if(pObj == nullptr)
+			return malloc(Size);
+		ASAN_UNPOISON_MEMORY_REGION(pObj, Size);
+		m_pFirst = *(void **)pObj;
+		return pObj;
+	}
+
+	void Push(void *pObj, size_t Size)
+	{
+		*(void **)pObj = m_pFirst;
+		m_pFirst = pObj;
+		ASAN_POISON_MEMORY_REGION((char *)pObj + sizeof(void *), Size - sizeof(void *));
+	}
+};
+
+// the free lists are never destroyed, so objects can still be deleted
+// during the destruction of other static objects
+#define MACRO_ALLOC_FREELIST_IMPL(POOLTYPE) \
+	static_assert(sizeof(POOLTYPE) >= sizeof(void *)); \
+	static thread_local CAllocFreeList gs_FreeList##POOLTYPE = {nullptr}; \
+	void *POOLTYPE::operator new(size_t Size) \
+	{ \
+		void *pObj = Size == sizeof(POOLTYPE) ? gs_FreeList##POOLTYPE.Pop(Size) : malloc(Size); \
+		mem_zero(pObj, Size); \
+		return pObj; \
+	} \
+	void POOLTYPE::operator delete(void *pObj, size_t Size) \
+	{ \
+		if(Size == sizeof(POOLTYPE)) \
+			gs_FreeList##POOLTYPE.Push(pObj, Size); \
+		else \
+			free(pObj); \
+	}
+
 #if __has_feature(address_sanitizer)
 #define MACRO_ALLOC_GET_SIZE(POOLTYPE) ((sizeof(POOLTYPE) + 7) & ~7)
 #else
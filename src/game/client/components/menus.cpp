@@ -21,6 +21,7 @@
 #include <engine/keys.h>
 #include <engine/serverbrowser.h>
 #include <engine/shared/config.h>
+#include <engine/shared/demo.h>
 #include <engine/storage.h>
 #include <engine/textrender.h>
 
@@ -1589,6 +1590,8 @@ void CMenus::RenderPopupFullscreen(CUIRect Screen)
 			}
 			else if(Storage()->RenameFile(aBufOld, aBufNew, m_vpFilteredDemos[m_DemolistSelectedIndex]->m_StorageType))
 			{
+				if(!m_vpFilteredDemos[m_DemolistSelectedIndex]->m_IsDir)
+					CDemoKeyFrameIndex::Rename(Storage(), aBufOld, aBufNew, m_vpFilteredDemos[m_DemolistSelectedIndex]->m_StorageType);
 				str_copy(m_aCurrentDemoSelectionName, m_DemoRenameInput.GetString());
 				if(!m_vpFilteredDemos[m_DemolistSelectedIndex]->m_IsDir)
 					fs_split_file_extension(m_DemoRenameInput.GetString(), m_aCurrentDemoSelectionName, sizeof(m_aCurrentDemoSelectionName));
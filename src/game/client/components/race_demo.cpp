@@ -4,6 +4,7 @@
 
 #include <base/system.h>
 #include <engine/shared/config.h>
+#include <engine/shared/demo.h>
 #include <engine/storage.h>
 
 #include <game/client/race.h>
@@ -179,10 +180,14 @@ void CRaceDemo::StopRecord(int Time)
 			char aNewFilename[512];
 			GetPath(aNewFilename, sizeof(aNewFilename), m_Time);
 
-			Storage()->RenameFile(m_aTmpFilename, aNewFilename, IStorage::TYPE_SAVE);
+			if(Storage()->RenameFile(m_aTmpFilename, aNewFilename, IStorage::TYPE_SAVE))
+				CDemoKeyFrameIndex::Rename(Storage(), m_aTmpFilename, aNewFilename, IStorage::TYPE_SAVE);
 		}
 		else // no new record
+		{
 			Storage()->RemoveFile(m_aTmpFilename, IStorage::TYPE_SAVE);
+			CDemoKeyFrameIndex::Remove(Storage(), m_aTmpFilename, IStorage::TYPE_SAVE);
+		}
 
 		m_aTmpFilename[0] = '\0';
 	}
@@ -259,6 +264,7 @@ bool CRaceDemo::CheckDemo(int Time)
 		char aFilename[IO_MAX_PATH_LENGTH];
 		str_format(aFilename, sizeof(aFilename), "%s/%s.demo", ms_pRaceDemoDir, Demo.m_aName);
 		Storage()->RemoveFile(aFilename, IStorage::TYPE_SAVE);
+		CDemoKeyFrameIndex::Remove(Storage(), aFilename, IStorage::TYPE_SAVE);
 	}
 
 	return true;
@@ -11,6 +11,8 @@
 #include "laser.h"
 #include "projectile.h"
 
+MACRO_ALLOC_FREELIST_IMPL(CCharacter)
+
 // Character, "physical" player's part
 
 void CCharacter::SetWeapon(int Weapon)
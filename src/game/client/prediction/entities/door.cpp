@@ -5,6 +5,8 @@
 #include <game/collision.h>
 #include <game/mapitems.h>
 
+MACRO_ALLOC_FREELIST_IMPL(CDoor)
+
 CDoor::CDoor(CGameWorld *pGameWorld, int Id, const CLaserData *pData) :
 	CEntity(pGameWorld, CGameWorld::ENTTYPE_DOOR)
 {
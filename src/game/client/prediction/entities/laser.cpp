@@ -11,6 +11,8 @@
 
 #include <engine/shared/config.h>
 
+MACRO_ALLOC_FREELIST_IMPL(CLaser)
+
 CLaser::CLaser(CGameWorld *pGameWorld, vec2 Pos, vec2 Direction, float StartEnergy, int Owner, int Type) :
 	CEntity(pGameWorld, CGameWorld::ENTTYPE_LASER)
 {
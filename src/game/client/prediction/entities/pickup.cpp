@@ -9,6 +9,8 @@
 #include <game/collision.h>
 #include <game/mapitems.h>
 
+MACRO_ALLOC_FREELIST_IMPL(CPickup)
+
 static constexpr int gs_PickupPhysSize = 14;
 
 void CPickup::Tick()
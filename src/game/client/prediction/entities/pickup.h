@@ -9,6 +9,8 @@ class CPickupData;
 
 class CPickup : public CEntity
 {
+	MACRO_ALLOC_FREELIST()
+
 public:
 	static const int ms_CollisionExtraSize = 6;
 
@@ -6,6 +6,8 @@
 #include <game/collision.h>
 #include <game/mapitems.h>
 
+MACRO_ALLOC_FREELIST_IMPL(CPlasma)
+
 const float PLASMA_ACCEL = 1.1f;
 
 CPlasma::CPlasma(CGameWorld *pGameWorld, int Id, const CLaserData *pData) :
@@ -11,6 +11,8 @@
 #include "character.h"
 #include "projectile.h"
 
+MACRO_ALLOC_FREELIST_IMPL(CProjectile)
+
 CProjectile::CProjectile(
 	CGameWorld *pGameWorld,
 	int Type,
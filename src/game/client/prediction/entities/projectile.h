@@ -9,6 +9,8 @@ class CProjectileData;
 
 class CProjectile : public CEntity
 {
+	MACRO_ALLOC_FREELIST()
+
 	friend class CGameWorld;
 	friend class CItems;
 
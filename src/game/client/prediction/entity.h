@@ -17,6 +17,7 @@ private:
 	friend CGameWorld; // entity list handling
 	CEntity *m_pPrevTypeEntity;
 	CEntity *m_pNextTypeEntity;
+	CEntityGrid<CEntity>::CNode m_GridNode;
 
 protected:
 	CGameWorld *m_pGameWorld;
@@ -23,7 +23,8 @@
 //////////////////////////////////////////////////
 // game world
 //////////////////////////////////////////////////
-CGameWorld::CGameWorld()
+CGameWorld::CGameWorld() :
+	m_EntityGrid(NUM_ENTTYPES)
 {
 	for(auto &pFirstEntityType : m_apFirstEntityTypes)
 		pFirstEntityType = nullptr;
@@ -33,6 +34,8 @@ CGameWorld::CGameWorld()
 	m_GameTick = 0;
 	m_pParent = nullptr;
 	m_pChild = nullptr;
+	m_pTickingEntity = nullptr;
+	m_EntityGridInTick = false;
 }
 
 CGameWorld::~CGameWorld()
@@ -66,8 +69,11 @@ int CGameWorld::FindEntities(vec2 Pos, float Radius, CEntity **ppEnts, int Max,
 	if(Type < 0 || Type >= NUM_ENTTYPES)
 		return 0;
 
+	const float Range = Radius + m_EntityGrid.MaxRadius(Type) + 1.0f;
+	QueryEntityGrid(Type, Pos - vec2(Range, Range), Pos + vec2(Range, Range));
+
 	int Num = 0;
-	for(CEntity *pEnt = m_apFirstEntityTypes[Type]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+	for(CEntity *pEnt : m_vpGridCandidates)
 	{
 		if(distance(pEnt->m_Pos, Pos) < Radius + pEnt->m_ProximityRadius)
 		{
@@ -113,6 +119,10 @@ void CGameWorld::InsertEntity(CEntity *pEnt, bool Last)
 		pEnt->m_pNextTypeEntity = nullptr;
 	}
 
+	// copied entities come with the node of their original
+	pEnt->m_GridNode = CEntityGrid<CEntity>::CNode();
+	m_EntityGrid.Insert(pEnt->m_GridNode, pEnt, pEnt->m_ObjType, pEnt->m_Pos, pEnt->m_ProximityRadius, Last);
+
 	if(pEnt->m_ObjType == ENTTYPE_CHARACTER)
 	{
 		auto *pChar = (CCharacter *)pEnt;
@@ -147,6 +157,10 @@ void CGameWorld::RemoveEntity(CEntity *pEnt)
 	pEnt->m_pNextTypeEntity = nullptr;
 	pEnt->m_pPrevTypeEntity = nullptr;
 
+	m_EntityGrid.Remove(pEnt->m_GridNode);
+	if(m_pTickingEntity == pEnt)
+		m_pTickingEntity = nullptr;
+
 	if(pEnt->m_pParent)
 	{
 		if(m_IsValidCopy && m_pParent && m_pParent->m_pChild == this)
@@ -161,6 +175,34 @@ void CGameWorld::RemoveEntity(CEntity *pEnt)
 	}
 }
 
+void CGameWorld::UpdateEntityGrid(int Type)
+{
+	for(CEntity *pEnt = m_apFirstEntityTypes[Type]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+		m_EntityGrid.Update(pEnt->m_GridNode, pEnt->m_Pos);
+}
+
+void CGameWorld::BeginEntityTick(CEntity *pEnt)
+{
+	m_pTickingEntity = pEnt;
+}
+
+void CGameWorld::EndEntityTick()
+{
+	if(m_pTickingEntity)
+		m_EntityGrid.Update(m_pTickingEntity->m_GridNode, m_pTickingEntity->m_Pos);
+	m_pTickingEntity = nullptr;
+}
+
+void CGameWorld::QueryEntityGrid(int Type, vec2 Min, vec2 Max)
+{
+	if(!m_EntityGridInTick)
+		UpdateEntityGrid(Type);
+	else if(m_pTickingEntity)
+		m_EntityGrid.Update(m_pTickingEntity->m_GridNode, m_pTickingEntity->m_Pos);
+
+	m_EntityGrid.Query(Type, Min, Max, m_vpGridCandidates);
+}
+
 void CGameWorld::RemoveCharacter(CCharacter *pChar)
 {
 	int Id = pChar->GetCid();
@@ -188,6 +230,11 @@ void CGameWorld::RemoveEntities()
 
 void CGameWorld::Tick()
 {
+	// pick up everything that was moved from outside of the world tick
+	for(int i = 0; i < NUM_ENTTYPES; i++)
+		UpdateEntityGrid(i);
+	m_EntityGridInTick = true;
+
 	// update all objects
 	for(int i = 0; i < NUM_ENTTYPES; i++)
 	{
@@ -199,7 +246,9 @@ void CGameWorld::Tick()
 			for(; pEnt;)
 			{
 				m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
+				BeginEntityTick(pEnt);
 				((CCharacter *)pEnt)->PreTick();
+				EndEntityTick();
 				pEnt = m_pNextTraverseEntity;
 			}
 		}
@@ -208,7 +257,9 @@ void CGameWorld::Tick()
 		for(; pEnt;)
 		{
 			m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
+			BeginEntityTick(pEnt);
 			pEnt->Tick();
+			EndEntityTick();
 			pEnt = m_pNextTraverseEntity;
 		}
 	}
@@ -217,11 +268,15 @@ void CGameWorld::Tick()
 		for(; pEnt;)
 		{
 			m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
+			BeginEntityTick(pEnt);
 			pEnt->TickDeferred();
+			EndEntityTick();
 			pEnt->m_SnapTicks++;
 			pEnt = m_pNextTraverseEntity;
 		}
 
+	m_EntityGridInTick = false;
+
 	RemoveEntities();
 
 	// update switch state
@@ -254,11 +309,16 @@ CCharacter *CGameWorld::IntersectCharacter(vec2 Pos0, vec2 Pos1, float Radius, v
 
 CEntity *CGameWorld::IntersectEntity(vec2 Pos0, vec2 Pos1, float Radius, int Type, vec2 &NewPos, const CEntity *pNotThis, int CollideWith, const CEntity *pThisOnly)
 {
+	if(Type < 0 || Type >= NUM_ENTTYPES)
+		return nullptr;
+
 	float ClosestLen = distance(Pos0, Pos1) * 100.0f;
 	CEntity *pClosest = nullptr;
 
-	CEntity *pEntity = FindFirst(Type);
-	for(; pEntity; pEntity = pEntity->TypeNext())
+	const float Range = Radius + m_EntityGrid.MaxRadius(Type) + 1.0f;
+	QueryEntityGrid(Type, vec2(minimum(Pos0.x, Pos1.x), minimum(Pos0.y, Pos1.y)) - vec2(Range, Range), vec2(maximum(Pos0.x, Pos1.x), maximum(Pos0.y, Pos1.y)) + vec2(Range, Range));
+
+	for(CEntity *pEntity : m_vpGridCandidates)
 	{
 		if(pEntity == pNotThis)
 			continue;
@@ -292,9 +352,13 @@ CEntity *CGameWorld::IntersectEntity(vec2 Pos0, vec2 Pos1, float Radius, int Typ
 std::vector<CCharacter *> CGameWorld::IntersectedCharacters(vec2 Pos0, vec2 Pos1, float Radius, const CEntity *pNotThis)
 {
 	std::vector<CCharacter *> vpCharacters;
-	CCharacter *pChr = (CCharacter *)FindFirst(CGameWorld::ENTTYPE_CHARACTER);
-	for(; pChr; pChr = (CCharacter *)pChr->TypeNext())
+
+	const float Range = Radius + m_EntityGrid.MaxRadius(ENTTYPE_CHARACTER) + 1.0f;
+	QueryEntityGrid(ENTTYPE_CHARACTER, vec2(minimum(Pos0.x, Pos1.x), minimum(Pos0.y, Pos1.y)) - vec2(Range, Range), vec2(maximum(Pos0.x, Pos1.x), maximum(Pos0.y, Pos1.y)) + vec2(Range, Range));
+
+	for(CEntity *pEnt : m_vpGridCandidates)
 	{
+		CCharacter *pChr = (CCharacter *)pEnt;
 		if(pChr == pNotThis)
 			continue;
 
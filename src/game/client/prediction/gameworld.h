@@ -3,6 +3,7 @@
 #ifndef GAME_CLIENT_PREDICTION_GAMEWORLD_H
 #define GAME_CLIENT_PREDICTION_GAMEWORLD_H
 
+#include <game/entity_grid.h>
 #include <game/gamecore.h>
 #include <game/teamscore.h>
 
@@ -118,6 +119,17 @@ private:
 	CEntity *m_apFirstEntityTypes[NUM_ENTTYPES];
 
 	CCharacter *m_apCharacters[MAX_CLIENTS];
+
+	// spatial index for the proximity and line queries, see the server world
+	CEntityGrid<CEntity> m_EntityGrid;
+	std::vector<CEntity *> m_vpGridCandidates;
+	CEntity *m_pTickingEntity;
+	bool m_EntityGridInTick;
+
+	void UpdateEntityGrid(int Type);
+	void BeginEntityTick(CEntity *pEnt);
+	void EndEntityTick();
+	void QueryEntityGrid(int Type, vec2 Min, vec2 Max);
 };
 
 class CCharOrder
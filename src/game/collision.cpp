@@ -146,6 +146,19 @@ void CCollision::Init(class CLayers *pLayers)
 			}
 		}
 	}
+
+	for(auto &vTilePlane : m_avTilePlanes)
+		vTilePlane.assign(((size_t)m_Width * m_Height + 63) / 64, 0);
+	for(int i = 0; i < m_Width * m_Height; i++)
+		UpdateTilePlanes(i);
+
+	m_RayBlocksWidth = (m_Width + RAY_BLOCK_SIZE - 1) / RAY_BLOCK_SIZE;
+	const int RayBlocksHeight = (m_Height + RAY_BLOCK_SIZE - 1) / RAY_BLOCK_SIZE;
+	m_vRayBlockers.assign((size_t)m_RayBlocksWidth * RayBlocksHeight, 0);
+	for(int y = 0; y < m_Height; y++)
+		for(int x = 0; x < m_Width; x++)
+			if(IsRayBlocker(y * m_Width + x))
+				m_vRayBlockers[(y >> RAY_BLOCK_SHIFT) * m_RayBlocksWidth + (x >> RAY_BLOCK_SHIFT)]++;
 }
 
 void CCollision::Unload()
@@ -169,6 +182,110 @@ void CCollision::Unload()
 	m_pTune = nullptr;
 	delete[] m_pDoor;
 	m_pDoor = nullptr;
+
+	for(auto &vTilePlane : m_avTilePlanes)
+		vTilePlane.clear();
+
+	m_vRayBlockers.clear();
+	m_RayBlocksWidth = 0;
+}
+
+void CCollision::SetTilePlane(int Plane, int Index, bool Value)
+{
+	const uint64_t Bit = (uint64_t)1 << (Index & 63);
+	if(Value)
+		m_avTilePlanes[Plane][Index >> 6] |= Bit;
+	else
+		m_avTilePlanes[Plane][Index >> 6] &= ~Bit;
+}
+
+void CCollision::UpdateTilePlanes(int Index)
+{
+	const int GameIndex = m_pTiles[Index].m_Index;
+	const int FrontIndex = m_pFront ? m_pFront[Index].m_Index : (int)TILE_AIR;
+
+	SetTilePlane(TILEPLANE_SOLID, Index, GameIndex == TILE_SOLID || GameIndex == TILE_NOHOOK);
+	SetTilePlane(TILEPLANE_THROUGH, Index,
+		GameIndex == TILE_THROUGH || GameIndex == TILE_THROUGH_ALL || GameIndex == TILE_THROUGH_DIR ||
+			FrontIndex == TILE_THROUGH || FrontIndex == TILE_THROUGH_CUT || FrontIndex == TILE_THROUGH_ALL || FrontIndex == TILE_THROUGH_DIR);
+	SetTilePlane(TILEPLANE_STOPPER, Index,
+		GameIndex == TILE_STOP || GameIndex == TILE_STOPS || GameIndex == TILE_STOPA ||
+			FrontIndex == TILE_STOP || FrontIndex == TILE_STOPS || FrontIndex == TILE_STOPA);
+	SetTilePlane(TILEPLANE_TELE, Index, m_pTele && m_pTele[Index].m_Type);
+	SetTilePlane(TILEPLANE_SWITCH, Index, m_pSwitch && m_pSwitch[Index].m_Type > 0);
+
+	bool Exists = (GameIndex >= TILE_FREEZE && GameIndex <= TILE_TELE_LASER_DISABLE) || (GameIndex >= TILE_LFREEZE && GameIndex <= TILE_LUNFREEZE) ||
+		      (FrontIndex >= TILE_FREEZE && FrontIndex <= TILE_TELE_LASER_DISABLE) || (FrontIndex >= TILE_LFREEZE && FrontIndex <= TILE_LUNFREEZE);
+	if(m_pTele && (m_pTele[Index].m_Type == TILE_TELEIN || m_pTele[Index].m_Type == TILE_TELEINEVIL || m_pTele[Index].m_Type == TILE_TELECHECKINEVIL || m_pTele[Index].m_Type == TILE_TELECHECK || m_pTele[Index].m_Type == TILE_TELECHECKIN))
+		Exists = true;
+	if(m_pSpeedup && m_pSpeedup[Index].m_Force > 0)
+		Exists = true;
+	if(m_pSwitch && m_pSwitch[Index].m_Type)
+		Exists = true;
+	if(m_pTune && m_pTune[Index].m_Type)
+		Exists = true;
+	SetTilePlane(TILEPLANE_EXISTS, Index, Exists || TileExistsNext(Index, true, false));
+}
+
+bool CCollision::IsRayBlocker(int Index) const
+{
+	// everything the checks of the Intersect* functions except IntersectAir react to
+	const int GameIndex = m_pTiles[Index].m_Index;
+	if((GameIndex >= TILE_SOLID && GameIndex <= TILE_NOLASER) || GameIndex == TILE_THROUGH_ALL || GameIndex == TILE_THROUGH_DIR)
+		return true;
+	if(m_pFront)
+	{
+		const int FrontIndex = m_pFront[Index].m_Index;
+		if(FrontIndex == TILE_NOLASER || FrontIndex == TILE_THROUGH_ALL || FrontIndex == TILE_THROUGH_DIR)
+			return true;
+	}
+	return m_pTele && m_pTele[Index].m_Type;
+}
+
+int CCollision::RayBlockIndex(vec2 Pos) const
+{
+	const int Nx = std::clamp(round_to_int(Pos.x) / 32, 0, m_Width - 1);
+	const int Ny = std::clamp(round_to_int(Pos.y) / 32, 0, m_Height - 1);
+	return (Ny >> RAY_BLOCK_SHIFT) * m_RayBlocksWidth + (Nx >> RAY_BLOCK_SHIFT);
+}
+
+// Returns the first ray sample from Sample to End that lies in a block with
+// tiles that can stop the ray, or End + 1 if there is none. GetSample has to
+// compute the sample positions exactly like the caller does. The tile
+// coordinates of the samples are monotonic along the ray, so all samples in
+// one block are consecutive and the end of the run can be searched for.
+template<typename TSample>
+int CCollision::SkipRayEmptyBlocks(int Sample, int End, TSample &&GetSample) const
+{
+	if(m_vRayBlockers.empty())
+		return Sample;
+
+	while(Sample <= End)
+	{
+		const int Block = RayBlockIndex(GetSample(Sample));
+		if(m_vRayBlockers[Block])
+			return Sample;
+
+		// gallop to the end of the run of samples in this block, then bisect
+		int Inside = Sample;
+		int Step = 1;
+		while(Inside + Step <= End && RayBlockIndex(GetSample(Inside + Step)) == Block)
+		{
+			Inside += Step;
+			Step *= 2;
+		}
+		int Outside = std::min(Inside + Step, End + 1);
+		while(Outside - Inside > 1)
+		{
+			const int Middle = Inside + (Outside - Inside) / 2;
+			if(RayBlockIndex(GetSample(Middle)) == Block)
+				Inside = Middle;
+			else
+				Outside = Middle;
+		}
+		Sample = Outside;
+	}
+	return Sample;
 }
 
 void CCollision::FillAntibot(CAntibotMapData *pMapData) const
@@ -282,7 +399,7 @@ int CCollision::GetMoveRestrictions(CALLBACK_SWITCHACTIVE pfnSwitchActive, void
 		{
 			ModMapIndex = OverrideCenterTileIndex;
 		}
-		for(int Front = 0; Front < 2; Front++)
+		for(int Front = 0; Front < 2 && TilePlane(TILEPLANE_STOPPER, ModMapIndex); Front++)
 		{
 			int Tile;
 			int Flags;
@@ -332,8 +449,18 @@ int CCollision::IntersectLine(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *p
 	float Distance = distance(Pos0, Pos1);
 	int End(Distance + 1);
 	vec2 Last = Pos0;
+	const auto GetSample = [&](int i) { return mix(Pos0, Pos1, i / (float)End); };
 	for(int i = 0; i <= End; i++)
 	{
+		const int Next = SkipRayEmptyBlocks(i, End, GetSample);
+		if(Next > End)
+			break;
+		if(Next != i)
+		{
+			Last = GetSample(Next - 1);
+			i = Next;
+		}
+
 		float a = i / (float)End;
 		vec2 Pos = mix(Pos0, Pos1, a);
 		// Temporary position for checking collision
@@ -365,8 +492,21 @@ int CCollision::IntersectLineTeleHook(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision,
 	vec2 Last = Pos0;
 	int dx = 0, dy = 0; // Offset for checking the "through" tile
 	ThroughOffset(Pos0, Pos1, &dx, &dy);
+	const auto GetSample = [&](int i) { return mix(Pos0, Pos1, i / (float)End); };
 	for(int i = 0; i <= End; i++)
 	{
+		const int Next = SkipRayEmptyBlocks(i, End, GetSample);
+		if(Next != i)
+		{
+			// skipped samples have no teleporter
+			if(pTeleNr)
+				*pTeleNr = 0;
+			if(Next > End)
+				break;
+			Last = GetSample(Next - 1);
+			i = Next;
+		}
+
 		float a = i / (float)End;
 		vec2 Pos = mix(Pos0, Pos1, a);
 		// Temporary position for checking collision
@@ -423,8 +563,21 @@ int CCollision::IntersectLineTeleWeapon(vec2 Pos0, vec2 Pos1, vec2 *pOutCollisio
 	float Distance = distance(Pos0, Pos1);
 	int End(Distance + 1);
 	vec2 Last = Pos0;
+	const auto GetSample = [&](int i) { return mix(Pos0, Pos1, i / (float)End); };
 	for(int i = 0; i <= End; i++)
 	{
+		const int Next = SkipRayEmptyBlocks(i, End, GetSample);
+		if(Next != i)
+		{
+			// skipped samples have no teleporter
+			if(pTeleNr)
+				*pTeleNr = 0;
+			if(Next > End)
+				break;
+			Last = GetSample(Next - 1);
+			i = Next;
+		}
+
 		float a = i / (float)End;
 		vec2 Pos = mix(Pos0, Pos1, a);
 		// Temporary position for checking collision
@@ -598,24 +751,32 @@ void CCollision::MoveBox(vec2 *pInoutPos, vec2 *pInoutVel, vec2 Size, vec2 Elast
 
 int CCollision::IsSolid(int x, int y) const
 {
-	int index = GetTile(x, y);
-	return index == TILE_SOLID || index == TILE_NOHOOK;
+	if(!m_pTiles)
+		return 0;
+
+	int Nx = std::clamp(x / 32, 0, m_Width - 1);
+	int Ny = std::clamp(y / 32, 0, m_Height - 1);
+	return TilePlane(TILEPLANE_SOLID, Ny * m_Width + Nx);
 }
 
 bool CCollision::IsThrough(int x, int y, int OffsetX, int OffsetY, vec2 Pos0, vec2 Pos1) const
 {
 	int pos = GetPureMapIndex(x, y);
+	int offpos = GetPureMapIndex(x + OffsetX, y + OffsetY);
+	if(!TilePlane(TILEPLANE_THROUGH, pos) && !TilePlane(TILEPLANE_THROUGH, offpos))
+		return false;
 	if(m_pFront && (m_pFront[pos].m_Index == TILE_THROUGH_ALL || m_pFront[pos].m_Index == TILE_THROUGH_CUT))
 		return true;
 	if(m_pFront && m_pFront[pos].m_Index == TILE_THROUGH_DIR && ((m_pFront[pos].m_Flags == ROTATION_0 && Pos0.y > Pos1.y) || (m_pFront[pos].m_Flags == ROTATION_90 && Pos0.x < Pos1.x) || (m_pFront[pos].m_Flags == ROTATION_180 && Pos0.y < Pos1.y) || (m_pFront[pos].m_Flags == ROTATION_270 && Pos0.x > Pos1.x)))
 		return true;
-	int offpos = GetPureMapIndex(x + OffsetX, y + OffsetY);
 	return m_pTiles[offpos].m_Index == TILE_THROUGH || (m_pFront && m_pFront[offpos].m_Index == TILE_THROUGH);
 }
 
 bool CCollision::IsHookBlocker(int x, int y, vec2 Pos0, vec2 Pos1) const
 {
 	int pos = GetPureMapIndex(x, y);
+	if(!TilePlane(TILEPLANE_THROUGH, pos))
+		return false;
 	if(m_pTiles[pos].m_Index == TILE_THROUGH_ALL || (m_pFront && m_pFront[pos].m_Index == TILE_THROUGH_ALL))
 		return true;
 	if(m_pTiles[pos].m_Index == TILE_THROUGH_DIR && ((m_pTiles[pos].m_Flags == ROTATION_0 && Pos0.y < Pos1.y) ||
@@ -648,7 +809,7 @@ int CCollision::IsFrontNoLaser(int x, int y) const
 
 int CCollision::IsTeleport(int Index) const
 {
-	if(Index < 0 || !m_pTele)
+	if(Index < 0 || !m_pTele || !TilePlane(TILEPLANE_TELE, Index))
 		return 0;
 
 	if(m_pTele[Index].m_Type == TILE_TELEIN)
@@ -700,7 +861,7 @@ int CCollision::IsTeleCheckpoint(int Index) const
 
 int CCollision::IsTeleportWeapon(int Index) const
 {
-	if(Index < 0 || !m_pTele)
+	if(Index < 0 || !m_pTele || !TilePlane(TILEPLANE_TELE, Index))
 		return 0;
 
 	if(m_pTele[Index].m_Type == TILE_TELEINWEAPON)
@@ -711,7 +872,7 @@ int CCollision::IsTeleportWeapon(int Index) const
 
 int CCollision::IsTeleportHook(int Index) const
 {
-	if(Index < 0 || !m_pTele)
+	if(Index < 0 || !m_pTele || !TilePlane(TILEPLANE_TELE, Index))
 		return 0;
 
 	if(m_pTele[Index].m_Type == TILE_TELEINHOOK)
@@ -756,7 +917,7 @@ void CCollision::GetSpeedup(int Index, vec2 *pDir, int *pForce, int *pMaxSpeed,
 
 int CCollision::GetSwitchType(int Index) const
 {
-	if(Index < 0 || !m_pSwitch)
+	if(Index < 0 || !m_pSwitch || !TilePlane(TILEPLANE_SWITCH, Index))
 		return 0;
 
 	if(m_pSwitch[Index].m_Type > 0)
@@ -767,7 +928,7 @@ int CCollision::GetSwitchType(int Index) const
 
 int CCollision::GetSwitchNumber(int Index) const
 {
-	if(Index < 0 || !m_pSwitch)
+	if(Index < 0 || !m_pSwitch || !TilePlane(TILEPLANE_SWITCH, Index))
 		return 0;
 
 	if(m_pSwitch[Index].m_Type > 0 && m_pSwitch[Index].m_Number > 0)
@@ -778,7 +939,7 @@ int CCollision::GetSwitchNumber(int Index) const
 
 int CCollision::GetSwitchDelay(int Index) const
 {
-	if(Index < 0 || !m_pSwitch)
+	if(Index < 0 || !m_pSwitch || !TilePlane(TILEPLANE_SWITCH, Index))
 		return 0;
 
 	if(m_pSwitch[Index].m_Type > 0)
@@ -841,24 +1002,20 @@ bool CCollision::TileExists(int Index) const
 	if(Index < 0)
 		return false;
 
-	if((m_pTiles[Index].m_Index >= TILE_FREEZE && m_pTiles[Index].m_Index <= TILE_TELE_LASER_DISABLE) || (m_pTiles[Index].m_Index >= TILE_LFREEZE && m_pTiles[Index].m_Index <= TILE_LUNFREEZE))
-		return true;
-	if(m_pFront && ((m_pFront[Index].m_Index >= TILE_FREEZE && m_pFront[Index].m_Index <= TILE_TELE_LASER_DISABLE) || (m_pFront[Index].m_Index >= TILE_LFREEZE && m_pFront[Index].m_Index <= TILE_LUNFREEZE)))
-		return true;
-	if(m_pTele && (m_pTele[Index].m_Type == TILE_TELEIN || m_pTele[Index].m_Type == TILE_TELEINEVIL || m_pTele[Index].m_Type == TILE_TELECHECKINEVIL || m_pTele[Index].m_Type == TILE_TELECHECK || m_pTele[Index].m_Type == TILE_TELECHECKIN))
-		return true;
-	if(m_pSpeedup && m_pSpeedup[Index].m_Force > 0)
+	// everything but the doors, which can change at any time
+	if(TilePlane(TILEPLANE_EXISTS, Index))
 		return true;
 	if(m_pDoor && m_pDoor[Index].m_Index)
 		return true;
-	if(m_pSwitch && m_pSwitch[Index].m_Type)
-		return true;
-	if(m_pTune && m_pTune[Index].m_Type)
-		return true;
-	return TileExistsNext(Index);
+	return TileExistsNext(Index, false, true);
 }
 
 bool CCollision::TileExistsNext(int Index) const
+{
+	return TileExistsNext(Index, true, true);
+}
+
+bool CCollision::TileExistsNext(int Index, bool Layers, bool Doors) const
 {
 	if(Index < 0)
 		return false;
@@ -867,26 +1024,29 @@ bool CCollision::TileExistsNext(int Index) const
 	int TileBelow = (Index + m_Width < m_Width * m_Height) ? Index + m_Width : Index;
 	int TileAbove = (Index - m_Width > 0) ? Index - m_Width : Index;
 
-	if((m_pTiles[TileOnTheRight].m_Index == TILE_STOP && m_pTiles[TileOnTheRight].m_Flags == ROTATION_270) || (m_pTiles[TileOnTheLeft].m_Index == TILE_STOP && m_pTiles[TileOnTheLeft].m_Flags == ROTATION_90))
-		return true;
-	if((m_pTiles[TileBelow].m_Index == TILE_STOP && m_pTiles[TileBelow].m_Flags == ROTATION_0) || (m_pTiles[TileAbove].m_Index == TILE_STOP && m_pTiles[TileAbove].m_Flags == ROTATION_180))
-		return true;
-	if(m_pTiles[TileOnTheRight].m_Index == TILE_STOPA || m_pTiles[TileOnTheLeft].m_Index == TILE_STOPA || ((m_pTiles[TileOnTheRight].m_Index == TILE_STOPS || m_pTiles[TileOnTheLeft].m_Index == TILE_STOPS)))
-		return true;
-	if(m_pTiles[TileBelow].m_Index == TILE_STOPA || m_pTiles[TileAbove].m_Index == TILE_STOPA || ((m_pTiles[TileBelow].m_Index == TILE_STOPS || m_pTiles[TileAbove].m_Index == TILE_STOPS) && m_pTiles[TileBelow].m_Flags | ROTATION_180 | ROTATION_0))
-		return true;
-	if(m_pFront)
+	if(Layers)
 	{
-		if(m_pFront[TileOnTheRight].m_Index == TILE_STOPA || m_pFront[TileOnTheLeft].m_Index == TILE_STOPA || ((m_pFront[TileOnTheRight].m_Index == TILE_STOPS || m_pFront[TileOnTheLeft].m_Index == TILE_STOPS)))
+		if((m_pTiles[TileOnTheRight].m_Index == TILE_STOP && m_pTiles[TileOnTheRight].m_Flags == ROTATION_270) || (m_pTiles[TileOnTheLeft].m_Index == TILE_STOP && m_pTiles[TileOnTheLeft].m_Flags == ROTATION_90))
 			return true;
-		if(m_pFront[TileBelow].m_Index == TILE_STOPA || m_pFront[TileAbove].m_Index == TILE_STOPA || ((m_pFront[TileBelow].m_Index == TILE_STOPS || m_pFront[TileAbove].m_Index == TILE_STOPS) && m_pFront[TileBelow].m_Flags | ROTATION_180 | ROTATION_0))
+		if((m_pTiles[TileBelow].m_Index == TILE_STOP && m_pTiles[TileBelow].m_Flags == ROTATION_0) || (m_pTiles[TileAbove].m_Index == TILE_STOP && m_pTiles[TileAbove].m_Flags == ROTATION_180))
 			return true;
-		if((m_pFront[TileOnTheRight].m_Index == TILE_STOP && m_pFront[TileOnTheRight].m_Flags == ROTATION_270) || (m_pFront[TileOnTheLeft].m_Index == TILE_STOP && m_pFront[TileOnTheLeft].m_Flags == ROTATION_90))
+		if(m_pTiles[TileOnTheRight].m_Index == TILE_STOPA || m_pTiles[TileOnTheLeft].m_Index == TILE_STOPA || ((m_pTiles[TileOnTheRight].m_Index == TILE_STOPS || m_pTiles[TileOnTheLeft].m_Index == TILE_STOPS)))
 			return true;
-		if((m_pFront[TileBelow].m_Index == TILE_STOP && m_pFront[TileBelow].m_Flags == ROTATION_0) || (m_pFront[TileAbove].m_Index == TILE_STOP && m_pFront[TileAbove].m_Flags == ROTATION_180))
+		if(m_pTiles[TileBelow].m_Index == TILE_STOPA || m_pTiles[TileAbove].m_Index == TILE_STOPA || ((m_pTiles[TileBelow].m_Index == TILE_STOPS || m_pTiles[TileAbove].m_Index == TILE_STOPS) && m_pTiles[TileBelow].m_Flags | ROTATION_180 | ROTATION_0))
 			return true;
+		if(m_pFront)
+		{
+			if(m_pFront[TileOnTheRight].m_Index == TILE_STOPA || m_pFront[TileOnTheLeft].m_Index == TILE_STOPA || ((m_pFront[TileOnTheRight].m_Index == TILE_STOPS || m_pFront[TileOnTheLeft].m_Index == TILE_STOPS)))
+				return true;
+			if(m_pFront[TileBelow].m_Index == TILE_STOPA || m_pFront[TileAbove].m_Index == TILE_STOPA || ((m_pFront[TileBelow].m_Index == TILE_STOPS || m_pFront[TileAbove].m_Index == TILE_STOPS) && m_pFront[TileBelow].m_Flags | ROTATION_180 | ROTATION_0))
+				return true;
+			if((m_pFront[TileOnTheRight].m_Index == TILE_STOP && m_pFront[TileOnTheRight].m_Flags == ROTATION_270) || (m_pFront[TileOnTheLeft].m_Index == TILE_STOP && m_pFront[TileOnTheLeft].m_Flags == ROTATION_90))
+				return true;
+			if((m_pFront[TileBelow].m_Index == TILE_STOP && m_pFront[TileBelow].m_Flags == ROTATION_0) || (m_pFront[TileAbove].m_Index == TILE_STOP && m_pFront[TileAbove].m_Flags == ROTATION_180))
+				return true;
+		}
 	}
-	if(m_pDoor)
+	if(Doors && m_pDoor)
 	{
 		if(m_pDoor[TileOnTheRight].m_Index == TILE_STOPA || m_pDoor[TileOnTheLeft].m_Index == TILE_STOPA || ((m_pDoor[TileOnTheRight].m_Index == TILE_STOPS || m_pDoor[TileOnTheLeft].m_Index == TILE_STOPS)))
 			return true;
@@ -1078,8 +1238,24 @@ void CCollision::SetCollisionAt(float x, float y, int Index)
 {
 	int Nx = std::clamp(round_to_int(x) / 32, 0, m_Width - 1);
 	int Ny = std::clamp(round_to_int(y) / 32, 0, m_Height - 1);
+	const int TileIndex = Ny * m_Width + Nx;
+
+	const bool WasRayBlocker = IsRayBlocker(TileIndex);
+	m_pTiles[TileIndex].m_Index = Index;
+	const bool IsNowRayBlocker = IsRayBlocker(TileIndex);
+	if(WasRayBlocker != IsNowRayBlocker && !m_vRayBlockers.empty())
+	{
+		unsigned char &Count = m_vRayBlockers[(Ny >> RAY_BLOCK_SHIFT) * m_RayBlocksWidth + (Nx >> RAY_BLOCK_SHIFT)];
+		if(IsNowRayBlocker)
+			Count++;
+		else
+			Count--;
+	}
 
-	m_pTiles[Ny * m_Width + Nx].m_Index = Index;
+	// TileExists of the neighbours depends on this tile as well
+	for(int Neighbour : {TileIndex, TileIndex - 1, TileIndex + 1, TileIndex - m_Width, TileIndex + m_Width})
+		if(Neighbour >= 0 && Neighbour < m_Width * m_Height)
+			UpdateTilePlanes(Neighbour);
 }
 
 void CCollision::SetDoorCollisionAt(float x, float y, int Type, int Flags, int Number)
@@ -1143,8 +1319,18 @@ int CCollision::IntersectNoLaser(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2
 	float d = distance(Pos0, Pos1);
 	vec2 Last = Pos0;
 
+	const auto GetSample = [&](int i) { return mix(Pos0, Pos1, i / d); };
 	for(int i = 0, id = std::ceil(d); i < id; i++)
 	{
+		const int Next = SkipRayEmptyBlocks(i, id - 1, GetSample);
+		if(Next >= id)
+			break;
+		if(Next != i)
+		{
+			Last = GetSample(Next - 1);
+			i = Next;
+		}
+
 		float a = i / d;
 		vec2 Pos = mix(Pos0, Pos1, a);
 		int Nx = std::clamp(round_to_int(Pos.x) / 32, 0, m_Width - 1);
@@ -1174,8 +1360,18 @@ int CCollision::IntersectNoLaserNoWalls(vec2 Pos0, vec2 Pos1, vec2 *pOutCollisio
 	float d = distance(Pos0, Pos1);
 	vec2 Last = Pos0;
 
+	const auto GetSample = [&](int i) { return mix(Pos0, Pos1, (float)i / d); };
 	for(int i = 0, id = std::ceil(d); i < id; i++)
 	{
+		const int Next = SkipRayEmptyBlocks(i, id - 1, GetSample);
+		if(Next >= id)
+			break;
+		if(Next != i)
+		{
+			Last = GetSample(Next - 1);
+			i = Next;
+		}
+
 		float a = (float)i / d;
 		vec2 Pos = mix(Pos0, Pos1, a);
 		if(IsNoLaser(round_to_int(Pos.x), round_to_int(Pos.y)) || IsFrontNoLaser(round_to_int(Pos.x), round_to_int(Pos.y)))
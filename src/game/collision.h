@@ -6,6 +6,7 @@
 #include <base/vmath.h>
 #include <engine/shared/protocol.h>
 
+#include <cstdint>
 #include <map>
 #include <vector>
 
@@ -157,6 +158,41 @@ private:
 	CTuneTile *m_pTune;
 	CDoorTile *m_pDoor;
 
+	// number of tiles that can stop a ray of the Intersect* functions per
+	// block of RAY_BLOCK_SIZE x RAY_BLOCK_SIZE tiles, rays skip over blocks
+	// without any of them
+	enum
+	{
+		RAY_BLOCK_SHIFT = 3,
+		RAY_BLOCK_SIZE = 1 << RAY_BLOCK_SHIFT,
+	};
+	std::vector<unsigned char> m_vRayBlockers;
+	int m_RayBlocksWidth;
+
+	// one bit per tile for the properties the hot lookups check first, so
+	// they don't have to touch the tile arrays of several layers
+	enum
+	{
+		TILEPLANE_SOLID = 0, // solid or nohook in the game layer
+		TILEPLANE_THROUGH, // any hook-through tile in the game or front layer
+		TILEPLANE_STOPPER, // any stopper in the game or front layer
+		TILEPLANE_EXISTS, // TileExists without the doors
+		TILEPLANE_TELE, // any teleporter
+		TILEPLANE_SWITCH, // any switch
+		NUM_TILEPLANES
+	};
+	std::vector<uint64_t> m_avTilePlanes[NUM_TILEPLANES];
+
+	bool TilePlane(int Plane, int Index) const { return (m_avTilePlanes[Plane][Index >> 6] >> (Index & 63)) & 1; }
+	void SetTilePlane(int Plane, int Index, bool Value);
+	void UpdateTilePlanes(int Index);
+	bool TileExistsNext(int Index, bool Layers, bool Doors) const;
+
+	bool IsRayBlocker(int Index) const;
+	int RayBlockIndex(vec2 Pos) const;
+	template<typename TSample>
+	int SkipRayEmptyBlocks(int Sample, int End, TSample &&GetSample) const;
+
 	// TILE_TELEIN
 	std::map<int, std::vector<vec2>> m_TeleIns;
 	// TILE_TELEOUT
@@ -0,0 +1,232 @@
+#ifndef GAME_ENTITY_GRID_H
+#define GAME_ENTITY_GRID_H
+
+#include <base/vmath.h>
+
+#include <algorithm>
+#include <bitset>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+/*
+	Class: Entity Grid
+		Spatial hash of the entities of a game world, used to narrow down
+		proximity and line queries to the entities near the queried area.
+
+		Entities are binned into square cells per entity type, the cells
+		are hashed into a fixed number of buckets so the grid needs to know
+		nothing about the map. Every bucket is an intrusive list of the nodes
+		embedded in the entities.
+
+		Query returns the candidates in the order of the entity type lists
+		of the game world, so callers that apply the same exact checks as a
+		full list traversal get the same results.
+*/
+template<typename TEntity>
+class CEntityGrid
+{
+public:
+	static constexpr float CELL_SIZE = 256.0f;
+	static constexpr int NUM_BUCKETS = 256;
+	// positions are clamped to this many cells in each direction
+	static constexpr float MAX_CELL = 1 << 20;
+
+	class CNode
+	{
+		friend CEntityGrid;
+
+		TEntity *m_pEntity = nullptr;
+		CNode *m_pPrev = nullptr;
+		CNode *m_pNext = nullptr;
+		int m_Type = -1;
+		int m_Bucket = -1;
+		int m_CellX = 0;
+		int m_CellY = 0;
+		// position of the entity in its type list, higher is earlier
+		int64_t m_Order = 0;
+
+	public:
+		bool InGrid() const { return m_Bucket >= 0; }
+	};
+
+	explicit CEntityGrid(int NumTypes) :
+		m_vpBuckets(NumTypes * NUM_BUCKETS, nullptr),
+		m_vMaxRadius(NumTypes, 0.0f)
+	{
+	}
+
+	/*
+		Function: Insert
+			Adds an entity to the grid.
+
+		Arguments:
+			Node - Grid node of the entity.
+			pEntity - Entity the node belongs to.
+			Type - Entity type.
+			Pos - Current position of the entity.
+			Radius - Proximity radius of the entity.
+			Last - Whether the entity was added to the end of its type list
+				instead of the front.
+	*/
+	void Insert(CNode &Node, TEntity *pEntity, int Type, vec2 Pos, float Radius, bool Last = false)
+	{
+		Node.m_pEntity = pEntity;
+		Node.m_Type = Type;
+		Node.m_Order = Last ? --m_BackOrder : ++m_FrontOrder;
+		Node.m_CellX = CellCoord(Pos.x);
+		Node.m_CellY = CellCoord(Pos.y);
+		Link(Node);
+		m_vMaxRadius[Type] = std::max(m_vMaxRadius[Type], Radius);
+	}
+
+	void Remove(CNode &Node)
+	{
+		if(!Node.InGrid())
+			return;
+		Unlink(Node);
+	}
+
+	/*
+		Function: Update
+			Moves an entity to the cell of its new position, cheap if the
+			entity stayed within its cell.
+	*/
+	void Update(CNode &Node, vec2 Pos)
+	{
+		if(!Node.InGrid())
+			return;
+		const int CellX = CellCoord(Pos.x);
+		const int CellY = CellCoord(Pos.y);
+		if(CellX == Node.m_CellX && CellY == Node.m_CellY)
+			return;
+		Unlink(Node);
+		Node.m_CellX = CellX;
+		Node.m_CellY = CellY;
+		Link(Node);
+	}
+
+	// largest proximity radius of all entities of a type ever inserted
+	float MaxRadius(int Type) const { return m_vMaxRadius[Type]; }
+
+	/*
+		Function: Query
+			Finds all entities of a type whose cell overlaps a rectangle.
+
+		Arguments:
+			Type - Entity type.
+			Min - Top left corner of the rectangle.
+			Max - Bottom right corner of the rectangle.
+			vpResult - Filled with the candidates in type list order.
+	*/
+	void Query(int Type, vec2 Min, vec2 Max, std::vector<TEntity *> &vpResult)
+	{
+		vpResult.clear();
+		m_vpQueryNodes.clear();
+
+		CNode *const *ppBuckets = &m_vpBuckets[Type * NUM_BUCKETS];
+		if(std::isnan(Min.x) || std::isnan(Min.y) || std::isnan(Max.x) || std::isnan(Max.y))
+		{
+			for(int b = 0; b < NUM_BUCKETS; b++)
+				for(CNode *pNode = ppBuckets[b]; pNode; pNode = pNode->m_pNext)
+					m_vpQueryNodes.push_back(pNode);
+		}
+		else
+		{
+			const int MinX = CellCoord(Min.x);
+			const int MinY = CellCoord(Min.y);
+			const int MaxX = CellCoord(Max.x);
+			const int MaxY = CellCoord(Max.y);
+			if(MinX > MaxX || MinY > MaxY)
+				return;
+
+			const int64_t NumCells = (int64_t)(MaxX - MinX + 1) * (MaxY - MinY + 1);
+			if(NumCells >= NUM_BUCKETS)
+			{
+				for(int b = 0; b < NUM_BUCKETS; b++)
+					CollectBucket(ppBuckets[b], MinX, MinY, MaxX, MaxY);
+			}
+			else
+			{
+				// several cells can hash to the same bucket, visit each once
+				std::bitset<NUM_BUCKETS> Visited;
+				for(int y = MinY; y <= MaxY; y++)
+				{
+					for(int x = MinX; x <= MaxX; x++)
+					{
+						const int Bucket = BucketIndex(x, y);
+						if(Visited.test(Bucket))
+							continue;
+						Visited.set(Bucket);
+						CollectBucket(ppBuckets[Bucket], MinX, MinY, MaxX, MaxY);
+					}
+				}
+			}
+		}
+
+		std::sort(m_vpQueryNodes.begin(), m_vpQueryNodes.end(), [](const CNode *pA, const CNode *pB) {
+			return pA->m_Order > pB->m_Order;
+		});
+		for(const CNode *pNode : m_vpQueryNodes)
+			vpResult.push_back(pNode->m_pEntity);
+	}
+
+private:
+	std::vector<CNode *> m_vpBuckets;
+	std::vector<float> m_vMaxRadius;
+	std::vector<CNode *> m_vpQueryNodes;
+	int64_t m_FrontOrder = 0;
+	int64_t m_BackOrder = 0;
+
+	static int CellCoord(float Value)
+	{
+		const float Cell = std::floor(Value / CELL_SIZE);
+		// NaN positions end up in cell 0, they never match a query anyway
+		if(!(Cell > -MAX_CELL))
+			return Cell <= -MAX_CELL ? -(int)MAX_CELL : 0;
+		if(Cell >= MAX_CELL)
+			return (int)MAX_CELL;
+		return (int)Cell;
+	}
+
+	static int BucketIndex(int CellX, int CellY)
+	{
+		const unsigned Hash = (unsigned)CellX * 73856093u ^ (unsigned)CellY * 19349663u;
+		return (Hash ^ (Hash >> 16)) & (NUM_BUCKETS - 1);
+	}
+
+	void Link(CNode &Node)
+	{
+		Node.m_Bucket = BucketIndex(Node.m_CellX, Node.m_CellY);
+		CNode *&pHead = m_vpBuckets[Node.m_Type * NUM_BUCKETS + Node.m_Bucket];
+		Node.m_pPrev = nullptr;
+		Node.m_pNext = pHead;
+		if(pHead)
+			pHead->m_pPrev = &Node;
+		pHead = &Node;
+	}
+
+	void Unlink(CNode &Node)
+	{
+		if(Node.m_pPrev)
+			Node.m_pPrev->m_pNext = Node.m_pNext;
+		else
+			m_vpBuckets[Node.m_Type * NUM_BUCKETS + Node.m_Bucket] = Node.m_pNext;
+		if(Node.m_pNext)
+			Node.m_pNext->m_pPrev = Node.m_pPrev;
+		Node.m_pPrev = nullptr;
+		Node.m_pNext = nullptr;
+		Node.m_Bucket = -1;
+	}
+
+	void CollectBucket(CNode *pNode, int MinX, int MinY, int MaxX, int MaxY)
+	{
+		for(; pNode; pNode = pNode->m_pNext)
+		{
+			if(pNode->m_CellX >= MinX && pNode->m_CellX <= MaxX && pNode->m_CellY >= MinY && pNode->m_CellY <= MaxY)
+				m_vpQueryNodes.push_back(pNode);
+		}
+	}
+};
+
+#endif
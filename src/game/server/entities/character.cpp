@@ -827,6 +827,12 @@ void CCharacter::Tick()
 }
 
 void CCharacter::TickDeferred()
+{
+	TickDeferredCore();
+	TickDeferredEvents();
+}
+
+void CCharacter::TickDeferredCore()
 {
 	// advance the dummy
 	{
@@ -839,18 +845,21 @@ void CCharacter::TickDeferred()
 	}
 
 	//lastsentcore
-	vec2 StartPos = m_Core.m_Pos;
-	vec2 StartVel = m_Core.m_Vel;
-	bool StuckBefore = Collision()->TestBox(m_Core.m_Pos, CCharacterCore::PhysicalSizeVec2());
+	m_DeferredStartPos = m_Core.m_Pos;
+	m_DeferredStartVel = m_Core.m_Vel;
+	m_DeferredStuckBefore = Collision()->TestBox(m_Core.m_Pos, CCharacterCore::PhysicalSizeVec2());
 
 	m_Core.m_Id = m_pPlayer->GetCid();
 	m_Core.Move();
-	bool StuckAfterMove = Collision()->TestBox(m_Core.m_Pos, CCharacterCore::PhysicalSizeVec2());
+	m_DeferredStuckAfterMove = Collision()->TestBox(m_Core.m_Pos, CCharacterCore::PhysicalSizeVec2());
 	m_Core.Quantize();
-	bool StuckAfterQuant = Collision()->TestBox(m_Core.m_Pos, CCharacterCore::PhysicalSizeVec2());
+	m_DeferredStuckAfterQuant = Collision()->TestBox(m_Core.m_Pos, CCharacterCore::PhysicalSizeVec2());
 	m_Pos = m_Core.m_Pos;
+}
 
-	if(!StuckBefore && (StuckAfterMove || StuckAfterQuant))
+void CCharacter::TickDeferredEvents()
+{
+	if(!m_DeferredStuckBefore && (m_DeferredStuckAfterMove || m_DeferredStuckAfterQuant))
 	{
 		// Hackish solution to get rid of strict-aliasing warning
 		union
@@ -859,18 +868,18 @@ void CCharacter::TickDeferred()
 			unsigned u;
 		} StartPosX, StartPosY, StartVelX, StartVelY;
 
-		StartPosX.f = StartPos.x;
-		StartPosY.f = StartPos.y;
-		StartVelX.f = StartVel.x;
-		StartVelY.f = StartVel.y;
+		StartPosX.f = m_DeferredStartPos.x;
+		StartPosY.f = m_DeferredStartPos.y;
+		StartVelX.f = m_DeferredStartVel.x;
+		StartVelY.f = m_DeferredStartVel.y;
 
 		char aBuf[256];
 		str_format(aBuf, sizeof(aBuf), "STUCK!!! %d %d %d %f %f %f %f %x %x %x %x",
-			StuckBefore,
-			StuckAfterMove,
-			StuckAfterQuant,
-			StartPos.x, StartPos.y,
-			StartVel.x, StartVel.y,
+			m_DeferredStuckBefore,
+			m_DeferredStuckAfterMove,
+			m_DeferredStuckAfterQuant,
+			m_DeferredStartPos.x, m_DeferredStartPos.y,
+			m_DeferredStartVel.x, m_DeferredStartVel.y,
 			StartPosX.u, StartPosY.u,
 			StartVelX.u, StartVelY.u);
 		GameServer()->Console()->Print(IConsole::OUTPUT_LEVEL_DEBUG, "game", aBuf);
@@ -40,6 +40,11 @@ public:
 	void PreTick();
 	void Tick() override;
 	void TickDeferred() override;
+	// TickDeferred in two steps: the first only moves this character and
+	// reads the characters it can collide with, so it may run concurrently
+	// for characters that can't collide. The second creates the events.
+	void TickDeferredCore();
+	void TickDeferredEvents();
 	void TickPaused() override;
 	void Snap(int SnappingClient) override;
 	void SwapClients(int Client1, int Client2) override;
@@ -165,6 +170,12 @@ private:
 	int m_ReckoningTick; // tick that we are performing dead reckoning From
 	CCharacterCore m_SendCore; // core that we should send
 	CCharacterCore m_ReckoningCore; // the dead reckoning core
+	// stuck check of TickDeferredCore, reported by TickDeferredEvents
+	vec2 m_DeferredStartPos;
+	vec2 m_DeferredStartVel;
+	bool m_DeferredStuckBefore;
+	bool m_DeferredStuckAfterMove;
+	bool m_DeferredStuckAfterQuant;
 
 	// DDRace
 
@@ -19,6 +19,7 @@ public:
 
 	void Reset() override;
 	void Snap(int SnappingClient) override;
+	bool GetSnapBounds(vec2 &Min, vec2 &Max) override;
 };
 
 #endif // GAME_SERVER_ENTITIES_DOOR_H
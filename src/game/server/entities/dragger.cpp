@@ -236,6 +236,12 @@ void CDragger::Snap(int SnappingClient)
 		m_Pos, m_Pos, StartTick, -1, LASERTYPE_DRAGGER, Subtype, m_Number);
 }
 
+bool CDragger::GetSnapBounds(vec2 &Min, vec2 &Max)
+{
+	Min = Max = m_Pos;
+	return true;
+}
+
 void CDragger::SwapClients(int Client1, int Client2)
 {
 	std::swap(m_apDraggerBeam[Client1], m_apDraggerBeam[Client2]);
@@ -174,3 +174,9 @@ void CGun::Snap(int SnappingClient)
 	GameServer()->SnapLaserObject(CSnapContext(SnappingClientVersion, Server()->IsSixup(SnappingClient), SnappingClient), GetId(),
 		m_Pos, m_Pos, StartTick, -1, LASERTYPE_GUN, Subtype, m_Number);
 }
+
+bool CGun::GetSnapBounds(vec2 &Min, vec2 &Max)
+{
+	Min = Max = m_Pos;
+	return true;
+}
@@ -319,6 +319,13 @@ void CLaser::Snap(int SnappingClient)
 		m_Pos, m_From, m_EvalTick, m_Owner, LaserType, 0, m_Number);
 }
 
+bool CLaser::GetSnapBounds(vec2 &Min, vec2 &Max)
+{
+	Min = vec2(minimum(m_Pos.x, m_From.x), minimum(m_Pos.y, m_From.y));
+	Max = vec2(maximum(m_Pos.x, m_From.x), maximum(m_Pos.y, m_From.y));
+	return true;
+}
+
 void CLaser::SwapClients(int Client1, int Client2)
 {
 	m_Owner = m_Owner == Client1 ? Client2 : m_Owner == Client2 ? Client1 : m_Owner;
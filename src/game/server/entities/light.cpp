@@ -140,3 +140,10 @@ void CLight::Snap(int SnappingClient)
 	GameServer()->SnapLaserObject(CSnapContext(SnappingClientVersion, Server()->IsSixup(SnappingClient), SnappingClient), GetId(),
 		m_Pos, From, StartTick, -1, LASERTYPE_FREEZE, 0, m_Number);
 }
+
+bool CLight::GetSnapBounds(vec2 &Min, vec2 &Max)
+{
+	Min = vec2(minimum(m_Pos.x, m_To.x), minimum(m_Pos.y, m_To.y));
+	Max = vec2(maximum(m_Pos.x, m_To.x), maximum(m_Pos.y, m_To.y));
+	return true;
+}
@@ -40,6 +40,7 @@ public:
 	void Reset() override;
 	void Tick() override;
 	void Snap(int SnappingClient) override;
+	bool GetSnapBounds(vec2 &Min, vec2 &Max) override;
 	void SwapClients(int Client1, int Client2) override;
 };
 
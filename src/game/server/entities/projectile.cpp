@@ -364,6 +364,13 @@ void CProjectile::Snap(int SnappingClient)
 	}
 }
 
+bool CProjectile::GetSnapBounds(vec2 &Min, vec2 &Max)
+{
+	float Ct = (Server()->Tick() - m_StartTick) / (float)Server()->TickSpeed();
+	Min = Max = GetPos(Ct);
+	return true;
+}
+
 void CProjectile::SwapClients(int Client1, int Client2)
 {
 	m_Owner = m_Owner == Client1 ? Client2 : m_Owner == Client2 ? Client1 : m_Owner;
@@ -29,6 +29,7 @@ public:
 	void Tick() override;
 	void TickPaused() override;
 	void Snap(int SnappingClient) override;
+	bool GetSnapBounds(vec2 &Min, vec2 &Max) override;
 	void SwapClients(int Client1, int Client2) override;
 
 private:
@@ -25,6 +25,7 @@ private:
 	friend CGameWorld; // entity list handling
 	CEntity *m_pPrevTypeEntity;
 	CEntity *m_pNextTypeEntity;
+	CEntityGrid<CEntity>::CNode m_GridNode;
 
 	/* Identity */
 	CGameWorld *m_pGameWorld;
@@ -123,6 +124,22 @@ public: // TODO: Maybe make protected
 	*/
 	virtual void Snap(int SnappingClient) {}
 
+	/*
+		Function: GetSnapBounds
+			Gets the area spanned by all positions that Snap checks with
+			NetworkClipped. The entity is not snapped for clients whose
+			view does not overlap this area.
+
+		Arguments:
+			Min - Receives the top left corner of the area.
+			Max - Receives the bottom right corner of the area.
+
+		Returns:
+			False if the entity has to be snapped regardless of the view
+			of the client.
+	*/
+	virtual bool GetSnapBounds(vec2 &Min, vec2 &Max) { return false; }
+
 	/*
 		Function: SwapClients
 			Called when two players have swapped their client ids.
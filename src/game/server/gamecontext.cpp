@@ -196,7 +196,10 @@ void CGameContext::Clear()
 void CGameContext::TeeHistorianWrite(const void *pData, int DataSize, void *pUser)
 {
 	CGameContext *pSelf = (CGameContext *)pUser;
-	aio_write(pSelf->m_pTeeHistorianFile, pData, DataSize);
+	if(pSelf->m_TeeHistorianCompressed.IsOpen())
+		pSelf->m_TeeHistorianCompressed.Write(pData, DataSize);
+	else
+		aio_write(pSelf->m_pTeeHistorianFile, pData, DataSize);
 }
 
 void CGameContext::CommandCallback(int ClientId, int FlagMask, const char *pCmd, IConsole::IResult *pResult, void *pUser)
@@ -1037,11 +1040,22 @@ void CGameContext::OnTick()
 
 	if(m_TeeHistorianActive)
 	{
-		int Error = aio_error(m_pTeeHistorianFile);
-		if(Error)
+		if(m_TeeHistorianCompressed.IsOpen())
 		{
-			dbg_msg("teehistorian", "error writing to file, err=%d", Error);
-			Server()->SetErrorShutdown("teehistorian io error");
+			if(m_TeeHistorianCompressed.Error())
+			{
+				dbg_msg("teehistorian", "error writing to compressed file");
+				Server()->SetErrorShutdown("teehistorian io error");
+			}
+		}
+		else
+		{
+			int Error = aio_error(m_pTeeHistorianFile);
+			if(Error)
+			{
+				dbg_msg("teehistorian", "error writing to file, err=%d", Error);
+				Server()->SetErrorShutdown("teehistorian io error");
+			}
 		}
 
 		if(!m_TeeHistorian.Starting())
@@ -1049,6 +1063,11 @@ void CGameContext::OnTick()
 			m_TeeHistorian.EndInputs();
 			m_TeeHistorian.EndTick();
 		}
+		if(m_TeeHistorianCompressed.IsOpen() && m_TeeHistorianCompressed.FrameDue(Server()->Tick()))
+		{
+			m_TeeHistorian.SerializeState(m_vTeeHistorianState);
+			m_TeeHistorianCompressed.BeginFrame(Server()->Tick(), m_vTeeHistorianState.data(), m_vTeeHistorianState.size());
+		}
 		m_TeeHistorian.BeginTick(Server()->Tick());
 		m_TeeHistorian.BeginPlayers();
 	}
@@ -4091,7 +4110,7 @@ void CGameContext::OnInit(const void *pPersistentData)
 		FormatUuid(m_GameUuid, aGameUuid, sizeof(aGameUuid));
 
 		char aFilename[IO_MAX_PATH_LENGTH];
-		str_format(aFilename, sizeof(aFilename), "teehistorian/%s.teehistorian", aGameUuid);
+		str_format(aFilename, sizeof(aFilename), "teehistorian/%s.teehistorian%s", aGameUuid, g_Config.m_SvTeeHistorianCompress ? ".z" : "");
 
 		IOHANDLE THFile = Storage()->OpenFile(aFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
 		if(!THFile)
@@ -4104,7 +4123,15 @@ void CGameContext::OnInit(const void *pPersistentData)
 		{
 			dbg_msg("teehistorian", "recording to '%s'", aFilename);
 		}
-		m_pTeeHistorianFile = aio_new(THFile);
+		if(g_Config.m_SvTeeHistorianCompress)
+		{
+			m_pTeeHistorianFile = nullptr;
+			m_TeeHistorianCompressed.Open(THFile, g_Config.m_SvTeeHistorianFrameInterval * Server()->TickSpeed());
+		}
+		else
+		{
+			m_pTeeHistorianFile = aio_new(THFile);
+		}
 
 		char aVersion[128];
 		if(GIT_SHORTREV_HASH)
@@ -4437,15 +4464,27 @@ void CGameContext::OnShutdown(void *pPersistentData)
 	if(m_TeeHistorianActive)
 	{
 		m_TeeHistorian.Finish();
-		aio_close(m_pTeeHistorianFile);
-		aio_wait(m_pTeeHistorianFile);
-		int Error = aio_error(m_pTeeHistorianFile);
-		if(Error)
+		if(m_TeeHistorianCompressed.IsOpen())
 		{
-			dbg_msg("teehistorian", "error closing file, err=%d", Error);
-			Server()->SetErrorShutdown("teehistorian close error");
+			m_TeeHistorianCompressed.Close();
+			if(m_TeeHistorianCompressed.Error())
+			{
+				dbg_msg("teehistorian", "error closing compressed file");
+				Server()->SetErrorShutdown("teehistorian close error");
+			}
+		}
+		else
+		{
+			aio_close(m_pTeeHistorianFile);
+			aio_wait(m_pTeeHistorianFile);
+			int Error = aio_error(m_pTeeHistorianFile);
+			if(Error)
+			{
+				dbg_msg("teehistorian", "error closing file, err=%d", Error);
+				Server()->SetErrorShutdown("teehistorian close error");
+			}
+			aio_free(m_pTeeHistorianFile);
 		}
-		aio_free(m_pTeeHistorianFile);
 	}
 
 	// Stop any demos being recorded.
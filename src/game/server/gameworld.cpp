@@ -6,16 +6,36 @@
 #include "entity.h"
 #include "gamecontext.h"
 #include "gamecontroller.h"
+#include "player.h"
 
 #include <engine/shared/config.h>
+#include <engine/shared/jobs.h>
+#include <engine/shared/profiler.h>
 
 #include <algorithm>
 #include <utility>
 
+static const char *const s_apProfileTickNames[CGameWorld::NUM_ENTTYPES] = {
+	"world/tick/projectile",
+	"world/tick/laser",
+	"world/tick/pickup",
+	"world/tick/flag",
+	"world/tick/character",
+};
+
+static const char *const s_apProfileSnapNames[CGameWorld::NUM_ENTTYPES] = {
+	"world/snap/projectile",
+	"world/snap/laser",
+	"world/snap/pickup",
+	"world/snap/flag",
+	"world/snap/character",
+};
+
 //////////////////////////////////////////////////
 // game world
 //////////////////////////////////////////////////
-CGameWorld::CGameWorld()
+CGameWorld::CGameWorld() :
+	m_EntityGrid(NUM_ENTTYPES)
 {
 	m_pGameServer = nullptr;
 	m_pConfig = nullptr;
@@ -25,10 +45,30 @@ CGameWorld::CGameWorld()
 	m_ResetRequested = false;
 	for(auto &pFirstEntityType : m_apFirstEntityTypes)
 		pFirstEntityType = nullptr;
+
+	m_SnapEntitiesMaxWidth = 0.0f;
+	m_SnapEntitiesTick = -1;
+
+	m_pTickingEntity = nullptr;
+	m_EntityGridInTick = false;
+
+	m_NumTickPartitions = 0;
+	m_NextTickPartition = 0;
+
+	for(int i = 0; i < NUM_ENTTYPES; i++)
+	{
+		m_aProfileTick[i] = g_Profiler.Section(s_apProfileTickNames[i]);
+		m_aProfileSnap[i] = g_Profiler.Section(s_apProfileSnapNames[i]);
+	}
+	m_ProfileTickDeferred = g_Profiler.Section("world/tick/deferred");
+	m_ProfileSnapVisible = g_Profiler.Section("world/snap/visible");
 }
 
 CGameWorld::~CGameWorld()
 {
+	if(m_pTickJobPool)
+		sphore_destroy(&m_TickJobsDone);
+
 	// delete all entities
 	for(auto &pFirstEntityType : m_apFirstEntityTypes)
 		while(pFirstEntityType)
@@ -40,6 +80,128 @@ void CGameWorld::SetGameServer(CGameContext *pGameServer)
 	m_pGameServer = pGameServer;
 	m_pConfig = m_pGameServer->Config();
 	m_pServer = m_pGameServer->Server();
+
+	if(!m_pTickJobPool)
+	{
+		m_pTickJobPool = m_pServer->WorldJobPool();
+		if(m_pTickJobPool)
+			sphore_init(&m_TickJobsDone);
+	}
+}
+
+class CWorldTickJob : public IJob
+{
+	CGameWorld *m_pWorld;
+	SEMAPHORE *m_pDone;
+
+	void Run() override
+	{
+		m_pWorld->RunTickWorker();
+		sphore_signal(m_pDone);
+	}
+
+public:
+	CWorldTickJob(CGameWorld *pWorld, SEMAPHORE *pDone) :
+		m_pWorld(pWorld), m_pDone(pDone)
+	{
+	}
+};
+
+void CGameWorld::RunTickWorker()
+{
+	for(int Index = m_NextTickPartition.fetch_add(1); Index < m_NumTickPartitions; Index = m_NextTickPartition.fetch_add(1))
+	{
+		for(CCharacter *pChr : m_vvTickPartitions[Index])
+			pChr->TickDeferredCore();
+	}
+}
+
+bool CGameWorld::PartitionCharacters()
+{
+	// characters only collide within their team, solo characters with nobody
+	// and super characters with everyone. Moving doesn't touch hooked
+	// characters, so the collision rules are all that matters here.
+	const CTeamsCore &TeamsCore = GameServer()->m_pController->Teams().m_Core;
+	const int SuperTeam = TeamsCore.m_IsDDRace16 ? VANILLA_TEAM_SUPER : TEAM_SUPER;
+	int aPartitionOfKey[(int)NUM_DDRACE_TEAMS + MAX_CLIENTS];
+	std::fill(std::begin(aPartitionOfKey), std::end(aPartitionOfKey), -1);
+
+	m_NumTickPartitions = 0;
+	for(CCharacter *pChr = (CCharacter *)FindFirst(ENTTYPE_CHARACTER); pChr; pChr = (CCharacter *)pChr->TypeNext())
+	{
+		const int ClientId = pChr->GetPlayer()->GetCid();
+		const int Team = TeamsCore.Team(ClientId);
+		if(Team == SuperTeam || pChr->Core()->m_Super)
+			return false;
+
+		const int Key = pChr->Core()->m_Solo || TeamsCore.GetSolo(ClientId) ? NUM_DDRACE_TEAMS + ClientId : Team;
+		if(aPartitionOfKey[Key] == -1)
+		{
+			aPartitionOfKey[Key] = m_NumTickPartitions++;
+			if((int)m_vvTickPartitions.size() < m_NumTickPartitions)
+				m_vvTickPartitions.emplace_back();
+			m_vvTickPartitions[aPartitionOfKey[Key]].clear();
+		}
+		m_vvTickPartitions[aPartitionOfKey[Key]].push_back(pChr);
+	}
+	if(m_NumTickPartitions < 2)
+		return false;
+
+	// start with the largest partitions, the workers pick up the small ones at the end
+	std::stable_sort(m_vvTickPartitions.begin(), m_vvTickPartitions.begin() + m_NumTickPartitions, [](const std::vector<CCharacter *> &vA, const std::vector<CCharacter *> &vB) {
+		return vA.size() > vB.size();
+	});
+	return true;
+}
+
+void CGameWorld::TickDeferred()
+{
+	if(!m_pTickJobPool || !PartitionCharacters())
+	{
+		for(auto *pEnt : m_apFirstEntityTypes)
+			for(; pEnt;)
+			{
+				m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
+				BeginEntityTick(pEnt);
+				pEnt->TickDeferred();
+				EndEntityTick();
+				pEnt = m_pNextTraverseEntity;
+			}
+		return;
+	}
+
+	for(int i = 0; i < NUM_ENTTYPES; i++)
+	{
+		if(i == ENTTYPE_CHARACTER)
+			continue;
+		for(CEntity *pEnt = m_apFirstEntityTypes[i]; pEnt;)
+		{
+			m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
+			BeginEntityTick(pEnt);
+			pEnt->TickDeferred();
+			EndEntityTick();
+			pEnt = m_pNextTraverseEntity;
+		}
+	}
+
+	m_NextTickPartition = 0;
+	const int NumJobs = minimum(m_pConfig->m_SvWorldThreads, m_NumTickPartitions - 1);
+	for(int i = 0; i < NumJobs; i++)
+		m_pTickJobPool->Add(std::make_shared<CWorldTickJob>(this, &m_TickJobsDone));
+	RunTickWorker();
+	for(int i = 0; i < NumJobs; i++)
+		sphore_wait(&m_TickJobsDone);
+
+	// the characters are only re-binned and create their events now, in
+	// the same order as without partitions
+	for(CEntity *pEnt = m_apFirstEntityTypes[ENTTYPE_CHARACTER]; pEnt;)
+	{
+		m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
+		BeginEntityTick(pEnt);
+		((CCharacter *)pEnt)->TickDeferredEvents();
+		EndEntityTick();
+		pEnt = m_pNextTraverseEntity;
+	}
 }
 
 CEntity *CGameWorld::FindFirst(int Type)
@@ -52,8 +214,11 @@ int CGameWorld::FindEntities(vec2 Pos, float Radius, CEntity **ppEnts, int Max,
 	if(Type < 0 || Type >= NUM_ENTTYPES)
 		return 0;
 
+	const float Range = Radius + m_EntityGrid.MaxRadius(Type) + 1.0f;
+	QueryEntityGrid(Type, Pos - vec2(Range, Range), Pos + vec2(Range, Range));
+
 	int Num = 0;
-	for(CEntity *pEnt = m_apFirstEntityTypes[Type]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+	for(CEntity *pEnt : m_vpGridCandidates)
 	{
 		if(distance(pEnt->m_Pos, Pos) < Radius + pEnt->m_ProximityRadius)
 		{
@@ -81,6 +246,10 @@ void CGameWorld::InsertEntity(CEntity *pEnt)
 	pEnt->m_pNextTypeEntity = m_apFirstEntityTypes[pEnt->m_ObjType];
 	pEnt->m_pPrevTypeEntity = nullptr;
 	m_apFirstEntityTypes[pEnt->m_ObjType] = pEnt;
+
+	m_EntityGrid.Insert(pEnt->m_GridNode, pEnt, pEnt->m_ObjType, pEnt->m_Pos, pEnt->m_ProximityRadius);
+
+	m_SnapEntitiesTick = -1;
 }
 
 void CGameWorld::RemoveEntity(CEntity *pEnt)
@@ -103,16 +272,126 @@ void CGameWorld::RemoveEntity(CEntity *pEnt)
 
 	pEnt->m_pNextTypeEntity = nullptr;
 	pEnt->m_pPrevTypeEntity = nullptr;
+
+	m_EntityGrid.Remove(pEnt->m_GridNode);
+	if(m_pTickingEntity == pEnt)
+		m_pTickingEntity = nullptr;
+
+	m_SnapEntitiesTick = -1;
+}
+
+void CGameWorld::UpdateEntityGrid(int Type)
+{
+	for(CEntity *pEnt = m_apFirstEntityTypes[Type]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+		m_EntityGrid.Update(pEnt->m_GridNode, pEnt->m_Pos);
+}
+
+void CGameWorld::BeginEntityTick(CEntity *pEnt)
+{
+	m_pTickingEntity = pEnt;
+}
+
+void CGameWorld::EndEntityTick()
+{
+	if(m_pTickingEntity)
+		m_EntityGrid.Update(m_pTickingEntity->m_GridNode, m_pTickingEntity->m_Pos);
+	m_pTickingEntity = nullptr;
+}
+
+void CGameWorld::QueryEntityGrid(int Type, vec2 Min, vec2 Max)
+{
+	if(!m_EntityGridInTick)
+		UpdateEntityGrid(Type);
+	else if(m_pTickingEntity)
+		m_EntityGrid.Update(m_pTickingEntity->m_GridNode, m_pTickingEntity->m_Pos);
+
+	m_EntityGrid.Query(Type, Min, Max, m_vpGridCandidates);
+}
+
+void CGameWorld::PrepareSnapEntities()
+{
+	m_vSnapEntities.clear();
+	m_vUnboundedSnapEntities.clear();
+	m_vSnapEntitiesByX.clear();
+	m_SnapEntitiesMaxWidth = 0.0f;
+
+	for(int i = 0; i < NUM_ENTTYPES; i++)
+	{
+		if(i == ENTTYPE_CHARACTER)
+			continue;
+
+		for(CEntity *pEnt = m_apFirstEntityTypes[i]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+		{
+			CSnapEntity SnapEntity;
+			SnapEntity.m_pEntity = pEnt;
+			const int Index = m_vSnapEntities.size();
+			if(pEnt->GetSnapBounds(SnapEntity.m_Min, SnapEntity.m_Max))
+			{
+				m_SnapEntitiesMaxWidth = maximum(m_SnapEntitiesMaxWidth, SnapEntity.m_Max.x - SnapEntity.m_Min.x);
+				m_vSnapEntitiesByX.push_back(Index);
+			}
+			else
+			{
+				m_vUnboundedSnapEntities.push_back(Index);
+			}
+			m_vSnapEntities.push_back(SnapEntity);
+		}
+	}
+
+	std::sort(m_vSnapEntitiesByX.begin(), m_vSnapEntitiesByX.end(), [this](int a, int b) {
+		return m_vSnapEntities[a].m_Min.x < m_vSnapEntities[b].m_Min.x;
+	});
+
+	m_SnapEntitiesTick = Server()->Tick();
+}
+
+void CGameWorld::SnapVisibleEntities(int SnappingClient)
+{
+	if(m_SnapEntitiesTick != Server()->Tick())
+		PrepareSnapEntities();
+
+	// small margin so rounding can never clip an entity that NetworkClipped would keep
+	const CPlayer *pPlayer = GameServer()->m_apPlayers[SnappingClient];
+	const vec2 ViewMin = pPlayer->m_ViewPos - pPlayer->m_ShowDistance - vec2(1.0f, 1.0f);
+	const vec2 ViewMax = pPlayer->m_ViewPos + pPlayer->m_ShowDistance + vec2(1.0f, 1.0f);
+
+	m_vSnapCandidates = m_vUnboundedSnapEntities;
+	const auto First = std::lower_bound(m_vSnapEntitiesByX.begin(), m_vSnapEntitiesByX.end(), ViewMin.x - m_SnapEntitiesMaxWidth, [this](int Index, float x) {
+		return m_vSnapEntities[Index].m_Min.x < x;
+	});
+	for(auto It = First; It != m_vSnapEntitiesByX.end() && m_vSnapEntities[*It].m_Min.x <= ViewMax.x; ++It)
+	{
+		const CSnapEntity &SnapEntity = m_vSnapEntities[*It];
+		if(SnapEntity.m_Max.x >= ViewMin.x && SnapEntity.m_Max.y >= ViewMin.y && SnapEntity.m_Min.y <= ViewMax.y)
+			m_vSnapCandidates.push_back(*It);
+	}
+
+	// keep the same item order as a full traversal of the entity lists
+	std::sort(m_vSnapCandidates.begin(), m_vSnapCandidates.end());
+	for(int Index : m_vSnapCandidates)
+		m_vSnapEntities[Index].m_pEntity->Snap(SnappingClient);
 }
 
 //
 void CGameWorld::Snap(int SnappingClient)
 {
-	for(CEntity *pEnt = m_apFirstEntityTypes[ENTTYPE_CHARACTER]; pEnt;)
 	{
-		m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
-		pEnt->Snap(SnappingClient);
-		pEnt = m_pNextTraverseEntity;
+		CProfileScope Profile(m_aProfileSnap[ENTTYPE_CHARACTER]);
+		for(CEntity *pEnt = m_apFirstEntityTypes[ENTTYPE_CHARACTER]; pEnt;)
+		{
+			m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
+			pEnt->Snap(SnappingClient);
+			pEnt = m_pNextTraverseEntity;
+		}
+	}
+
+	// only the demo recorder and players with /showall see the whole world,
+	// everyone else only gets entities near their view
+	if(SnappingClient != SERVER_DEMO_CLIENT && !GameServer()->m_apPlayers[SnappingClient]->m_ShowAll)
+	{
+		CProfileScope Profile(m_ProfileSnapVisible);
+		SnapVisibleEntities(SnappingClient);
+		return;
 	}
 
 	for(int i = 0; i < NUM_ENTTYPES; i++)
@@ -120,6 +399,7 @@ void CGameWorld::Snap(int SnappingClient)
 		if(i == ENTTYPE_CHARACTER)
 			continue;
 
+		CProfileScope Profile(m_aProfileSnap[i]);
 		for(CEntity *pEnt = m_apFirstEntityTypes[i]; pEnt;)
 		{
 			m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
@@ -196,11 +476,18 @@ void CGameWorld::Tick()
 	if(m_ResetRequested)
 		Reset();
 
+	// pick up everything that was moved from outside of the world tick
+	for(int i = 0; i < NUM_ENTTYPES; i++)
+		UpdateEntityGrid(i);
+	m_EntityGridInTick = true;
+
 	if(!m_Paused)
 	{
 		// update all objects
 		for(int i = 0; i < NUM_ENTTYPES; i++)
 		{
+			CProfileScope Profile(m_aProfileTick[i]);
+
 			// It's important to call PreTick() and Tick() after each other.
 			// If we call PreTick() before, and Tick() after other entities have been processed, it causes physics changes such as a stronger shotgun or grenade.
 			if(g_Config.m_SvNoWeakHook && i == ENTTYPE_CHARACTER)
@@ -209,7 +496,9 @@ void CGameWorld::Tick()
 				for(; pEnt;)
 				{
 					m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
+					BeginEntityTick(pEnt);
 					((CCharacter *)pEnt)->PreTick();
+					EndEntityTick();
 					pEnt = m_pNextTraverseEntity;
 				}
 			}
@@ -218,18 +507,15 @@ void CGameWorld::Tick()
 			for(; pEnt;)
 			{
 				m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
+				BeginEntityTick(pEnt);
 				pEnt->Tick();
+				EndEntityTick();
 				pEnt = m_pNextTraverseEntity;
 			}
 		}
 
-		for(auto *pEnt : m_apFirstEntityTypes)
-			for(; pEnt;)
-			{
-				m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
-				pEnt->TickDeferred();
-				pEnt = m_pNextTraverseEntity;
-			}
+		CProfileScope Profile(m_ProfileTickDeferred);
+		TickDeferred();
 	}
 	else
 	{
@@ -238,11 +524,15 @@ void CGameWorld::Tick()
 			for(; pEnt;)
 			{
 				m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
+				BeginEntityTick(pEnt);
 				pEnt->TickPaused();
+				EndEntityTick();
 				pEnt = m_pNextTraverseEntity;
 			}
 	}
 
+	m_EntityGridInTick = false;
+
 	RemoveEntities();
 
 	// find the characters' strong/weak id
@@ -288,11 +578,16 @@ CCharacter *CGameWorld::IntersectCharacter(vec2 Pos0, vec2 Pos1, float Radius, v
 
 CEntity *CGameWorld::IntersectEntity(vec2 Pos0, vec2 Pos1, float Radius, int Type, vec2 &NewPos, const CEntity *pNotThis, int CollideWith, const CEntity *pThisOnly)
 {
+	if(Type < 0 || Type >= NUM_ENTTYPES)
+		return nullptr;
+
 	float ClosestLen = distance(Pos0, Pos1) * 100.0f;
 	CEntity *pClosest = nullptr;
 
-	CEntity *pEntity = FindFirst(Type);
-	for(; pEntity; pEntity = pEntity->TypeNext())
+	const float Range = Radius + m_EntityGrid.MaxRadius(Type) + 1.0f;
+	QueryEntityGrid(Type, vec2(minimum(Pos0.x, Pos1.x), minimum(Pos0.y, Pos1.y)) - vec2(Range, Range), vec2(maximum(Pos0.x, Pos1.x), maximum(Pos0.y, Pos1.y)) + vec2(Range, Range));
+
+	for(CEntity *pEntity : m_vpGridCandidates)
 	{
 		if(pEntity == pNotThis)
 			continue;
@@ -329,9 +624,12 @@ CCharacter *CGameWorld::ClosestCharacter(vec2 Pos, float Radius, const CEntity *
 	float ClosestRange = Radius * 2;
 	CCharacter *pClosest = nullptr;
 
-	CCharacter *p = (CCharacter *)FindFirst(ENTTYPE_CHARACTER);
-	for(; p; p = (CCharacter *)p->TypeNext())
+	const float Range = Radius + m_EntityGrid.MaxRadius(ENTTYPE_CHARACTER) + 1.0f;
+	QueryEntityGrid(ENTTYPE_CHARACTER, Pos - vec2(Range, Range), Pos + vec2(Range, Range));
+
+	for(CEntity *pEnt : m_vpGridCandidates)
 	{
+		CCharacter *p = (CCharacter *)pEnt;
 		if(p == pNotThis)
 			continue;
 
@@ -352,9 +650,13 @@ CCharacter *CGameWorld::ClosestCharacter(vec2 Pos, float Radius, const CEntity *
 std::vector<CCharacter *> CGameWorld::IntersectedCharacters(vec2 Pos0, vec2 Pos1, float Radius, const CEntity *pNotThis)
 {
 	std::vector<CCharacter *> vpCharacters;
-	CCharacter *pChr = (CCharacter *)FindFirst(CGameWorld::ENTTYPE_CHARACTER);
-	for(; pChr; pChr = (CCharacter *)pChr->TypeNext())
+
+	const float Range = Radius + m_EntityGrid.MaxRadius(ENTTYPE_CHARACTER) + 1.0f;
+	QueryEntityGrid(ENTTYPE_CHARACTER, vec2(minimum(Pos0.x, Pos1.x), minimum(Pos0.y, Pos1.y)) - vec2(Range, Range), vec2(maximum(Pos0.x, Pos1.x), maximum(Pos0.y, Pos1.y)) + vec2(Range, Range));
+
+	for(CEntity *pEnt : m_vpGridCandidates)
 	{
+		CCharacter *pChr = (CCharacter *)pEnt;
 		if(pChr == pNotThis)
 			continue;
 
@@ -3,14 +3,19 @@
 #ifndef GAME_SERVER_GAMEWORLD_H
 #define GAME_SERVER_GAMEWORLD_H
 
+#include <base/system.h>
+
+#include <game/entity_grid.h>
 #include <game/gamecore.h>
 
 #include "save.h"
 
+#include <atomic>
 #include <vector>
 
 class CEntity;
 class CCharacter;
+class CJobPool;
 
 /*
 	Class: Game World
@@ -37,6 +42,59 @@ private:
 	CEntity *m_pNextTraverseEntity = nullptr;
 	CEntity *m_apFirstEntityTypes[NUM_ENTTYPES];
 
+	// all non-character entities with their snap bounds, collected once per
+	// tick and shared between the snapshots of all clients
+	class CSnapEntity
+	{
+	public:
+		CEntity *m_pEntity;
+		vec2 m_Min;
+		vec2 m_Max;
+	};
+	std::vector<CSnapEntity> m_vSnapEntities;
+	std::vector<int> m_vUnboundedSnapEntities;
+	std::vector<int> m_vSnapEntitiesByX;
+	std::vector<int> m_vSnapCandidates;
+	float m_SnapEntitiesMaxWidth;
+	int m_SnapEntitiesTick;
+
+	void PrepareSnapEntities();
+	void SnapVisibleEntities(int SnappingClient);
+
+	// spatial index for the proximity and line queries. Entity positions
+	// only change while the entity itself ticks, so the ticking entity is
+	// re-binned before queries and after its tick, everything else once per
+	// tick and before queries from outside of the world tick.
+	CEntityGrid<CEntity> m_EntityGrid;
+	std::vector<CEntity *> m_vpGridCandidates;
+	CEntity *m_pTickingEntity;
+	bool m_EntityGridInTick;
+
+	// profiler sections per entity type
+	int m_aProfileTick[NUM_ENTTYPES];
+	int m_aProfileSnap[NUM_ENTTYPES];
+	int m_ProfileTickDeferred;
+	int m_ProfileSnapVisible;
+
+	// characters that can't collide with each other move independently, so
+	// with sv_world_threads the deferred tick of the characters is split into
+	// partitions that are moved concurrently. Events are created afterwards
+	// on the main thread in the usual order. The job pool belongs to the
+	// server.
+	CJobPool *m_pTickJobPool = nullptr;
+	SEMAPHORE m_TickJobsDone;
+	std::vector<std::vector<CCharacter *>> m_vvTickPartitions;
+	int m_NumTickPartitions;
+	std::atomic<int> m_NextTickPartition;
+
+	bool PartitionCharacters();
+	void TickDeferred();
+
+	void UpdateEntityGrid(int Type);
+	void BeginEntityTick(CEntity *pEnt);
+	void EndEntityTick();
+	void QueryEntityGrid(int Type, vec2 Min, vec2 Max);
+
 	class CGameContext *m_pGameServer;
 	class CConfig *m_pConfig;
 	class IServer *m_pServer;
@@ -54,6 +112,7 @@ public:
 	~CGameWorld();
 
 	void SetGameServer(CGameContext *pGameServer);
+	void RunTickWorker();
 
 	CEntity *FindFirst(int Type);
 
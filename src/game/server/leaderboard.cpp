@@ -0,0 +1,248 @@
+#include "leaderboard.h"
+
+#include "scoreworker.h"
+
+#include <base/math.h>
+#include <base/system.h>
+#include <engine/server/databases/connection_pool.h>
+#include <engine/shared/config.h>
+
+#include <cctype>
+#include <type_traits>
+
+template<typename TValue, bool HigherIsBetter>
+static void GetTop(const CRanking<TValue, HigherIsBetter> &Ranking, int Start, int Num, bool Ascending, std::vector<CScoreTopEntry> &vTop)
+{
+	const int End = minimum(Start + Num, Ranking.Size());
+	for(int i = Start; i < End; i++)
+	{
+		const int Index = Ascending ? i : Ranking.Size() - 1 - i;
+		CScoreTopEntry Entry = {};
+		Entry.m_Rank = Ranking.Rank(Index);
+		str_copy(Entry.m_aName, Ranking.Entry(Index).m_Name.c_str());
+		if constexpr(std::is_same_v<TValue, float>)
+			Entry.m_Time = Ranking.Entry(Index).m_Value;
+		else
+			Entry.m_Points = Ranking.Entry(Index).m_Value;
+		vTop.push_back(Entry);
+	}
+}
+
+// Matches like `LIKE` of SQLite and of MySQL's case insensitive collations:
+// % matches any number of characters, _ exactly one, ASCII ignores case
+static bool SqlLike(const char *pStr, const char *pPattern)
+{
+	for(; *pPattern; pPattern++, pStr++)
+	{
+		if(*pPattern == '%')
+		{
+			while(*pPattern == '%')
+				pPattern++;
+			if(!*pPattern)
+				return true;
+			for(; *pStr; pStr++)
+				if(SqlLike(pStr, pPattern))
+					return true;
+			return false;
+		}
+		if(!*pStr)
+			return false;
+		if(*pPattern != '_' && std::tolower((unsigned char)*pPattern) != std::tolower((unsigned char)*pStr))
+			return false;
+	}
+	return !*pStr;
+}
+
+bool CLeaderboard::Fresh() const
+{
+	return m_Loaded && time_get() < m_LoadTime + (int64_t)g_Config.m_SvLeaderboardCache * time_freq();
+}
+
+void CLeaderboard::Update(CDbConnectionPool *pPool, const char *pMap, const char *pServer)
+{
+	if(g_Config.m_SvLeaderboardCache == 0)
+	{
+		m_Loaded = false;
+		m_pLoadResult = nullptr;
+		m_vPendingFinishes.clear();
+		m_vReplayFinishes.clear();
+		return;
+	}
+
+	if(str_comp(m_aMap, pMap) != 0 || str_comp(m_aServer, pServer) != 0)
+	{
+		str_copy(m_aMap, pMap);
+		str_copy(m_aServer, pServer);
+		m_Loaded = false;
+		m_vPendingFinishes.clear();
+	}
+
+	if(m_pLoadResult != nullptr && m_pLoadResult->m_Completed)
+		ApplyLoadResult();
+
+	for(auto It = m_vPendingFinishes.begin(); It != m_vPendingFinishes.end();)
+	{
+		if(!It->m_pResult->m_Completed)
+		{
+			++It;
+			continue;
+		}
+		if(It->m_pResult->m_Success)
+		{
+			if(m_pLoadResult != nullptr)
+				m_vReplayFinishes.push_back(*It);
+			ApplyFinish(*It);
+		}
+		It = m_vPendingFinishes.erase(It);
+	}
+
+	if((!Fresh() || m_PointsOutdated) && m_pLoadResult == nullptr)
+		Load(pPool);
+}
+
+void CLeaderboard::AddFinish(std::shared_ptr<CScorePlayerResult> pResult, const char *pName, float Time)
+{
+	if(g_Config.m_SvLeaderboardCache == 0)
+		return;
+	CFinish Finish;
+	Finish.m_pResult = std::move(pResult);
+	str_copy(Finish.m_aName, pName);
+	Finish.m_Time = Time;
+	m_vPendingFinishes.push_back(std::move(Finish));
+}
+
+void CLeaderboard::Load(CDbConnectionPool *pPool)
+{
+	m_pLoadResult = std::make_shared<CScoreLeaderboardResult>();
+	str_copy(m_aLoadMap, m_aMap);
+	str_copy(m_aLoadServer, m_aServer);
+	m_LoadMaxPoints = g_Config.m_SvLeaderboardCachePoints;
+	m_vReplayFinishes.clear();
+
+	auto Tmp = std::make_unique<CSqlLeaderboardRequest>(m_pLoadResult);
+	str_copy(Tmp->m_aMap, m_aMap, sizeof(Tmp->m_aMap));
+	Tmp->m_MaxPoints = m_LoadMaxPoints;
+	pPool->Execute(CScoreWorker::LoadLeaderboard, std::move(Tmp), "load leaderboard");
+}
+
+void CLeaderboard::ApplyLoadResult()
+{
+	std::shared_ptr<CScoreLeaderboardResult> pResult = std::move(m_pLoadResult);
+	m_pLoadResult = nullptr;
+	if(!pResult->m_Success || str_comp(m_aLoadMap, m_aMap) != 0 || str_comp(m_aLoadServer, m_aServer) != 0)
+	{
+		m_vReplayFinishes.clear();
+		return;
+	}
+
+	Fill(m_aLoadMap, m_aLoadServer, *pResult, m_LoadMaxPoints);
+
+	for(const CFinish &Finish : m_vReplayFinishes)
+		ApplyFinish(Finish);
+	m_vReplayFinishes.clear();
+}
+
+void CLeaderboard::Fill(const char *pMap, const char *pServer, const CScoreLeaderboardResult &Result, int MaxPoints)
+{
+	str_copy(m_aMap, pMap);
+	str_copy(m_aServer, pServer);
+
+	// same as `Server LIKE %<server>%` of the rank queries
+	char aServerLike[16];
+	str_format(aServerLike, sizeof(aServerLike), "%%%s%%", m_aServer);
+	m_Global.Clear();
+	m_Regional.Clear();
+	for(const auto &MapTime : Result.m_vMapTimes)
+	{
+		m_Global.Improve(MapTime.m_aName, MapTime.m_Time);
+		if(SqlLike(MapTime.m_aServer, aServerLike))
+			m_Regional.Improve(MapTime.m_aName, MapTime.m_Time);
+	}
+
+	m_Points.Clear();
+	for(const auto &Points : Result.m_vPoints)
+		m_Points.Improve(Points.m_aName, Points.m_Points);
+	m_PointsComplete = (int)Result.m_vPoints.size() < MaxPoints;
+	m_PointsOutdated = false;
+
+	m_Loaded = true;
+	m_LoadTime = time_get();
+}
+
+void CLeaderboard::ApplyFinish(const CFinish &Finish)
+{
+	if(!m_Loaded)
+		return;
+	// the first finish on a map gives points
+	if(!m_Global.Contains(Finish.m_aName))
+		m_PointsOutdated = true;
+	m_Global.Improve(Finish.m_aName, Finish.m_Time);
+	// ranks of this server always match the regional filter
+	m_Regional.Improve(Finish.m_aName, Finish.m_Time);
+}
+
+bool CLeaderboard::ShowRank(CScorePlayerResult *pResult, const char *pName, const char *pRequestingPlayer)
+{
+	if(!Fresh())
+		return false;
+
+	float Time = 0.0f;
+	const int Rank = m_Global.Find(pName, &Time);
+	float PercentRank = 0.0f;
+	if(Rank != 0 && m_Global.Size() > 1)
+		PercentRank = (double)(Rank - 1) / (m_Global.Size() - 1);
+	float RegionalTime;
+	const int RegionalRank = m_Regional.Find(pName, &RegionalTime);
+
+	CScoreWorker::FormatRank(pResult, pName, pRequestingPlayer, m_aServer, Rank, Time, PercentRank, RegionalRank);
+	return true;
+}
+
+bool CLeaderboard::ShowTop(CScorePlayerResult *pResult, int Offset)
+{
+	if(!Fresh())
+		return false;
+
+	const int Start = maximum(absolute(Offset) - 1, 0);
+	std::vector<CScoreTopEntry> vGlobal;
+	GetTop(m_Global, Start, 5, Offset >= 0, vGlobal);
+	if(!g_Config.m_SvRegionalRankings)
+	{
+		CScoreWorker::FormatTop(pResult, m_aServer, vGlobal, nullptr);
+		return true;
+	}
+	std::vector<CScoreTopEntry> vRegional;
+	GetTop(m_Regional, Start, 3, Offset >= 0, vRegional);
+	CScoreWorker::FormatTop(pResult, m_aServer, vGlobal, &vRegional);
+	return true;
+}
+
+bool CLeaderboard::ShowPoints(CScorePlayerResult *pResult, const char *pName, const char *pRequestingPlayer)
+{
+	if(!Fresh() || m_PointsOutdated)
+		return false;
+
+	int Points = 0;
+	const int Rank = m_Points.Find(pName, &Points);
+	// the player might be below the cached players
+	if(Rank == 0 && !m_PointsComplete)
+		return false;
+
+	CScoreWorker::FormatPoints(pResult, pName, pRequestingPlayer, Rank, Points);
+	return true;
+}
+
+bool CLeaderboard::ShowTopPoints(CScorePlayerResult *pResult, int Offset)
+{
+	if(!Fresh() || m_PointsOutdated)
+		return false;
+
+	const int Start = maximum(Offset - 1, 0);
+	if(!m_PointsComplete && Start + 5 > m_Points.Size())
+		return false;
+
+	std::vector<CScoreTopEntry> vTop;
+	GetTop(m_Points, Start, 5, true, vTop);
+	CScoreWorker::FormatTopPoints(pResult, vTop);
+	return true;
+}
@@ -0,0 +1,161 @@
+#ifndef GAME_SERVER_LEADERBOARD_H
+#define GAME_SERVER_LEADERBOARD_H
+
+#include <engine/map.h>
+#include <engine/shared/protocol.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class CDbConnectionPool;
+struct CScoreLeaderboardResult;
+struct CScorePlayerResult;
+
+/*
+	Class: Ranking
+		Players ordered by one value. Ranks follow SQL's RANK(): players
+		with the same value share a rank and the following ranks are
+		skipped accordingly. Players with the same value are ordered by
+		name.
+*/
+template<typename TValue, bool HigherIsBetter>
+class CRanking
+{
+public:
+	struct CEntry
+	{
+		TValue m_Value;
+		std::string m_Name;
+	};
+
+	void Clear()
+	{
+		m_vEntries.clear();
+		m_Values.clear();
+	}
+
+	// sets the value of a player, only if it is better than the current one
+	void Improve(const char *pName, TValue Value)
+	{
+		auto It = m_Values.find(pName);
+		if(It != m_Values.end())
+		{
+			if(!Better(Value, It->second))
+				return;
+			m_vEntries.erase(std::lower_bound(m_vEntries.begin(), m_vEntries.end(), CEntry{It->second, pName}, Before));
+			It->second = Value;
+		}
+		else
+		{
+			m_Values.emplace(pName, Value);
+		}
+		CEntry Entry{Value, pName};
+		m_vEntries.insert(std::upper_bound(m_vEntries.begin(), m_vEntries.end(), Entry, Before), std::move(Entry));
+	}
+
+	// returns the rank of the player, 0 if the player isn't ranked
+	int Find(const char *pName, TValue *pValue) const
+	{
+		auto It = m_Values.find(pName);
+		if(It == m_Values.end())
+			return 0;
+		*pValue = It->second;
+		return RankOf(It->second);
+	}
+
+	bool Contains(const char *pName) const { return m_Values.find(pName) != m_Values.end(); }
+	int Size() const { return m_vEntries.size(); }
+	// Index is the position in ranking order
+	const CEntry &Entry(int Index) const { return m_vEntries[Index]; }
+	int Rank(int Index) const { return RankOf(m_vEntries[Index].m_Value); }
+
+private:
+	std::vector<CEntry> m_vEntries;
+	std::unordered_map<std::string, TValue> m_Values;
+
+	static bool Better(TValue A, TValue B) { return HigherIsBetter ? A > B : A < B; }
+	static bool Before(const CEntry &A, const CEntry &B)
+	{
+		if(Better(A.m_Value, B.m_Value))
+			return true;
+		if(Better(B.m_Value, A.m_Value))
+			return false;
+		return A.m_Name < B.m_Name;
+	}
+
+	int RankOf(TValue Value) const
+	{
+		auto It = std::lower_bound(m_vEntries.begin(), m_vEntries.end(), Value, [](const CEntry &Entry, TValue Val) {
+			return Better(Entry.m_Value, Val);
+		});
+		return 1 + (It - m_vEntries.begin());
+	}
+};
+
+/*
+	Class: Leaderboard
+		Cache of the map ranks and the players with the most points,
+		answering /rank, /top5, /points and /toppoints without querying
+		the database. It is reloaded after sv_leaderboard_cache seconds
+		and updated with the finishes on this server in between.
+
+		The Show* functions return false if the cache can't answer the
+		request and it has to go to the database.
+*/
+class CLeaderboard
+{
+public:
+	// pMap and pServer identify the leaderboard, it is reloaded when they change
+	void Update(CDbConnectionPool *pPool, const char *pMap, const char *pServer);
+	// applies the finish once its score got saved successfully
+	void AddFinish(std::shared_ptr<CScorePlayerResult> pResult, const char *pName, float Time);
+	// replaces the cache with the result of CScoreWorker::LoadLeaderboard
+	void Fill(const char *pMap, const char *pServer, const CScoreLeaderboardResult &Result, int MaxPoints);
+
+	bool ShowRank(CScorePlayerResult *pResult, const char *pName, const char *pRequestingPlayer);
+	bool ShowTop(CScorePlayerResult *pResult, int Offset);
+	bool ShowPoints(CScorePlayerResult *pResult, const char *pName, const char *pRequestingPlayer);
+	bool ShowTopPoints(CScorePlayerResult *pResult, int Offset);
+
+private:
+	struct CFinish
+	{
+		std::shared_ptr<CScorePlayerResult> m_pResult;
+		char m_aName[MAX_NAME_LENGTH];
+		float m_Time;
+	};
+
+	char m_aMap[MAX_MAP_LENGTH] = "";
+	char m_aServer[5] = "";
+	bool m_Loaded = false;
+	int64_t m_LoadTime = 0;
+
+	std::shared_ptr<CScoreLeaderboardResult> m_pLoadResult;
+	// map and server the pending load is for
+	char m_aLoadMap[MAX_MAP_LENGTH] = "";
+	char m_aLoadServer[5] = "";
+	int m_LoadMaxPoints = 0;
+
+	CRanking<float, false> m_Global;
+	CRanking<float, false> m_Regional;
+	CRanking<int, true> m_Points;
+	// whether m_Points holds all players with points
+	bool m_PointsComplete = false;
+	// a first finish on the map changed the points of a player
+	bool m_PointsOutdated = false;
+
+	// finishes waiting for their score to be saved
+	std::vector<CFinish> m_vPendingFinishes;
+	// finishes applied while a load is pending, the loaded data might miss them
+	std::vector<CFinish> m_vReplayFinishes;
+
+	bool Fresh() const;
+	void Load(CDbConnectionPool *pPool);
+	void ApplyLoadResult();
+	void ApplyFinish(const CFinish &Finish);
+};
+
+#endif // GAME_SERVER_LEADERBOARD_H
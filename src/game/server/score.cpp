@@ -33,7 +33,8 @@ void CScore::ExecPlayerThread(
 	const char *pThreadName,
 	int ClientId,
 	const char *pName,
-	int Offset)
+	int Offset,
+	bool Dismissable)
 {
 	auto pResult = NewSqlPlayerResult(ClientId);
 	if(pResult == nullptr)
@@ -45,7 +46,7 @@ void CScore::ExecPlayerThread(
 	str_copy(Tmp->m_aRequestingPlayer, Server()->ClientName(ClientId), sizeof(Tmp->m_aRequestingPlayer));
 	Tmp->m_Offset = Offset;
 
-	m_pPool->Execute(pFuncPtr, std::move(Tmp), pThreadName);
+	m_pPool->Execute(pFuncPtr, std::move(Tmp), pThreadName, Dismissable);
 }
 
 bool CScore::RateLimitPlayer(int ClientId)
@@ -59,6 +60,28 @@ bool CScore::RateLimitPlayer(int ClientId)
 	return false;
 }
 
+void CScore::UpdateLeaderboard()
+{
+	char aServer[5];
+	str_copy(aServer, g_Config.m_SvSqlServerName);
+	m_Leaderboard.Update(m_pPool, Server()->GetMapName(), aServer);
+}
+
+bool CScore::ShowFromLeaderboard(int ClientId, const std::function<bool(CScorePlayerResult *)> &ShowFunc)
+{
+	UpdateLeaderboard();
+	CPlayer *pCurPlayer = GameServer()->m_apPlayers[ClientId];
+	if(pCurPlayer->m_ScoreQueryResult != nullptr)
+		return false;
+	auto pResult = std::make_shared<CScorePlayerResult>();
+	if(!ShowFunc(pResult.get()))
+		return false;
+	pResult->m_Success = true;
+	pResult->m_Completed.store(true);
+	pCurPlayer->m_ScoreQueryResult = pResult;
+	return true;
+}
+
 void CScore::GeneratePassphrase(char *pBuf, int BufSize)
 {
 	for(int i = 0; i < 3; i++)
@@ -77,6 +100,7 @@ CScore::CScore(CGameContext *pGameServer, CDbConnectionPool *pPool) :
 	m_pServer(pGameServer->Server())
 {
 	LoadBestTime();
+	UpdateLeaderboard();
 
 	uint64_t aSeed[2];
 	secure_random_fill(aSeed, sizeof(aSeed));
@@ -166,6 +190,7 @@ void CScore::SaveScore(int ClientId, int TimeTicks, const char *pTimestamp, cons
 	for(int i = 0; i < NUM_CHECKPOINTS; i++)
 		Tmp->m_aCurrentTimeCp[i] = aTimeCp[i];
 
+	m_Leaderboard.AddFinish(pCurPlayer->m_ScoreFinishResult, Tmp->m_aName, Tmp->m_Time);
 	m_pPool->ExecuteWrite(CScoreWorker::SaveScore, std::move(Tmp), "save score");
 }
 
@@ -199,63 +224,71 @@ void CScore::ShowRank(int ClientId, const char *pName)
 {
 	if(RateLimitPlayer(ClientId))
 		return;
-	ExecPlayerThread(CScoreWorker::ShowRank, "show rank", ClientId, pName, 0);
+	if(ShowFromLeaderboard(ClientId, [&](CScorePlayerResult *pResult) { return m_Leaderboard.ShowRank(pResult, pName, Server()->ClientName(ClientId)); }))
+		return;
+	ExecPlayerThread(CScoreWorker::ShowRank, "show rank", ClientId, pName, 0, true);
 }
 
 void CScore::ShowTeamRank(int ClientId, const char *pName)
 {
 	if(RateLimitPlayer(ClientId))
 		return;
-	ExecPlayerThread(CScoreWorker::ShowTeamRank, "show team rank", ClientId, pName, 0);
+	ExecPlayerThread(CScoreWorker::ShowTeamRank, "show team rank", ClientId, pName, 0, true);
 }
 
 void CScore::ShowTop(int ClientId, int Offset)
 {
 	if(RateLimitPlayer(ClientId))
 		return;
-	ExecPlayerThread(CScoreWorker::ShowTop, "show top5", ClientId, "", Offset);
+	if(ShowFromLeaderboard(ClientId, [&](CScorePlayerResult *pResult) { return m_Leaderboard.ShowTop(pResult, Offset); }))
+		return;
+	ExecPlayerThread(CScoreWorker::ShowTop, "show top5", ClientId, "", Offset, true);
 }
 
 void CScore::ShowTeamTop5(int ClientId, int Offset)
 {
 	if(RateLimitPlayer(ClientId))
 		return;
-	ExecPlayerThread(CScoreWorker::ShowTeamTop5, "show team top5", ClientId, "", Offset);
+	ExecPlayerThread(CScoreWorker::ShowTeamTop5, "show team top5", ClientId, "", Offset, true);
 }
 
 void CScore::ShowPlayerTeamTop5(int ClientId, const char *pName, int Offset)
 {
 	if(RateLimitPlayer(ClientId))
 		return;
-	ExecPlayerThread(CScoreWorker::ShowPlayerTeamTop5, "show team top5 player", ClientId, pName, Offset);
+	ExecPlayerThread(CScoreWorker::ShowPlayerTeamTop5, "show team top5 player", ClientId, pName, Offset, true);
 }
 
 void CScore::ShowTimes(int ClientId, int Offset)
 {
 	if(RateLimitPlayer(ClientId))
 		return;
-	ExecPlayerThread(CScoreWorker::ShowTimes, "show times", ClientId, "", Offset);
+	ExecPlayerThread(CScoreWorker::ShowTimes, "show times", ClientId, "", Offset, true);
 }
 
 void CScore::ShowTimes(int ClientId, const char *pName, int Offset)
 {
 	if(RateLimitPlayer(ClientId))
 		return;
-	ExecPlayerThread(CScoreWorker::ShowTimes, "show times", ClientId, pName, Offset);
+	ExecPlayerThread(CScoreWorker::ShowTimes, "show times", ClientId, pName, Offset, true);
 }
 
 void CScore::ShowPoints(int ClientId, const char *pName)
 {
 	if(RateLimitPlayer(ClientId))
 		return;
-	ExecPlayerThread(CScoreWorker::ShowPoints, "show points", ClientId, pName, 0);
+	if(ShowFromLeaderboard(ClientId, [&](CScorePlayerResult *pResult) { return m_Leaderboard.ShowPoints(pResult, pName, Server()->ClientName(ClientId)); }))
+		return;
+	ExecPlayerThread(CScoreWorker::ShowPoints, "show points", ClientId, pName, 0, true);
 }
 
 void CScore::ShowTopPoints(int ClientId, int Offset)
 {
 	if(RateLimitPlayer(ClientId))
 		return;
-	ExecPlayerThread(CScoreWorker::ShowTopPoints, "show top points", ClientId, "", Offset);
+	if(ShowFromLeaderboard(ClientId, [&](CScorePlayerResult *pResult) { return m_Leaderboard.ShowTopPoints(pResult, Offset); }))
+		return;
+	ExecPlayerThread(CScoreWorker::ShowTopPoints, "show top points", ClientId, "", Offset, true);
 }
 
 void CScore::RandomMap(int ClientId, int Stars)
@@ -395,5 +428,5 @@ void CScore::GetSaves(int ClientId)
 {
 	if(RateLimitPlayer(ClientId))
 		return;
-	ExecPlayerThread(CScoreWorker::GetSaves, "get saves", ClientId, "", 0);
+	ExecPlayerThread(CScoreWorker::GetSaves, "get saves", ClientId, "", 0, true);
 }
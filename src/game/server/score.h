@@ -3,8 +3,11 @@
 
 #include <game/prng.h>
 
+#include "leaderboard.h"
 #include "scoreworker.h"
 
+#include <functional>
+
 class CDbConnectionPool;
 class CGameContext;
 class IDbConnection;
@@ -27,17 +30,25 @@ class CScore
 
 	// returns new SqlResult bound to the player, if no current Thread is active for this player
 	std::shared_ptr<CScorePlayerResult> NewSqlPlayerResult(int ClientId);
-	// Creates for player database requests
+	// Creates for player database requests, dismissable ones are dropped
+	// while the database is overloaded
 	void ExecPlayerThread(
 		bool (*pFuncPtr)(IDbConnection *, const ISqlData *, char *pError, int ErrorSize),
 		const char *pThreadName,
 		int ClientId,
 		const char *pName,
-		int Offset);
+		int Offset,
+		bool Dismissable = false);
 
 	// returns true if the player should be rate limited
 	bool RateLimitPlayer(int ClientId);
 
+	CLeaderboard m_Leaderboard;
+	void UpdateLeaderboard();
+	// answers a request from the leaderboard cache, returns false if it has
+	// to go to the database
+	bool ShowFromLeaderboard(int ClientId, const std::function<bool(CScorePlayerResult *)> &ShowFunc);
+
 public:
 	CScore(CGameContext *pGameServer, CDbConnectionPool *pPool);
 
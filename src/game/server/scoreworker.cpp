@@ -170,6 +170,64 @@ bool CScoreWorker::LoadBestTime(IDbConnection *pSqlServer, const ISqlData *pGame
 	return true;
 }
 
+bool CScoreWorker::LoadLeaderboard(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+{
+	const auto *pData = dynamic_cast<const CSqlLeaderboardRequest *>(pGameData);
+	auto *pResult = dynamic_cast<CScoreLeaderboardResult *>(pGameData->m_pResult.get());
+
+	char aBuf[512];
+	str_format(aBuf, sizeof(aBuf),
+		"SELECT Name, Server, MIN(Time) "
+		"FROM %s_race "
+		"WHERE Map = ? AND Server IS NOT NULL "
+		"GROUP BY Name, Server",
+		pSqlServer->GetPrefix());
+	if(!pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
+	{
+		return false;
+	}
+	pSqlServer->BindString(1, pData->m_aMap);
+
+	bool End = false;
+	while(pSqlServer->Step(&End, pError, ErrorSize) && !End)
+	{
+		CScoreLeaderboardResult::CMapTime MapTime;
+		pSqlServer->GetString(1, MapTime.m_aName, sizeof(MapTime.m_aName));
+		pSqlServer->GetString(2, MapTime.m_aServer, sizeof(MapTime.m_aServer));
+		MapTime.m_Time = pSqlServer->GetFloat(3);
+		pResult->m_vMapTimes.push_back(MapTime);
+	}
+	if(!End)
+	{
+		return false;
+	}
+
+	if(pData->m_MaxPoints <= 0)
+	{
+		return true;
+	}
+	str_format(aBuf, sizeof(aBuf),
+		"SELECT Name, Points "
+		"FROM %s_points "
+		"ORDER BY Points DESC LIMIT ?",
+		pSqlServer->GetPrefix());
+	if(!pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
+	{
+		return false;
+	}
+	pSqlServer->BindInt(1, pData->m_MaxPoints);
+
+	End = false;
+	while(pSqlServer->Step(&End, pError, ErrorSize) && !End)
+	{
+		CScoreLeaderboardResult::CPoints Points;
+		pSqlServer->GetString(1, Points.m_aName, sizeof(Points.m_aName));
+		Points.m_Points = pSqlServer->GetInt(2);
+		pResult->m_vPoints.push_back(Points);
+	}
+	return End;
+}
+
 // update stuff
 bool CScoreWorker::LoadPlayerData(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
 {
@@ -855,15 +913,7 @@ bool CScoreWorker::ShowRank(IDbConnection *pSqlServer, const ISqlData *pGameData
 		return false;
 	}
 
-	char aRegionalRank[16];
-	if(End)
-	{
-		str_copy(aRegionalRank, "unranked", sizeof(aRegionalRank));
-	}
-	else
-	{
-		str_format(aRegionalRank, sizeof(aRegionalRank), "rank %d", pSqlServer->GetInt(1));
-	}
+	int RegionalRank = End ? 0 : pSqlServer->GetInt(1);
 
 	const char *pAny = "%";
 
@@ -882,52 +932,73 @@ bool CScoreWorker::ShowRank(IDbConnection *pSqlServer, const ISqlData *pGameData
 
 	if(!End)
 	{
-		int Rank = pSqlServer->GetInt(1);
-		float Time = pSqlServer->GetFloat(2);
-		// CEIL and FLOOR are not supported in SQLite
-		int BetterThanPercent = std::floor(100.0f - 100.0f * pSqlServer->GetFloat(3));
-		str_time_float(Time, TIME_HOURS_CENTISECS, aBuf, sizeof(aBuf));
-		if(g_Config.m_SvHideScore)
+		FormatRank(pResult, pData->m_aName, pData->m_aRequestingPlayer, pData->m_aServer,
+			pSqlServer->GetInt(1), pSqlServer->GetFloat(2), pSqlServer->GetFloat(3), RegionalRank);
+	}
+	else
+	{
+		FormatRank(pResult, pData->m_aName, pData->m_aRequestingPlayer, pData->m_aServer, 0, 0.0f, 0.0f, 0);
+	}
+	return true;
+}
+
+void CScoreWorker::FormatRank(CScorePlayerResult *pResult, const char *pName, const char *pRequestingPlayer, const char *pServer, int Rank, float Time, float PercentRank, int RegionalRank)
+{
+	if(Rank == 0)
+	{
+		str_format(pResult->m_Data.m_aaMessages[0], sizeof(pResult->m_Data.m_aaMessages[0]),
+			"%s is not ranked", pName);
+		return;
+	}
+
+	char aRegionalRank[16];
+	if(RegionalRank == 0)
+	{
+		str_copy(aRegionalRank, "unranked", sizeof(aRegionalRank));
+	}
+	else
+	{
+		str_format(aRegionalRank, sizeof(aRegionalRank), "rank %d", RegionalRank);
+	}
+
+	char aBuf[64];
+	// CEIL and FLOOR are not supported in SQLite
+	int BetterThanPercent = std::floor(100.0f - 100.0f * PercentRank);
+	str_time_float(Time, TIME_HOURS_CENTISECS, aBuf, sizeof(aBuf));
+	if(g_Config.m_SvHideScore)
+	{
+		str_format(pResult->m_Data.m_aaMessages[0], sizeof(pResult->m_Data.m_aaMessages[0]),
+			"Your time: %s, better than %d%%", aBuf, BetterThanPercent);
+	}
+	else
+	{
+		pResult->m_MessageKind = CScorePlayerResult::ALL;
+
+		if(str_comp_nocase(pRequestingPlayer, pName) == 0)
 		{
 			str_format(pResult->m_Data.m_aaMessages[0], sizeof(pResult->m_Data.m_aaMessages[0]),
-				"Your time: %s, better than %d%%", aBuf, BetterThanPercent);
+				"%s - %s - better than %d%%",
+				pName, aBuf, BetterThanPercent);
 		}
 		else
 		{
-			pResult->m_MessageKind = CScorePlayerResult::ALL;
-
-			if(str_comp_nocase(pData->m_aRequestingPlayer, pData->m_aName) == 0)
-			{
-				str_format(pResult->m_Data.m_aaMessages[0], sizeof(pResult->m_Data.m_aaMessages[0]),
-					"%s - %s - better than %d%%",
-					pData->m_aName, aBuf, BetterThanPercent);
-			}
-			else
-			{
-				str_format(pResult->m_Data.m_aaMessages[0], sizeof(pResult->m_Data.m_aaMessages[0]),
-					"%s - %s - better than %d%% - requested by %s",
-					pData->m_aName, aBuf, BetterThanPercent, pData->m_aRequestingPlayer);
-			}
+			str_format(pResult->m_Data.m_aaMessages[0], sizeof(pResult->m_Data.m_aaMessages[0]),
+				"%s - %s - better than %d%% - requested by %s",
+				pName, aBuf, BetterThanPercent, pRequestingPlayer);
+		}
 
-			if(g_Config.m_SvRegionalRankings)
-			{
-				str_format(pResult->m_Data.m_aaMessages[1], sizeof(pResult->m_Data.m_aaMessages[1]),
-					"Global rank %d - %s %s",
-					Rank, pData->m_aServer, aRegionalRank);
-			}
-			else
-			{
-				str_format(pResult->m_Data.m_aaMessages[1], sizeof(pResult->m_Data.m_aaMessages[1]),
-					"Global rank %d", Rank);
-			}
+		if(g_Config.m_SvRegionalRankings)
+		{
+			str_format(pResult->m_Data.m_aaMessages[1], sizeof(pResult->m_Data.m_aaMessages[1]),
+				"Global rank %d - %s %s",
+				Rank, pServer, aRegionalRank);
+		}
+		else
+		{
+			str_format(pResult->m_Data.m_aaMessages[1], sizeof(pResult->m_Data.m_aaMessages[1]),
+				"Global rank %d", Rank);
 		}
 	}
-	else
-	{
-		str_format(pResult->m_Data.m_aaMessages[0], sizeof(pResult->m_Data.m_aaMessages[0]),
-			"%s is not ranked", pData->m_aName);
-	}
-	return true;
 }
 
 bool CScoreWorker::ShowTeamRank(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
@@ -1048,30 +1119,20 @@ bool CScoreWorker::ShowTop(IDbConnection *pSqlServer, const ISqlData *pGameData,
 	pSqlServer->BindString(2, pAny);
 	pSqlServer->BindInt(3, 5);
 
-	// show top
-	int Line = 0;
-	str_copy(pResult->m_Data.m_aaMessages[Line], "------------ Global Top ------------", sizeof(pResult->m_Data.m_aaMessages[Line]));
-	Line++;
-
-	char aTime[32];
+	std::vector<CScoreTopEntry> vGlobal;
 	bool End = false;
-
 	while(pSqlServer->Step(&End, pError, ErrorSize) && !End)
 	{
-		char aName[MAX_NAME_LENGTH];
-		pSqlServer->GetString(1, aName, sizeof(aName));
-		float Time = pSqlServer->GetFloat(2);
-		str_time_float(Time, TIME_HOURS_CENTISECS, aTime, sizeof(aTime));
-		int Rank = pSqlServer->GetInt(3);
-		str_format(pResult->m_Data.m_aaMessages[Line], sizeof(pResult->m_Data.m_aaMessages[Line]),
-			"%d. %s Time: %s", Rank, aName, aTime);
-
-		Line++;
+		CScoreTopEntry Entry = {};
+		pSqlServer->GetString(1, Entry.m_aName, sizeof(Entry.m_aName));
+		Entry.m_Time = pSqlServer->GetFloat(2);
+		Entry.m_Rank = pSqlServer->GetInt(3);
+		vGlobal.push_back(Entry);
 	}
 
 	if(!g_Config.m_SvRegionalRankings)
 	{
-		str_copy(pResult->m_Data.m_aaMessages[Line], "-----------------------------------------", sizeof(pResult->m_Data.m_aaMessages[Line]));
+		FormatTop(pResult, pData->m_aServer, vGlobal, nullptr);
 		return End;
 	}
 
@@ -1086,24 +1147,54 @@ bool CScoreWorker::ShowTop(IDbConnection *pSqlServer, const ISqlData *pGameData,
 	pSqlServer->BindString(2, aServerLike);
 	pSqlServer->BindInt(3, 3);
 
+	std::vector<CScoreTopEntry> vRegional;
+	while(pSqlServer->Step(&End, pError, ErrorSize) && !End)
+	{
+		CScoreTopEntry Entry = {};
+		pSqlServer->GetString(1, Entry.m_aName, sizeof(Entry.m_aName));
+		Entry.m_Time = pSqlServer->GetFloat(2);
+		Entry.m_Rank = pSqlServer->GetInt(3);
+		vRegional.push_back(Entry);
+	}
+
+	FormatTop(pResult, pData->m_aServer, vGlobal, &vRegional);
+	return End;
+}
+
+void CScoreWorker::FormatTop(CScorePlayerResult *pResult, const char *pServer, const std::vector<CScoreTopEntry> &vGlobal, const std::vector<CScoreTopEntry> *pvRegional)
+{
+	// show top
+	int Line = 0;
+	str_copy(pResult->m_Data.m_aaMessages[Line], "------------ Global Top ------------", sizeof(pResult->m_Data.m_aaMessages[Line]));
+	Line++;
+
+	char aTime[32];
+	for(const CScoreTopEntry &Entry : vGlobal)
+	{
+		str_time_float(Entry.m_Time, TIME_HOURS_CENTISECS, aTime, sizeof(aTime));
+		str_format(pResult->m_Data.m_aaMessages[Line], sizeof(pResult->m_Data.m_aaMessages[Line]),
+			"%d. %s Time: %s", Entry.m_Rank, Entry.m_aName, aTime);
+		Line++;
+	}
+
+	if(pvRegional == nullptr)
+	{
+		str_copy(pResult->m_Data.m_aaMessages[Line], "-----------------------------------------", sizeof(pResult->m_Data.m_aaMessages[Line]));
+		return;
+	}
+
 	str_format(pResult->m_Data.m_aaMessages[Line], sizeof(pResult->m_Data.m_aaMessages[Line]),
-		"------------ %s Top ------------", pData->m_aServer);
+		"------------ %s Top ------------", pServer);
 	Line++;
 
 	// show top
-	while(pSqlServer->Step(&End, pError, ErrorSize) && !End)
+	for(const CScoreTopEntry &Entry : *pvRegional)
 	{
-		char aName[MAX_NAME_LENGTH];
-		pSqlServer->GetString(1, aName, sizeof(aName));
-		float Time = pSqlServer->GetFloat(2);
-		str_time_float(Time, TIME_HOURS_CENTISECS, aTime, sizeof(aTime));
-		int Rank = pSqlServer->GetInt(3);
+		str_time_float(Entry.m_Time, TIME_HOURS_CENTISECS, aTime, sizeof(aTime));
 		str_format(pResult->m_Data.m_aaMessages[Line], sizeof(pResult->m_Data.m_aaMessages[Line]),
-			"%d. %s Time: %s", Rank, aName, aTime);
+			"%d. %s Time: %s", Entry.m_Rank, Entry.m_aName, aTime);
 		Line++;
 	}
-
-	return End;
 }
 
 bool CScoreWorker::ShowTeamTop5(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
@@ -1414,7 +1505,6 @@ bool CScoreWorker::ShowPoints(IDbConnection *pSqlServer, const ISqlData *pGameDa
 {
 	const auto *pData = dynamic_cast<const CSqlPlayerRequest *>(pGameData);
 	auto *pResult = dynamic_cast<CScorePlayerResult *>(pGameData->m_pResult.get());
-	auto *paMessages = pResult->m_Data.m_aaMessages;
 
 	char aBuf[512];
 	str_format(aBuf, sizeof(aBuf),
@@ -1438,28 +1528,38 @@ bool CScoreWorker::ShowPoints(IDbConnection *pSqlServer, const ISqlData *pGameDa
 	}
 	if(!End)
 	{
-		int Rank = pSqlServer->GetInt(1);
-		int Count = pSqlServer->GetInt(2);
 		char aName[MAX_NAME_LENGTH];
 		pSqlServer->GetString(3, aName, sizeof(aName));
+		FormatPoints(pResult, aName, pData->m_aRequestingPlayer, pSqlServer->GetInt(1), pSqlServer->GetInt(2));
+	}
+	else
+	{
+		FormatPoints(pResult, pData->m_aName, pData->m_aRequestingPlayer, 0, 0);
+	}
+	return true;
+}
+
+void CScoreWorker::FormatPoints(CScorePlayerResult *pResult, const char *pName, const char *pRequestingPlayer, int Rank, int Points)
+{
+	auto *paMessages = pResult->m_Data.m_aaMessages;
+	if(Rank != 0)
+	{
 		pResult->m_MessageKind = CScorePlayerResult::ALL;
 		str_format(paMessages[0], sizeof(paMessages[0]),
 			"%d. %s Points: %d, requested by %s",
-			Rank, aName, Count, pData->m_aRequestingPlayer);
+			Rank, pName, Points, pRequestingPlayer);
 	}
 	else
 	{
 		str_format(paMessages[0], sizeof(paMessages[0]),
-			"%s has not collected any points so far", pData->m_aName);
+			"%s has not collected any points so far", pName);
 	}
-	return true;
 }
 
 bool CScoreWorker::ShowTopPoints(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
 {
 	const auto *pData = dynamic_cast<const CSqlPlayerRequest *>(pGameData);
 	auto *pResult = dynamic_cast<CScorePlayerResult *>(pGameData->m_pResult.get());
-	auto *paMessages = pResult->m_Data.m_aaMessages;
 
 	int LimitStart = maximum(pData->m_Offset - 1, 0);
 
@@ -1480,30 +1580,42 @@ bool CScoreWorker::ShowTopPoints(IDbConnection *pSqlServer, const ISqlData *pGam
 	pSqlServer->BindInt(1, LimitStart + 5);
 	pSqlServer->BindInt(2, LimitStart);
 
-	// show top points
-	str_copy(paMessages[0], "-------- Top Points --------", sizeof(paMessages[0]));
-
+	std::vector<CScoreTopEntry> vTop;
 	bool End = false;
-	int Line = 1;
 	while(pSqlServer->Step(&End, pError, ErrorSize) && !End)
 	{
-		int Rank = pSqlServer->GetInt(1);
-		int Points = pSqlServer->GetInt(2);
-		char aName[MAX_NAME_LENGTH];
-		pSqlServer->GetString(3, aName, sizeof(aName));
-		str_format(paMessages[Line], sizeof(paMessages[Line]),
-			"%d. %s Points: %d", Rank, aName, Points);
-		Line++;
+		CScoreTopEntry Entry = {};
+		Entry.m_Rank = pSqlServer->GetInt(1);
+		Entry.m_Points = pSqlServer->GetInt(2);
+		pSqlServer->GetString(3, Entry.m_aName, sizeof(Entry.m_aName));
+		vTop.push_back(Entry);
 	}
 	if(!End)
 	{
 		return false;
 	}
-	str_copy(paMessages[Line], "-------------------------------", sizeof(paMessages[Line]));
+	FormatTopPoints(pResult, vTop);
 
 	return true;
 }
 
+void CScoreWorker::FormatTopPoints(CScorePlayerResult *pResult, const std::vector<CScoreTopEntry> &vTop)
+{
+	auto *paMessages = pResult->m_Data.m_aaMessages;
+
+	// show top points
+	str_copy(paMessages[0], "-------- Top Points --------", sizeof(paMessages[0]));
+
+	int Line = 1;
+	for(const CScoreTopEntry &Entry : vTop)
+	{
+		str_format(paMessages[Line], sizeof(paMessages[Line]),
+			"%d. %s Points: %d", Entry.m_Rank, Entry.m_aName, Entry.m_Points);
+		Line++;
+	}
+	str_copy(paMessages[Line], "-------------------------------", sizeof(paMessages[Line]));
+}
+
 bool CScoreWorker::RandomMap(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
 {
 	const auto *pData = dynamic_cast<const CSqlRandomMapRequest *>(pGameData);
@@ -100,6 +100,46 @@ struct CSqlPlayerRequest : ISqlData
 	char m_aServer[5];
 };
 
+// one line of a /top5 or /toppoints answer
+struct CScoreTopEntry
+{
+	int m_Rank;
+	char m_aName[MAX_NAME_LENGTH];
+	float m_Time;
+	int m_Points;
+};
+
+struct CScoreLeaderboardResult : ISqlResult
+{
+	struct CMapTime
+	{
+		char m_aName[MAX_NAME_LENGTH];
+		char m_aServer[5];
+		float m_Time;
+	};
+	struct CPoints
+	{
+		char m_aName[MAX_NAME_LENGTH];
+		int m_Points;
+	};
+	// best time of every player on every server, without ranks that have
+	// no server, the rank queries never match those with `Server LIKE ?`
+	std::vector<CMapTime> m_vMapTimes;
+	// players with the most points, in descending order
+	std::vector<CPoints> m_vPoints;
+};
+
+struct CSqlLeaderboardRequest : ISqlData
+{
+	CSqlLeaderboardRequest(std::shared_ptr<CScoreLeaderboardResult> pResult) :
+		ISqlData(std::move(pResult))
+	{
+	}
+
+	char m_aMap[MAX_MAP_LENGTH];
+	int m_MaxPoints;
+};
+
 struct CScoreRandomMapResult : ISqlResult
 {
 	CScoreRandomMapResult(int ClientId) :
@@ -282,6 +322,7 @@ struct CTeamrank
 struct CScoreWorker
 {
 	static bool LoadBestTime(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize);
+	static bool LoadLeaderboard(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize);
 
 	static bool RandomMap(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize);
 	static bool RandomUnfinishedMap(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize);
@@ -305,6 +346,14 @@ struct CScoreWorker
 
 	static bool SaveScore(IDbConnection *pSqlServer, const ISqlData *pGameData, Write w, char *pError, int ErrorSize);
 	static bool SaveTeamScore(IDbConnection *pSqlServer, const ISqlData *pGameData, Write w, char *pError, int ErrorSize);
+
+	// messages of the ranking commands, shared with the leaderboard cache
+	// Rank is 0 if the player isn't ranked
+	static void FormatRank(CScorePlayerResult *pResult, const char *pName, const char *pRequestingPlayer, const char *pServer, int Rank, float Time, float PercentRank, int RegionalRank);
+	// pvRegional is nullptr if regional rankings are disabled
+	static void FormatTop(CScorePlayerResult *pResult, const char *pServer, const std::vector<CScoreTopEntry> &vGlobal, const std::vector<CScoreTopEntry> *pvRegional);
+	static void FormatPoints(CScorePlayerResult *pResult, const char *pName, const char *pRequestingPlayer, int Rank, int Points);
+	static void FormatTopPoints(CScorePlayerResult *pResult, const std::vector<CScoreTopEntry> &vTop);
 };
 
 #endif // GAME_SERVER_SCOREWORKER_H
@@ -238,6 +238,38 @@ void CTeeHistorian::WriteExtra(CUuid Uuid, const void *pData, int DataSize)
 	Write(pData, DataSize);
 }
 
+void CTeeHistorian::SerializeState(std::vector<unsigned char> &vState) const
+{
+	dbg_assert(m_State == STATE_START || m_State == STATE_BEFORE_TICK, "invalid teehistorian state");
+
+	CTeehistorianPacker Buffer;
+	Buffer.Reset();
+	Buffer.AddInt(m_LastWrittenTick);
+	Buffer.AddInt(m_MaxClientId);
+	for(const CTeehistorianPlayer &Player : m_aPrevPlayers)
+	{
+		Buffer.AddInt(Player.m_Alive);
+		if(Player.m_Alive)
+		{
+			Buffer.AddInt(Player.m_X);
+			Buffer.AddInt(Player.m_Y);
+		}
+		Buffer.AddInt(Player.m_Team);
+		Buffer.AddInt(Player.m_UniqueClientId);
+		if(Player.m_UniqueClientId != 0)
+		{
+			const int *pInput = (const int *)&Player.m_Input;
+			for(size_t i = 0; i < sizeof(Player.m_Input) / sizeof(int32_t); i++)
+				Buffer.AddInt(pInput[i]);
+		}
+	}
+	for(const CTeam &Team : m_aPrevTeams)
+		Buffer.AddInt(Team.m_Practice);
+	dbg_assert(!Buffer.Error(), "teehistorian state too large");
+
+	vState.assign(Buffer.Data(), Buffer.Data() + Buffer.Size());
+}
+
 void CTeeHistorian::BeginTick(int Tick)
 {
 	dbg_assert(m_State == STATE_START || m_State == STATE_BEFORE_TICK, "invalid teehistorian state");
@@ -7,6 +7,7 @@
 #include <generated/protocol.h>
 
 #include <ctime>
+#include <vector>
 
 class CConfig;
 class CTuningParams;
@@ -53,6 +54,9 @@ public:
 	void Finish();
 
 	bool Starting() const { return m_State == STATE_START; }
+	// state needed to decode the stream from the next tick on without the
+	// data before it, see CCompressedTeeHistorianWriter
+	void SerializeState(std::vector<unsigned char> &vState) const;
 
 	void BeginTick(int Tick);
 
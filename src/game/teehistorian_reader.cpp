@@ -0,0 +1,573 @@
+#include "teehistorian_reader.h"
+
+#include <base/math.h>
+
+#include <engine/shared/compression.h>
+#include <engine/shared/json.h>
+#include <engine/shared/packer.h>
+
+#include <cstring>
+
+static const CUuid TEEHISTORIAN_UUID = CalculateUuid("teehistorian@ddnet.tw");
+
+#define UUID(id, name) static const CUuid UUID_##id = CalculateUuid(name);
+#include <engine/shared/teehistorian_ex_chunks.h>
+#undef UUID
+
+enum
+{
+	TEEHISTORIAN_NONE,
+	TEEHISTORIAN_FINISH,
+	TEEHISTORIAN_TICK_SKIP,
+	TEEHISTORIAN_PLAYER_NEW,
+	TEEHISTORIAN_PLAYER_OLD,
+	TEEHISTORIAN_INPUT_DIFF,
+	TEEHISTORIAN_INPUT_NEW,
+	TEEHISTORIAN_MESSAGE,
+	TEEHISTORIAN_JOIN,
+	TEEHISTORIAN_DROP,
+	TEEHISTORIAN_CONSOLE_COMMAND,
+	TEEHISTORIAN_EX,
+};
+
+enum
+{
+	NUM_INPUT_INTS = sizeof(CNetObj_PlayerInput) / sizeof(int32_t),
+	MAX_CONSOLE_ARGS = 16,
+};
+
+// unpacks a chunk that might not be completely in the buffer yet
+class CChunkUnpacker
+{
+	const unsigned char *m_pStart;
+	const unsigned char *m_pCurrent;
+	const unsigned char *m_pEnd;
+
+public:
+	bool m_Incomplete = false;
+	bool m_Invalid = false;
+
+	CChunkUnpacker(const unsigned char *pData, size_t Size) :
+		m_pStart(pData), m_pCurrent(pData), m_pEnd(pData + Size)
+	{
+	}
+
+	bool Ok() const { return !m_Incomplete && !m_Invalid; }
+	int Size() const { return m_pCurrent - m_pStart; }
+
+	int GetInt()
+	{
+		int Value = 0;
+		if(!Ok())
+			return 0;
+		const unsigned char *pNext = CVariableInt::Unpack(m_pCurrent, &Value, m_pEnd - m_pCurrent);
+		if(!pNext)
+		{
+			m_Incomplete = true;
+			return 0;
+		}
+		m_pCurrent = pNext;
+		return Value;
+	}
+
+	const char *GetString()
+	{
+		if(!Ok())
+			return "";
+		const unsigned char *pNul = (const unsigned char *)memchr(m_pCurrent, 0, m_pEnd - m_pCurrent);
+		if(!pNul)
+		{
+			m_Incomplete = true;
+			return "";
+		}
+		const char *pString = (const char *)m_pCurrent;
+		m_pCurrent = pNul + 1;
+		return pString;
+	}
+
+	const unsigned char *GetRaw(int Size)
+	{
+		if(!Ok())
+			return nullptr;
+		if(Size < 0)
+		{
+			m_Invalid = true;
+			return nullptr;
+		}
+		if(Size > m_pEnd - m_pCurrent)
+		{
+			m_Incomplete = true;
+			return nullptr;
+		}
+		const unsigned char *pData = m_pCurrent;
+		m_pCurrent += Size;
+		return pData;
+	}
+};
+
+CTeeHistorianReader::CTeeHistorianReader()
+{
+	m_File = nullptr;
+	m_pHeader = nullptr;
+	Close();
+}
+
+CTeeHistorianReader::~CTeeHistorianReader()
+{
+	Close();
+}
+
+bool CTeeHistorianReader::Open(IOHANDLE File)
+{
+	Close();
+
+	unsigned char aUuid[sizeof(CUuid)];
+	if(io_read(File, aUuid, sizeof(aUuid)) != sizeof(aUuid))
+	{
+		io_close(File);
+		return SetError("file too short");
+	}
+	io_seek(File, 0, IOSEEK_START);
+
+	m_Compressed = CCompressedTeeHistorianReader::IsCompressed(aUuid, sizeof(aUuid));
+	if(m_Compressed)
+	{
+		if(!m_CompressedReader.Open(File))
+			return SetError("invalid compressed file");
+	}
+	else
+	{
+		m_File = File;
+	}
+	return ReadHeader();
+}
+
+void CTeeHistorianReader::Close()
+{
+	if(m_File)
+		io_close(m_File);
+	m_File = nullptr;
+	m_CompressedReader.Close();
+	m_Compressed = false;
+	m_NextFrame = 0;
+	m_Eof = false;
+	m_vBuffer.clear();
+	m_BufferPos = 0;
+	if(m_pHeader)
+		json_value_free(m_pHeader);
+	m_pHeader = nullptr;
+	m_aError[0] = '\0';
+	m_Stopped = false;
+	m_Finished = false;
+	ResetState();
+}
+
+void CTeeHistorianReader::ResetState()
+{
+	// same as `CTeeHistorian::Reset`
+	m_Tick = 0;
+	m_LastClientId = MAX_CLIENTS;
+	for(auto &Player : m_aPlayers)
+	{
+		Player.m_Alive = false;
+		Player.m_X = 0;
+		Player.m_Y = 0;
+		Player.m_UniqueClientId = 0;
+		mem_zero(&Player.m_Input, sizeof(Player.m_Input));
+		Player.m_Team = 0;
+	}
+	for(bool &Practice : m_aTeamPractice)
+		Practice = false;
+}
+
+bool CTeeHistorianReader::LoadState(const std::vector<unsigned char> &vState)
+{
+	ResetState();
+	if(vState.empty())
+		return true;
+
+	// written by `CTeeHistorian::SerializeState`
+	CChunkUnpacker Unpacker(vState.data(), vState.size());
+	m_Tick = Unpacker.GetInt();
+	m_LastClientId = Unpacker.GetInt();
+	for(auto &Player : m_aPlayers)
+	{
+		Player.m_Alive = Unpacker.GetInt();
+		if(Player.m_Alive)
+		{
+			Player.m_X = Unpacker.GetInt();
+			Player.m_Y = Unpacker.GetInt();
+		}
+		Player.m_Team = Unpacker.GetInt();
+		Player.m_UniqueClientId = Unpacker.GetInt();
+		if(Player.m_UniqueClientId != 0)
+		{
+			int *pInput = (int *)&Player.m_Input;
+			for(int i = 0; i < NUM_INPUT_INTS; i++)
+				pInput[i] = Unpacker.GetInt();
+		}
+	}
+	for(bool &Practice : m_aTeamPractice)
+		Practice = Unpacker.GetInt();
+	return Unpacker.Ok() || SetError("invalid frame state");
+}
+
+bool CTeeHistorianReader::ReadHeader()
+{
+	// uuid followed by null terminated json
+	Fill(READ_CHUNK_SIZE);
+	while(true)
+	{
+		if(Available() > sizeof(CUuid))
+		{
+			const unsigned char *pStart = m_vBuffer.data() + m_BufferPos;
+			const unsigned char *pNul = (const unsigned char *)memchr(pStart + sizeof(CUuid), 0, Available() - sizeof(CUuid));
+			if(pNul)
+			{
+				if(mem_comp(pStart, &TEEHISTORIAN_UUID, sizeof(CUuid)) != 0)
+					return SetError("not a teehistorian file");
+				const char *pJson = (const char *)pStart + sizeof(CUuid);
+				m_pHeader = json_parse(pJson, pNul - (const unsigned char *)pJson);
+				if(!m_pHeader || m_pHeader->type != json_object)
+					return SetError("invalid header");
+				m_BufferPos += (pNul + 1) - pStart;
+				return true;
+			}
+		}
+		if(m_Eof)
+			return SetError("header too short");
+		Fill(Available() + READ_CHUNK_SIZE);
+	}
+}
+
+const char *CTeeHistorianReader::HeaderString(const char *pName) const
+{
+	const json_value *pValue = json_object_get(m_pHeader, pName);
+	if(pValue == &json_value_none || pValue->type != json_string)
+		return "";
+	return json_string_get(pValue);
+}
+
+void CTeeHistorianReader::Fill(size_t Size)
+{
+	if(m_BufferPos > 0)
+	{
+		m_vBuffer.erase(m_vBuffer.begin(), m_vBuffer.begin() + m_BufferPos);
+		m_BufferPos = 0;
+	}
+	while(m_vBuffer.size() < Size && !m_Eof)
+	{
+		if(m_Compressed)
+		{
+			if(m_NextFrame >= m_CompressedReader.NumFrames() || !m_CompressedReader.ReadFrame(m_NextFrame, m_vFrameState, m_vFrameData))
+			{
+				m_Eof = true;
+				break;
+			}
+			m_NextFrame++;
+			m_vBuffer.insert(m_vBuffer.end(), m_vFrameData.begin(), m_vFrameData.end());
+		}
+		else
+		{
+			const size_t OldSize = m_vBuffer.size();
+			m_vBuffer.resize(OldSize + READ_CHUNK_SIZE);
+			const unsigned Read = io_read(m_File, m_vBuffer.data() + OldSize, READ_CHUNK_SIZE);
+			m_vBuffer.resize(OldSize + Read);
+			if(Read == 0)
+				m_Eof = true;
+		}
+	}
+}
+
+bool CTeeHistorianReader::SeekTick(int Tick)
+{
+	if(!m_Compressed)
+		return SetError("only compressed files can be seeked");
+
+	// the first frame contains the header
+	const int Frame = maximum(m_CompressedReader.FindFrame(Tick), 1);
+	if(Frame >= m_CompressedReader.NumFrames())
+		return SetError("tick not in file");
+	if(!m_CompressedReader.ReadFrame(Frame, m_vFrameState, m_vFrameData))
+		return SetError("error reading frame");
+	if(!LoadState(m_vFrameState))
+		return false;
+
+	m_vBuffer = m_vFrameData;
+	m_BufferPos = 0;
+	m_NextFrame = Frame + 1;
+	m_Eof = false;
+	m_Finished = false;
+	return true;
+}
+
+bool CTeeHistorianReader::Read(IListener *pListener)
+{
+	m_Stopped = false;
+	while(!m_Finished && !m_Stopped)
+	{
+		if(Available() < READ_CHUNK_SIZE && !m_Eof)
+			Fill(READ_CHUNK_SIZE);
+		if(Available() == 0)
+			return SetError("unexpected end of file");
+
+		int Size = ParseChunk(pListener);
+		while(Size == 0 && !m_Eof)
+		{
+			Fill(Available() * 2);
+			Size = ParseChunk(pListener);
+		}
+		if(Size == 0)
+			return SetError("unexpected end of file");
+		if(Size < 0)
+			return false;
+		m_BufferPos += Size;
+	}
+	return true;
+}
+
+void CTeeHistorianReader::NextTick(IListener *pListener, int Tick)
+{
+	m_Tick = Tick;
+	m_LastClientId = -1;
+	pListener->OnTick(Tick);
+}
+
+void CTeeHistorianReader::PlayerData(IListener *pListener, int ClientId)
+{
+	// same as `CTeeHistorian::EnsureTickWrittenPlayerData`, player data in
+	// increasing order, a lower id starts the next tick
+	if(ClientId <= m_LastClientId)
+		NextTick(pListener, m_Tick + 1);
+	m_LastClientId = ClientId;
+}
+
+int CTeeHistorianReader::ParseChunk(IListener *pListener)
+{
+	CChunkUnpacker Unpacker(m_vBuffer.data() + m_BufferPos, Available());
+
+#define CHECK_CHUNK() \
+	do \
+	{ \
+		if(Unpacker.m_Incomplete) \
+			return 0; \
+		if(Unpacker.m_Invalid) \
+		{ \
+			SetError("invalid chunk"); \
+			return -1; \
+		} \
+	} while(0)
+#define CHECK_CLIENT_ID(ClientId) \
+	do \
+	{ \
+		if((ClientId) < 0 || (ClientId) >= MAX_CLIENTS) \
+		{ \
+			SetError("invalid client id"); \
+			return -1; \
+		} \
+	} while(0)
+
+	const int Type = Unpacker.GetInt();
+	CHECK_CHUNK();
+
+	if(Type >= 0)
+	{
+		// player diff, the type is the client id
+		const int ClientId = Type;
+		const int dx = Unpacker.GetInt();
+		const int dy = Unpacker.GetInt();
+		CHECK_CHUNK();
+		CHECK_CLIENT_ID(ClientId);
+		PlayerData(pListener, ClientId);
+		CPlayer &Player = m_aPlayers[ClientId];
+		Player.m_X += dx;
+		Player.m_Y += dy;
+		pListener->OnPlayer(ClientId, Player.m_X, Player.m_Y);
+		return Unpacker.Size();
+	}
+
+	switch(-Type)
+	{
+	case TEEHISTORIAN_FINISH:
+		m_Finished = true;
+		pListener->OnFinish();
+		break;
+	case TEEHISTORIAN_TICK_SKIP:
+	{
+		const int Dt = Unpacker.GetInt();
+		CHECK_CHUNK();
+		NextTick(pListener, m_Tick + Dt + 1);
+		break;
+	}
+	case TEEHISTORIAN_PLAYER_NEW:
+	{
+		const int ClientId = Unpacker.GetInt();
+		const int x = Unpacker.GetInt();
+		const int y = Unpacker.GetInt();
+		CHECK_CHUNK();
+		CHECK_CLIENT_ID(ClientId);
+		PlayerData(pListener, ClientId);
+		CPlayer &Player = m_aPlayers[ClientId];
+		Player.m_Alive = true;
+		Player.m_X = x;
+		Player.m_Y = y;
+		pListener->OnPlayer(ClientId, x, y);
+		break;
+	}
+	case TEEHISTORIAN_PLAYER_OLD:
+	{
+		const int ClientId = Unpacker.GetInt();
+		CHECK_CHUNK();
+		CHECK_CLIENT_ID(ClientId);
+		PlayerData(pListener, ClientId);
+		m_aPlayers[ClientId].m_Alive = false;
+		pListener->OnDeadPlayer(ClientId);
+		break;
+	}
+	case TEEHISTORIAN_INPUT_DIFF:
+	case TEEHISTORIAN_INPUT_NEW:
+	{
+		const int ClientId = Unpacker.GetInt();
+		int aInput[NUM_INPUT_INTS];
+		for(int &Value : aInput)
+			Value = Unpacker.GetInt();
+		CHECK_CHUNK();
+		CHECK_CLIENT_ID(ClientId);
+		CPlayer &Player = m_aPlayers[ClientId];
+		int *pInput = (int *)&Player.m_Input;
+		for(int i = 0; i < NUM_INPUT_INTS; i++)
+			pInput[i] = -Type == TEEHISTORIAN_INPUT_DIFF ? pInput[i] + aInput[i] : aInput[i];
+		pListener->OnInput(ClientId, &Player.m_Input);
+		break;
+	}
+	case TEEHISTORIAN_MESSAGE:
+	{
+		const int ClientId = Unpacker.GetInt();
+		const int MsgSize = Unpacker.GetInt();
+		const unsigned char *pMsg = Unpacker.GetRaw(MsgSize);
+		CHECK_CHUNK();
+		CHECK_CLIENT_ID(ClientId);
+		pListener->OnMessage(ClientId, pMsg, MsgSize);
+		break;
+	}
+	case TEEHISTORIAN_JOIN:
+	{
+		const int ClientId = Unpacker.GetInt();
+		CHECK_CHUNK();
+		CHECK_CLIENT_ID(ClientId);
+		pListener->OnJoin(ClientId);
+		break;
+	}
+	case TEEHISTORIAN_DROP:
+	{
+		const int ClientId = Unpacker.GetInt();
+		const char *pReason = Unpacker.GetString();
+		CHECK_CHUNK();
+		CHECK_CLIENT_ID(ClientId);
+		pListener->OnDrop(ClientId, pReason);
+		break;
+	}
+	case TEEHISTORIAN_CONSOLE_COMMAND:
+	{
+		const int ClientId = Unpacker.GetInt();
+		const int FlagMask = Unpacker.GetInt();
+		const char *pCmd = Unpacker.GetString();
+		const int NumArgs = Unpacker.GetInt();
+		if(NumArgs < 0)
+			Unpacker.m_Invalid = true;
+		const char *apArgs[MAX_CONSOLE_ARGS];
+		for(int i = 0; i < NumArgs && Unpacker.Ok(); i++)
+		{
+			const char *pArg = Unpacker.GetString();
+			if(i < MAX_CONSOLE_ARGS)
+				apArgs[i] = pArg;
+		}
+		CHECK_CHUNK();
+		pListener->OnConsoleCommand(ClientId, FlagMask, pCmd, minimum(NumArgs, (int)MAX_CONSOLE_ARGS), apArgs);
+		break;
+	}
+	case TEEHISTORIAN_EX:
+	{
+		const unsigned char *pUuid = Unpacker.GetRaw(sizeof(CUuid));
+		const int DataSize = Unpacker.GetInt();
+		const unsigned char *pData = Unpacker.GetRaw(DataSize);
+		CHECK_CHUNK();
+		CUuid Uuid;
+		mem_copy(&Uuid, pUuid, sizeof(Uuid));
+
+		CChunkUnpacker Ex(pData, DataSize);
+		if(Uuid == UUID_TEEHISTORIAN_PLAYER_NAME)
+		{
+			const int ClientId = Ex.GetInt();
+			const char *pName = Ex.GetString();
+			if(Ex.Ok() && ClientId >= 0 && ClientId < MAX_CLIENTS)
+				pListener->OnPlayerName(ClientId, pName);
+		}
+		else if(Uuid == UUID_TEEHISTORIAN_PLAYER_TEAM)
+		{
+			const int ClientId = Ex.GetInt();
+			const int Team = Ex.GetInt();
+			if(Ex.Ok() && ClientId >= 0 && ClientId < MAX_CLIENTS)
+			{
+				m_aPlayers[ClientId].m_Team = Team;
+				pListener->OnPlayerTeam(ClientId, Team);
+			}
+		}
+		else if(Uuid == UUID_TEEHISTORIAN_TEAM_PRACTICE)
+		{
+			const int Team = Ex.GetInt();
+			const bool Practice = Ex.GetInt();
+			if(Ex.Ok() && Team >= 0 && Team < MAX_CLIENTS)
+			{
+				m_aTeamPractice[Team] = Practice;
+				pListener->OnTeamPractice(Team, Practice);
+			}
+		}
+		else if(Uuid == UUID_TEEHISTORIAN_PLAYER_FINISH || Uuid == UUID_TEEHISTORIAN_TEAM_FINISH)
+		{
+			const int Id = Ex.GetInt();
+			const int TimeTicks = Ex.GetInt();
+			if(Ex.Ok())
+			{
+				if(Uuid == UUID_TEEHISTORIAN_PLAYER_FINISH)
+					pListener->OnPlayerFinish(Id, TimeTicks);
+				else
+					pListener->OnTeamFinish(Id, TimeTicks);
+			}
+		}
+		else if(Uuid == UUID_TEEHISTORIAN_JOINVER6 || Uuid == UUID_TEEHISTORIAN_JOINVER7 ||
+			Uuid == UUID_TEEHISTORIAN_PLAYER_REJOIN || Uuid == UUID_TEEHISTORIAN_PLAYER_READY)
+		{
+			const int ClientId = Ex.GetInt();
+			if(Ex.Ok() && ClientId >= 0 && ClientId < MAX_CLIENTS)
+			{
+				if(Uuid == UUID_TEEHISTORIAN_PLAYER_REJOIN)
+					pListener->OnRejoin(ClientId);
+				else if(Uuid == UUID_TEEHISTORIAN_PLAYER_READY)
+					pListener->OnReady(ClientId);
+				else
+					pListener->OnJoinVersion(ClientId, Uuid == UUID_TEEHISTORIAN_JOINVER7);
+			}
+		}
+		else
+		{
+			pListener->OnExtra(Uuid, pData, DataSize);
+		}
+		break;
+	}
+	default:
+		SetError("unknown chunk type");
+		return -1;
+	}
+
+#undef CHECK_CHUNK
+#undef CHECK_CLIENT_ID
+
+	return Unpacker.Size();
+}
+
+bool CTeeHistorianReader::SetError(const char *pError)
+{
+	str_format(m_aError, sizeof(m_aError), "%s (tick %d)", pError, m_Tick);
+	return false;
+}
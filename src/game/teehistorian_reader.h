@@ -0,0 +1,131 @@
+#ifndef GAME_TEEHISTORIAN_READER_H
+#define GAME_TEEHISTORIAN_READER_H
+
+#include <base/system.h>
+#include <engine/shared/protocol.h>
+#include <engine/shared/teehistorian_compressed.h>
+#include <engine/shared/uuid_manager.h>
+
+#include <generated/protocol.h>
+
+#include <vector>
+
+typedef struct _json_value json_value;
+
+/*
+	Class: TeeHistorianReader
+		Parses files written by CTeeHistorian, plain or compressed, and
+		passes their contents to a listener. Positions and inputs are
+		passed as absolute values, the diffs of the file are resolved.
+
+		Compressed files can be seeked to the frame containing a tick
+		without parsing the data before it.
+*/
+class CTeeHistorianReader
+{
+public:
+	class IListener
+	{
+	public:
+		virtual ~IListener() = default;
+
+		// called once for every tick that has data, ticks without data are skipped
+		virtual void OnTick(int Tick) {}
+		virtual void OnPlayer(int ClientId, int x, int y) {}
+		virtual void OnDeadPlayer(int ClientId) {}
+		// the input applied in the next tick
+		virtual void OnInput(int ClientId, const CNetObj_PlayerInput *pInput) {}
+		virtual void OnMessage(int ClientId, const void *pMsg, int MsgSize) {}
+		virtual void OnJoin(int ClientId) {}
+		virtual void OnJoinVersion(int ClientId, bool Sixup) {}
+		virtual void OnRejoin(int ClientId) {}
+		virtual void OnReady(int ClientId) {}
+		virtual void OnDrop(int ClientId, const char *pReason) {}
+		virtual void OnConsoleCommand(int ClientId, int FlagMask, const char *pCmd, int NumArgs, const char **ppArgs) {}
+		virtual void OnPlayerName(int ClientId, const char *pName) {}
+		virtual void OnPlayerTeam(int ClientId, int Team) {}
+		virtual void OnTeamPractice(int Team, bool Practice) {}
+		virtual void OnPlayerFinish(int ClientId, int TimeTicks) {}
+		virtual void OnTeamFinish(int Team, int TimeTicks) {}
+		// extra chunks without a callback above
+		virtual void OnExtra(const CUuid &Uuid, const void *pData, int DataSize) {}
+		virtual void OnFinish() {}
+	};
+
+	struct CPlayer
+	{
+		bool m_Alive;
+		int m_X;
+		int m_Y;
+		// zero means no input yet
+		uint32_t m_UniqueClientId;
+		CNetObj_PlayerInput m_Input;
+		int m_Team;
+	};
+
+	CTeeHistorianReader();
+	~CTeeHistorianReader();
+
+	// takes ownership of the file, reads the header
+	bool Open(IOHANDLE File);
+	void Close();
+
+	const json_value *Header() const { return m_pHeader; }
+	// a string member of the header, "" if it doesn't exist
+	const char *HeaderString(const char *pName) const;
+	bool Compressed() const { return m_Compressed; }
+
+	// parses until the end of the file or until the listener calls Stop
+	bool Read(IListener *pListener);
+	void Stop() { m_Stopped = true; }
+	bool Finished() const { return m_Finished; }
+	const char *Error() const { return m_aError; }
+
+	// continues reading before Tick, only for compressed files
+	bool SeekTick(int Tick);
+
+	int Tick() const { return m_Tick; }
+	const CPlayer &Player(int ClientId) const { return m_aPlayers[ClientId]; }
+	bool TeamPractice(int Team) const { return m_aTeamPractice[Team]; }
+
+private:
+	enum
+	{
+		READ_CHUNK_SIZE = 64 * 1024,
+	};
+
+	IOHANDLE m_File;
+	bool m_Compressed;
+	CCompressedTeeHistorianReader m_CompressedReader;
+	int m_NextFrame;
+	bool m_Eof;
+
+	std::vector<unsigned char> m_vBuffer;
+	size_t m_BufferPos;
+	std::vector<unsigned char> m_vFrameState;
+	std::vector<unsigned char> m_vFrameData;
+
+	json_value *m_pHeader;
+	char m_aError[128];
+	bool m_Stopped;
+	bool m_Finished;
+
+	int m_Tick;
+	int m_LastClientId;
+	CPlayer m_aPlayers[MAX_CLIENTS];
+	bool m_aTeamPractice[MAX_CLIENTS];
+
+	void ResetState();
+	bool LoadState(const std::vector<unsigned char> &vState);
+	bool ReadHeader();
+	// makes at least Size bytes available, fewer at the end of the file
+	void Fill(size_t Size);
+	size_t Available() const { return m_vBuffer.size() - m_BufferPos; }
+	// returns the size of the parsed chunk, 0 if more data is needed and -1 on errors
+	int ParseChunk(IListener *pListener);
+	void PlayerData(IListener *pListener, int ClientId);
+	void NextTick(IListener *pListener, int Tick);
+	bool SetError(const char *pError);
+};
+
+#endif // GAME_TEEHISTORIAN_READER_H
@@ -0,0 +1,370 @@
+#include "test.h"
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/kernel.h>
+#include <engine/map.h>
+#include <engine/shared/config.h>
+#include <engine/shared/datafile.h>
+#include <engine/storage.h>
+
+#include <game/collision.h>
+#include <game/layers.h>
+#include <game/mapitems.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+class CTestCollision : public ::testing::Test
+{
+public:
+	std::unique_ptr<IKernel> m_pKernel;
+	CTestInfo m_TestInfo;
+	std::unique_ptr<IStorage> m_pStorage;
+	IEngineMap *m_pMap = nullptr;
+	CLayers m_Layers;
+	CCollision m_Collision;
+
+	CTestCollision()
+	{
+		m_pKernel = std::unique_ptr<IKernel>(IKernel::Create());
+
+		m_TestInfo.m_DeleteTestStorageFilesOnSuccess = true;
+		m_pStorage = m_TestInfo.CreateTestStorage();
+		EXPECT_NE(m_pStorage, nullptr);
+		m_pKernel->RegisterInterface(m_pStorage.get(), false);
+
+		m_pMap = CreateEngineMap();
+		m_pKernel->RegisterInterface(m_pMap);
+		m_pKernel->RegisterInterface(static_cast<IMap *>(m_pMap), false);
+	}
+
+	void LoadMap(const char *pMapName)
+	{
+		ASSERT_TRUE(m_pMap->Load(pMapName));
+		m_Layers.Init(m_pMap, true);
+		m_Collision.Init(&m_Layers);
+	}
+
+	// writes a map with only a game layer of random solid and stopper tiles
+	void WriteRandomMap(const char *pMapName, int Width, int Height)
+	{
+		CDataFileWriter Writer;
+		ASSERT_TRUE(Writer.Open(m_pStorage.get(), pMapName));
+
+		CMapItemVersion Version;
+		Version.m_Version = 1;
+		Writer.AddItem(MAPITEMTYPE_VERSION, 0, sizeof(Version), &Version);
+
+		CMapItemGroup_v1 Group;
+		Group.m_Version = 1;
+		Group.m_OffsetX = 0;
+		Group.m_OffsetY = 0;
+		Group.m_ParallaxX = 100;
+		Group.m_ParallaxY = 100;
+		Group.m_StartLayer = 0;
+		Group.m_NumLayers = 1;
+		Writer.AddItem(MAPITEMTYPE_GROUP, 0, sizeof(Group), &Group);
+
+		std::vector<CTile> vTiles((size_t)Width * Height);
+		unsigned Seed = 1;
+		for(CTile &Tile : vTiles)
+		{
+			Seed = Seed * 1103515245u + 12345u;
+			const unsigned Random = (Seed >> 8) % 100;
+			Tile.m_Index = Random < 20 ? TILE_SOLID : Random < 25 ? TILE_NOHOOK : Random < 26 ? TILE_STOP : Random < 27 ? TILE_STOPA : TILE_AIR;
+			Tile.m_Flags = Tile.m_Index == TILE_STOP ? (Seed >> 16) % 4 * TILEFLAG_ROTATE : 0;
+			Tile.m_Skip = 0;
+			Tile.m_Reserved = 0;
+		}
+		const int TilesData = Writer.AddData(vTiles.size() * sizeof(CTile), vTiles.data());
+
+		CMapItemLayerTilemap GameLayer;
+		mem_zero(&GameLayer, sizeof(GameLayer));
+		GameLayer.m_Layer.m_Type = LAYERTYPE_TILES;
+		GameLayer.m_Version = 3;
+		GameLayer.m_Width = Width;
+		GameLayer.m_Height = Height;
+		GameLayer.m_Flags = TILESLAYERFLAG_GAME;
+		GameLayer.m_ColorEnv = -1;
+		GameLayer.m_Image = -1;
+		GameLayer.m_Data = TilesData;
+		GameLayer.m_Tele = -1;
+		GameLayer.m_Speedup = -1;
+		GameLayer.m_Front = -1;
+		GameLayer.m_Switch = -1;
+		GameLayer.m_Tune = -1;
+		Writer.AddItem(MAPITEMTYPE_LAYER, 0, sizeof(GameLayer), &GameLayer);
+
+		Writer.Finish();
+	}
+
+	// solid check on the raw game layer, as done before the bit planes
+	bool IsSolidTiles(int x, int y) const
+	{
+		const int Nx = std::clamp(x / 32, 0, m_Collision.GetWidth() - 1);
+		const int Ny = std::clamp(y / 32, 0, m_Collision.GetHeight() - 1);
+		const int Index = m_Collision.GameLayer()[Ny * m_Collision.GetWidth() + Nx].m_Index;
+		return Index == TILE_SOLID || Index == TILE_NOHOOK;
+	}
+};
+
+TEST_F(CTestCollision, SolidMatchesGameLayer)
+{
+	LoadMap("maps/Tutorial.map");
+	for(int y = -1; y <= m_Collision.GetHeight(); y++)
+	{
+		for(int x = -1; x <= m_Collision.GetWidth(); x++)
+		{
+			const int PosX = x * 32 + 16;
+			const int PosY = y * 32 + 16;
+			EXPECT_EQ(m_Collision.IsSolid(PosX, PosY) != 0, IsSolidTiles(PosX, PosY)) << "x=" << x << " y=" << y;
+		}
+	}
+}
+
+TEST_F(CTestCollision, RandomSolidLookups)
+{
+	LoadMap("maps/Tutorial.map");
+
+	const int Width = m_Collision.GetWidth() * 32;
+	const int Height = m_Collision.GetHeight() * 32;
+	unsigned Seed = 1;
+	for(int i = 0; i < 1 << 14; i++)
+	{
+		Seed = Seed * 1103515245u + 12345u;
+		const int x = (Seed >> 8) % Width;
+		Seed = Seed * 1103515245u + 12345u;
+		const int y = (Seed >> 8) % Height;
+		ASSERT_EQ(m_Collision.IsSolid(x, y) != 0, IsSolidTiles(x, y)) << "x=" << x << " y=" << y;
+	}
+}
+
+// whether a stopper is close enough to restrict the movement, checked on the
+// raw layers as done before the bit planes
+static bool HasStopperTiles(const CCollision &Collision, vec2 Pos, float Distance)
+{
+	const vec2 aDirections[] = {vec2(0, 0), vec2(1, 0), vec2(0, 1), vec2(-1, 0), vec2(0, -1)};
+	for(const vec2 &Direction : aDirections)
+	{
+		const int Index = Collision.GetPureMapIndex(Pos + Direction * Distance);
+		const int aTiles[] = {Collision.GetTileIndex(Index), Collision.GetFrontTileIndex(Index)};
+		for(int Tile : aTiles)
+		{
+			if(Tile == TILE_STOP || Tile == TILE_STOPS || Tile == TILE_STOPA)
+				return true;
+		}
+	}
+	return false;
+}
+
+TEST_F(CTestCollision, BenchmarkLookups)
+{
+	WriteRandomMap("large.map", 2000, 2000);
+	LoadMap("large.map");
+
+	const int NumLookups = 1 << 22;
+	const int Width = m_Collision.GetWidth() * 32;
+	const int Height = m_Collision.GetHeight() * 32;
+	std::vector<ivec2> vPoints(NumLookups);
+	unsigned Seed = 1;
+	for(auto &Point : vPoints)
+	{
+		Seed = Seed * 1103515245u + 12345u;
+		Point.x = (Seed >> 8) % Width;
+		Seed = Seed * 1103515245u + 12345u;
+		Point.y = (Seed >> 8) % Height;
+	}
+
+	int SolidTiles = 0;
+	const auto SolidTilesStart = time_get_nanoseconds();
+	for(const auto &Point : vPoints)
+		SolidTiles += IsSolidTiles(Point.x, Point.y);
+	const auto SolidTilesTime = time_get_nanoseconds() - SolidTilesStart;
+
+	int SolidPlane = 0;
+	const auto SolidPlaneStart = time_get_nanoseconds();
+	for(const auto &Point : vPoints)
+		SolidPlane += m_Collision.IsSolid(Point.x, Point.y) != 0;
+	const auto SolidPlaneTime = time_get_nanoseconds() - SolidPlaneStart;
+
+	int StopperTiles = 0;
+	const auto StopperTilesStart = time_get_nanoseconds();
+	for(const auto &Point : vPoints)
+		StopperTiles += HasStopperTiles(m_Collision, vec2(Point.x, Point.y), 18.0f);
+	const auto StopperTilesTime = time_get_nanoseconds() - StopperTilesStart;
+
+	int Restricted = 0;
+	int NumMismatches = 0;
+	const auto StopperPlaneStart = time_get_nanoseconds();
+	for(const auto &Point : vPoints)
+		Restricted += m_Collision.GetMoveRestrictions(vec2(Point.x, Point.y)) != 0;
+	const auto StopperPlaneTime = time_get_nanoseconds() - StopperPlaneStart;
+	for(int i = 0; i < NumLookups; i += 64)
+	{
+		const vec2 Pos(vPoints[i].x, vPoints[i].y);
+		if(m_Collision.GetMoveRestrictions(Pos) != 0 && !HasStopperTiles(m_Collision, Pos, 18.0f))
+			NumMismatches++;
+	}
+
+	EXPECT_EQ(SolidTiles, SolidPlane);
+	EXPECT_EQ(NumMismatches, 0);
+	EXPECT_GT(Restricted, 0);
+	EXPECT_LE(Restricted, StopperTiles);
+	dbg_msg("test", "%d lookups on %dx%d tiles: solid %.2f ns/lookup on tiles, %.2f ns/lookup on bit plane, move restrictions %.2f ns/lookup on tiles, %.2f ns/lookup on bit plane",
+		NumLookups, m_Collision.GetWidth(), m_Collision.GetHeight(),
+		(double)SolidTilesTime.count() / NumLookups, (double)SolidPlaneTime.count() / NumLookups,
+		(double)StopperTilesTime.count() / NumLookups, (double)StopperPlaneTime.count() / NumLookups);
+}
+
+// the ray walks as they were before empty blocks were skipped
+static int IntersectLineWalk(const CCollision &Collision, vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision)
+{
+	float Distance = distance(Pos0, Pos1);
+	int End(Distance + 1);
+	vec2 Last = Pos0;
+	for(int i = 0; i <= End; i++)
+	{
+		float a = i / (float)End;
+		vec2 Pos = mix(Pos0, Pos1, a);
+		int ix = round_to_int(Pos.x);
+		int iy = round_to_int(Pos.y);
+
+		if(Collision.CheckPoint(ix, iy))
+		{
+			*pOutCollision = Pos;
+			*pOutBeforeCollision = Last;
+			return Collision.GetCollisionAt(ix, iy);
+		}
+
+		Last = Pos;
+	}
+	*pOutCollision = Pos1;
+	*pOutBeforeCollision = Pos1;
+	return 0;
+}
+
+static int IntersectLineTeleHookWalk(const CCollision &Collision, vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision, int *pTeleNr)
+{
+	float Distance = distance(Pos0, Pos1);
+	int End(Distance + 1);
+	vec2 Last = Pos0;
+	int dx = 0, dy = 0;
+	ThroughOffset(Pos0, Pos1, &dx, &dy);
+	for(int i = 0; i <= End; i++)
+	{
+		float a = i / (float)End;
+		vec2 Pos = mix(Pos0, Pos1, a);
+		int ix = round_to_int(Pos.x);
+		int iy = round_to_int(Pos.y);
+
+		int Index = Collision.GetPureMapIndex(Pos);
+		if(g_Config.m_SvOldTeleportHook)
+			*pTeleNr = Collision.IsTeleport(Index);
+		else
+			*pTeleNr = Collision.IsTeleportHook(Index);
+		if(*pTeleNr)
+		{
+			*pOutCollision = Pos;
+			*pOutBeforeCollision = Last;
+			return TILE_TELEINHOOK;
+		}
+
+		int hit = 0;
+		if(Collision.CheckPoint(ix, iy))
+		{
+			if(!Collision.IsThrough(ix, iy, dx, dy, Pos0, Pos1))
+				hit = Collision.GetCollisionAt(ix, iy);
+		}
+		else if(Collision.IsHookBlocker(ix, iy, Pos0, Pos1))
+		{
+			hit = TILE_NOHOOK;
+		}
+		if(hit)
+		{
+			*pOutCollision = Pos;
+			*pOutBeforeCollision = Last;
+			return hit;
+		}
+
+		Last = Pos;
+	}
+	*pOutCollision = Pos1;
+	*pOutBeforeCollision = Pos1;
+	return 0;
+}
+
+static void ExpectSameIntersections(const CCollision &Collision, vec2 Pos0, vec2 Pos1)
+{
+	vec2 Collision0, Before0, Collision1, Before1;
+	int Hit0 = IntersectLineWalk(Collision, Pos0, Pos1, &Collision0, &Before0);
+	int Hit1 = Collision.IntersectLine(Pos0, Pos1, &Collision1, &Before1);
+	ASSERT_EQ(Hit0, Hit1) << "line from " << Pos0.x << "," << Pos0.y << " to " << Pos1.x << "," << Pos1.y;
+	ASSERT_TRUE(Collision0.x == Collision1.x && Collision0.y == Collision1.y && Before0.x == Before1.x && Before0.y == Before1.y)
+		<< "line from " << Pos0.x << "," << Pos0.y << " to " << Pos1.x << "," << Pos1.y;
+
+	int TeleNr0 = -1, TeleNr1 = -1;
+	Hit0 = IntersectLineTeleHookWalk(Collision, Pos0, Pos1, &Collision0, &Before0, &TeleNr0);
+	Hit1 = Collision.IntersectLineTeleHook(Pos0, Pos1, &Collision1, &Before1, &TeleNr1);
+	ASSERT_EQ(Hit0, Hit1) << "hook from " << Pos0.x << "," << Pos0.y << " to " << Pos1.x << "," << Pos1.y;
+	ASSERT_EQ(TeleNr0, TeleNr1) << "hook from " << Pos0.x << "," << Pos0.y << " to " << Pos1.x << "," << Pos1.y;
+	ASSERT_TRUE(Collision0.x == Collision1.x && Collision0.y == Collision1.y && Before0.x == Before1.x && Before0.y == Before1.y)
+		<< "hook from " << Pos0.x << "," << Pos0.y << " to " << Pos1.x << "," << Pos1.y;
+}
+
+TEST_F(CTestCollision, SkipEmptyBlocks)
+{
+	LoadMap("maps/Tutorial.map");
+	const int Width = m_Collision.GetWidth();
+	const int Height = m_Collision.GetHeight();
+
+	// clear the game layer, except for sparse solid, unhookable and hook through tiles
+	unsigned Seed = 1;
+	const auto Random = [&Seed](unsigned Max) {
+		Seed = Seed * 1103515245u + 12345u;
+		return (Seed >> 8) % Max;
+	};
+	const int aSparseTiles[] = {TILE_SOLID, TILE_NOHOOK, TILE_THROUGH_CUT, TILE_THROUGH_ALL};
+	for(int y = 0; y < Height; y++)
+	{
+		for(int x = 0; x < Width; x++)
+		{
+			const int Index = Random(100) == 0 ? aSparseTiles[Random(std::size(aSparseTiles))] : (int)TILE_AIR;
+			m_Collision.SetCollisionAt(x * 32 + 16, y * 32 + 16, Index);
+		}
+	}
+
+	// random rays, starting and ending inside and outside of the map
+	const int MaxX = Width * 32 + 64;
+	const int MaxY = Height * 32 + 64;
+	for(int i = 0; i < 1500; i++)
+	{
+		const vec2 Pos0((int)Random(MaxX + 64) - 64 + Random(1000) / 1000.0f, (int)Random(MaxY + 64) - 64 + Random(1000) / 1000.0f);
+		const vec2 Pos1 = i % 2 ?
+					  vec2((int)Random(MaxX + 64) - 64 + Random(1000) / 1000.0f, (int)Random(MaxY + 64) - 64 + Random(1000) / 1000.0f) :
+					  Pos0 + vec2((int)Random(1601) - 800, (int)Random(1601) - 800);
+		ExpectSameIntersections(m_Collision, Pos0, Pos1);
+		if(HasFatalFailure())
+			return;
+	}
+
+	// axis-aligned rays on and next to the edges of the 8x8 tile blocks and the map
+	std::vector<int> vEdges = {0, Width * 32, Height * 32};
+	for(int i = 0; i < 100; i++)
+		vEdges.push_back(Random(std::max(Width, Height) / 8) * 8 * 32);
+	const float aOffsets[] = {-32.0f, -1.0f, -0.5f, -0.49f, 0.0f, 0.49f, 0.5f, 1.0f, 16.0f};
+	for(int Edge : vEdges)
+	{
+		for(float Offset : aOffsets)
+		{
+			const float Pos = Edge + Offset;
+			ExpectSameIntersections(m_Collision, vec2(-64.0f, Pos), vec2(MaxX, Pos));
+			ExpectSameIntersections(m_Collision, vec2(MaxX, Pos), vec2(-64.0f, Pos));
+			ExpectSameIntersections(m_Collision, vec2(Pos, -64.0f), vec2(Pos, MaxY));
+			ExpectSameIntersections(m_Collision, vec2(Pos, MaxY), vec2(Pos, -64.0f));
+			if(HasFatalFailure())
+				return;
+		}
+	}
+}
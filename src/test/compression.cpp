@@ -1,6 +1,10 @@
 #include <gtest/gtest.h>
 
+#include <base/system.h>
 #include <engine/shared/compression.h>
+#include <game/prng.h>
+
+#include <vector>
 
 static const int DATA[] = {0, 1, -1, 32, 64, 256, -512, 12345, -123456, 1234567, 12345678, 123456789, 2147483647, (-2147483647 - 1)};
 static const int NUM = std::size(DATA);
@@ -82,3 +86,84 @@ TEST(CVariableInt, DecompressBufferTooSmall)
 	long CompressedSize = CVariableInt::Decompress(aCompressed, sizeof(aCompressed), aUncompressed, sizeof(aUncompressed));
 	ASSERT_EQ(CompressedSize, -1);
 }
+
+// mostly small values like in snapshot deltas, with runs of zeros and a few large values
+static std::vector<int> DeltaLikeData(int Num, uint64_t Seed)
+{
+	uint64_t aSeed[2] = {Seed, Seed + 1};
+	CPrng Prng;
+	Prng.Seed(aSeed);
+	std::vector<int> vData(Num);
+	for(int &Value : vData)
+	{
+		const unsigned Kind = Prng.RandomBits() % 16;
+		const int Random = (int)Prng.RandomBits();
+		if(Kind < 8)
+			Value = 0;
+		else if(Kind < 13)
+			Value = Random % 64;
+		else if(Kind < 15)
+			Value = Random % 100000;
+		else
+			Value = Random;
+	}
+	return vData;
+}
+
+TEST(CVariableInt, CompressMatchesPack)
+{
+	for(int Num : {1, 7, 8, 9, 100, 1000})
+	{
+		const std::vector<int> vData = DeltaLikeData(Num, Num);
+		std::vector<unsigned char> vExpected(Num * CVariableInt::MAX_BYTES_PACKED);
+		unsigned char *pEnd = vExpected.data();
+		for(int Value : vData)
+			pEnd = CVariableInt::Pack(pEnd, Value, vExpected.data() + vExpected.size() - pEnd);
+		vExpected.resize(pEnd - vExpected.data());
+		const int ExpectedSize = vExpected.size();
+
+		std::vector<unsigned char> vCompressed(vExpected.size());
+		ASSERT_EQ(CVariableInt::Compress(vData.data(), Num * sizeof(int), vCompressed.data(), ExpectedSize), ExpectedSize);
+		EXPECT_EQ(vCompressed, vExpected);
+		for(int Missing = 1; Missing <= CVariableInt::MAX_BYTES_PACKED && Missing <= ExpectedSize; Missing++)
+			EXPECT_EQ(CVariableInt::Compress(vData.data(), Num * sizeof(int), vCompressed.data(), ExpectedSize - Missing), -1);
+
+		std::vector<int> vDecompressed(Num);
+		ASSERT_EQ(CVariableInt::Decompress(vExpected.data(), ExpectedSize, vDecompressed.data(), Num * sizeof(int)), (long)(Num * sizeof(int)));
+		EXPECT_EQ(vDecompressed, vData);
+		EXPECT_EQ(CVariableInt::Decompress(vExpected.data(), ExpectedSize, vDecompressed.data(), (Num - 1) * sizeof(int)), -1);
+		// cutting off the last byte either truncates the last int or drops it
+		const long Truncated = CVariableInt::Decompress(vExpected.data(), ExpectedSize - 1, vDecompressed.data(), Num * sizeof(int));
+		EXPECT_TRUE(Truncated == -1 || Truncated == (long)((Num - 1) * sizeof(int)));
+	}
+}
+
+TEST(CVariableInt, BenchmarkCompressDecompress)
+{
+	const int Num = 64 * 1024;
+	const int NumRounds = 20;
+	const std::vector<int> vData = DeltaLikeData(Num, 0);
+	std::vector<unsigned char> vCompressed(Num * CVariableInt::MAX_BYTES_PACKED);
+	std::vector<int> vDecompressed(Num);
+
+	long CompressedSize = 0;
+	const auto CompressStart = time_get_nanoseconds();
+	for(int Round = 0; Round < NumRounds; Round++)
+		CompressedSize = CVariableInt::Compress(vData.data(), Num * sizeof(int), vCompressed.data(), vCompressed.size());
+	const auto CompressTime = time_get_nanoseconds() - CompressStart;
+	ASSERT_GT(CompressedSize, 0);
+
+	long DecompressedSize = 0;
+	const auto DecompressStart = time_get_nanoseconds();
+	for(int Round = 0; Round < NumRounds; Round++)
+		DecompressedSize = CVariableInt::Decompress(vCompressed.data(), CompressedSize, vDecompressed.data(), Num * sizeof(int));
+	const auto DecompressTime = time_get_nanoseconds() - DecompressStart;
+	ASSERT_EQ(DecompressedSize, (long)(Num * sizeof(int)));
+	EXPECT_EQ(vDecompressed, vData);
+
+	const double Bytes = (double)Num * sizeof(int) * NumRounds;
+	dbg_msg("test", "%d ints to %ld bytes: compress %.1f MB/s, decompress %.1f MB/s",
+		Num, CompressedSize,
+		Bytes / 1e6 / (CompressTime.count() / 1e9),
+		Bytes / 1e6 / (DecompressTime.count() / 1e9));
+}
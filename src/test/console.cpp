@@ -0,0 +1,158 @@
+#include "test.h"
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/console.h>
+#include <engine/kernel.h>
+#include <engine/shared/config.h>
+#include <engine/storage.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+static void ConCount(IConsole::IResult *pResult, void *pUserData)
+{
+	(*static_cast<int *>(pUserData))++;
+}
+
+TEST(Console, FindCommand)
+{
+	std::unique_ptr<IConsole> pConsole = CreateConsole(CFGFLAG_SERVER | CFGFLAG_CLIENT);
+
+	int ServerCalls = 0;
+	int ClientCalls = 0;
+	pConsole->Register("Foo", "", CFGFLAG_SERVER, ConCount, &ServerCalls, "");
+	pConsole->Register("foo", "", CFGFLAG_CLIENT, ConCount, &ClientCalls, "");
+
+	const IConsole::ICommandInfo *pServerFoo = pConsole->GetCommandInfo("FOO", CFGFLAG_SERVER, false);
+	const IConsole::ICommandInfo *pClientFoo = pConsole->GetCommandInfo("fOo", CFGFLAG_CLIENT, false);
+	ASSERT_NE(pServerFoo, nullptr);
+	ASSERT_NE(pClientFoo, nullptr);
+	EXPECT_STREQ(pServerFoo->Name(), "Foo");
+	EXPECT_STREQ(pClientFoo->Name(), "foo");
+	EXPECT_EQ(pConsole->GetCommandInfo("foo", CFGFLAG_SERVER, true), nullptr);
+	EXPECT_EQ(pConsole->GetCommandInfo("fo", CFGFLAG_SERVER, false), nullptr);
+
+	// the first command in sorted order that matches the flags wins
+	pConsole->ExecuteLine("FOO");
+	EXPECT_EQ(ServerCalls, 1);
+	EXPECT_EQ(ClientCalls, 0);
+	pConsole->ExecuteLineFlag("foo", CFGFLAG_CLIENT);
+	EXPECT_EQ(ServerCalls, 1);
+	EXPECT_EQ(ClientCalls, 1);
+
+	// registering again replaces the command
+	int NewCalls = 0;
+	pConsole->Register("foo", "", CFGFLAG_SERVER, ConCount, &NewCalls, "");
+	pConsole->ExecuteLineFlag("foo", CFGFLAG_SERVER);
+	EXPECT_EQ(ServerCalls, 1);
+	EXPECT_EQ(NewCalls, 1);
+}
+
+TEST(Console, TempCommands)
+{
+	std::unique_ptr<IConsole> pConsole = CreateConsole(CFGFLAG_SERVER);
+
+	pConsole->RegisterTemp("tmp_a", "", CFGFLAG_SERVER, "");
+	pConsole->RegisterTemp("tmp_b", "", CFGFLAG_SERVER, "");
+	EXPECT_NE(pConsole->GetCommandInfo("TMP_A", CFGFLAG_SERVER, true), nullptr);
+	EXPECT_EQ(pConsole->GetCommandInfo("tmp_a", CFGFLAG_SERVER, false), nullptr);
+
+	pConsole->DeregisterTemp("tmp_a");
+	EXPECT_EQ(pConsole->GetCommandInfo("tmp_a", CFGFLAG_SERVER, true), nullptr);
+	EXPECT_NE(pConsole->GetCommandInfo("tmp_b", CFGFLAG_SERVER, true), nullptr);
+
+	// reuses the removed command
+	pConsole->RegisterTemp("tmp_c", "", CFGFLAG_SERVER, "");
+	EXPECT_EQ(pConsole->GetCommandInfo("tmp_a", CFGFLAG_SERVER, true), nullptr);
+	EXPECT_NE(pConsole->GetCommandInfo("tmp_c", CFGFLAG_SERVER, true), nullptr);
+
+	pConsole->DeregisterTempAll();
+	EXPECT_EQ(pConsole->GetCommandInfo("tmp_b", CFGFLAG_SERVER, true), nullptr);
+	EXPECT_EQ(pConsole->GetCommandInfo("tmp_c", CFGFLAG_SERVER, true), nullptr);
+	EXPECT_NE(pConsole->GetCommandInfo("echo", CFGFLAG_SERVER, false), nullptr);
+}
+
+// Executes an autoexec that sets every one of as many commands as a server
+// has config variables and chat commands, and compares the lookup in the
+// command list that FindCommand used to do with the hashed one.
+TEST(Console, BenchmarkExecuteFile)
+{
+	CTestInfo Info;
+	Info.m_DeleteTestStorageFilesOnSuccess = true;
+	std::unique_ptr<IStorage> pStorage = Info.CreateTestStorage();
+	ASSERT_NE(pStorage, nullptr);
+
+	std::unique_ptr<IKernel> pKernel = std::unique_ptr<IKernel>(IKernel::Create());
+	pKernel->RegisterInterface(pStorage.get(), false);
+	IConsole *pConsole = CreateConsole(CFGFLAG_SERVER).release();
+	pKernel->RegisterInterface(pConsole);
+	pConsole->Init();
+
+	const int NumCommands = 1000;
+	const int NumLines = 100000;
+	std::vector<std::string> vNames;
+	for(int i = 0; i < NumCommands; i++)
+		vNames.push_back("sv_variable_" + std::to_string(i * 7919 % NumCommands));
+	int Calls = 0;
+	for(const std::string &Name : vNames)
+		pConsole->Register(Name.c_str(), "?i[value]", CFGFLAG_SERVER, ConCount, &Calls, "");
+
+	std::vector<std::string> vLines;
+	unsigned Seed = 1;
+	for(int i = 0; i < NumLines; i++)
+	{
+		Seed = Seed * 1103515245u + 12345u;
+		vLines.push_back(vNames[(Seed >> 8) % NumCommands]);
+	}
+
+	char aFilename[IO_MAX_PATH_LENGTH];
+	Info.Filename(aFilename, sizeof(aFilename), ".cfg");
+	IOHANDLE File = pStorage->OpenFile(aFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+	ASSERT_TRUE(File);
+	for(const std::string &Line : vLines)
+	{
+		io_write(File, Line.c_str(), Line.size());
+		io_write(File, " 1\n", 3);
+	}
+	io_close(File);
+
+	const auto ExecStart = time_get_nanoseconds();
+	EXPECT_TRUE(pConsole->ExecuteFile(aFilename, -1, true, IStorage::TYPE_SAVE));
+	const auto ExecDuration = time_get_nanoseconds() - ExecStart;
+	EXPECT_EQ(Calls, NumLines);
+	pStorage->RemoveFile(aFilename, IStorage::TYPE_SAVE);
+
+	int ScanFound = 0;
+	const auto ScanStart = time_get_nanoseconds();
+	for(const std::string &Line : vLines)
+	{
+		for(const IConsole::ICommandInfo *pInfo = pConsole->FirstCommandInfo(IConsole::EAccessLevel::ADMIN, CFGFLAG_SERVER); pInfo; pInfo = pInfo->NextCommandInfo(IConsole::EAccessLevel::ADMIN, CFGFLAG_SERVER))
+		{
+			if(str_comp_nocase(pInfo->Name(), Line.c_str()) == 0)
+			{
+				ScanFound++;
+				break;
+			}
+		}
+	}
+	const auto ScanDuration = time_get_nanoseconds() - ScanStart;
+
+	int HashFound = 0;
+	const auto HashStart = time_get_nanoseconds();
+	for(const std::string &Line : vLines)
+	{
+		if(pConsole->GetCommandInfo(Line.c_str(), CFGFLAG_SERVER, false))
+			HashFound++;
+	}
+	const auto HashDuration = time_get_nanoseconds() - HashStart;
+	EXPECT_EQ(ScanFound, NumLines);
+	EXPECT_EQ(HashFound, NumLines);
+
+	dbg_msg("test", "exec %d lines: %.2fms, lookup scan: %.2fms, hashed: %.2fms",
+		NumLines,
+		ExecDuration.count() / 1000000.0,
+		ScanDuration.count() / 1000000.0,
+		HashDuration.count() / 1000000.0);
+}
@@ -2,6 +2,9 @@
 #include <gtest/gtest.h>
 #include <memory>
 
+#include <base/system.h>
+
+#include <engine/engine.h>
 #include <engine/shared/datafile.h>
 #include <engine/storage.h>
 #include <game/mapitems_ex.h>
@@ -109,3 +112,157 @@ TEST(Datafile, StringData)
 		pStorage->RemoveFile(Info.m_aFilename, IStorage::TYPE_SAVE);
 	}
 }
+
+TEST(Datafile, Mapped)
+{
+	std::unique_ptr<IStorage> pStorage = CreateLocalStorage();
+	ASSERT_NE(pStorage, nullptr) << "Error creating local storage";
+
+	CTestInfo Info;
+
+	CMapItemTest ItemTest;
+	ItemTest.m_Version = 1;
+	ItemTest.m_aFields[0] = 1234;
+	ItemTest.m_aFields[1] = 5678;
+	ItemTest.m_Field3 = 9876;
+	ItemTest.m_Field4 = 5432;
+
+	std::vector<int> vData(4096);
+	for(size_t i = 0; i < vData.size(); i++)
+		vData[i] = i * 7;
+
+	{
+		CDataFileWriter Writer;
+		ASSERT_TRUE(Writer.Open(pStorage.get(), Info.m_aFilename));
+
+		Writer.AddItem(MAPITEMTYPE_TEST, 0x8000, sizeof(ItemTest), &ItemTest);
+		for(int i = 0; i < 16; i++)
+			EXPECT_EQ(Writer.AddData((i + 1) * 256 * sizeof(int), vData.data()), i);
+		EXPECT_EQ(Writer.AddDataString("Abc"), 16);
+
+		Writer.Finish();
+	}
+
+	{
+		CDataFileReader Reader;
+		CDataFileReader MappedReader;
+		ASSERT_TRUE(Reader.Open(pStorage.get(), Info.m_aFilename, IStorage::TYPE_ALL));
+		ASSERT_TRUE(MappedReader.Open(pStorage.get(), Info.m_aFilename, IStorage::TYPE_ALL, true));
+
+		EXPECT_EQ(MappedReader.Sha256(), Reader.Sha256());
+		EXPECT_EQ(MappedReader.Crc(), Reader.Crc());
+		EXPECT_EQ(MappedReader.MapSize(), Reader.MapSize());
+		EXPECT_EQ(MappedReader.NumData(), Reader.NumData());
+
+		const CMapItemTest *pTest = (const CMapItemTest *)MappedReader.FindItem(MAPITEMTYPE_TEST, 0x8000);
+		ASSERT_NE(pTest, nullptr);
+		EXPECT_EQ(pTest->m_aFields[1], ItemTest.m_aFields[1]);
+		EXPECT_EQ(pTest->m_Field4, ItemTest.m_Field4);
+
+		std::vector<int> vIndices = {15, 3, 3, 0, 1000, -1};
+		for(int i = 0; i < MappedReader.NumData(); i++)
+			vIndices.push_back(i);
+		std::unique_ptr<IEngine> pEngine(CreateTestEngine("test"));
+		MappedReader.LoadData(vIndices, pEngine.get());
+		for(int i = 0; i < 16; i++)
+		{
+			ASSERT_EQ(MappedReader.GetDataSize(i), (i + 1) * 256 * (int)sizeof(int));
+			ASSERT_EQ(MappedReader.GetDataSize(i), Reader.GetDataSize(i));
+			EXPECT_EQ(mem_comp(MappedReader.GetData(i), Reader.GetData(i), MappedReader.GetDataSize(i)), 0);
+		}
+		EXPECT_STREQ(MappedReader.GetDataString(16), "Abc");
+
+		MappedReader.UnloadData(3);
+		EXPECT_EQ(mem_comp(MappedReader.GetData(3), vData.data(), 4 * 256 * sizeof(int)), 0);
+		int *pReplaced = static_cast<int *>(malloc(sizeof(int)));
+		*pReplaced = 42;
+		MappedReader.ReplaceData(3, reinterpret_cast<char *>(pReplaced), sizeof(int));
+		EXPECT_EQ(*static_cast<int *>(MappedReader.GetData(3)), 42);
+
+		MappedReader.Close();
+		Reader.Close();
+	}
+
+	if(!HasFailure())
+	{
+		pStorage->RemoveFile(Info.m_aFilename, IStorage::TYPE_SAVE);
+	}
+}
+
+TEST(Datafile, MappedUncompressed)
+{
+	std::unique_ptr<IStorage> pStorage = CreateLocalStorage();
+	ASSERT_NE(pStorage, nullptr) << "Error creating local storage";
+
+	CTestInfo Info;
+
+	// The writer only creates version 4 files with compressed data, so write
+	// a version 3 file without items and with uncompressed data by hand. The
+	// data starts aligned after the header and the data offsets, so the third
+	// block is the only one that is not aligned.
+	const char aData[] = "aligned\0oddunaligned";
+	const int aOffsets[] = {0, 8, 11};
+	const int NumData = std::size(aOffsets);
+	const int DataSize = sizeof(aData);
+	const int HeaderSize = 9 * sizeof(int);
+	const int SizeOffset = 4 * sizeof(int); // magic, version, size and swaplen
+	const int SwapSize = HeaderSize + sizeof(aOffsets);
+	int aHeader[] = {0, 3, SwapSize + DataSize - SizeOffset, SwapSize - SizeOffset, 0, 0, NumData, 0, DataSize};
+	mem_copy(aHeader, "DATA", 4);
+	int aFileOffsets[NumData];
+	mem_copy(aFileOffsets, aOffsets, sizeof(aOffsets));
+#if defined(CONF_ARCH_ENDIAN_BIG)
+	swap_endian(&aHeader[1], sizeof(int), std::size(aHeader) - 1);
+	swap_endian(aFileOffsets, sizeof(int), std::size(aFileOffsets));
+#endif
+	{
+		IOHANDLE File = pStorage->OpenFile(Info.m_aFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+		ASSERT_TRUE(File);
+		io_write(File, aHeader, sizeof(aHeader));
+		io_write(File, aFileOffsets, sizeof(aFileOffsets));
+		io_write(File, aData, sizeof(aData));
+		io_close(File);
+	}
+
+	{
+		CDataFileReader Reader;
+		CDataFileReader MappedReader;
+		ASSERT_TRUE(Reader.Open(pStorage.get(), Info.m_aFilename, IStorage::TYPE_ALL));
+		ASSERT_TRUE(MappedReader.Open(pStorage.get(), Info.m_aFilename, IStorage::TYPE_ALL, true));
+		ASSERT_EQ(MappedReader.NumData(), NumData);
+
+		std::unique_ptr<IEngine> pEngine(CreateTestEngine("test"));
+		MappedReader.LoadData({0, 1, 2}, pEngine.get());
+		const int aSizes[] = {8, 3, DataSize - 11};
+		for(int i = 0; i < NumData; i++)
+		{
+			ASSERT_EQ(MappedReader.GetDataSize(i), aSizes[i]);
+			ASSERT_EQ(Reader.GetDataSize(i), aSizes[i]);
+			EXPECT_EQ(mem_comp(MappedReader.GetData(i), aData + aOffsets[i], aSizes[i]), 0);
+			EXPECT_EQ(mem_comp(Reader.GetData(i), aData + aOffsets[i], aSizes[i]), 0);
+		}
+		EXPECT_STREQ(MappedReader.GetDataString(0), "aligned");
+		EXPECT_STREQ(MappedReader.GetDataString(2), "unaligned");
+
+		// the aligned blocks point into the mapping, so consecutive blocks
+		// are adjacent, the unaligned block is copied to aligned memory
+		EXPECT_EQ(static_cast<char *>(MappedReader.GetData(1)), static_cast<char *>(MappedReader.GetData(0)) + aOffsets[1]);
+		EXPECT_NE(static_cast<char *>(MappedReader.GetData(2)), static_cast<char *>(MappedReader.GetData(0)) + aOffsets[2]);
+		EXPECT_EQ((uintptr_t)MappedReader.GetData(2) % sizeof(int), 0u);
+
+		// unloading must not free the mapped blocks
+		for(int i = 0; i < NumData; i++)
+		{
+			MappedReader.UnloadData(i);
+			EXPECT_EQ(mem_comp(MappedReader.GetData(i), aData + aOffsets[i], aSizes[i]), 0);
+		}
+
+		MappedReader.Close();
+		Reader.Close();
+	}
+
+	if(!HasFailure())
+	{
+		pStorage->RemoveFile(Info.m_aFilename, IStorage::TYPE_SAVE);
+	}
+}
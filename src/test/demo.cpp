@@ -0,0 +1,120 @@
+#include "test.h"
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+
+#include <engine/shared/demo.h>
+#include <engine/shared/network.h>
+#include <engine/shared/snapshot.h>
+#include <engine/storage.h>
+
+#include <game/version.h>
+
+#include <generated/protocol.h>
+
+#include <memory>
+#include <vector>
+
+static const int FIRST_TICK = 100;
+static const int LAST_TICK = FIRST_TICK + 60 * SERVER_TICK_SPEED - 1;
+
+static void RecordDemo(IStorage *pStorage, CSnapshotDelta *pSnapshotDelta, const char *pFilename, const char *pTargetFilename)
+{
+	CDemoRecorder Recorder(pSnapshotDelta);
+	unsigned char aMapData[4] = {1, 2, 3, 4};
+	SHA256_DIGEST Sha256 = {};
+	ASSERT_EQ(Recorder.Start(pStorage, nullptr, pFilename, GAME_NETVERSION, "test", Sha256, 0, "client", sizeof(aMapData), aMapData, nullptr, nullptr, nullptr), 0);
+
+	CSnapshotBuilder Builder;
+	unsigned char aSnapshot[CSnapshot::MAX_SIZE];
+	for(int Tick = FIRST_TICK; Tick <= LAST_TICK; Tick++)
+	{
+		Builder.Init();
+		CNetObj_Flag *pFlag = static_cast<CNetObj_Flag *>(Builder.NewItem(CNetObj_Flag::ms_MsgId, 0, sizeof(CNetObj_Flag)));
+		pFlag->m_X = Tick;
+		pFlag->m_Y = Tick * 2;
+		pFlag->m_Team = 0;
+		const int Size = Builder.Finish(aSnapshot);
+		Recorder.RecordSnapshot(Tick, aSnapshot, Size);
+	}
+	EXPECT_EQ(Recorder.Stop(IDemoRecorder::EStopMode::KEEP_FILE, pTargetFilename), 0);
+}
+
+static void PlayDemo(IStorage *pStorage, CSnapshotDelta *pSnapshotDelta, const char *pFilename)
+{
+	CDemoPlayer Player(pSnapshotDelta, false);
+	ASSERT_EQ(Player.Load(pStorage, nullptr, pFilename, IStorage::TYPE_SAVE), 0);
+	EXPECT_EQ(Player.BaseInfo()->m_FirstTick, FIRST_TICK);
+	EXPECT_EQ(Player.BaseInfo()->m_LastTick, LAST_TICK);
+	EXPECT_EQ(Player.SetPos(LAST_TICK - SERVER_TICK_SPEED), 0);
+	EXPECT_TRUE(Player.IsPlaying()) << Player.ErrorMessage();
+	EXPECT_EQ(Player.Info()->m_NextTick, LAST_TICK - SERVER_TICK_SPEED);
+	Player.Stop();
+}
+
+static int64_t DemoSize(IStorage *pStorage, const char *pFilename)
+{
+	IOHANDLE File = pStorage->OpenFile(pFilename, IOFLAG_READ, IStorage::TYPE_SAVE);
+	if(!File)
+		return -1;
+	const int64_t Size = io_length(File);
+	io_close(File);
+	return Size;
+}
+
+TEST(Demo, KeyFrameIndex)
+{
+	CTestInfo Info;
+	Info.m_DeleteTestStorageFilesOnSuccess = true;
+	std::unique_ptr<IStorage> pStorage = Info.CreateTestStorage();
+	ASSERT_NE(pStorage, nullptr);
+	CNetBase::Init();
+	CSnapshotDelta SnapshotDelta;
+
+	// the index follows the demo to its final name
+	RecordDemo(pStorage.get(), &SnapshotDelta, "recording.demo", "test.demo");
+	EXPECT_FALSE(pStorage->FileExists("recording.demo.idx", IStorage::TYPE_SAVE));
+	EXPECT_TRUE(pStorage->FileExists("test.demo.idx", IStorage::TYPE_SAVE));
+
+	const int64_t Size = DemoSize(pStorage.get(), "test.demo");
+	int FirstTick, LastTick;
+	std::vector<CDemoKeyFrame> vKeyFrames;
+	ASSERT_TRUE(CDemoKeyFrameIndex::Read(pStorage.get(), "test.demo", IStorage::TYPE_SAVE, Size, &FirstTick, &LastTick, &vKeyFrames));
+	EXPECT_EQ(FirstTick, FIRST_TICK);
+	EXPECT_EQ(LastTick, LAST_TICK);
+	// a keyframe is written at least every 5 seconds
+	ASSERT_EQ(vKeyFrames.size(), 12u);
+	EXPECT_EQ(vKeyFrames.front().m_Tick, FIRST_TICK);
+	for(size_t i = 1; i < vKeyFrames.size(); i++)
+	{
+		EXPECT_GT(vKeyFrames[i].m_Filepos, vKeyFrames[i - 1].m_Filepos);
+		EXPECT_EQ(vKeyFrames[i].m_Tick - vKeyFrames[i - 1].m_Tick, SERVER_TICK_SPEED * 5 + 1);
+	}
+	EXPECT_FALSE(CDemoKeyFrameIndex::Read(pStorage.get(), "test.demo", IStorage::TYPE_SAVE, Size + 1, &FirstTick, &LastTick, &vKeyFrames));
+	EXPECT_TRUE(vKeyFrames.empty());
+
+	PlayDemo(pStorage.get(), &SnapshotDelta, "test.demo");
+
+	// without the index the demo is scanned
+	CDemoKeyFrameIndex::Rename(pStorage.get(), "test.demo", "other.demo", IStorage::TYPE_SAVE);
+	EXPECT_FALSE(pStorage->FileExists("test.demo.idx", IStorage::TYPE_SAVE));
+	EXPECT_TRUE(pStorage->FileExists("other.demo.idx", IStorage::TYPE_SAVE));
+	PlayDemo(pStorage.get(), &SnapshotDelta, "test.demo");
+
+	// an index of a different demo with the same name is ignored
+	ASSERT_TRUE(pStorage->RenameFile("other.demo.idx", "test.demo.idx", IStorage::TYPE_SAVE));
+	IOHANDLE File = pStorage->OpenFile("test.demo", IOFLAG_APPEND, IStorage::TYPE_SAVE);
+	ASSERT_TRUE(File);
+	const unsigned char Padding = 0;
+	io_write(File, &Padding, sizeof(Padding));
+	io_close(File);
+	PlayDemo(pStorage.get(), &SnapshotDelta, "test.demo");
+
+	// recording over a demo replaces its index
+	RecordDemo(pStorage.get(), &SnapshotDelta, "test.demo", "");
+	EXPECT_TRUE(CDemoKeyFrameIndex::Read(pStorage.get(), "test.demo", IStorage::TYPE_SAVE, DemoSize(pStorage.get(), "test.demo"), &FirstTick, &LastTick, &vKeyFrames));
+
+	pStorage->RemoveFile("test.demo", IStorage::TYPE_SAVE);
+	CDemoKeyFrameIndex::Remove(pStorage.get(), "test.demo", IStorage::TYPE_SAVE);
+	EXPECT_FALSE(pStorage->FileExists("test.demo.idx", IStorage::TYPE_SAVE));
+}
@@ -23,8 +23,12 @@
 #include <game/server/gameworld.h>
 #include <game/version.h>
 
+#include <chrono>
 #include <memory>
 #include <thread>
+#include <vector>
+
+#include <zlib.h>
 
 bool IsInterrupted()
 {
@@ -253,6 +257,55 @@ TEST_F(CTestGameWorld, IntersectEntity)
 	EXPECT_EQ(pIntersectedChar, pChrRight);
 }
 
+TEST_F(CTestGameWorld, EntityGridMatchesScan)
+{
+	CNetObj_PlayerInput Input = {};
+	CGameWorld &World = GameServer()->m_World;
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		CCharacter *pChr = new(i) CCharacter(&World, Input);
+		pChr->m_Pos = vec2((i * 397) % 3000, (i * 211) % 1500);
+		World.InsertEntity(pChr);
+	}
+
+	for(int Round = 0; Round < 2; Round++)
+	{
+		for(int x = -200; x < 3200; x += 170)
+		{
+			for(int y = -200; y < 1700; y += 130)
+			{
+				const vec2 Pos(x, y);
+				const float Radius = 50.0f + (x + y) % 400;
+
+				std::vector<CEntity *> vpExpected;
+				for(CEntity *pEnt = World.FindFirst(CGameWorld::ENTTYPE_CHARACTER); pEnt; pEnt = pEnt->TypeNext())
+					if(distance(pEnt->m_Pos, Pos) < Radius + pEnt->GetProximityRadius())
+						vpExpected.push_back(pEnt);
+
+				CEntity *apEnts[MAX_CLIENTS];
+				const int Num = World.FindEntities(Pos, Radius, apEnts, MAX_CLIENTS, CGameWorld::ENTTYPE_CHARACTER);
+				ASSERT_EQ(Num, (int)vpExpected.size());
+				for(int i = 0; i < Num; i++)
+					EXPECT_EQ(apEnts[i], vpExpected[i]);
+
+				std::vector<CCharacter *> vpIntersected = World.IntersectedCharacters(Pos, Pos + vec2(300, 120), 10.0f);
+				std::vector<CCharacter *> vpExpectedIntersected;
+				for(CEntity *pEnt = World.FindFirst(CGameWorld::ENTTYPE_CHARACTER); pEnt; pEnt = pEnt->TypeNext())
+				{
+					vec2 IntersectPos;
+					if(closest_point_on_line(Pos, Pos + vec2(300, 120), pEnt->m_Pos, IntersectPos) && distance(pEnt->m_Pos, IntersectPos) < pEnt->GetProximityRadius() + 10.0f)
+						vpExpectedIntersected.push_back((CCharacter *)pEnt);
+				}
+				EXPECT_EQ(vpIntersected, vpExpectedIntersected);
+			}
+		}
+
+		// move everyone from outside of the world tick, the grid has to follow
+		for(CEntity *pEnt = World.FindFirst(CGameWorld::ENTTYPE_CHARACTER); pEnt; pEnt = pEnt->TypeNext())
+			pEnt->m_Pos = vec2(3000, 1500) - pEnt->m_Pos;
+	}
+}
+
 TEST_F(CTestGameWorld, BasicTick)
 {
 	int ClientId = 0;
@@ -308,3 +361,161 @@ TEST_F(CTestGameWorld, CharacterEmote)
 	pChr->Freeze(10);
 	ASSERT_EQ(pChr->DetermineEyeEmote(), EMOTE_ANGRY);
 }
+
+TEST_F(CTestGameWorld, ParallelTickMatchesSerial)
+{
+	struct CCoreState
+	{
+		vec2 m_Pos;
+		vec2 m_Vel;
+		vec2 m_HookPos;
+		vec2 m_HookDir;
+		vec2 m_HookTeleBase;
+		int m_HookTick;
+		int m_HookState;
+		int m_HookedPlayer;
+		int m_Jumped;
+		int m_JumpedTotal;
+		int m_Jumps;
+		int m_Colliding;
+		int m_TriggeredEvents;
+		bool m_LeftWall;
+	};
+
+	// four teams of three and four solo players, all starting at the same spawn
+	const int NumClients = 16;
+	const int NumTicks = 500;
+	const auto &&Run = [&]() {
+		for(int ClientId = 0; ClientId < NumClients; ClientId++)
+		{
+			GameServer()->CreatePlayer(ClientId, TEAM_RED, false, -1);
+			vec2 SpawnPos;
+			EXPECT_TRUE(GameServer()->m_pController->CanSpawn(TEAM_RED, &SpawnPos, 0));
+			GameServer()->m_apPlayers[ClientId]->ForceSpawn(SpawnPos);
+			CCharacter *pChr = GameServer()->GetPlayerChar(ClientId);
+			EXPECT_NE(pChr, nullptr);
+			if(ClientId < 12)
+				GameServer()->m_pController->Teams().SetForceCharacterTeam(ClientId, 1 + ClientId % 4);
+			else
+				pChr->SetSolo(true);
+		}
+
+		std::vector<CCoreState> vStates;
+		uint32_t Random = 1;
+		for(int Tick = 0; Tick < NumTicks; Tick++)
+		{
+			for(int ClientId = 0; ClientId < NumClients; ClientId++)
+			{
+				CCharacter *pChr = GameServer()->GetPlayerChar(ClientId);
+				if(!pChr)
+					continue;
+				Random = Random * 1103515245 + 12345;
+				CNetObj_PlayerInput Input = {};
+				Input.m_Direction = (int)((Random >> 16) % 3) - 1;
+				Input.m_Jump = (Random >> 20) % 8 == 0;
+				Input.m_Hook = (Random >> 24) % 4 != 0;
+				Input.m_TargetX = (int)((Random >> 8) % 400) - 200;
+				Input.m_TargetY = -(int)((Random >> 4) % 200);
+				pChr->OnPredictedInput(&Input);
+				pChr->OnDirectInput(&Input);
+			}
+			GameServer()->OnTick();
+
+			for(int ClientId = 0; ClientId < NumClients; ClientId++)
+			{
+				CCoreState State;
+				mem_zero(&State, sizeof(State));
+				CCharacter *pChr = GameServer()->GetPlayerChar(ClientId);
+				if(pChr)
+				{
+					const CCharacterCore &Core = *pChr->Core();
+					State.m_Pos = Core.m_Pos;
+					State.m_Vel = Core.m_Vel;
+					State.m_HookPos = Core.m_HookPos;
+					State.m_HookDir = Core.m_HookDir;
+					State.m_HookTeleBase = Core.m_HookTeleBase;
+					State.m_HookTick = Core.m_HookTick;
+					State.m_HookState = Core.m_HookState;
+					State.m_HookedPlayer = Core.HookedPlayer();
+					State.m_Jumped = Core.m_Jumped;
+					State.m_JumpedTotal = Core.m_JumpedTotal;
+					State.m_Jumps = Core.m_Jumps;
+					State.m_Colliding = Core.m_Colliding;
+					State.m_TriggeredEvents = Core.m_TriggeredEvents;
+					State.m_LeftWall = Core.m_LeftWall;
+				}
+				vStates.push_back(State);
+			}
+		}
+		return vStates;
+	};
+
+	ASSERT_EQ(m_pServer->WorldJobPool(), nullptr);
+	const std::vector<CCoreState> vSerial = Run();
+
+	// the worker threads are picked up by the world of the next map
+	m_pServer->Config()->m_SvWorldThreads = 4;
+	EXPECT_NE(m_pServer->LoadMap("coverage"), 0);
+	GameServer()->OnShutdown(nullptr);
+	m_pKernel->ReregisterInterface(m_pGameServer);
+	GameServer()->OnInit(nullptr);
+	ASSERT_NE(m_pServer->WorldJobPool(), nullptr);
+	const std::vector<CCoreState> vParallel = Run();
+	m_pServer->Config()->m_SvWorldThreads = 0;
+
+	ASSERT_EQ(vSerial.size(), vParallel.size());
+	for(size_t i = 0; i < vSerial.size(); i++)
+		ASSERT_EQ(mem_comp(&vSerial[i], &vParallel[i], sizeof(CCoreState)), 0) << "tick " << i / NumClients << ", client " << i % NumClients;
+}
+
+TEST_F(CTestGameWorld, PreloadedMapDownload)
+{
+	// copies of a map and another one as its 0.7 version, which are
+	// removed before LoadMap, so it can only take them from the preload
+	ASSERT_TRUE(m_pStorage->CreateFolder("maps", IStorage::TYPE_SAVE));
+	ASSERT_TRUE(m_pStorage->CreateFolder("maps7", IStorage::TYPE_SAVE));
+	const char *apFrom[CServer::NUM_MAP_TYPES] = {"maps/Tutorial.map", "maps/dm1.map"};
+	const char *apTo[CServer::NUM_MAP_TYPES] = {"maps/preloaded.map", "maps7/preloaded.map"};
+	std::vector<unsigned char> avData[CServer::NUM_MAP_TYPES];
+	for(int i = 0; i < CServer::NUM_MAP_TYPES; i++)
+	{
+		void *pData;
+		unsigned Size;
+		ASSERT_TRUE(m_pStorage->ReadFile(apFrom[i], IStorage::TYPE_ALL, &pData, &Size));
+		avData[i].assign(static_cast<unsigned char *>(pData), static_cast<unsigned char *>(pData) + Size);
+		free(pData);
+		IOHANDLE File = m_pStorage->OpenFile(apTo[i], IOFLAG_WRITE, IStorage::TYPE_SAVE);
+		ASSERT_TRUE(File);
+		io_write(File, avData[i].data(), avData[i].size());
+		io_close(File);
+	}
+
+	CConfig *pConfig = m_pServer->Config();
+	const int OldSixup = pConfig->m_SvSixup;
+	pConfig->m_SvSixup = 1;
+	str_copy(pConfig->m_SvMap, "preloaded");
+	m_pServer->m_MapReload = true;
+	EXPECT_TRUE(m_pServer->PreloadingMap());
+	for(int i = 0; i < 1000 && m_pServer->PreloadingMap(); i++)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	ASSERT_FALSE(m_pServer->PreloadingMap());
+
+	// removing open files fails on Windows, the maps are then read again
+	for(const char *pTo : apTo)
+		m_pStorage->RemoveFile(pTo, IStorage::TYPE_SAVE);
+	ASSERT_NE(m_pServer->LoadMap("preloaded"), 0);
+	EXPECT_EQ(pConfig->m_SvSixup, 1);
+	for(int i = 0; i < CServer::NUM_MAP_TYPES; i++)
+	{
+		ASSERT_NE(m_pServer->m_apCurrentMapData[i], nullptr) << "map type " << i;
+		ASSERT_EQ(m_pServer->m_aCurrentMapSize[i], avData[i].size()) << "map type " << i;
+		EXPECT_EQ(mem_comp(m_pServer->m_apCurrentMapData[i], avData[i].data(), avData[i].size()), 0) << "map type " << i;
+		EXPECT_EQ(m_pServer->m_aCurrentMapSha256[i], sha256(avData[i].data(), avData[i].size())) << "map type " << i;
+		EXPECT_EQ(m_pServer->m_aCurrentMapCrc[i], crc32(0, avData[i].data(), avData[i].size())) << "map type " << i;
+	}
+
+	pConfig->m_SvSixup = OldSixup;
+	GameServer()->OnShutdown(nullptr);
+	m_pKernel->ReregisterInterface(m_pGameServer);
+	GameServer()->OnInit(nullptr);
+}
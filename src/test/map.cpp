@@ -0,0 +1,118 @@
+#include "test.h"
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/kernel.h>
+#include <engine/map.h>
+#include <engine/storage.h>
+
+#include <game/mapitems.h>
+
+#include <memory>
+
+class CTestMap : public ::testing::Test
+{
+public:
+	std::unique_ptr<IKernel> m_pKernel;
+	CTestInfo m_TestInfo;
+	std::unique_ptr<IStorage> m_pStorage;
+	IEngineMap *m_pMap = nullptr;
+
+	CTestMap()
+	{
+		m_pKernel = std::unique_ptr<IKernel>(IKernel::Create());
+
+		m_TestInfo.m_DeleteTestStorageFilesOnSuccess = true;
+		m_pStorage = m_TestInfo.CreateTestStorage();
+		EXPECT_NE(m_pStorage, nullptr);
+		m_pKernel->RegisterInterface(m_pStorage.get(), false);
+
+		m_pMap = CreateEngineMap();
+		m_pKernel->RegisterInterface(m_pMap);
+		m_pKernel->RegisterInterface(static_cast<IMap *>(m_pMap), false);
+	}
+
+	// copies a map into the test storage, so it can be removed while it is preloaded
+	void CopyMap(const char *pFrom, const char *pTo)
+	{
+		void *pData;
+		unsigned Size;
+		ASSERT_TRUE(m_pStorage->ReadFile(pFrom, IStorage::TYPE_ALL, &pData, &Size));
+		IOHANDLE File = m_pStorage->OpenFile(pTo, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+		if(File)
+		{
+			io_write(File, pData, Size);
+			io_close(File);
+		}
+		free(pData);
+		ASSERT_TRUE(File);
+	}
+
+	SHA256_DIGEST LoadedSha256(const char *pMapName)
+	{
+		EXPECT_TRUE(m_pMap->Load(pMapName));
+		return m_pMap->Sha256();
+	}
+};
+
+TEST_F(CTestMap, FailedPreload)
+{
+	const SHA256_DIGEST Sha256 = LoadedSha256("maps/Tutorial.map");
+
+	// a failed preload leaves the loaded map alone
+	EXPECT_FALSE(m_pMap->Preload("maps/does_not_exist.map"));
+	ASSERT_TRUE(m_pMap->IsLoaded());
+	EXPECT_EQ(m_pMap->Sha256(), Sha256);
+	EXPECT_NE(m_pMap->FindItem(MAPITEMTYPE_VERSION, 0), nullptr);
+	EXPECT_EQ(LoadedSha256("maps/Tutorial.map"), Sha256);
+}
+
+TEST_F(CTestMap, PreloadKeepsCurrentMap)
+{
+	ASSERT_NO_FATAL_FAILURE(CopyMap("maps/Tutorial.map", "preloaded.map"));
+	const SHA256_DIGEST PreloadedSha256 = LoadedSha256("preloaded.map");
+	const SHA256_DIGEST Sha256 = LoadedSha256("maps/dm1.map");
+	ASSERT_NE(PreloadedSha256, Sha256);
+	const int NumItems = m_pMap->NumItems();
+	const int NumData = m_pMap->NumData();
+
+	// the current map stays readable until the preloaded one is loaded
+	ASSERT_TRUE(m_pMap->Preload("preloaded.map"));
+	EXPECT_EQ(m_pMap->Sha256(), Sha256);
+	EXPECT_EQ(m_pMap->NumItems(), NumItems);
+	EXPECT_EQ(m_pMap->NumData(), NumData);
+	int LayersStart, LayersNum;
+	m_pMap->GetType(MAPITEMTYPE_LAYER, &LayersStart, &LayersNum);
+	ASSERT_GT(LayersNum, 0);
+	for(int i = 0; i < LayersNum; i++)
+	{
+		const CMapItemLayer *pLayer = static_cast<CMapItemLayer *>(m_pMap->GetItem(LayersStart + i));
+		if(pLayer->m_Type != LAYERTYPE_TILES)
+			continue;
+		const CMapItemLayerTilemap *pTilemap = reinterpret_cast<const CMapItemLayerTilemap *>(pLayer);
+		EXPECT_NE(m_pMap->GetData(pTilemap->m_Data), nullptr);
+		EXPECT_EQ(m_pMap->GetDataSize(pTilemap->m_Data), pTilemap->m_Width * pTilemap->m_Height * (int)sizeof(CTile));
+	}
+
+	// loading takes the preloaded file, even if it was removed in the
+	// meantime. Removing an open file fails on Windows, the map is then
+	// loaded from the file again.
+	m_pStorage->RemoveFile("preloaded.map", IStorage::TYPE_SAVE);
+	ASSERT_TRUE(m_pMap->Load("preloaded.map"));
+	EXPECT_EQ(m_pMap->Sha256(), PreloadedSha256);
+}
+
+TEST_F(CTestMap, LoadDropsPreload)
+{
+	ASSERT_NO_FATAL_FAILURE(CopyMap("maps/Tutorial.map", "preloaded.map"));
+	const SHA256_DIGEST Sha256 = LoadedSha256("maps/dm1.map");
+
+	// loading another map closes the preloaded file, so it can't be loaded
+	// anymore once it is removed
+	ASSERT_TRUE(m_pMap->Preload("preloaded.map"));
+	EXPECT_EQ(LoadedSha256("maps/dm1.map"), Sha256);
+	EXPECT_TRUE(m_pStorage->RemoveFile("preloaded.map", IStorage::TYPE_SAVE));
+	EXPECT_FALSE(m_pMap->Load("preloaded.map"));
+	ASSERT_TRUE(m_pMap->IsLoaded());
+	EXPECT_EQ(m_pMap->Sha256(), Sha256);
+}
@@ -1,8 +1,12 @@
 #include <gtest/gtest.h>
 
 #include <base/system.h>
+#include <engine/shared/config.h>
+#include <engine/shared/network.h>
 
 #include <chrono>
+#include <unordered_map>
+#include <vector>
 
 using namespace std::chrono_literals;
 
@@ -52,3 +56,277 @@ TEST(Net, Ipv4AndIpv6Work)
 	net_udp_close(Socket1);
 	net_udp_close(Socket2);
 }
+
+TEST(Net, BatchedSend)
+{
+	NETADDR Bindaddr = {};
+	NETSOCKET Receiver;
+	NETSOCKET Sender;
+
+	Bindaddr.type = NETTYPE_IPV4;
+	Sender = net_udp_create(Bindaddr);
+	ASSERT_TRUE(Sender);
+	do
+	{
+		Bindaddr.port = secure_rand() % 64511 + 1024;
+	} while(!(Receiver = net_udp_create(Bindaddr)));
+
+	NETADDR Target;
+	ASSERT_FALSE(net_addr_from_str(&Target, "127.0.0.1"));
+	Target.port = Bindaddr.port;
+
+	// more packets than fit into one batch, but few enough to not overflow
+	// the receive buffer of the socket
+	const int NumPackets = 160;
+	// port 0 can't be sent to, the packet gets skipped
+	NETADDR Invalid = Target;
+	Invalid.port = 0;
+	for(int Round = 0; Round < 2; Round++)
+	{
+		NETSTATS Before;
+		net_stats(&Before);
+		net_udp_send_batch_begin(Sender);
+		int Bytes = 0;
+		for(int i = 0; i < NumPackets; i++)
+		{
+			char aBuf[16];
+			str_format(aBuf, sizeof(aBuf), "packet %d", i);
+			EXPECT_EQ(net_udp_send(Sender, &Target, aBuf, str_length(aBuf)), str_length(aBuf));
+			Bytes += str_length(aBuf);
+			if(i == NumPackets / 2)
+				net_udp_send(Sender, &Invalid, aBuf, str_length(aBuf));
+		}
+		net_udp_send_batch_flush(Sender);
+		NETSTATS After;
+		net_stats(&After);
+		EXPECT_EQ(After.sent_packets - Before.sent_packets, (uint64_t)NumPackets);
+		EXPECT_EQ(After.sent_bytes - Before.sent_bytes, (uint64_t)Bytes);
+
+		for(int i = 0; i < NumPackets; i++)
+		{
+			NETADDR Addr;
+			unsigned char *pData;
+			int RecvBytes;
+			while((RecvBytes = net_udp_recv(Receiver, &Addr, &pData)) <= 0)
+				ASSERT_EQ(net_socket_read_wait(Receiver, 10s), 1);
+			char aExpected[16];
+			str_format(aExpected, sizeof(aExpected), "packet %d", i);
+			ASSERT_EQ(RecvBytes, str_length(aExpected));
+			EXPECT_EQ(mem_comp(pData, aExpected, RecvBytes), 0);
+		}
+	}
+
+	net_udp_close(Receiver);
+	net_udp_close(Sender);
+}
+
+struct CSlotEvents
+{
+	int m_NumNew = 0;
+	int m_LastNew = -1;
+};
+
+static int NewClient(int ClientId, void *pUser, bool Sixup)
+{
+	CSlotEvents *pEvents = static_cast<CSlotEvents *>(pUser);
+	pEvents->m_NumNew++;
+	pEvents->m_LastNew = ClientId;
+	return 0;
+}
+
+static int NewClientNoAuth(int ClientId, void *pUser)
+{
+	return NewClient(ClientId, pUser, false);
+}
+
+static int ClientRejoin(int ClientId, void *pUser)
+{
+	return 0;
+}
+
+static int DelClient(int ClientId, const char *pReason, void *pUser)
+{
+	return 0;
+}
+
+// returns the slot the server accepted the client in, -1 on failure
+static int ConnectClient(CNetServer &Server, CSlotEvents &Events, CNetClient &Client, const NETADDR &ServerAddr)
+{
+	const int NumNew = Events.m_NumNew;
+	Client.Connect(&ServerAddr, 1);
+	for(int i = 0; i < 1000 && (Events.m_NumNew == NumNew || Client.State() != NETSTATE_ONLINE); i++)
+	{
+		CNetChunk Chunk;
+		SECURITY_TOKEN ResponseToken;
+		Client.Update();
+		while(Server.Recv(&Chunk, &ResponseToken))
+			;
+		Server.Update();
+		while(Client.Recv(&Chunk, &ResponseToken, false))
+			;
+		net_socket_read_wait(Client.m_Socket, 10ms);
+	}
+	return Events.m_NumNew == NumNew + 1 ? Events.m_LastNew : -1;
+}
+
+TEST(Net, ClientSlotIndex)
+{
+	CNetBase::Init();
+	const CConfig OldConfig = g_Config;
+	g_Config.m_ConnTimeout = CConfig::ms_ConnTimeout;
+	g_Config.m_ConnTimeoutProtection = CConfig::ms_ConnTimeoutProtection;
+	// all clients connect from the same IP
+	g_Config.m_SvConnlimit = 0;
+	g_Config.m_SvConnlimitTime = 0;
+
+	NETADDR ServerAddr;
+	ASSERT_FALSE(net_addr_from_str(&ServerAddr, "127.0.0.1"));
+	CNetServer Server;
+	do
+	{
+		ServerAddr.port = secure_rand() % 64511 + 1024;
+	} while(!Server.Open(ServerAddr, nullptr, 4, 4));
+	CSlotEvents Events;
+	Server.SetCallbacks(NewClient, NewClientNoAuth, ClientRejoin, DelClient, &Events);
+
+	NETADDR BindAddr = {};
+	BindAddr.type = NETTYPE_IPV4;
+	CNetClient aClients[3];
+	for(auto &Client : aClients)
+		ASSERT_TRUE(Client.Open(BindAddr));
+
+	// accept
+	const int SlotA = ConnectClient(Server, Events, aClients[0], ServerAddr);
+	const int SlotB = ConnectClient(Server, Events, aClients[1], ServerAddr);
+	ASSERT_NE(SlotA, -1);
+	ASSERT_NE(SlotB, -1);
+	ASSERT_NE(SlotA, SlotB);
+	const NETADDR AddrA = *Server.ClientAddr(SlotA);
+	const NETADDR AddrB = *Server.ClientAddr(SlotB);
+	EXPECT_EQ(Server.GetClientSlot(AddrA), SlotA);
+	EXPECT_EQ(Server.GetClientSlot(AddrB), SlotB);
+	NETADDR Unknown = AddrA;
+	Unknown.port++;
+	EXPECT_EQ(Server.GetClientSlot(Unknown), Unknown == AddrB ? SlotB : -1);
+
+	// drop
+	Server.Drop(SlotB, "test");
+	EXPECT_EQ(Server.GetClientSlot(AddrB), -1);
+	EXPECT_EQ(Server.GetClientSlot(AddrA), SlotA);
+	for(int i = 0; i < 1000 && aClients[1].State() != NETSTATE_OFFLINE; i++)
+	{
+		CNetChunk Chunk;
+		SECURITY_TOKEN ResponseToken;
+		net_socket_read_wait(aClients[1].m_Socket, 10ms);
+		while(aClients[1].Recv(&Chunk, &ResponseToken, false))
+			;
+		aClients[1].Update();
+	}
+	ASSERT_EQ(aClients[1].State(), NETSTATE_OFFLINE);
+
+	// timeout, the slot keeps its address but doesn't get its packets anymore
+	Server.SetTimeoutProtected(SlotA);
+	g_Config.m_ConnTimeout = 0;
+	Server.Update();
+	g_Config.m_ConnTimeout = CConfig::ms_ConnTimeout;
+	EXPECT_EQ(Server.GetClientSlot(AddrA), -1);
+
+	// the timed out slot takes over the connection of its new client
+	const int SlotC = ConnectClient(Server, Events, aClients[2], ServerAddr);
+	ASSERT_NE(SlotC, -1);
+	const NETADDR AddrC = *Server.ClientAddr(SlotC);
+	EXPECT_EQ(Server.GetClientSlot(AddrC), SlotC);
+	ASSERT_TRUE(Server.SetTimedOut(SlotA, SlotC));
+	EXPECT_EQ(Server.GetClientSlot(AddrC), SlotA);
+	EXPECT_EQ(Server.GetClientSlot(AddrA), -1);
+
+	// reconnect from the address of a dropped client
+	const int SlotB2 = ConnectClient(Server, Events, aClients[1], ServerAddr);
+	ASSERT_NE(SlotB2, -1);
+	EXPECT_EQ(Server.GetClientSlot(AddrB), SlotB2);
+	EXPECT_EQ(Server.GetClientSlot(AddrC), SlotA);
+
+	Server.Drop(SlotA, "test");
+	EXPECT_EQ(Server.GetClientSlot(AddrC), -1);
+	EXPECT_EQ(Server.GetClientSlot(AddrB), SlotB2);
+
+	for(auto &Client : aClients)
+		Client.Close();
+	Server.Close();
+	g_Config = OldConfig;
+}
+
+// Compares the linear scan over all client slots that CNetServer used to
+// find the slot of an incoming packet with the address index it uses now.
+// A CNetServer has at most NET_MAX_CLIENTS slots, so the larger slot counts
+// use an index of the same type as the one in CNetServer.
+TEST(Net, BenchmarkClientSlotLookup)
+{
+	const int NumLookups = 1 << 18;
+	for(int NumSlots : {64, 128, 256})
+	{
+		std::vector<NETADDR> vSlotAddrs(NumSlots);
+		std::unordered_map<NETADDR, int> AddrSlots;
+		for(int i = 0; i < NumSlots; i++)
+		{
+			NETADDR &Addr = vSlotAddrs[i];
+			Addr = NETADDR{};
+			Addr.type = NETTYPE_IPV4;
+			Addr.ip[0] = 10;
+			Addr.ip[2] = i / 256;
+			Addr.ip[3] = i % 256;
+			Addr.port = 8303 + i;
+			AddrSlots[Addr] = i;
+		}
+		// hits come from the address of a slot, misses from the same IP
+		// with another port
+		std::vector<NETADDR> vHits(NumLookups);
+		std::vector<NETADDR> vMisses(NumLookups);
+		unsigned Seed = 1;
+		for(int i = 0; i < NumLookups; i++)
+		{
+			Seed = Seed * 1103515245u + 12345u;
+			vHits[i] = vSlotAddrs[(Seed >> 8) % NumSlots];
+			vMisses[i] = vHits[i];
+			vMisses[i].port += NumSlots;
+		}
+
+		const auto &&ScanLookups = [&](const std::vector<NETADDR> &vPackets, int64_t *pSum) {
+			const auto Start = time_get_nanoseconds();
+			for(const auto &Packet : vPackets)
+			{
+				int Slot = -1;
+				for(int i = 0; i < NumSlots; i++)
+				{
+					if(net_addr_comp(&vSlotAddrs[i], &Packet) == 0)
+					{
+						Slot = i;
+						break;
+					}
+				}
+				*pSum += Slot;
+			}
+			return (double)(time_get_nanoseconds() - Start).count() / vPackets.size();
+		};
+		const auto &&IndexLookups = [&](const std::vector<NETADDR> &vPackets, int64_t *pSum) {
+			const auto Start = time_get_nanoseconds();
+			for(const auto &Packet : vPackets)
+			{
+				const auto It = AddrSlots.find(Packet);
+				*pSum += It == AddrSlots.end() ? -1 : It->second;
+			}
+			return (double)(time_get_nanoseconds() - Start).count() / vPackets.size();
+		};
+
+		int64_t ScanHitSum = 0, IndexHitSum = 0, ScanMissSum = 0, IndexMissSum = 0;
+		const double ScanHitTime = ScanLookups(vHits, &ScanHitSum);
+		const double IndexHitTime = IndexLookups(vHits, &IndexHitSum);
+		const double ScanMissTime = ScanLookups(vMisses, &ScanMissSum);
+		const double IndexMissTime = IndexLookups(vMisses, &IndexMissSum);
+		EXPECT_EQ(ScanHitSum, IndexHitSum);
+		EXPECT_EQ(ScanMissSum, -NumLookups);
+		EXPECT_EQ(IndexMissSum, -NumLookups);
+		dbg_msg("test", "%d slots: linear scan %.1f ns/hit %.1f ns/miss, address index %.1f ns/hit %.1f ns/miss",
+			NumSlots, ScanHitTime, ScanMissTime, IndexHitTime, IndexMissTime);
+	}
+}
@@ -0,0 +1,93 @@
+#include "test.h"
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/external/json-parser/json.h>
+#include <engine/shared/profiler.h>
+#include <engine/shared/protocol.h>
+
+TEST(Profiler, Sections)
+{
+	CProfiler Profiler;
+	const int First = Profiler.Section("first");
+	const int Second = Profiler.Section("second");
+	EXPECT_NE(First, Second);
+	EXPECT_EQ(Profiler.Section("first"), First);
+	EXPECT_EQ(Profiler.NumSections(), 2);
+	EXPECT_STREQ(Profiler.GetSection(Second).m_pName, "second");
+}
+
+TEST(Profiler, Histogram)
+{
+	CProfiler Profiler;
+	const int Section = Profiler.Section("section");
+	for(int i = 0; i < 98; i++)
+		Profiler.Add(Section, 0, 1500);
+	Profiler.Add(Section, 0, 100000);
+	Profiler.Add(Section, 0, 2 * 1000000000 / SERVER_TICK_SPEED);
+
+	const CProfiler::CSection &Stats = Profiler.GetSection(Section);
+	EXPECT_EQ(Stats.m_Count, 100);
+	EXPECT_EQ(Stats.m_TotalNs, 98 * 1500 + 100000 + 2 * 1000000000 / SERVER_TICK_SPEED);
+	EXPECT_EQ(Stats.m_MaxNs, 2 * 1000000000 / SERVER_TICK_SPEED);
+	EXPECT_EQ(Stats.m_OverBudget, 1);
+	// 1.5us lies in the bucket below 2us, 100us in the one below 128us
+	EXPECT_EQ(Profiler.Percentile(Section, 0.5f), 2000);
+	EXPECT_EQ(Profiler.Percentile(Section, 0.99f), 128000);
+	EXPECT_EQ(Profiler.Percentile(Section, 1.0f), Stats.m_MaxNs);
+
+	Profiler.Reset();
+	EXPECT_EQ(Profiler.GetSection(Section).m_Count, 0);
+	EXPECT_STREQ(Profiler.GetSection(Section).m_pName, "section");
+}
+
+TEST(Profiler, Disabled)
+{
+	CProfiler Profiler;
+	EXPECT_FALSE(Profiler.Enabled());
+	Profiler.SetEnabled(true);
+	EXPECT_TRUE(Profiler.Enabled());
+}
+
+TEST(Profiler, Trace)
+{
+	CTestInfo Info;
+	IOHANDLE File = io_open(Info.m_aFilename, IOFLAG_WRITE);
+	ASSERT_TRUE(File);
+
+	CProfiler Profiler;
+	const int Tick = Profiler.Section("tick");
+	const int Snap = Profiler.Section("snap");
+	Profiler.StartTrace(File, 2);
+	EXPECT_TRUE(Profiler.Enabled());
+	for(int i = 0; i < 3; i++)
+	{
+		Profiler.OnTick();
+		if(!Profiler.Tracing())
+			break;
+		const int64_t Now = time_get_nanoseconds().count();
+		Profiler.Add(Tick, Now, 3000);
+		Profiler.Add(Snap, Now + 3000, 500);
+	}
+	EXPECT_FALSE(Profiler.Tracing());
+	EXPECT_FALSE(Profiler.Enabled());
+
+	File = io_open(Info.m_aFilename, IOFLAG_READ);
+	ASSERT_TRUE(File);
+	char *pTrace = io_read_all_str(File);
+	io_close(File);
+	ASSERT_TRUE(pTrace);
+	json_value *pJson = json_parse(pTrace, str_length(pTrace));
+	free(pTrace);
+	ASSERT_TRUE(pJson);
+
+	const json_value &Events = (*pJson)["traceEvents"];
+	ASSERT_EQ(Events.type, json_array);
+	ASSERT_EQ(Events.u.array.length, 4u);
+	EXPECT_STREQ(Events[0]["name"], "tick");
+	EXPECT_STREQ(Events[1]["name"], "snap");
+	EXPECT_STREQ(Events[1]["ph"], "X");
+	EXPECT_DOUBLE_EQ((double)Events[1]["dur"], 0.5);
+	json_value_free(pJson);
+	fs_remove(Info.m_aFilename);
+}
@@ -5,10 +5,13 @@
 #include <engine/server/databases/connection.h>
 #include <engine/server/databases/connection_pool.h>
 #include <engine/shared/config.h>
+#include <game/server/leaderboard.h>
 #include <game/server/scoreworker.h>
 
 #include <sqlite3.h>
 
+#include <string>
+
 #if defined(CONF_TEST_MYSQL)
 int DummyMysqlInit = (MysqlInit(), 1);
 #endif
@@ -551,6 +554,151 @@ TEST_P(Points, EqualPointsTop)
 			"-------------------------------"});
 }
 
+struct Leaderboard : public Score
+{
+	std::shared_ptr<CScoreLeaderboardResult> m_pLeaderboardResult{std::make_shared<CScoreLeaderboardResult>()};
+	CSqlLeaderboardRequest m_LeaderboardRequest{m_pLeaderboardResult};
+
+	Leaderboard()
+	{
+		str_copy(m_LeaderboardRequest.m_aMap, "Kobra 3", sizeof(m_LeaderboardRequest.m_aMap));
+		m_LeaderboardRequest.m_MaxPoints = 10;
+	}
+
+	// pServer can be nullptr for ranks without a server
+	void InsertServerRank(const char *pName, const char *pServer, float Time)
+	{
+		char aBuf[256];
+		str_format(aBuf, sizeof(aBuf), "INSERT INTO %s_race(Map, Name, Time, Server) VALUES (?, ?, ?, ?)", m_pConn->GetPrefix());
+		ASSERT_TRUE(m_pConn->PrepareStatement(aBuf, m_aError, sizeof(m_aError))) << m_aError;
+		m_pConn->BindString(1, "Kobra 3");
+		m_pConn->BindString(2, pName);
+		m_pConn->BindFloat(3, Time);
+		if(pServer)
+			m_pConn->BindString(4, pServer);
+		else
+			m_pConn->BindNull(4);
+		int NumInserted = 0;
+		ASSERT_TRUE(m_pConn->ExecuteUpdate(&NumInserted, m_aError, sizeof(m_aError))) << m_aError;
+		ASSERT_EQ(NumInserted, 1);
+	}
+
+	void ExpectSameResult(const CScorePlayerResult &Database, const CScorePlayerResult &Cache)
+	{
+		EXPECT_EQ(Database.m_MessageKind, Cache.m_MessageKind);
+		for(int i = 0; i < CScorePlayerResult::MAX_MESSAGES; i++)
+			EXPECT_STREQ(Database.m_Data.m_aaMessages[i], Cache.m_Data.m_aaMessages[i]) << "line " << i;
+	}
+};
+
+TEST_P(Leaderboard, Load)
+{
+	InsertRank(100.0);
+	InsertRank(90.0);
+	m_pConn->AddPoints("nameless tee", 2, m_aError, sizeof(m_aError));
+	m_pConn->AddPoints("brainless tee", 3, m_aError, sizeof(m_aError));
+	ASSERT_TRUE(CScoreWorker::LoadLeaderboard(m_pConn, &m_LeaderboardRequest, m_aError, sizeof(m_aError))) << m_aError;
+
+	ASSERT_EQ(m_pLeaderboardResult->m_vMapTimes.size(), 1u);
+	EXPECT_STREQ(m_pLeaderboardResult->m_vMapTimes[0].m_aName, "nameless tee");
+	EXPECT_STREQ(m_pLeaderboardResult->m_vMapTimes[0].m_aServer, "USA");
+	EXPECT_EQ(m_pLeaderboardResult->m_vMapTimes[0].m_Time, 90.0f);
+
+	// the first finish gave the 5 points of the map
+	ASSERT_EQ(m_pLeaderboardResult->m_vPoints.size(), 2u);
+	EXPECT_STREQ(m_pLeaderboardResult->m_vPoints[0].m_aName, "nameless tee");
+	EXPECT_EQ(m_pLeaderboardResult->m_vPoints[0].m_Points, 7);
+	EXPECT_STREQ(m_pLeaderboardResult->m_vPoints[1].m_aName, "brainless tee");
+	EXPECT_EQ(m_pLeaderboardResult->m_vPoints[1].m_Points, 3);
+}
+
+TEST_P(Leaderboard, LoadMaxPoints)
+{
+	m_pConn->AddPoints("nameless tee", 2, m_aError, sizeof(m_aError));
+	m_pConn->AddPoints("brainless tee", 3, m_aError, sizeof(m_aError));
+	m_LeaderboardRequest.m_MaxPoints = 1;
+	ASSERT_TRUE(CScoreWorker::LoadLeaderboard(m_pConn, &m_LeaderboardRequest, m_aError, sizeof(m_aError))) << m_aError;
+	ASSERT_EQ(m_pLeaderboardResult->m_vPoints.size(), 1u);
+	EXPECT_STREQ(m_pLeaderboardResult->m_vPoints[0].m_aName, "brainless tee");
+}
+
+TEST_P(Leaderboard, CacheMatchesQueries)
+{
+	InsertServerRank("usa", "USA", 100.0f);
+	InsertServerRank("usa lowercase", "usa", 101.0f);
+	InsertServerRank("usa suffix", "USA2", 102.0f);
+	InsertServerRank("ger", "GER", 103.0f);
+	InsertServerRank("empty server", "", 104.0f);
+	InsertServerRank("no server", nullptr, 90.0f);
+	InsertServerRank("usa and ger", "GER", 106.0f);
+	InsertServerRank("usa and ger", "USA", 107.0f);
+	ASSERT_TRUE(CScoreWorker::LoadLeaderboard(m_pConn, &m_LeaderboardRequest, m_aError, sizeof(m_aError))) << m_aError;
+
+	const int OldLeaderboardCache = g_Config.m_SvLeaderboardCache;
+	g_Config.m_SvLeaderboardCache = 60;
+	for(const char *pServer : {"USA", "GER", "US", "", "U_A"})
+	{
+		CLeaderboard Cache;
+		Cache.Fill("Kobra 3", pServer, *m_pLeaderboardResult, m_LeaderboardRequest.m_MaxPoints);
+		str_copy(m_PlayerRequest.m_aMap, "Kobra 3");
+		str_copy(m_PlayerRequest.m_aServer, pServer);
+		str_copy(m_PlayerRequest.m_aRequestingPlayer, "brainless tee");
+		for(bool Regional : {false, true})
+		{
+			g_Config.m_SvRegionalRankings = Regional;
+			for(const char *pName : {"usa", "usa lowercase", "usa suffix", "ger", "empty server", "no server", "usa and ger", "nobody"})
+			{
+				SCOPED_TRACE(std::string("server '") + pServer + "', rank of " + pName);
+				auto pDatabase = std::make_shared<CScorePlayerResult>();
+				m_PlayerRequest.m_pResult = pDatabase;
+				str_copy(m_PlayerRequest.m_aName, pName);
+				ASSERT_TRUE(CScoreWorker::ShowRank(m_pConn, &m_PlayerRequest, m_aError, sizeof(m_aError))) << m_aError;
+				CScorePlayerResult Cached;
+				ASSERT_TRUE(Cache.ShowRank(&Cached, pName, "brainless tee"));
+				ExpectSameResult(*pDatabase, Cached);
+			}
+			for(int Offset : {0, 1, 3, -1})
+			{
+				SCOPED_TRACE(std::string("server '") + pServer + "', top5 at " + std::to_string(Offset));
+				auto pDatabase = std::make_shared<CScorePlayerResult>();
+				m_PlayerRequest.m_pResult = pDatabase;
+				m_PlayerRequest.m_Offset = Offset;
+				ASSERT_TRUE(CScoreWorker::ShowTop(m_pConn, &m_PlayerRequest, m_aError, sizeof(m_aError))) << m_aError;
+				CScorePlayerResult Cached;
+				ASSERT_TRUE(Cache.ShowTop(&Cached, Offset));
+				ExpectSameResult(*pDatabase, Cached);
+			}
+		}
+	}
+	g_Config.m_SvLeaderboardCache = OldLeaderboardCache;
+}
+
+TEST(LeaderboardRanking, Ties)
+{
+	CRanking<int, true> Ranking;
+	Ranking.Improve("a", 3);
+	Ranking.Improve("b", 5);
+	Ranking.Improve("c", 3);
+	Ranking.Improve("d", 1);
+	// lower values don't replace better ones
+	Ranking.Improve("b", 2);
+
+	int Value;
+	EXPECT_EQ(Ranking.Find("b", &Value), 1);
+	EXPECT_EQ(Value, 5);
+	EXPECT_EQ(Ranking.Find("a", &Value), 2);
+	EXPECT_EQ(Ranking.Find("c", &Value), 2);
+	EXPECT_EQ(Ranking.Find("d", &Value), 4);
+	EXPECT_EQ(Ranking.Find("e", &Value), 0);
+
+	Ranking.Improve("d", 6);
+	EXPECT_EQ(Ranking.Find("d", &Value), 1);
+	EXPECT_EQ(Ranking.Find("b", &Value), 2);
+	ASSERT_EQ(Ranking.Size(), 4);
+	EXPECT_EQ(Ranking.Entry(2).m_Name, "a");
+	EXPECT_EQ(Ranking.Rank(3), 3);
+}
+
 struct RandomMap : public Score
 {
 	std::shared_ptr<CScoreRandomMapResult> m_pRandomMapResult{std::make_shared<CScoreRandomMapResult>(0)};
@@ -649,4 +797,5 @@ INSTANTIATE(TeamScore);
 INSTANTIATE(MapInfo);
 INSTANTIATE(MapVote);
 INSTANTIATE(Points);
+INSTANTIATE(Leaderboard);
 INSTANTIATE(RandomMap);
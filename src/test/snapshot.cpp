@@ -6,6 +6,8 @@
 
 #include <generated/protocol.h>
 
+#include <vector>
+
 TEST(Snapshot, CrcOneInt)
 {
 	CSnapshotBuilder Builder;
@@ -85,3 +87,171 @@ TEST(Snapshot, CrcOverflow)
 
 	ASSERT_EQ(pSnapshot->Crc(), 1);
 }
+
+static void AddFlag(CSnapshotBuilder *pBuilder, int Id, int X)
+{
+	CNetObj_Flag *pFlag = (CNetObj_Flag *)pBuilder->NewItem(CNetObj_Flag::ms_MsgId, Id, sizeof(CNetObj_Flag));
+	ASSERT_FALSE(pFlag == nullptr);
+	pFlag->m_X = X;
+	pFlag->m_Y = Id;
+	pFlag->m_Team = 0;
+}
+
+TEST(SnapshotDelta, Unchanged)
+{
+	CSnapshotBuilder Builder;
+	Builder.Init();
+	for(int i = 0; i < 3; i++)
+		AddFlag(&Builder, i, i * 10);
+	char aData[CSnapshot::MAX_SIZE];
+	CSnapshot *pSnapshot = (CSnapshot *)aData;
+	Builder.Finish(pSnapshot);
+
+	CSnapshotDelta Delta;
+	char aDeltaData[CSnapshot::MAX_SIZE];
+	EXPECT_EQ(Delta.CreateDelta(pSnapshot, pSnapshot, aDeltaData), 0);
+}
+
+TEST(SnapshotDelta, RoundTrip)
+{
+	CSnapshotBuilder Builder;
+	Builder.Init();
+	for(int i = 0; i < 8; i++)
+		AddFlag(&Builder, i, i * 10);
+	char aFrom[CSnapshot::MAX_SIZE];
+	CSnapshot *pFrom = (CSnapshot *)aFrom;
+	Builder.Finish(pFrom);
+
+	// deleted, changed, unchanged, new and reordered items
+	Builder.Init();
+	AddFlag(&Builder, 1, 10);
+	AddFlag(&Builder, 2, 25);
+	AddFlag(&Builder, 9, 90);
+	AddFlag(&Builder, 3, 30);
+	AddFlag(&Builder, 7, 70);
+	AddFlag(&Builder, 5, 55);
+	AddFlag(&Builder, 4, 40);
+	char aTo[CSnapshot::MAX_SIZE];
+	CSnapshot *pTo = (CSnapshot *)aTo;
+	Builder.Finish(pTo);
+
+	CSnapshotDelta Delta;
+	char aDeltaData[CSnapshot::MAX_SIZE];
+	const int DeltaSize = Delta.CreateDelta(pFrom, pTo, aDeltaData);
+	ASSERT_GT(DeltaSize, 0);
+	const CSnapshotDelta::CData *pDelta = (const CSnapshotDelta::CData *)aDeltaData;
+	EXPECT_EQ(pDelta->m_NumDeletedItems, 2);
+	EXPECT_EQ(pDelta->m_NumUpdateItems, 3);
+
+	char aUnpacked[CSnapshot::MAX_SIZE];
+	CSnapshot *pUnpacked = (CSnapshot *)aUnpacked;
+	const int UnpackedSize = Delta.UnpackDelta(pFrom, pUnpacked, aDeltaData, DeltaSize, false);
+	ASSERT_GT(UnpackedSize, 0);
+	ASSERT_EQ(pUnpacked->NumItems(), pTo->NumItems());
+	for(int i = 0; i < pTo->NumItems(); i++)
+	{
+		const CSnapshotItem *pItem = pTo->GetItem(i);
+		const void *pUnpackedItem = pUnpacked->FindItem(pItem->Type(), pItem->Id());
+		ASSERT_FALSE(pUnpackedItem == nullptr);
+		EXPECT_EQ(mem_comp(pUnpackedItem, pItem->Data(), pTo->GetItemSize(i)), 0);
+	}
+	EXPECT_EQ(pUnpacked->Crc(), pTo->Crc());
+}
+
+// a snapshot like that of a full server: characters and player infos that
+// change every tick and pickups that don't
+static void BuildBenchmarkSnapshot(CSnapshotBuilder *pBuilder, int Tick)
+{
+	pBuilder->Init();
+	for(int i = 0; i < 64; i++)
+	{
+		CNetObj_PlayerInfo *pInfo = (CNetObj_PlayerInfo *)pBuilder->NewItem(CNetObj_PlayerInfo::ms_MsgId, i, sizeof(CNetObj_PlayerInfo));
+		pInfo->m_Local = 0;
+		pInfo->m_ClientId = i;
+		pInfo->m_Team = 0;
+		pInfo->m_Score = i * 100;
+		pInfo->m_Latency = 20 + (Tick + i) % 7;
+
+		CNetObj_Character *pCharacter = (CNetObj_Character *)pBuilder->NewItem(CNetObj_Character::ms_MsgId, i, sizeof(CNetObj_Character));
+		mem_zero(pCharacter, sizeof(*pCharacter));
+		pCharacter->m_Tick = Tick;
+		pCharacter->m_X = i * 320 + Tick * 3;
+		pCharacter->m_Y = 1000 + (Tick * 7 + i) % 50;
+		pCharacter->m_VelX = 256 * ((Tick + i) % 5);
+		pCharacter->m_Angle = (Tick * 13 + i) % 628;
+		pCharacter->m_Direction = 1;
+		pCharacter->m_Health = 10;
+		pCharacter->m_Weapon = i % 3;
+	}
+	for(int i = 0; i < 300; i++)
+	{
+		// a few pickups get picked up and respawn
+		if((i + Tick / 10) % 50 == 0)
+			continue;
+		CNetObj_Pickup *pPickup = (CNetObj_Pickup *)pBuilder->NewItem(CNetObj_Pickup::ms_MsgId, 64 + i, sizeof(CNetObj_Pickup));
+		pPickup->m_X = (i % 30) * 64;
+		pPickup->m_Y = (i / 30) * 64;
+		pPickup->m_Type = i % 3;
+		pPickup->m_Subtype = 0;
+	}
+}
+
+TEST(SnapshotDelta, BenchmarkCreateAndUnpack)
+{
+	const int NumSnapshots = 64;
+	const int NumRounds = 50;
+	CSnapshotBuilder Builder;
+	std::vector<std::vector<char>> vvSnapshots(NumSnapshots + 1);
+	for(int i = 0; i <= NumSnapshots; i++)
+	{
+		vvSnapshots[i].resize(CSnapshot::MAX_SIZE);
+		BuildBenchmarkSnapshot(&Builder, i * 2);
+		vvSnapshots[i].resize(Builder.Finish(vvSnapshots[i].data()));
+	}
+
+	CSnapshotDelta Delta;
+	Delta.SetStaticsize(CNetObj_PlayerInfo::ms_MsgId, sizeof(CNetObj_PlayerInfo));
+	Delta.SetStaticsize(CNetObj_Character::ms_MsgId, sizeof(CNetObj_Character));
+	Delta.SetStaticsize(CNetObj_Pickup::ms_MsgId, sizeof(CNetObj_Pickup));
+	std::vector<std::vector<char>> vvDeltas(NumSnapshots);
+	char aDeltaData[CSnapshot::MAX_SIZE];
+
+	int64_t DeltaBytes = 0;
+	const auto CreateStart = time_get_nanoseconds();
+	for(int Round = 0; Round < NumRounds; Round++)
+	{
+		for(int i = 0; i < NumSnapshots; i++)
+		{
+			const int Size = Delta.CreateDelta((const CSnapshot *)vvSnapshots[i].data(), (const CSnapshot *)vvSnapshots[i + 1].data(), aDeltaData);
+			if(Round == 0)
+			{
+				vvDeltas[i].assign(aDeltaData, aDeltaData + Size);
+				DeltaBytes += Size;
+			}
+		}
+	}
+	const auto CreateTime = time_get_nanoseconds() - CreateStart;
+
+	char aUnpacked[CSnapshot::MAX_SIZE];
+	CSnapshot *pUnpacked = (CSnapshot *)aUnpacked;
+	int NumMismatches = 0;
+	const auto UnpackStart = time_get_nanoseconds();
+	for(int Round = 0; Round < NumRounds; Round++)
+	{
+		for(int i = 0; i < NumSnapshots; i++)
+		{
+			const int Size = Delta.UnpackDelta((const CSnapshot *)vvSnapshots[i].data(), pUnpacked, vvDeltas[i].data(), vvDeltas[i].size(), false);
+			// the items can end up in a different order
+			const CSnapshot *pExpected = (const CSnapshot *)vvSnapshots[i + 1].data();
+			if(Round == 0 && (Size != (int)vvSnapshots[i + 1].size() || pUnpacked->NumItems() != pExpected->NumItems() || pUnpacked->Crc() != pExpected->Crc()))
+				NumMismatches++;
+		}
+	}
+	const auto UnpackTime = time_get_nanoseconds() - UnpackStart;
+
+	EXPECT_EQ(NumMismatches, 0);
+	const CSnapshot *pFirst = (const CSnapshot *)vvSnapshots[0].data();
+	dbg_msg("test", "%d items, %.0f delta bytes: create %.2f us/delta, unpack %.2f us/delta",
+		pFirst->NumItems(), (double)DeltaBytes / NumSnapshots,
+		CreateTime.count() / 1000.0 / (NumRounds * NumSnapshots), UnpackTime.count() / 1000.0 / (NumRounds * NumSnapshots));
+}
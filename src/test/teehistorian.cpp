@@ -1,12 +1,17 @@
+#include "test.h"
 #include <gtest/gtest.h>
 
 #include <base/detect.h>
 #include <engine/external/json-parser/json.h>
 #include <engine/server.h>
 #include <engine/shared/config.h>
+#include <engine/shared/teehistorian_compressed.h>
 #include <game/gamecore.h>
 #include <game/server/teehistorian.h>
+#include <game/teehistorian_reader.h>
 
+#include <cstdarg>
+#include <string>
 #include <vector>
 
 void RegisterGameUuids(CUuidManager *pManager);
@@ -22,6 +27,9 @@ protected:
 
 	std::vector<unsigned char> m_vBuffer;
 
+	CCompressedTeeHistorianWriter *m_pCompressed = nullptr;
+	std::vector<std::vector<unsigned char>> m_vvFrameStates;
+
 	enum
 	{
 		STATE_NONE,
@@ -93,6 +101,8 @@ protected:
 	{
 		TeeHistorian *pThis = (TeeHistorian *)pUser;
 		WriteBuffer(pThis->m_vBuffer, pData, DataSize);
+		if(pThis->m_pCompressed)
+			pThis->m_pCompressed->Write(pData, DataSize);
 	}
 
 	void Reset(const CTeeHistorian::CGameInfo *pGameInfo)
@@ -188,6 +198,13 @@ protected:
 			m_TH.EndInputs();
 			m_TH.EndTick();
 		}
+		if(m_pCompressed && m_pCompressed->FrameDue(Tick))
+		{
+			std::vector<unsigned char> vState;
+			m_TH.SerializeState(vState);
+			m_pCompressed->BeginFrame(Tick, vState.data(), vState.size());
+			m_vvFrameStates.push_back(vState);
+		}
 		m_TH.BeginTick(Tick);
 		m_TH.BeginPlayers();
 		m_State = STATE_PLAYERS;
@@ -223,6 +240,29 @@ protected:
 		Char.m_Y = y;
 		m_TH.RecordPlayer(ClientId, &Char);
 	}
+
+	// writes 95 ticks of two players with a frame every 10 ticks
+	void WriteCompressedGame(const char *pFilename)
+	{
+		IOHANDLE File = io_open(pFilename, IOFLAG_WRITE);
+		ASSERT_TRUE(File);
+
+		CCompressedTeeHistorianWriter Writer;
+		Writer.Open(File, 10);
+		m_pCompressed = &Writer;
+		Reset(&m_GameInfo);
+		for(int i = 1; i <= 95; i++)
+		{
+			Tick(i);
+			Player(0, i, -i);
+			if(i % 3 == 0)
+				Player(1, 2 * i, 5);
+		}
+		Finish();
+		Writer.Close();
+		m_pCompressed = nullptr;
+		ASSERT_FALSE(Writer.Error());
+	}
 };
 
 TEST_F(TeeHistorian, Empty)
@@ -904,3 +944,210 @@ TEST_F(TeeHistorian, PrevGameUuid)
 	EXPECT_STREQ(JsonPrevGameUuid, "fe19c218-f555-4002-a273-126c59ccc17a");
 	json_value_free(pJson);
 }
+
+TEST_F(TeeHistorian, Compressed)
+{
+	CTestInfo Info;
+	char aFilename[IO_MAX_PATH_LENGTH];
+	Info.Filename(aFilename, sizeof(aFilename), ".teehistorian.z");
+	ASSERT_NO_FATAL_FAILURE(WriteCompressedGame(aFilename));
+
+	CCompressedTeeHistorianReader Reader;
+	IOHANDLE File = io_open(aFilename, IOFLAG_READ);
+	ASSERT_TRUE(File);
+	ASSERT_TRUE(Reader.Open(File));
+	// the frame with the header and one every 10 ticks starting at the first tick
+	ASSERT_EQ(Reader.NumFrames(), 11);
+	EXPECT_EQ(Reader.FindFrame(-1), -1);
+	EXPECT_EQ(Reader.FindFrame(0), 0);
+	EXPECT_EQ(Reader.FindFrame(5), 1);
+	EXPECT_EQ(Reader.FindFrame(50), 5);
+	EXPECT_EQ(Reader.FindFrame(51), 6);
+	EXPECT_EQ(Reader.FindFrame(1000), 10);
+
+	std::vector<unsigned char> vData;
+	std::vector<unsigned char> vState;
+	std::vector<unsigned char> vFrameData;
+	for(int i = 0; i < Reader.NumFrames(); i++)
+	{
+		EXPECT_EQ(Reader.Frame(i).m_Tick, i == 0 ? 0 : 1 + (i - 1) * 10);
+		EXPECT_EQ(Reader.Frame(i).m_DataOffset, (int64_t)vData.size());
+		ASSERT_TRUE(Reader.ReadFrame(i, vState, vFrameData));
+		if(i == 0)
+			EXPECT_TRUE(vState.empty());
+		else
+			EXPECT_EQ(vState, m_vvFrameStates[i - 1]);
+		vData.insert(vData.end(), vFrameData.begin(), vFrameData.end());
+	}
+	EXPECT_EQ(vData, m_vBuffer);
+
+	// without the index and with the last frame cut off, like after a crash
+	const int64_t TruncatedSize = Reader.Frame(5).m_FileOffset + 10;
+	Reader.Close();
+	File = io_open(aFilename, IOFLAG_READ);
+	ASSERT_TRUE(File);
+	void *pFile;
+	unsigned FileSize;
+	ASSERT_TRUE(io_read_all(File, &pFile, &FileSize));
+	io_close(File);
+	File = io_open(aFilename, IOFLAG_WRITE);
+	ASSERT_TRUE(File);
+	io_write(File, pFile, TruncatedSize);
+	io_close(File);
+	free(pFile);
+
+	File = io_open(aFilename, IOFLAG_READ);
+	ASSERT_TRUE(File);
+	ASSERT_TRUE(Reader.Open(File));
+	ASSERT_EQ(Reader.NumFrames(), 5);
+	ASSERT_TRUE(Reader.ReadFrame(4, vState, vFrameData));
+	EXPECT_EQ(vState, m_vvFrameStates[3]);
+	Reader.Close();
+
+	EXPECT_FALSE(fs_remove(aFilename));
+}
+
+class CTeeHistorianEventLog : public CTeeHistorianReader::IListener
+{
+public:
+	std::vector<std::string> m_vEvents;
+
+	[[gnu::format(printf, 2, 3)]] void Add(const char *pFormat, ...)
+	{
+		char aBuf[128];
+		va_list Args;
+		va_start(Args, pFormat);
+		str_format_v(aBuf, sizeof(aBuf), pFormat, Args);
+		va_end(Args);
+		m_vEvents.emplace_back(aBuf);
+	}
+
+	void OnTick(int Tick) override { Add("tick %d", Tick); }
+	void OnPlayer(int ClientId, int x, int y) override { Add("player %d %d %d", ClientId, x, y); }
+	void OnDeadPlayer(int ClientId) override { Add("dead %d", ClientId); }
+	void OnInput(int ClientId, const CNetObj_PlayerInput *pInput) override { Add("input %d %d %d", ClientId, pInput->m_Direction, pInput->m_TargetX); }
+	void OnMessage(int ClientId, const void *pMsg, int MsgSize) override { Add("message %d %d", ClientId, MsgSize); }
+	void OnJoin(int ClientId) override { Add("join %d", ClientId); }
+	void OnJoinVersion(int ClientId, bool Sixup) override { Add("joinver %d %d", ClientId, Sixup); }
+	void OnDrop(int ClientId, const char *pReason) override { Add("drop %d", ClientId); }
+	void OnPlayerName(int ClientId, const char *pName) override { m_vEvents.push_back(std::string("name ") + pName); }
+	void OnPlayerTeam(int ClientId, int Team) override { Add("team %d %d", ClientId, Team); }
+	void OnPlayerFinish(int ClientId, int TimeTicks) override { Add("finish %d %d", ClientId, TimeTicks); }
+	void OnFinish() override { Add("end"); }
+};
+
+static bool ReadTeeHistorian(const char *pFilename, CTeeHistorianEventLog *pLog)
+{
+	CTeeHistorianReader Reader;
+	IOHANDLE File = io_open(pFilename, IOFLAG_READ);
+	return File && Reader.Open(File) && Reader.Read(pLog) && Reader.Finished();
+}
+
+TEST_F(TeeHistorian, Reader)
+{
+	CNetObj_PlayerInput Input = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+
+	m_TH.RecordPlayerJoin(3, CTeeHistorian::PROTOCOL_7);
+	m_TH.RecordPlayerName(3, "nameless tee");
+	Tick(1);
+	Player(3, 100, 200);
+	Inputs();
+	m_TH.RecordPlayerInput(3, 1, &Input);
+	Tick(2);
+	Player(3, 101, 198);
+	Inputs();
+	Input.m_Direction = -1;
+	m_TH.RecordPlayerInput(3, 1, &Input);
+	m_TH.RecordPlayerMessage(3, "\x01\x02", 2);
+	Tick(3);
+	Player(3, 101, 198);
+	Tick(7);
+	m_TH.RecordPlayerFinish(3, 1234);
+	m_TH.RecordPlayerTeam(3, 5);
+	DeadPlayer(3);
+	Inputs();
+	m_TH.RecordPlayerDrop(3, "bye");
+	Finish();
+
+	CTestInfo Info;
+	char aFilename[IO_MAX_PATH_LENGTH];
+	Info.Filename(aFilename, sizeof(aFilename), ".teehistorian");
+	IOHANDLE File = io_open(aFilename, IOFLAG_WRITE);
+	ASSERT_TRUE(File);
+	io_write(File, m_vBuffer.data(), m_vBuffer.size());
+	io_close(File);
+
+	CTeeHistorianEventLog Log;
+	ASSERT_TRUE(ReadTeeHistorian(aFilename, &Log));
+	const std::vector<std::string> vExpected = {
+		"joinver 3 1",
+		"join 3",
+		"name nameless tee",
+		"tick 1",
+		"player 3 100 200",
+		"input 3 1 2",
+		"tick 2",
+		"player 3 101 198",
+		"input 3 -1 2",
+		"message 3 2",
+		// tick 3 has nothing new, the positions didn't change
+		"tick 7",
+		"finish 3 1234",
+		"team 3 5",
+		"dead 3",
+		"drop 3",
+		"end",
+	};
+	EXPECT_EQ(Log.m_vEvents, vExpected);
+
+	// only compressed files have frames to seek to
+	CTeeHistorianReader Reader;
+	File = io_open(aFilename, IOFLAG_READ);
+	ASSERT_TRUE(File);
+	ASSERT_TRUE(Reader.Open(File));
+	EXPECT_FALSE(Reader.Compressed());
+	EXPECT_FALSE(Reader.SeekTick(2));
+	Reader.Close();
+
+	EXPECT_FALSE(fs_remove(aFilename));
+}
+
+TEST_F(TeeHistorian, ReaderSeek)
+{
+	CTestInfo Info;
+	char aFilename[IO_MAX_PATH_LENGTH];
+	Info.Filename(aFilename, sizeof(aFilename), ".teehistorian.z");
+	ASSERT_NO_FATAL_FAILURE(WriteCompressedGame(aFilename));
+
+	// reading the compressed file gives the same as the plain one
+	CTeeHistorianEventLog Log;
+	ASSERT_TRUE(ReadTeeHistorian(aFilename, &Log));
+	ASSERT_EQ(Log.m_vEvents.size(), 95u + 95u + 31u + 1u);
+	EXPECT_EQ(Log.m_vEvents[0], "tick 1");
+	EXPECT_EQ(Log.m_vEvents.back(), "end");
+
+	// continue at the frame starting at tick 41
+	CTeeHistorianReader Reader;
+	IOHANDLE File = io_open(aFilename, IOFLAG_READ);
+	ASSERT_TRUE(File);
+	ASSERT_TRUE(Reader.Open(File));
+	EXPECT_TRUE(Reader.Compressed());
+	EXPECT_STREQ(Reader.HeaderString("map_name"), "Kobra 3 Solo");
+	ASSERT_TRUE(Reader.SeekTick(50));
+	EXPECT_EQ(Reader.Tick(), 40);
+	EXPECT_TRUE(Reader.Player(0).m_Alive);
+	EXPECT_EQ(Reader.Player(0).m_X, 40);
+	EXPECT_EQ(Reader.Player(1).m_X, 78);
+
+	CTeeHistorianEventLog SeekLog;
+	ASSERT_TRUE(Reader.Read(&SeekLog));
+	const std::vector<std::string> vExpected(Log.m_vEvents.end() - SeekLog.m_vEvents.size(), Log.m_vEvents.end());
+	ASSERT_EQ(SeekLog.m_vEvents.front(), "tick 41");
+	EXPECT_EQ(SeekLog.m_vEvents, vExpected);
+
+	ASSERT_TRUE(Reader.SeekTick(0));
+	EXPECT_EQ(Reader.Tick(), 0);
+	Reader.Close();
+
+	EXPECT_FALSE(fs_remove(aFilename));
+}
@@ -0,0 +1,397 @@
+#include <base/logger.h>
+#include <base/system.h>
+
+#include <engine/console.h>
+#include <engine/server/antibot.h>
+#include <engine/server/databases/connection_pool.h>
+#include <engine/server/server.h>
+#include <engine/shared/config.h>
+#include <engine/shared/profiler.h>
+
+#include <game/prng.h>
+#include <game/server/gamecontext.h>
+#include <game/teehistorian_reader.h>
+
+#include "server_common.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <vector>
+
+static const char *TOOL_NAME = "server_benchmark";
+
+bool IsInterrupted()
+{
+	return false;
+}
+
+// counts the allocations of all threads, allocations through malloc aren't included
+static std::atomic<uint64_t> s_NumAllocations{0};
+
+void *operator new(size_t Size)
+{
+	s_NumAllocations.fetch_add(1, std::memory_order_relaxed);
+	void *pMemory = malloc(Size ? Size : 1);
+	dbg_assert(pMemory != nullptr, "out of memory");
+	return pMemory;
+}
+
+void *operator new[](size_t Size)
+{
+	return operator new(Size);
+}
+
+void operator delete(void *pMemory) noexcept
+{
+	free(pMemory);
+}
+
+void operator delete[](void *pMemory) noexcept
+{
+	free(pMemory);
+}
+
+void operator delete(void *pMemory, size_t Size) noexcept
+{
+	free(pMemory);
+}
+
+void operator delete[](void *pMemory, size_t Size) noexcept
+{
+	free(pMemory);
+}
+
+// collects the inputs of every player of a teehistorian file, one per tick
+class CInputRecorder : public CTeeHistorianReader::IListener
+{
+public:
+	std::vector<std::vector<CNetObj_PlayerInput>> m_vvTracks;
+
+	CInputRecorder()
+	{
+		for(int i = 0; i < MAX_CLIENTS; i++)
+			m_aTrack[i] = -1;
+	}
+
+	void OnTick(int Tick) override
+	{
+		// the inputs didn't change in the ticks that were skipped
+		const int NumTicks = m_LastTick == -1 ? 1 : Tick - m_LastTick;
+		m_LastTick = Tick;
+		for(int i = 0; i < MAX_CLIENTS; i++)
+		{
+			if(m_aTrack[i] != -1)
+				m_vvTracks[m_aTrack[i]].insert(m_vvTracks[m_aTrack[i]].end(), NumTicks, m_aInputs[i]);
+		}
+	}
+
+	void OnInput(int ClientId, const CNetObj_PlayerInput *pInput) override
+	{
+		if(m_aTrack[ClientId] == -1)
+		{
+			m_aTrack[ClientId] = m_vvTracks.size();
+			m_vvTracks.emplace_back();
+		}
+		m_aInputs[ClientId] = *pInput;
+	}
+
+	void OnJoin(int ClientId) override { m_aTrack[ClientId] = -1; }
+	void OnRejoin(int ClientId) override { m_aTrack[ClientId] = -1; }
+	void OnDrop(int ClientId, const char *pReason) override { m_aTrack[ClientId] = -1; }
+
+private:
+	int m_LastTick = -1;
+	int m_aTrack[MAX_CLIENTS];
+	CNetObj_PlayerInput m_aInputs[MAX_CLIENTS];
+};
+
+/*
+	Class: SyntheticClient
+		Produces the inputs of a benchmark client, either by looping a
+		recorded input track or by running around randomly: walking,
+		jumping, hooking and shooting in random directions.
+*/
+class CSyntheticClient
+{
+public:
+	void Init(int ClientId, const std::vector<CNetObj_PlayerInput> *pvTrack, uint64_t Seed)
+	{
+		m_pvTrack = pvTrack;
+		// spread the clients over the track so they don't move in lockstep
+		m_TrackPos = pvTrack ? (ClientId * 97) % pvTrack->size() : 0;
+		uint64_t aSeed[2] = {Seed, (uint64_t)ClientId};
+		m_Prng.Seed(aSeed);
+		m_Input = {};
+		m_NextChange = 0;
+	}
+
+	const CNetObj_PlayerInput *NextInput(int Tick)
+	{
+		if(m_pvTrack)
+		{
+			const CNetObj_PlayerInput *pInput = &(*m_pvTrack)[m_TrackPos];
+			m_TrackPos = (m_TrackPos + 1) % m_pvTrack->size();
+			return pInput;
+		}
+
+		if(Tick >= m_NextChange)
+		{
+			m_Input.m_Direction = (int)(m_Prng.RandomBits() % 3) - 1;
+			m_Input.m_TargetX = (int)(m_Prng.RandomBits() % 801) - 400;
+			m_Input.m_TargetY = (int)(m_Prng.RandomBits() % 801) - 400;
+			m_Input.m_Jump = m_Prng.RandomBits() % 3 == 0;
+			m_Input.m_Hook = m_Prng.RandomBits() % 4 == 0;
+			// odd values mean the button is held down
+			const bool Fire = m_Prng.RandomBits() % 3 == 0;
+			if(Fire != (m_Input.m_Fire & 1))
+				m_Input.m_Fire++;
+			m_Input.m_PlayerFlags = PLAYERFLAG_PLAYING;
+			m_NextChange = Tick + 5 + m_Prng.RandomBits() % SERVER_TICK_SPEED;
+		}
+		return &m_Input;
+	}
+
+private:
+	const std::vector<CNetObj_PlayerInput> *m_pvTrack;
+	size_t m_TrackPos;
+	CPrng m_Prng;
+	CNetObj_PlayerInput m_Input;
+	int m_NextChange;
+};
+
+// durations in nanoseconds, sorts the samples
+static void LogDurations(const char *pName, std::vector<int64_t> &vSamples, int64_t TotalNs)
+{
+	std::sort(vSamples.begin(), vSamples.end());
+	log_info(TOOL_NAME, "%s: avg=%.3fms p50=%.3fms p99=%.3fms max=%.3fms",
+		pName,
+		TotalNs / (double)vSamples.size() / 1000000.0,
+		vSamples[vSamples.size() / 2] / 1000000.0,
+		vSamples[(vSamples.size() - 1) * 99 / 100] / 1000000.0,
+		vSamples.back() / 1000000.0);
+}
+
+static bool LoadInputTracks(const char *pFilename, std::vector<std::vector<CNetObj_PlayerInput>> *pvvTracks, char *pMap, int MapSize)
+{
+	IOHANDLE File = io_open(pFilename, IOFLAG_READ);
+	if(!File)
+	{
+		log_error(TOOL_NAME, "%s: failed to open file", pFilename);
+		return false;
+	}
+	CTeeHistorianReader Reader;
+	if(!Reader.Open(File))
+	{
+		log_error(TOOL_NAME, "%s: %s", pFilename, Reader.Error());
+		return false;
+	}
+	CInputRecorder Recorder;
+	if(!Reader.Read(&Recorder))
+	{
+		log_error(TOOL_NAME, "%s: %s", pFilename, Reader.Error());
+		return false;
+	}
+	for(auto &vTrack : Recorder.m_vvTracks)
+	{
+		if(!vTrack.empty())
+			pvvTracks->push_back(std::move(vTrack));
+	}
+	if(pvvTracks->empty())
+	{
+		log_error(TOOL_NAME, "%s: no inputs recorded", pFilename);
+		return false;
+	}
+	if(pMap[0] == '\0')
+		str_copy(pMap, Reader.HeaderString("map_name"), MapSize);
+	return true;
+}
+
+static int Run(const char *pMap, int NumClients, int NumTicks, int NumWarmupTicks, uint64_t Seed, const std::vector<std::vector<CNetObj_PlayerInput>> &vvTracks, bool Profile, ILogger *pLogger, int argc, const char **argv)
+{
+	CServer *pServer = CreateServer();
+	CGameContext *pGameServer = new CGameContext();
+	std::unique_ptr<IKernel> pKernel = CreateServerKernel(TOOL_NAME, pServer, pGameServer, argc, argv);
+	if(!pKernel)
+		return -1;
+	IConsole *pConsole = pKernel->RequestInterface<IConsole>();
+
+	// the benchmark measures the game, not the writing of teehistorian files
+	pConsole->ExecuteLine("sv_tee_historian 0");
+
+	if(!StartServer(pServer, pGameServer, pMap))
+	{
+		log_error(TOOL_NAME, "failed to load map '%s'", pMap);
+		return -1;
+	}
+
+	pServer->InitSnapshotWorkers();
+	pServer->Antibot()->Init();
+	pGameServer->OnInit(nullptr);
+
+	std::vector<CSyntheticClient> vClients(NumClients);
+	for(int i = 0; i < NumClients; i++)
+	{
+		vClients[i].Init(i, vvTracks.empty() ? nullptr : &vvTracks[i % vvTracks.size()], Seed);
+
+		CServer::CClient &Client = pServer->m_aClients[i];
+		Client.Reset();
+		Client.m_State = CServer::CClient::STATE_READY;
+		str_format(Client.m_aName, sizeof(Client.m_aName), "bench %d", i);
+		Client.m_aClan[0] = '\0';
+		Client.m_Country = -1;
+		Client.m_Sixup = false;
+		pGameServer->OnClientConnected(i, nullptr);
+		Client.m_State = CServer::CClient::STATE_INGAME;
+		pGameServer->OnClientEnter(i);
+	}
+
+	std::vector<int64_t> vTickNs;
+	std::vector<int64_t> vSnapshotNs;
+	int64_t TickTotalNs = 0;
+	int64_t SnapshotTotalNs = 0;
+	int64_t SnapshotBytes = 0;
+	int64_t NumSnapshots = 0;
+	uint64_t NumAllocations = 0;
+	for(int i = 0; i < NumWarmupTicks + NumTicks; i++)
+	{
+		const bool Measure = i >= NumWarmupTicks;
+		if(i == NumWarmupTicks)
+		{
+			g_Profiler.Reset();
+			g_Profiler.SetEnabled(Profile);
+		}
+		const uint64_t AllocationsBefore = s_NumAllocations.load(std::memory_order_relaxed);
+
+		// inputs arrive between the ticks and are applied in the next one
+		for(int c = 0; c < NumClients; c++)
+		{
+			const CNetObj_PlayerInput *pInput = vClients[c].NextInput(pServer->Tick());
+			pGameServer->OnClientDirectInput(c, pInput);
+			CServer::CClient::CInput &Input = pServer->m_aClients[c].m_aInputs[0];
+			mem_copy(Input.m_aData, pInput, sizeof(*pInput));
+			Input.m_GameTick = pServer->Tick() + 1;
+		}
+
+		const int64_t TickStart = time_get_nanoseconds().count();
+		pServer->DoGameTick();
+		const int64_t SnapshotStart = time_get_nanoseconds().count();
+
+		const bool IsGlobalSnap = pServer->Config()->m_SvHighBandwidth || (pServer->Tick() % 2) == 0;
+		pServer->CreateSnapshots(IsGlobalSnap);
+		if(IsGlobalSnap)
+			pGameServer->OnPostGlobalSnap();
+		const int64_t SnapshotEnd = time_get_nanoseconds().count();
+
+		// the clients ack every snapshot right away
+		for(int ClientId : pServer->m_vSnapshotRecipients)
+		{
+			CServer::CClient &Client = pServer->m_aClients[ClientId];
+			const int Source = Client.m_SnapshotDeltaSource;
+			if(Measure)
+				SnapshotBytes += pServer->m_aClients[Source != -1 ? Source : ClientId].m_vSnapshotData.size();
+			Client.m_LastAckedSnapshot = pServer->Tick();
+			Client.m_SnapRate = CServer::CClient::SNAPRATE_FULL;
+		}
+
+		if(!Measure)
+			continue;
+		vTickNs.push_back(SnapshotStart - TickStart);
+		vSnapshotNs.push_back(SnapshotEnd - SnapshotStart);
+		TickTotalNs += SnapshotStart - TickStart;
+		SnapshotTotalNs += SnapshotEnd - SnapshotStart;
+		NumSnapshots += pServer->m_vSnapshotRecipients.size();
+		NumAllocations += s_NumAllocations.load(std::memory_order_relaxed) - AllocationsBefore;
+	}
+	g_Profiler.SetEnabled(false);
+
+	pGameServer->OnShutdown(nullptr);
+	pServer->ShutdownSnapshotWorkers();
+	pServer->m_pMap->Unload();
+	pServer->DbPool()->OnShutdown();
+	pLogger->SetFilter(CLogFilter{LEVEL_INFO});
+
+	log_info(TOOL_NAME, "map=%s clients=%d ticks=%d input=%s", pMap, NumClients, NumTicks, vvTracks.empty() ? "scripted" : "recorded");
+	LogDurations("tick", vTickNs, TickTotalNs);
+	LogDurations("snapshot", vSnapshotNs, SnapshotTotalNs);
+	log_info(TOOL_NAME, "throughput: %.0f ticks/s, %.1fx real time",
+		NumTicks / ((TickTotalNs + SnapshotTotalNs) / 1000000000.0),
+		NumTicks / (float)SERVER_TICK_SPEED / ((TickTotalNs + SnapshotTotalNs) / 1000000000.0));
+	log_info(TOOL_NAME, "snapshot bytes: %.0f per tick, %.0f per snapshot",
+		SnapshotBytes / (double)NumTicks,
+		NumSnapshots ? SnapshotBytes / (double)NumSnapshots : 0.0);
+	log_info(TOOL_NAME, "allocations: %.1f per tick", NumAllocations / (double)NumTicks);
+
+	if(Profile)
+	{
+		for(int i = 0; i < g_Profiler.NumSections(); i++)
+		{
+			const CProfiler::CSection &Section = g_Profiler.GetSection(i);
+			if(Section.m_Count == 0)
+				continue;
+			log_info(TOOL_NAME, "%s: %.3fms per tick, count=%" PRId64 " p99<%.3fms max=%.3fms",
+				Section.m_pName,
+				Section.m_TotalNs / (double)NumTicks / 1000000.0,
+				Section.m_Count,
+				g_Profiler.Percentile(i, 0.99f) / 1000000.0,
+				Section.m_MaxNs / 1000000.0);
+		}
+	}
+	return 0;
+}
+
+int main(int argc, const char **argv)
+{
+	const CCmdlineFix CmdlineFix(&argc, &argv);
+	std::shared_ptr<ILogger> pStdoutLogger = std::shared_ptr<ILogger>(log_logger_stdout());
+	log_set_global_logger(log_logger_collection({pStdoutLogger}).release());
+
+	char aMap[IO_MAX_PATH_LENGTH] = "";
+	const char *pInputs = nullptr;
+	int NumClients = 16;
+	int NumTicks = 30 * SERVER_TICK_SPEED;
+	int NumWarmupTicks = SERVER_TICK_SPEED;
+	uint64_t Seed = 0;
+	bool Profile = false;
+	bool Verbose = false;
+	bool Usage = false;
+	for(int i = 1; i < argc; i++)
+	{
+		if(str_comp(argv[i], "-m") == 0 && i + 1 < argc)
+			str_copy(aMap, argv[++i]);
+		else if(str_comp(argv[i], "-n") == 0 && i + 1 < argc)
+			NumClients = std::clamp(str_toint(argv[++i]), 0, (int)MAX_CLIENTS);
+		else if(str_comp(argv[i], "-t") == 0 && i + 1 < argc)
+			NumTicks = maximum(str_toint(argv[++i]), 1);
+		else if(str_comp(argv[i], "-w") == 0 && i + 1 < argc)
+			NumWarmupTicks = maximum(str_toint(argv[++i]), 0);
+		else if(str_comp(argv[i], "-s") == 0 && i + 1 < argc)
+			Seed = str_toint(argv[++i]);
+		else if(str_comp(argv[i], "-i") == 0 && i + 1 < argc)
+			pInputs = argv[++i];
+		else if(str_comp(argv[i], "-p") == 0)
+			Profile = true;
+		else if(str_comp(argv[i], "-v") == 0)
+			Verbose = true;
+		else
+			Usage = true;
+	}
+	if(Usage || (aMap[0] == '\0' && !pInputs))
+	{
+		log_error(TOOL_NAME, "Usage: %s -m <map> [-n <clients>] [-t <ticks>] [-w <warmup ticks>] [-s <seed>] [-i <teehistorian file>] [-p] [-v]", TOOL_NAME);
+		log_error(TOOL_NAME, "Runs the server with synthetic clients without network and reports the tick times, snapshot sizes and allocations.");
+		log_error(TOOL_NAME, "The clients move randomly, or replay the inputs of the players of a teehistorian file with -i, whose map is used unless -m is given.");
+		log_error(TOOL_NAME, "-p additionally reports the sections of the tick profiler.");
+		return -1;
+	}
+
+	std::vector<std::vector<CNetObj_PlayerInput>> vvTracks;
+	if(pInputs && !LoadInputTracks(pInputs, &vvTracks, aMap, sizeof(aMap)))
+		return -1;
+
+	// the server logs a lot, only show its warnings unless asked to
+	if(!Verbose)
+		pStdoutLogger->SetFilter(CLogFilter{LEVEL_WARN});
+
+	return Run(aMap, NumClients, NumTicks, NumWarmupTicks, Seed, vvTracks, Profile, pStdoutLogger.get(), argc, argv) == 0 ? 0 : 1;
+}
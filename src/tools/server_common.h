@@ -0,0 +1,81 @@
+#ifndef TOOLS_SERVER_COMMON_H
+#define TOOLS_SERVER_COMMON_H
+
+#include <base/logger.h>
+#include <base/system.h>
+
+#include <engine/console.h>
+#include <engine/engine.h>
+#include <engine/kernel.h>
+#include <engine/map.h>
+#include <engine/server/antibot.h>
+#include <engine/server/server.h>
+#include <engine/shared/config.h>
+#include <engine/storage.h>
+
+#include <game/version.h>
+
+#include <cstdlib>
+#include <memory>
+
+// Creates the kernel with the interfaces of a server without network and
+// initializes them up to the registration of the server commands. Returns
+// nullptr on errors. The console can be configured before StartServer.
+inline std::unique_ptr<IKernel> CreateServerKernel(const char *pToolName, CServer *pServer, IGameServer *pGameServer, int argc, const char **argv)
+{
+	std::unique_ptr<IKernel> pKernel = std::unique_ptr<IKernel>(IKernel::Create());
+	pKernel->RegisterInterface(pServer);
+
+	IEngine *pEngine = CreateEngine(GAME_NAME, nullptr);
+	pKernel->RegisterInterface(pEngine);
+
+	IStorage *pStorage = CreateStorage(IStorage::EInitializationType::SERVER, argc, argv);
+	if(!pStorage)
+	{
+		log_error(pToolName, "failed to initialize storage");
+		return nullptr;
+	}
+	pKernel->RegisterInterface(pStorage);
+
+	IConsole *pConsole = CreateConsole(CFGFLAG_SERVER | CFGFLAG_ECON).release();
+	pKernel->RegisterInterface(pConsole);
+
+	IConfigManager *pConfigManager = CreateConfigManager();
+	pKernel->RegisterInterface(pConfigManager);
+
+	IEngineMap *pEngineMap = CreateEngineMap();
+	pKernel->RegisterInterface(pEngineMap);
+	pKernel->RegisterInterface(static_cast<IMap *>(pEngineMap), false);
+
+	IEngineAntibot *pEngineAntibot = CreateEngineAntibot();
+	pKernel->RegisterInterface(pEngineAntibot);
+	pKernel->RegisterInterface(static_cast<IAntibot *>(pEngineAntibot), false);
+
+	pKernel->RegisterInterface(pGameServer);
+
+	pEngine->Init();
+	pConsole->Init();
+	pConfigManager->Init();
+	pServer->RegisterCommands();
+	return pKernel;
+}
+
+// Does what CServer::Run does before the main loop, up to loading the map.
+// Returns false if the map can't be loaded. The antibot and the game server
+// still have to be initialized afterwards.
+inline bool StartServer(CServer *pServer, IGameServer *pGameServer, const char *pMap)
+{
+	pServer->m_RunServer = CServer::RUNNING;
+	pServer->m_AuthManager.Init();
+	const int PersistentDataSize = pGameServer->PersistentClientDataSize();
+	for(auto &Client : pServer->m_aClients)
+	{
+		Client.m_HasPersistentData = false;
+		Client.m_pPersistentData = malloc(PersistentDataSize);
+	}
+	pServer->m_pPersistentData = malloc(pGameServer->PersistentDataSize());
+
+	return pServer->LoadMap(pMap);
+}
+
+#endif // TOOLS_SERVER_COMMON_H
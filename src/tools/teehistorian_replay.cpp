@@ -0,0 +1,578 @@
+#include <base/hash.h>
+#include <base/logger.h>
+#include <base/system.h>
+
+#include <engine/console.h>
+#include <engine/server/antibot.h>
+#include <engine/server/databases/connection_pool.h>
+#include <engine/server/server.h>
+#include <engine/shared/config.h>
+#include <engine/shared/json.h>
+#include <engine/shared/protocol_ex.h>
+
+#include <game/server/entities/character.h>
+#include <game/server/gamecontext.h>
+#include <game/teehistorian_reader.h>
+
+#include "server_common.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+static const char *TOOL_NAME = "teehistorian_replay";
+
+bool IsInterrupted()
+{
+	return false;
+}
+
+// records the finishes of the simulation instead of writing a teehistorian file
+class CReplayGameContext : public CGameContext
+{
+public:
+	struct CFinish
+	{
+		int m_Tick;
+		int m_Id;
+		int m_TimeTicks;
+		bool m_Team;
+	};
+	std::vector<CFinish> m_vFinishes;
+
+	void TeehistorianRecordPlayerFinish(int ClientId, int TimeTicks) override
+	{
+		m_vFinishes.push_back({Server()->Tick(), ClientId, TimeTicks, false});
+	}
+
+	void TeehistorianRecordTeamFinish(int TeamId, int TimeTicks) override
+	{
+		m_vFinishes.push_back({Server()->Tick(), TeamId, TimeTicks, true});
+	}
+};
+
+/*
+	Class: Replay
+		Feeds the recorded joins, messages, rcon commands and inputs into a
+		server without network and compares the simulated characters with
+		the recorded ones after every tick.
+
+		Chat commands aren't replayed from the recorded console commands
+		because they are executed again by the replayed chat messages.
+		Commands of the server console aren't replayed either, the
+		recording can't tell them apart from the commands executed by the
+		game itself, e.g. for votes.
+*/
+class CReplay : public CTeeHistorianReader::IListener
+{
+public:
+	CReplay(const char *pFilename, CTeeHistorianReader *pReader, CServer *pServer, CReplayGameContext *pGameServer, bool Verbose) :
+		m_pFilename(pFilename), m_pReader(pReader), m_pServer(pServer), m_pGameServer(pGameServer), m_Verbose(Verbose)
+	{
+		for(int i = 0; i < MAX_CLIENTS; i++)
+		{
+			m_aHasInput[i] = false;
+			m_aDiverged[i] = false;
+		}
+	}
+
+	int NumTicks() const { return m_NumTicks; }
+	int NumDiverged() const { return m_NumDiverged; }
+
+	// compares the finishes of the file with the simulated ones, returns the number of mismatches
+	int CheckFinishes() const
+	{
+		std::vector<bool> vMatched(m_pGameServer->m_vFinishes.size(), false);
+		int NumMismatches = 0;
+		for(const CReplayGameContext::CFinish &Expected : m_vExpectedFinishes)
+		{
+			bool Found = false;
+			for(size_t i = 0; i < vMatched.size() && !Found; i++)
+			{
+				const CReplayGameContext::CFinish &Finish = m_pGameServer->m_vFinishes[i];
+				if(!vMatched[i] && Finish.m_Team == Expected.m_Team && Finish.m_Id == Expected.m_Id && Finish.m_TimeTicks == Expected.m_TimeTicks)
+				{
+					vMatched[i] = true;
+					Found = true;
+				}
+			}
+			if(!Found)
+			{
+				log_warn(TOOL_NAME, "%s: tick %d: %s %d finished in %d ticks, not reproduced", m_pFilename, Expected.m_Tick, Expected.m_Team ? "team" : "player", Expected.m_Id, Expected.m_TimeTicks);
+				NumMismatches++;
+			}
+		}
+		for(size_t i = 0; i < vMatched.size(); i++)
+		{
+			if(vMatched[i])
+				continue;
+			const CReplayGameContext::CFinish &Finish = m_pGameServer->m_vFinishes[i];
+			log_warn(TOOL_NAME, "%s: tick %d: %s %d finished in %d ticks, not recorded", m_pFilename, Finish.m_Tick, Finish.m_Team ? "team" : "player", Finish.m_Id, Finish.m_TimeTicks);
+			NumMismatches++;
+		}
+		return NumMismatches;
+	}
+
+	int NumExpectedFinishes() const { return m_vExpectedFinishes.size(); }
+
+	void OnTick(int Tick) override
+	{
+		CheckPlayers();
+		if(!m_Started)
+		{
+			m_pServer->SetTick(Tick - 1);
+			m_Started = true;
+		}
+		while(m_pServer->Tick() < Tick)
+		{
+			Step();
+			// nothing was recorded for skipped ticks, so nothing may change in them
+			m_CheckPending = true;
+			if(m_pServer->Tick() < Tick)
+				CheckPlayers();
+		}
+	}
+
+	void OnPlayer(int ClientId, int x, int y) override
+	{
+		CCharacter *pChr = m_pGameServer->GetPlayerChar(ClientId);
+		char aBuf[128];
+		if(!pChr)
+		{
+			str_format(aBuf, sizeof(aBuf), "character missing, recorded at (%d, %d)", x, y);
+			Diverge(ClientId, aBuf);
+			return;
+		}
+		CNetObj_CharacterCore Core;
+		pChr->GetCore().Write(&Core);
+		if(Core.m_X != x || Core.m_Y != y)
+		{
+			str_format(aBuf, sizeof(aBuf), "character at (%d, %d), recorded at (%d, %d)", Core.m_X, Core.m_Y, x, y);
+			Diverge(ClientId, aBuf);
+		}
+	}
+
+	void OnDeadPlayer(int ClientId) override
+	{
+		if(m_pGameServer->GetPlayerChar(ClientId))
+			Diverge(ClientId, "character alive, recorded dead");
+	}
+
+	void OnInput(int ClientId, const CNetObj_PlayerInput *pInput) override
+	{
+		CheckPlayers();
+		m_aInputs[ClientId] = *pInput;
+		m_aHasInput[ClientId] = true;
+		// inputs are received between the ticks, the server handles them right away
+		if(m_pServer->m_aClients[ClientId].m_State == CServer::CClient::STATE_INGAME)
+			m_pGameServer->OnClientDirectInput(ClientId, pInput);
+	}
+
+	void OnMessage(int ClientId, const void *pMsg, int MsgSize) override
+	{
+		CheckPlayers();
+		if(!EnsureConnected(ClientId))
+			return;
+
+		CUnpacker Unpacker;
+		Unpacker.Reset(pMsg, MsgSize);
+		CMsgPacker Packer(NETMSG_EX, true);
+		int Msg;
+		bool Sys;
+		CUuid Uuid;
+		if(UnpackMessageId(&Msg, &Sys, &Uuid, &Unpacker, &Packer) == UNPACKMESSAGE_ERROR || Sys)
+			return;
+		m_pGameServer->OnMessage(Msg, &Unpacker, ClientId);
+	}
+
+	void OnJoin(int ClientId) override
+	{
+		CheckPlayers();
+		ResetClient(ClientId, "join");
+	}
+
+	void OnJoinVersion(int ClientId, bool Sixup) override
+	{
+		m_pServer->m_aClients[ClientId].m_Sixup = Sixup;
+	}
+
+	void OnRejoin(int ClientId) override
+	{
+		CheckPlayers();
+		ResetClient(ClientId, "rejoin");
+	}
+
+	void OnReady(int ClientId) override
+	{
+		CheckPlayers();
+		if(!EnsureConnected(ClientId))
+			return;
+		m_pServer->m_aClients[ClientId].m_State = CServer::CClient::STATE_INGAME;
+		m_pGameServer->OnClientEnter(ClientId);
+	}
+
+	void OnDrop(int ClientId, const char *pReason) override
+	{
+		CheckPlayers();
+		CServer::CClient &Client = m_pServer->m_aClients[ClientId];
+		if(Client.m_State >= CServer::CClient::STATE_READY)
+			m_pGameServer->OnClientDrop(ClientId, pReason);
+		Client.m_State = CServer::CClient::STATE_EMPTY;
+		Client.m_aName[0] = '\0';
+		Client.m_aClan[0] = '\0';
+		Client.m_Sixup = false;
+		m_aHasInput[ClientId] = false;
+	}
+
+	void OnConsoleCommand(int ClientId, int FlagMask, const char *pCmd, int NumArgs, const char **ppArgs) override
+	{
+		if(ClientId < 0 || (FlagMask & CFGFLAG_CHAT))
+			return;
+		CheckPlayers();
+
+		char aLine[1024];
+		str_copy(aLine, pCmd);
+		for(int i = 0; i < NumArgs; i++)
+		{
+			char aArg[512];
+			char *pDst = aArg;
+			str_escape(&pDst, ppArgs[i], aArg + sizeof(aArg));
+			str_append(aLine, " \"");
+			str_append(aLine, aArg);
+			str_append(aLine, "\"");
+		}
+		m_pGameServer->Console()->ExecuteLineFlag(aLine, FlagMask, ClientId, false);
+	}
+
+	void OnPlayerFinish(int ClientId, int TimeTicks) override
+	{
+		m_vExpectedFinishes.push_back({m_pReader->Tick(), ClientId, TimeTicks, false});
+	}
+
+	void OnTeamFinish(int Team, int TimeTicks) override
+	{
+		m_vExpectedFinishes.push_back({m_pReader->Tick(), Team, TimeTicks, true});
+	}
+
+	void OnFinish() override
+	{
+		CheckPlayers();
+	}
+
+private:
+	const char *m_pFilename;
+	CTeeHistorianReader *m_pReader;
+	CServer *m_pServer;
+	CReplayGameContext *m_pGameServer;
+	bool m_Verbose;
+
+	bool m_Started = false;
+	int m_NumTicks = 0;
+	// the recorded positions of the last tick haven't been compared yet
+	bool m_CheckPending = false;
+
+	CNetObj_PlayerInput m_aInputs[MAX_CLIENTS];
+	bool m_aHasInput[MAX_CLIENTS];
+	bool m_aDiverged[MAX_CLIENTS];
+	int m_NumDiverged = 0;
+	std::vector<CReplayGameContext::CFinish> m_vExpectedFinishes;
+
+	void Step()
+	{
+		for(int i = 0; i < MAX_CLIENTS; i++)
+		{
+			if(!m_aHasInput[i])
+				continue;
+			CServer::CClient::CInput &Input = m_pServer->m_aClients[i].m_aInputs[0];
+			mem_copy(Input.m_aData, &m_aInputs[i], sizeof(m_aInputs[i]));
+			Input.m_GameTick = m_pServer->Tick() + 1;
+		}
+		m_pServer->DoGameTick();
+		m_NumTicks++;
+	}
+
+	// the player data of a tick is complete once the next event or tick starts
+	void CheckPlayers()
+	{
+		if(!m_CheckPending)
+			return;
+		m_CheckPending = false;
+
+		for(int i = 0; i < MAX_CLIENTS; i++)
+		{
+			const CTeeHistorianReader::CPlayer &Player = m_pReader->Player(i);
+			if(Player.m_Alive)
+				OnPlayer(i, Player.m_X, Player.m_Y);
+			else
+				OnDeadPlayer(i);
+		}
+	}
+
+	void ResetClient(int ClientId, const char *pReason)
+	{
+		CServer::CClient &Client = m_pServer->m_aClients[ClientId];
+		if(Client.m_State >= CServer::CClient::STATE_READY)
+			m_pGameServer->OnClientDrop(ClientId, pReason);
+		Client.Reset();
+		Client.m_State = CServer::CClient::STATE_CONNECTING;
+		Client.m_aName[0] = '\0';
+		Client.m_aClan[0] = '\0';
+		Client.m_Country = -1;
+		Client.m_Sixup = false;
+		m_aHasInput[ClientId] = false;
+		m_aDiverged[ClientId] = false;
+	}
+
+	// the readiness of the client isn't recorded, it's implied by its first message
+	bool EnsureConnected(int ClientId)
+	{
+		CServer::CClient &Client = m_pServer->m_aClients[ClientId];
+		if(Client.m_State == CServer::CClient::STATE_CONNECTING)
+		{
+			Client.m_State = CServer::CClient::STATE_READY;
+			m_pGameServer->OnClientConnected(ClientId, nullptr);
+		}
+		return Client.m_State >= CServer::CClient::STATE_READY;
+	}
+
+	void Diverge(int ClientId, const char *pReason)
+	{
+		if(m_aDiverged[ClientId] && !m_Verbose)
+			return;
+		if(!m_aDiverged[ClientId])
+			m_NumDiverged++;
+		m_aDiverged[ClientId] = true;
+		log_warn(TOOL_NAME, "%s: tick %d: cid=%d diverged: %s", m_pFilename, m_pServer->Tick(), ClientId, pReason);
+	}
+};
+
+static bool ApplyHeader(const CTeeHistorianReader &Reader, IConsole *pConsole)
+{
+	const json_value *pConfig = json_object_get(Reader.Header(), "config");
+	if(pConfig->type != json_object)
+		return false;
+	for(unsigned i = 0; i < pConfig->u.object.length; i++)
+	{
+		const json_value *pValue = pConfig->u.object.values[i].value;
+		if(pValue->type != json_string)
+			return false;
+		char aValue[512];
+		char *pDst = aValue;
+		str_escape(&pDst, json_string_get(pValue), aValue + sizeof(aValue));
+		char aLine[1024];
+		str_format(aLine, sizeof(aLine), "%s \"%s\"", pConfig->u.object.values[i].name, aValue);
+		pConsole->ExecuteLine(aLine);
+	}
+	return true;
+}
+
+static bool ApplyTuning(const CTeeHistorianReader &Reader, CTuningParams *pTuning)
+{
+	// the values are stored as integers, setting them as floats could round them
+	const json_value *pTuningJson = json_object_get(Reader.Header(), "tuning");
+	if(pTuningJson->type != json_object)
+		return false;
+	for(unsigned i = 0; i < pTuningJson->u.object.length; i++)
+	{
+		const json_value *pValue = pTuningJson->u.object.values[i].value;
+		if(pValue->type != json_string)
+			return false;
+		for(int Index = 0; Index < CTuningParams::Num(); Index++)
+		{
+			if(str_comp(CTuningParams::Name(Index), pTuningJson->u.object.values[i].name) == 0)
+				((CTuneParam *)pTuning)[Index].Set(str_toint(json_string_get(pValue)));
+		}
+	}
+	return true;
+}
+
+static bool SeedPrng(const char *pDescription, CPrng *pPrng)
+{
+	unsigned aSeed[4];
+	if(sscanf(pDescription, "pcg-xsh-rr:%08x%08x:%08x%08x", &aSeed[0], &aSeed[1], &aSeed[2], &aSeed[3]) != 4)
+		return false;
+	uint64_t aSeed64[2] = {
+		((uint64_t)aSeed[0] << 32) | aSeed[1],
+		((uint64_t)aSeed[2] << 32) | aSeed[3],
+	};
+	pPrng->Seed(aSeed64);
+	return str_comp(pPrng->Description(), pDescription) == 0;
+}
+
+// returns 0 if the replay matches the recording, 1 if it diverged and -1 on errors
+static int Replay(const char *pFilename, bool Verbose, ILogger *pLogger, int argc, const char **argv)
+{
+	// the server logs a lot, only show its warnings unless asked to
+	if(!Verbose)
+		pLogger->SetFilter(CLogFilter{LEVEL_WARN});
+
+	CTeeHistorianReader Reader;
+	IOHANDLE File = io_open(pFilename, IOFLAG_READ);
+	if(!File)
+	{
+		log_error(TOOL_NAME, "%s: failed to open file", pFilename);
+		return -1;
+	}
+	if(!Reader.Open(File))
+	{
+		log_error(TOOL_NAME, "%s: %s", pFilename, Reader.Error());
+		return -1;
+	}
+
+	CServer *pServer = CreateServer();
+	CReplayGameContext *pGameServer = new CReplayGameContext();
+	std::unique_ptr<IKernel> pKernel = CreateServerKernel(TOOL_NAME, pServer, pGameServer, argc, argv);
+	if(!pKernel)
+		return -1;
+	IConsole *pConsole = pKernel->RequestInterface<IConsole>();
+
+	if(!ApplyHeader(Reader, pConsole))
+	{
+		log_error(TOOL_NAME, "%s: invalid config in header", pFilename);
+		return -1;
+	}
+	pConsole->ExecuteLine("sv_tee_historian 0");
+
+	const char *pMap = Reader.HeaderString("map_name");
+	if(!StartServer(pServer, pGameServer, pMap))
+	{
+		log_error(TOOL_NAME, "%s: failed to load map '%s'", pFilename, pMap);
+		return -1;
+	}
+	char aSha256[SHA256_MAXSTRSIZE];
+	sha256_str(pServer->m_aCurrentMapSha256[CServer::MAP_TYPE_SIX], aSha256, sizeof(aSha256));
+	if(str_comp(aSha256, Reader.HeaderString("map_sha256")) != 0)
+	{
+		log_error(TOOL_NAME, "%s: map '%s' differs from the recorded one, sha256 %s, recorded %s", pFilename, pMap, aSha256, Reader.HeaderString("map_sha256"));
+		return -1;
+	}
+
+	pServer->Antibot()->Init();
+	pGameServer->OnInit(nullptr);
+
+	if(!ApplyTuning(Reader, pGameServer->Tuning()))
+	{
+		log_error(TOOL_NAME, "%s: invalid tuning in header", pFilename);
+		return -1;
+	}
+	if(!SeedPrng(Reader.HeaderString("prng_description"), pGameServer->Prng()))
+	{
+		log_error(TOOL_NAME, "%s: unknown random number generator '%s'", pFilename, Reader.HeaderString("prng_description"));
+		return -1;
+	}
+
+	CReplay Replay(pFilename, &Reader, pServer, pGameServer, Verbose);
+	const int64_t StartTime = time_get();
+	const bool Success = Reader.Read(&Replay);
+	const float Duration = (time_get() - StartTime) / (float)time_freq();
+
+	pGameServer->OnShutdown(nullptr);
+	pServer->m_pMap->Unload();
+	pServer->DbPool()->OnShutdown();
+	pLogger->SetFilter(CLogFilter{LEVEL_INFO});
+
+	if(!Success)
+	{
+		log_error(TOOL_NAME, "%s: %s", pFilename, Reader.Error());
+		return -1;
+	}
+
+	const int NumFinishMismatches = Replay.CheckFinishes();
+	log_info(TOOL_NAME, "%s: %s, %d ticks in %.2fs (%.0fx real time), %d/%d players diverged, %d/%d finishes reproduced",
+		pFilename,
+		Replay.NumDiverged() == 0 && NumFinishMismatches == 0 ? "ok" : "diverged",
+		Replay.NumTicks(), Duration, Replay.NumTicks() / (float)SERVER_TICK_SPEED / maximum(Duration, 0.001f),
+		Replay.NumDiverged(), MAX_CLIENTS,
+		Replay.NumExpectedFinishes() - minimum(NumFinishMismatches, Replay.NumExpectedFinishes()), Replay.NumExpectedFinishes());
+	return Replay.NumDiverged() == 0 && NumFinishMismatches == 0 ? 0 : 1;
+}
+
+int main(int argc, const char **argv)
+{
+	const CCmdlineFix CmdlineFix(&argc, &argv);
+	std::shared_ptr<ILogger> pStdoutLogger = std::shared_ptr<ILogger>(log_logger_stdout());
+	log_set_global_logger(log_logger_collection({pStdoutLogger}).release());
+
+	int Jobs = 1;
+	bool Verbose = false;
+	std::vector<const char *> vpFiles;
+	for(int i = 1; i < argc; i++)
+	{
+		if(str_comp(argv[i], "-j") == 0 && i + 1 < argc)
+			Jobs = maximum(str_toint(argv[++i]), 1);
+		else if(str_comp(argv[i], "-v") == 0)
+			Verbose = true;
+		else
+			vpFiles.push_back(argv[i]);
+	}
+	if(vpFiles.empty())
+	{
+		log_error(TOOL_NAME, "Usage: %s [-v] [-j <jobs>] <teehistorian file>...", TOOL_NAME);
+		log_error(TOOL_NAME, "Replays the recorded games and reports where they diverge from the recording.");
+		return -1;
+	}
+
+	if(vpFiles.size() == 1)
+		return Replay(vpFiles[0], Verbose, pStdoutLogger.get(), argc, argv) == 0 ? 0 : 1;
+
+	// every file needs a fresh config, the config is global so each file gets its own process
+	struct CJob
+	{
+		const char *m_pFile;
+		PROCESS m_Process;
+	};
+	std::vector<CJob> vJobs;
+	std::vector<const char *> vpFailed;
+	const auto &&CollectFinished = [&]() {
+		vJobs.erase(std::remove_if(vJobs.begin(), vJobs.end(), [&](const CJob &Job) {
+			int ExitCode;
+			if(!process_exit_code(Job.m_Process, &ExitCode))
+				return false;
+			if(ExitCode != 0)
+				vpFailed.push_back(Job.m_pFile);
+			return true;
+		}),
+			vJobs.end());
+	};
+	for(const char *pFile : vpFiles)
+	{
+		while((int)vJobs.size() >= Jobs)
+		{
+			CollectFinished();
+			if((int)vJobs.size() >= Jobs)
+				std::this_thread::sleep_for(10ms);
+		}
+		std::vector<const char *> vpArgs;
+		if(Verbose)
+			vpArgs.push_back("-v");
+		vpArgs.push_back(pFile);
+		PROCESS Process = shell_execute(argv[0], EShellExecuteWindowState::BACKGROUND, vpArgs.data(), vpArgs.size());
+		if(Process == INVALID_PROCESS)
+		{
+			log_error(TOOL_NAME, "%s: failed to start replay process", pFile);
+			vpFailed.push_back(pFile);
+			continue;
+		}
+		vJobs.push_back({pFile, Process});
+	}
+	while(!vJobs.empty())
+	{
+		CollectFinished();
+		if(!vJobs.empty())
+			std::this_thread::sleep_for(10ms);
+	}
+
+	if(vpFailed.empty())
+	{
+		log_info(TOOL_NAME, "all %d files replayed without differences", (int)vpFiles.size());
+		return 0;
+	}
+	log_error(TOOL_NAME, "%d of %d files failed:", (int)vpFailed.size(), (int)vpFiles.size());
+	for(const char *pFile : vpFailed)
+		log_error(TOOL_NAME, "  %s", pFile);
+	return 1;
+}